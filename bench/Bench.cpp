@@ -0,0 +1,138 @@
+#include "Bench.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include "Tensor.hpp"
+#include "backends/cpu/compute/GEMM_AArch64.hpp"
+#include "backends/cpu/compute/VecDotType.hpp"
+
+namespace mllm {
+
+void BenchRunner::add(BenchResult result) {
+    results_.push_back(std::move(result));
+    const auto &last = results_.back();
+    std::cerr << last.name << ": " << std::fixed << std::setprecision(2) << last.mean_us << " us" << std::defaultfloat << std::endl;
+}
+
+void BenchRunner::print(std::ostream &os) const {
+    size_t width = 4;
+    for (const auto &result : results_) {
+        width = std::max(width, result.name.size());
+    }
+    os << std::left << std::setw((int)width) << "name" << std::right << std::setw(10) << "iters" << std::setw(14) << "mean us"
+       << std::setw(14) << "min us" << std::setw(10) << "GFLOP/s" << std::setw(9) << "GB/s" << "\n";
+    for (const auto &result : results_) {
+        os << std::left << std::setw((int)width) << result.name << std::right << std::fixed
+           << std::setw(10) << result.iterations
+           << std::setw(14) << std::setprecision(2) << result.mean_us
+           << std::setw(14) << std::setprecision(2) << result.min_us;
+        if (result.flops > 0) {
+            os << std::setw(10) << std::setprecision(2) << result.flops / result.mean_us / 1e3;
+        } else {
+            os << std::setw(10) << "-";
+        }
+        if (result.bytes > 0) {
+            os << std::setw(9) << std::setprecision(2) << result.bytes / result.mean_us / 1e3;
+        } else {
+            os << std::setw(9) << "-";
+        }
+        os << "\n";
+    }
+    os << std::defaultfloat << std::flush;
+}
+
+static std::string jsonString(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+static std::string jsonObject(const std::vector<std::pair<std::string, std::string>> &values) {
+    std::string out = "{";
+    for (size_t i = 0; i < values.size(); ++i) {
+        out += (i == 0 ? "" : ", ") + jsonString(values[i].first) + ": " + jsonString(values[i].second);
+    }
+    return out + "}";
+}
+
+bool BenchRunner::writeJson(const std::string &path, const std::vector<std::pair<std::string, std::string>> &context) const {
+    FILE *fp = fopen(path.c_str(), "w");
+    if (fp == nullptr) {
+        std::cerr << "Can not open " << path << std::endl;
+        return false;
+    }
+    fprintf(fp, "{\n  \"context\": %s,\n  \"benchmarks\": [\n", jsonObject(context).c_str());
+    for (size_t i = 0; i < results_.size(); ++i) {
+        const auto &result = results_[i];
+        fprintf(fp, "    {\"name\": %s, \"params\": %s, \"iterations\": %d, \"mean_us\": %.3f, \"min_us\": %.3f, \"gflops\": %.3f, \"gbps\": %.3f}%s\n",
+                jsonString(result.name).c_str(), jsonObject(result.params).c_str(), result.iterations, result.mean_us, result.min_us,
+                result.flops / result.mean_us / 1e3, result.bytes / result.mean_us / 1e3, i + 1 == results_.size() ? "" : ",");
+    }
+    fprintf(fp, "  ]\n}\n");
+    const bool ok = ferror(fp) == 0;
+    fclose(fp);
+    return ok;
+}
+
+std::vector<float> randomFloats(size_t n, unsigned seed, float scale) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-scale, scale);
+    std::vector<float> values(n);
+    for (auto &value : values) {
+        value = dist(rng);
+    }
+    return values;
+}
+
+bool convertRows(const float *src, void *dst, DataType type, int64_t rows, int64_t cols) {
+    if (type == MLLM_TYPE_F32) {
+        memcpy(dst, src, rows * cols * sizeof(float));
+        return true;
+    }
+    if (type == MLLM_TYPE_Q4_0_4_4) {
+        quantize_q4_0_4x4(src, dst, rows, cols, nullptr);
+        return true;
+    }
+    const auto from_float = type_traits[type].from_float;
+    if (from_float == nullptr || cols % type_traits[type].blck_size != 0) {
+        return false;
+    }
+    const size_t row_size = cols / type_traits[type].blck_size * type_traits[type].size;
+    for (int64_t r = 0; r < rows; ++r) {
+        from_float(src + r * cols, (char *)dst + r * row_size, (int)cols);
+    }
+    return true;
+}
+
+bool fillRandom(Tensor &tensor, unsigned seed, float scale) {
+    const int64_t cols = tensor.dimension();
+    const int64_t rows = cols == 0 ? 0 : tensor.count() / cols;
+    const auto values = randomFloats(rows * cols, seed, scale);
+    return convertRows(values.data(), tensor.rawHostPtr(), tensor.dtype(), rows, cols);
+}
+
+bool RandomLoader::load(Tensor *tensor) {
+    if (tensor->name().find("norm") != std::string::npos) {
+        for (int i = 0; i < tensor->count(); ++i) {
+            tensor->hostPtr<float>()[i] = 1.0F;
+        }
+        return true;
+    }
+    return fillRandom(*tensor, (unsigned)std::hash<std::string>()(tensor->name()), 0.05F);
+}
+
+DataType RandomLoader::getDataType(string name) {
+    if (name.find("norm") != std::string::npos || name.find("embed") != std::string::npos) {
+        return MLLM_TYPE_F32;
+    }
+    return weight_type_;
+}
+
+} // namespace mllm
@@ -0,0 +1,165 @@
+#ifndef MLLM_BENCH_HPP
+#define MLLM_BENCH_HPP
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ParamLoader.hpp"
+#include "Types.hpp"
+
+namespace mllm {
+class Backend;
+class Tensor;
+
+/**
+ * \brief the timing of one benchmark, see BenchRunner.
+ */
+struct BenchResult {
+    std::string name; // e.g. "mat_mul/Q4_0/1x4096x4096"
+    std::vector<std::pair<std::string, std::string>> params;
+    int iterations = 0;
+    double mean_us = 0;
+    double min_us = 0;
+    double flops = 0; // of one iteration, 0 if not counted
+    double bytes = 0; // read and written by one iteration
+};
+
+/**
+ * \brief runs the benchmarks whose names match a filter and collects their results.
+ *
+ * each benchmark is run once to warm up, then repeated until it ran for min_time seconds (and at least 3 times).
+ * The results are printed as a table and written as JSON, see writeJson(), to track regressions between builds.
+ */
+class BenchRunner {
+public:
+    /**
+     * \param filter an ECMAScript regex the names of the benchmarks to run contain, all of them if empty.
+     */
+    BenchRunner(const std::string &filter, double min_time) :
+        filter_(filter.empty() ? ".*" : filter), min_time_(min_time) {
+    }
+
+    bool enabled(const std::string &name) const {
+        return std::regex_search(name, filter_);
+    }
+
+    /**
+     * \brief time fn() if `name` is enabled().
+     * \param flops the floating point operations of one call, 0 if not counted.
+     * \param bytes the bytes one call reads and writes.
+     */
+    template <typename Func>
+    void run(const std::string &name, std::vector<std::pair<std::string, std::string>> params, double flops, double bytes, Func &&fn) {
+        if (!enabled(name)) {
+            return;
+        }
+        fn();
+        BenchResult result{name, std::move(params), 0, 0, 1e30, flops, bytes};
+        double total_us = 0;
+        while (result.iterations < 3 || (total_us < min_time_ * 1e6 && result.iterations < max_iterations)) {
+            const auto start = std::chrono::steady_clock::now();
+            fn();
+            const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            total_us += us;
+            result.min_us = std::min(result.min_us, us);
+            result.iterations++;
+        }
+        result.mean_us = total_us / result.iterations;
+        add(std::move(result));
+    }
+    /**
+     * \brief add a result the caller timed itself, e.g. of a whole model.
+     */
+    void add(BenchResult result);
+
+    const std::vector<BenchResult> &results() const {
+        return results_;
+    }
+    /**
+     * \brief print the results as a table.
+     */
+    void print(std::ostream &os) const;
+    /**
+     * \brief write {"context": {...}, "benchmarks": [{"name", "params", "iterations", "mean_us", "min_us",
+     *        "gflops", "gbps"}, ...]}, the rates of the mean times.
+     * \param context e.g. the threads and the build of the run.
+     */
+    bool writeJson(const std::string &path, const std::vector<std::pair<std::string, std::string>> &context) const;
+
+private:
+    static constexpr int max_iterations = 1000000;
+    std::regex filter_;
+    double min_time_;
+    std::vector<BenchResult> results_;
+};
+
+/**
+ * \brief n floats uniform in [-scale, scale), the same for the same seed.
+ */
+std::vector<float> randomFloats(size_t n, unsigned seed, float scale = 1.0F);
+/**
+ * \brief store rows x cols floats in `dst` as `type`, in the layout a weight of that type has.
+ *        F32, F16, Q4_0, Q4_K, Q6_K, Q8_0, Q8_K and the interleaved Q4_0_4_4 are supported.
+ */
+bool convertRows(const float *src, void *dst, DataType type, int64_t rows, int64_t cols);
+/**
+ * \brief fill an allocated tensor of any type supported by convertRows() with random values.
+ */
+bool fillRandom(Tensor &tensor, unsigned seed, float scale = 1.0F);
+
+/**
+ * \brief loads random weights instead of a model file: the norms and the embeddings in F32 (the norms as 1), the
+ *        other weights in `weight_type`. The values of a weight depend on its name only.
+ */
+class RandomLoader : public AbstructLoader {
+public:
+    explicit RandomLoader(DataType weight_type = MLLM_TYPE_F32) :
+        weight_type_(weight_type) {
+    }
+    bool load(Tensor *tensor) override;
+    bool load(std::shared_ptr<Tensor> tensor) override {
+        return load(tensor.get());
+    }
+    DataType getDataType(string name) override;
+
+private:
+    DataType weight_type_;
+};
+
+/**
+ * \brief the kernel benchmarks: mat_mul per weight type and shape, vec_dot, llamafile_sgemm, softmax, RMSNorm,
+ *        RoPE and the KV cache append.
+ * \param shapes the M x N x K of the mat_mul and sgemm benchmarks.
+ */
+void runKernelBenchmarks(BenchRunner &runner, Backend *backend, int threads, const std::vector<std::vector<int>> &shapes);
+
+/**
+ * \brief the shape of a synthetic LLaMA, see runModelBenchmarks().
+ */
+struct BenchModelConfig {
+    std::string name;
+    int vocab_size;
+    int hidden_dim;
+    int heads;
+    int kv_heads;
+    int ffn_hidden;
+    int blocks;
+};
+/**
+ * \brief the synthetic models of runModelBenchmarks(), from "tiny" to the shape of a 1B LLaMA.
+ */
+const std::vector<BenchModelConfig> &benchModelConfigs();
+/**
+ * \brief prefill `prompt` tokens and decode `decode` tokens on a LLaMA of random weights, no model file is needed.
+ *        the weights of the Linear layers have type `weight_type`, the KV caches `kv_type`.
+ *        the benchmarks are named "model/<config>/<weight_type>/prefill" and ".../decode", one iteration is a token.
+ */
+void runModelBenchmarks(BenchRunner &runner, const BenchModelConfig &config, DataType weight_type, DataType kv_type,
+                        int prompt, int decode, int runs, bool capture);
+
+} // namespace mllm
+
+#endif // MLLM_BENCH_HPP
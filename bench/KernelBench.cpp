@@ -0,0 +1,174 @@
+#include "Bench.hpp"
+#include "Tensor.hpp"
+#include "backends/cpu/CPUKVCache.hpp"
+#include "backends/cpu/CPURMSNorm.hpp"
+#include "backends/cpu/CPURoPE.hpp"
+#include "backends/cpu/CPUSoftMax.hpp"
+#include "backends/cpu/ThreadPool.hpp"
+#include "backends/cpu/compute/Matmul.hpp"
+#include "backends/cpu/compute/SGEMM.hpp"
+#include "backends/cpu/compute/VecDotType.hpp"
+
+namespace mllm {
+
+namespace {
+std::string shapeName(const std::vector<int> &shape) {
+    std::string name;
+    for (size_t i = 0; i < shape.size(); ++i) {
+        name += (i == 0 ? "" : "x") + std::to_string(shape[i]);
+    }
+    return name;
+}
+
+std::shared_ptr<Tensor> randomTensor(Backend *backend, const std::vector<int> &shape, DataType type, unsigned seed, float scale = 1.0F) {
+    auto tensor = std::make_shared<Tensor>(backend);
+    tensor->reshape(shape[0], shape[1], shape[2], shape[3]);
+    tensor->setDtype(type);
+    tensor->alloc();
+    fillRandom(*tensor, seed, scale);
+    return tensor;
+}
+
+size_t rowSize(DataType type, int64_t cols) {
+    return cols / type_traits[type].blck_size * type_traits[type].size;
+}
+
+void benchMatMul(BenchRunner &runner, Backend *backend, int threads, const std::vector<std::vector<int>> &shapes) {
+    for (auto type : {MLLM_TYPE_F32, MLLM_TYPE_F16, MLLM_TYPE_Q4_0, MLLM_TYPE_Q4_K, MLLM_TYPE_Q6_K, MLLM_TYPE_Q8_0, MLLM_TYPE_Q4_0_4_4}) {
+        for (const auto &shape : shapes) {
+            const int m = shape[0], n = shape[1], k = shape[2];
+            const std::string name = "mat_mul/" + DataTypeName(type) + "/" + shapeName(shape);
+            if (!runner.enabled(name) || k % type_traits[type].blck_size != 0 || (type == MLLM_TYPE_Q4_0_4_4 && n % 4 != 0)) {
+                continue;
+            }
+            auto x = randomTensor(backend, {1, 1, m, k}, MLLM_TYPE_F32, 1);
+            auto w = randomTensor(backend, {1, 1, n, k}, type, 2, 0.1F);
+            Tensor y(1, 1, m, n, backend, true);
+            runner.run(name, {{"type", DataTypeName(type)}, {"M", std::to_string(m)}, {"N", std::to_string(n)}, {"K", std::to_string(k)}},
+                       2.0 * m * n * k, (double)x->cntSize() + w->cntSize() + y.cntSize(),
+                       [&] { mat_mul(x.get(), w.get(), &y, false, nullptr, false, true, threads); });
+        }
+    }
+}
+
+void benchVecDot(BenchRunner &runner) {
+    const int rows = 256, n = 4096;
+    for (auto type : {MLLM_TYPE_F32, MLLM_TYPE_F16, MLLM_TYPE_Q4_0, MLLM_TYPE_Q8_0, MLLM_TYPE_Q4_K, MLLM_TYPE_Q6_K}) {
+        const auto vec_dot_type = type_traits[type].vec_dot_type;
+        const std::string name = "vec_dot/" + DataTypeName(type) + "_" + DataTypeName(vec_dot_type) + "/" + shapeName({rows, n});
+        if (!runner.enabled(name)) {
+            continue;
+        }
+        std::vector<char> x(rows * rowSize(type, n)), y(rowSize(vec_dot_type, n));
+        convertRows(randomFloats((size_t)rows * n, 1).data(), x.data(), type, rows, n);
+        convertRows(randomFloats(n, 2).data(), y.data(), vec_dot_type, 1, n);
+        std::vector<float> out(rows);
+        const auto vec_dot = type_traits[type].vec_dot;
+        runner.run(name, {{"type", DataTypeName(type)}, {"rows", std::to_string(rows)}, {"n", std::to_string(n)}},
+                   2.0 * rows * n, (double)x.size() + y.size(), [&] {
+                       for (int r = 0; r < rows; ++r) {
+                           vec_dot(n, &out[r], x.data() + r * rowSize(type, n), y.data());
+                       }
+                   });
+    }
+}
+
+void benchSgemm(BenchRunner &runner, int threads, const std::vector<std::vector<int>> &shapes) {
+    for (auto type : {MLLM_TYPE_F32, MLLM_TYPE_F16, MLLM_TYPE_Q4_0, MLLM_TYPE_Q8_0}) {
+        const auto b_type = type_traits[type].vec_dot_type;
+        for (const auto &shape : shapes) {
+            const int m = shape[0], n = shape[1], k = shape[2];
+            const std::string name = "sgemm/" + DataTypeName(type) + "/" + shapeName(shape);
+            const int blocks = k / type_traits[type].blck_size;
+            // as in mat_mul, A is the weight and B the input converted to the vec_dot_type of the weight.
+            if (!runner.enabled(name) || k % type_traits[type].blck_size != 0
+                || !check_llamafile_sgemm(n, m, blocks, type, b_type, MLLM_TYPE_F32)) {
+                continue;
+            }
+            std::vector<char> a(n * rowSize(type, k)), b(m * rowSize(b_type, k));
+            convertRows(randomFloats((size_t)n * k, 1, 0.1F).data(), a.data(), type, n, k);
+            convertRows(randomFloats((size_t)m * k, 2).data(), b.data(), b_type, m, k);
+            std::vector<float> c((size_t)m * n);
+            runner.run(name, {{"type", DataTypeName(type)}, {"M", std::to_string(m)}, {"N", std::to_string(n)}, {"K", std::to_string(k)}},
+                       2.0 * m * n * k, (double)a.size() + b.size() + c.size() * sizeof(float), [&] {
+                           parallel_for(0, threads, threads, [&](int64_t id) {
+                               llamafile_sgemm(n, m, blocks, a.data(), blocks, b.data(), blocks, c.data(), n, (int)id, threads,
+                                               type, b_type, MLLM_TYPE_F32);
+                           });
+                       });
+        }
+    }
+}
+
+// runs `op` on `input` and `output`, reshaped and set up once.
+void benchOp(BenchRunner &runner, const std::string &name, std::vector<std::pair<std::string, std::string>> params, Op &op,
+             std::shared_ptr<Tensor> input, std::shared_ptr<Tensor> output, const std::function<void()> &before = nullptr) {
+    op.reshape({input}, {output});
+    op.setUp({input}, {output});
+    fillRandom(*input, 1);
+    runner.run(name, std::move(params), 0, (double)input->cntSize() + output->cntSize(), [&] {
+        if (before) {
+            before();
+        }
+        op.execute({input}, {output});
+    });
+}
+
+void benchOps(BenchRunner &runner, Backend *backend, int threads) {
+    RandomLoader loader;
+    for (const auto &shape : std::vector<std::vector<int>>{{1, 32, 1, 4096}, {1, 32, 128, 128}}) {
+        const std::string name = "softmax/" + shapeName(shape);
+        if (runner.enabled(name)) {
+            CPUSoftMax op(backend, "softmax", DIMENSION, false, threads);
+            benchOp(runner, name, {{"shape", shapeName(shape)}}, op, randomTensor(backend, shape, MLLM_TYPE_F32, 1), std::make_shared<Tensor>(backend));
+        }
+    }
+    for (const auto &shape : std::vector<std::vector<int>>{{1, 1, 1, 4096}, {1, 1, 128, 4096}}) {
+        const std::string name = "rmsnorm/" + shapeName({shape[2], shape[3]});
+        if (runner.enabled(name)) {
+            CPURMSNorm op(backend, "rmsnorm", shape[3], 1e-6, false, threads);
+            op.load(loader);
+            benchOp(runner, name, {{"shape", shapeName(shape)}}, op, randomTensor(backend, shape, MLLM_TYPE_F32, 1), std::make_shared<Tensor>(backend));
+        }
+    }
+    for (const auto &shape : std::vector<std::vector<int>>{{1, 32, 1, 128}, {1, 32, 128, 128}}) {
+        const std::string name = "rope/" + shapeName({shape[1], shape[2], shape[3]});
+        if (runner.enabled(name)) {
+            CPURoPE op(backend, "rope", HFHUBROPE, 10000, 4096, threads);
+            // the same positions on every iteration.
+            benchOp(runner, name, {{"shape", shapeName(shape)}}, op, randomTensor(backend, shape, MLLM_TYPE_F32, 1), std::make_shared<Tensor>(backend),
+                    [&] { op.setPosition(0); });
+        }
+    }
+    const int heads = 8, dim = 128, cache_max = 4096;
+    for (auto type : {MLLM_TYPE_F16, MLLM_TYPE_Q8_0, MLLM_TYPE_Q4_0}) {
+        const std::string name = "kv_append/" + DataTypeName(type) + "/" + shapeName({heads, dim});
+        if (!runner.enabled(name)) {
+            continue;
+        }
+        // a decoded token is appended as in a forward: reshape, set up and execute, the cache is cleared when full.
+        CPUKVCache op(backend, "kv_cache", 1, cache_max, threads, 0, type);
+        auto input = randomTensor(backend, {1, heads, 1, dim}, MLLM_TYPE_F32, 1);
+        auto output = std::make_shared<Tensor>(backend);
+        const size_t row_bytes = heads * rowSize(type, dim);
+        runner.run(name, {{"type", DataTypeName(type)}, {"heads", std::to_string(heads)}, {"dim", std::to_string(dim)}}, 0,
+                   (double)input->cntSize() + row_bytes, [&] {
+                       if (op.getCacheSeqLen() + 1 >= cache_max) {
+                           op.clearCache();
+                       }
+                       op.reshape({input}, {output});
+                       op.setUp({input}, {output});
+                       op.execute({input}, {output});
+                   });
+    }
+}
+} // namespace
+
+void runKernelBenchmarks(BenchRunner &runner, Backend *backend, int threads, const std::vector<std::vector<int>> &shapes) {
+    benchMatMul(runner, backend, threads, shapes);
+    benchVecDot(runner);
+    benchSgemm(runner, threads, shapes);
+    benchOps(runner, backend, threads);
+}
+
+} // namespace mllm
@@ -0,0 +1,101 @@
+#include "Bench.hpp"
+#include "models/llama/modeling_llama.hpp"
+#include "backends/cpu/compute/VecDotType.hpp"
+
+namespace mllm {
+
+const std::vector<BenchModelConfig> &benchModelConfigs() {
+    static const std::vector<BenchModelConfig> configs = {
+        {"tiny", 1024, 256, 4, 4, 768, 2},
+        {"small", 32000, 1024, 16, 4, 2816, 4},
+        // the shape of TinyLlama-1.1B.
+        {"1b", 32000, 2048, 32, 4, 5632, 22},
+    };
+    return configs;
+}
+
+namespace {
+// the weights of the Linear layers, the work of a token is about two FLOPs per weight.
+double linearWeights(const BenchModelConfig &config) {
+    const double kv_dim = (double)config.hidden_dim / config.heads * config.kv_heads;
+    const double attention = 2.0 * config.hidden_dim * config.hidden_dim + 2.0 * config.hidden_dim * kv_dim;
+    const double ffn = 3.0 * config.hidden_dim * config.ffn_hidden;
+    return config.blocks * (attention + ffn) + (double)config.hidden_dim * config.vocab_size;
+}
+
+BenchResult tokenResult(const std::string &name, std::vector<std::pair<std::string, std::string>> params, const std::vector<double> &token_us,
+                        double flops, double bytes) {
+    BenchResult result{name, std::move(params), (int)token_us.size(), 0, 1e30, flops, bytes};
+    for (double us : token_us) {
+        result.mean_us += us / token_us.size();
+        result.min_us = std::min(result.min_us, us);
+    }
+    return result;
+}
+
+double elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+void runModelBenchmarks(BenchRunner &runner, const BenchModelConfig &config, DataType weight_type, DataType kv_type,
+                        int prompt, int decode, int runs, bool capture) {
+    const std::string prefix = "model/" + config.name + "/" + DataTypeName(weight_type);
+    if (!runner.enabled(prefix + "/prefill") && !runner.enabled(prefix + "/decode")) {
+        return;
+    }
+    if (config.hidden_dim % type_traits[weight_type].blck_size != 0 || config.ffn_hidden % type_traits[weight_type].blck_size != 0) {
+        std::cerr << prefix << ": the weights do not fit in blocks of " << type_traits[weight_type].blck_size << std::endl;
+        return;
+    }
+    LLaMANameConfig names;
+    names.init(LLAMAROPE);
+    LLaMAModel model(config.vocab_size, config.hidden_dim, config.heads, config.kv_heads, config.ffn_hidden, config.blocks, LLAMAROPE,
+                     10000, prompt + decode, prompt + decode, names, names.blk_name, kv_type);
+    RandomLoader loader(weight_type);
+    model.load(loader);
+    if (capture) {
+        model.captureExecution();
+    }
+
+    // the first run warms up and is not counted.
+    std::vector<double> prefill_us, decode_us;
+    for (int run = 0; run <= runs; ++run) {
+        Tensor input(1, 1, prompt, 1, Module::backends[MLLM_CPU], true);
+        input.setTtype(INPUT_TENSOR);
+        for (int i = 0; i < prompt; ++i) {
+            input.setDataAt<float>(0, 0, i, 0, (float)((i * 7919 + 1) % config.vocab_size));
+        }
+        auto start = std::chrono::steady_clock::now();
+        model({input});
+        if (run > 0) {
+            prefill_us.push_back(elapsedUs(start) / prompt);
+        }
+        input.reshape(1, 1, 1, 1);
+        input.alloc();
+        for (int i = 0; i < decode; ++i) {
+            input.setDataAt<float>(0, 0, 0, 0, (float)((i * 104729 + 3) % config.vocab_size));
+            start = std::chrono::steady_clock::now();
+            model({input});
+            if (run > 0) {
+                decode_us.push_back(elapsedUs(start));
+            }
+        }
+        model.clear_kvcache();
+    }
+
+    const double weights = linearWeights(config);
+    const double weight_bytes = weights / type_traits[weight_type].blck_size * type_traits[weight_type].size;
+    const std::vector<std::pair<std::string, std::string>> params = {
+        {"config", config.name}, {"weight_type", DataTypeName(weight_type)}, {"kv_type", DataTypeName(kv_type)},
+        {"prompt", std::to_string(prompt)}, {"decode", std::to_string(decode)}, {"capture", capture ? "1" : "0"}};
+    // one iteration is a token: a decoded token reads all the weights, the tokens of a prefill share them.
+    if (runner.enabled(prefix + "/prefill")) {
+        runner.add(tokenResult(prefix + "/prefill", params, prefill_us, 2 * weights, weight_bytes / prompt));
+    }
+    if (runner.enabled(prefix + "/decode") && decode > 0) {
+        runner.add(tokenResult(prefix + "/decode", params, decode_us, 2 * weights, weight_bytes));
+    }
+}
+
+} // namespace mllm
@@ -0,0 +1,111 @@
+//
+// Benchmark the CPU kernels and the prefill and decode of synthetic models, see bench/Bench.hpp.
+//
+// e.g. ./mllm_bench --filter 'mat_mul/Q4_0|decode' --json bench.json
+//
+
+#include <iostream>
+#include <sstream>
+#include "cmdline.h"
+#include "Bench.hpp"
+#include "Module.hpp"
+#include "backends/cpu/CPUBackend.hpp"
+
+using namespace mllm;
+
+static DataType parseType(const string &type_name) {
+    for (int t = 0; t < MLLM_TYPE_COUNT; ++t) {
+        if (DataTypeName((DataType)t) == type_name) {
+            return (DataType)t;
+        }
+    }
+    return MLLM_TYPE_COUNT;
+}
+
+// "MxNxK,MxNxK,..."
+static bool parseShapes(const string &text, vector<vector<int>> &shapes) {
+    std::istringstream items(text);
+    string item;
+    while (std::getline(items, item, ',')) {
+        vector<int> shape;
+        std::istringstream dims(item);
+        string dim;
+        while (std::getline(dims, dim, 'x')) {
+            try {
+                shape.push_back(std::stoi(dim));
+            } catch (const std::exception &) {
+                return false;
+            }
+        }
+        if (shape.size() != 3 || shape[0] <= 0 || shape[1] <= 0 || shape[2] <= 0) {
+            return false;
+        }
+        shapes.push_back(shape);
+    }
+    return !shapes.empty();
+}
+
+int main(int argc, char **argv) {
+    cmdline::parser cmdParser;
+    cmdParser.add<string>("filter", 'f', "a regex the names of the benchmarks to run contain", false, "");
+    cmdParser.add<string>("json", 'j', "write the results to this JSON file", false, "");
+    cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.add<double>("min_time", 0, "min seconds each kernel benchmark runs", false, 0.5);
+    cmdParser.add<string>("shapes", 's', "the MxNxK of mat_mul and sgemm", false, "1x2048x2048,1x5632x2048,64x2048x2048");
+    cmdParser.add<string>("model", 'm', "the synthetic models, tiny, small, 1b or all", false, "tiny");
+    cmdParser.add<string>("model_type", 0, "the type of the Linear weights of the models", false, "Q4_0");
+    cmdParser.add<string>("kv_type", 0, "the type of the KV caches of the models", false, "F16");
+    cmdParser.add<int>("prompt", 'p', "tokens of the prefill", false, 64);
+    cmdParser.add<int>("decode", 'd', "tokens decoded after the prefill", false, 32);
+    cmdParser.add<int>("runs", 'r', "runs of each model, after one to warm up", false, 2);
+    cmdParser.add("capture", 0, "decode through a captured execution plan");
+    cmdParser.add("kernels_only", 0, "skip the models");
+    cmdParser.add("models_only", 0, "skip the kernels");
+    cmdParser.parse_check(argc, argv);
+
+    CPUBackend::cpu_threads = cmdParser.get<int>("thread");
+    vector<vector<int>> shapes;
+    if (!parseShapes(cmdParser.get<string>("shapes"), shapes)) {
+        std::cerr << "Invalid shapes " << cmdParser.get<string>("shapes") << std::endl;
+        return -1;
+    }
+    const auto model_type = parseType(cmdParser.get<string>("model_type"));
+    const auto kv_type = parseType(cmdParser.get<string>("kv_type"));
+    if (model_type == MLLM_TYPE_COUNT || kv_type == MLLM_TYPE_COUNT) {
+        std::cerr << "Unknown type " << cmdParser.get<string>("model_type") << " or " << cmdParser.get<string>("kv_type") << std::endl;
+        return -1;
+    }
+    const int prompt = cmdParser.get<int>("prompt");
+    if (prompt <= 0 || cmdParser.get<int>("decode") < 0 || cmdParser.get<int>("runs") <= 0) {
+        std::cerr << "prompt and runs must be positive" << std::endl;
+        return -1;
+    }
+
+    Module::initBackend(MLLM_CPU);
+    BenchRunner runner(cmdParser.get<string>("filter"), cmdParser.get<double>("min_time"));
+    if (!cmdParser.exist("models_only")) {
+        runKernelBenchmarks(runner, Module::backends[MLLM_CPU], CPUBackend::cpu_threads, shapes);
+    }
+    if (!cmdParser.exist("kernels_only")) {
+        const auto &model = cmdParser.get<string>("model");
+        for (const auto &config : benchModelConfigs()) {
+            if (model == "all" || model == config.name) {
+                runModelBenchmarks(runner, config, model_type, kv_type, prompt, cmdParser.get<int>("decode"),
+                                   cmdParser.get<int>("runs"), cmdParser.exist("capture"));
+            }
+        }
+    }
+
+    runner.print(std::cout);
+    const auto &json = cmdParser.get<string>("json");
+    if (!json.empty()) {
+        if (!runner.writeJson(json, {{"threads", std::to_string(CPUBackend::cpu_threads)},
+                                     {"min_time", std::to_string(cmdParser.get<double>("min_time"))},
+                                     {"model_type", cmdParser.get<string>("model_type")},
+                                     {"kv_type", cmdParser.get<string>("kv_type")}})) {
+            return -1;
+        }
+        std::cout << "Wrote " << runner.results().size() << " results to " << json << std::endl;
+    }
+    return 0;
+}
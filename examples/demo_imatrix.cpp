@@ -0,0 +1,74 @@
+//
+// Collect the importance matrix of a LLaMA model on a calibration text, for ./quantize -i.
+//
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "cmdline.h"
+#include "Imatrix.hpp"
+#include "models/llama/modeling_llama.hpp"
+#include "tokenizers/BPE/Bpe.hpp"
+
+using namespace mllm;
+
+int main(int argc, char **argv) {
+    cmdline::parser cmdParser;
+    cmdParser.add<string>("vocab", 'v', "specify mllm tokenizer model path", false, "../vocab/llama_vocab.mllm");
+    cmdParser.add<string>("model", 'm', "specify mllm model path, in F32", false, "../models/llama-2-7b-chat-fp32.mllm");
+    cmdParser.add<string>("file", 'f', "the calibration text", true);
+    cmdParser.add<string>("output", 'o', "the imatrix file", false, "../models/llama-2-7b-chat.imatrix");
+    cmdParser.add<int>("chunk", 'c', "tokens per forward", false, 512);
+    cmdParser.add<int>("chunks", 'n', "max chunks, 0 for the whole text", false, 0);
+    cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.parse_check(argc, argv);
+
+    string vocab_path = cmdParser.get<string>("vocab");
+    string model_path = cmdParser.get<string>("model");
+    int chunk = cmdParser.get<int>("chunk");
+    int max_chunks = cmdParser.get<int>("chunks");
+    CPUBackend::cpu_threads = cmdParser.get<int>("thread");
+
+    std::ifstream file(cmdParser.get<string>("file"));
+    if (!file.good()) {
+        std::cerr << "Can not open " << cmdParser.get<string>("file") << std::endl;
+        return -1;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    Module::initBackend(MLLM_CPU);
+    BPETokenizer tokenizer(vocab_path);
+    vector<token_id_t> tokens;
+    tokenizer.tokenize(" " + text.str(), tokens, false);
+
+    LLaMAConfig config(chunk + 1, "7B", LLAMAROPE);
+    auto model = LLaMAModel(config);
+    model.load(model_path);
+
+    Imatrix imatrix;
+    imatrix.begin();
+    int chunks = 0;
+    for (size_t begin = 0; begin + chunk <= tokens.size(); begin += chunk) {
+        if (max_chunks > 0 && chunks == max_chunks) {
+            break;
+        }
+        // each chunk is a sequence of its own.
+        vector<token_id_t> input = {1};
+        input.insert(input.end(), tokens.begin() + begin, tokens.begin() + begin + chunk);
+        auto input_tensor = BPETokenizer::tokens2Input(input);
+        model({input_tensor});
+        model.clear_kvcache();
+        std::cout << "chunk " << ++chunks << "/" << tokens.size() / chunk << std::endl;
+    }
+    imatrix.end();
+    if (chunks == 0) {
+        std::cerr << "The text has less than " << chunk << " tokens" << std::endl;
+        return -1;
+    }
+    if (!imatrix.save(cmdParser.get<string>("output"))) {
+        return -1;
+    }
+    std::cout << "Saved the imatrix of " << imatrix.size() << " weights to " << cmdParser.get<string>("output") << std::endl;
+    return 0;
+}
@@ -7,6 +7,8 @@
 #include "models/llama/modeling_llama.hpp"
 #include "models/llama/tokenization_llama.hpp"
 #include "processor/PostProcess.hpp"
+#include "Profiler.hpp"
+#include "PrefixCache.hpp"
 
 using namespace mllm;
 
@@ -16,6 +18,14 @@ int main(int argc, char **argv) {
     cmdParser.add<string>("model", 'm', "specify mllm model path", false, "../models/llama-2-7b-chat-q4_0_4_4.mllm");
     cmdParser.add<int>("limits", 'l', "max KV cache size", false, 400);
     cmdParser.add<int>("thread", 't', "num of threads", false, 4);
+    cmdParser.add("mmap", '\0', "use the weights in-place from a mmaped model file");
+    cmdParser.add("prefetch", '\0', "with --mmap, read the model file ahead");
+    cmdParser.add<string>("kv_type", '\0', "KV cache type: F16, Q8_0 or Q4_0", false, "F16", cmdline::oneof<string>("F16", "Q8_0", "Q4_0"));
+    cmdParser.add<int>("sink", '\0', "keep this many first tokens and evict the others once the KV cache is full, 0 to grow it", false, 0);
+    cmdParser.add<int>("chunk", '\0', "feed the prompt in forwards of at most this many tokens, 0 for one forward", false, 0);
+    cmdParser.add("capture", '\0', "decode from an execution plan captured on the first token");
+    cmdParser.add<int>("prefix_cache", '\0', "reuse the KV caches of the prompt prefixes seen before, up to this many MB, 0 to disable", false, 0);
+    cmdParser.add<string>("profile", '\0', "print the time of the ops by type and layer and write their Chrome trace to this file", false, "");
     cmdParser.parse_check(argc, argv);
 
     string vocab_path = cmdParser.get<string>("vocab");
@@ -26,8 +36,25 @@ int main(int argc, char **argv) {
     auto tokenizer = LLaMATokenizer(vocab_path);
 
     LLaMAConfig config(tokens_limit, "7B", LLAMAROPE);
+    config.attention_sink = cmdParser.get<int>("sink");
+    for (auto type : {MLLM_TYPE_F16, MLLM_TYPE_Q8_0, MLLM_TYPE_Q4_0}) {
+        if (DataTypeName(type) == cmdParser.get<string>("kv_type")) {
+            config.kv_cache_type = type;
+        }
+    }
     auto model = LLaMAModel(config);
-    model.load(model_path);
+    model.load(model_path, cmdParser.exist("mmap"), cmdParser.exist("prefetch"));
+    model.setPrefillChunk(cmdParser.get<int>("chunk"));
+    if (cmdParser.exist("capture")) {
+        model.captureExecution();
+    }
+    const int prefix_cache_mb = cmdParser.get<int>("prefix_cache");
+    PrefixCache prefix_cache(model, (size_t)prefix_cache_mb << 20);
+    const string profile_path = cmdParser.get<string>("profile");
+    Profiler profiler;
+    if (!profile_path.empty()) {
+        profiler.begin();
+    }
 
     vector<string> in_strs = {
         " Hello, who are you?",
@@ -38,6 +65,13 @@ int main(int argc, char **argv) {
     for (int i = 0; i < in_strs.size(); ++i) {
         auto in_str = in_strs[i];
         auto input_tensor = tokenizer.tokenize(in_str, i);
+        vector<unsigned int> prompt_ids;
+        if (prefix_cache_mb > 0) {
+            for (int s = 0; s < input_tensor.sequence(); ++s) {
+                prompt_ids.push_back((unsigned int)input_tensor.dataAt<float>(0, 0, s, 0));
+            }
+            prefix_cache.restore(input_tensor);
+        }
         std::cout << "[Q] " << in_str << std::endl;
         std::cout << "[A] " << std::flush;
         for (int step = 0; step < 100; step++) {
@@ -52,9 +86,17 @@ int main(int argc, char **argv) {
             chatPostProcessing(out_token, input_tensor, {});
         }
         printf("\n");
+        if (prefix_cache_mb > 0) {
+            prefix_cache.insert(prompt_ids);
+        }
         model.clear_kvcache();
         model.profiling();
     }
+    if (!profile_path.empty()) {
+        profiler.end();
+        profiler.summary(std::cout);
+        profiler.writeChromeTrace(profile_path);
+    }
 
     return 0;
 }
\ No newline at end of file
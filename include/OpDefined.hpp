@@ -50,10 +50,12 @@ enum OpType {
     SPARSEIDLINEAR,
     ELASTICLINEAR,
     POSITION,
+    ATTENTION,
+    LATENTATTENTION,
     OP_NUM
 };
 
-static const vector<string> OpNames = {
+static const char *const OpNames[] = {
     "INVALID_VALUE",
     "Parameter",
     "Add",
@@ -91,10 +93,13 @@ static const vector<string> OpNames = {
     "Range",
     "Where",
     "Replace",
+    "Predictor",
     "SparseLinear",
     "SparseIdLinear",
     "ElasticLinear",
     "Position",
+    "Attention",
+    "LatentAttention",
     "OP_NUM"};
 
 enum TensorFuncType {
@@ -117,8 +122,32 @@ enum TensorFuncType {
     FUNC_CLIPAXIS,
     FUNC_RANGE,
     FUNC_WHERE,
-    FUNC_SPLIT
+    FUNC_SPLIT,
+    FUNC_NUM
 };
 
+static const char *const TensorFuncNames[] = {
+    "add",
+    "sub",
+    "mul",
+    "div",
+    "ttadd",
+    "ttsub",
+    "ttmul",
+    "ttdiv",
+    "mm",
+    "norm",
+    "mean",
+    "cat",
+    "view",
+    "transpose",
+    "flatten",
+    "clip",
+    "clipaxis",
+    "range",
+    "where",
+    "split",
+    "FUNC_NUM"};
+
 } // namespace mllm
 #endif
@@ -80,16 +80,20 @@ enum ChlType {
     DBHS = 13
 };
 
-inline std::map<std::vector<int>, ChlType> Chls2Type = {
-    {{0, 2, 3, 1}, BDHS},
-    {{0, 1, 3, 2}, BHDS},
-    {{0, 2, 1, 3}, BSHD},
-    {{1, 2, 0, 3}, SBHD},
-    {{0, 3, 2, 1}, BDSH},
-    {{1, 2, 3, 0}, DBHS},
-    {{0, 1, 2, 3, 4}, BTHWC},
-    {{0, 2, 3, 4, 1}, BCTHW},
-    {{0, 3, 4, 1, 2}, BWCTH}};
+// a function-local static, so that only the translation units which use it initialize it.
+inline std::map<std::vector<int>, ChlType> &Chls2Type() {
+    static std::map<std::vector<int>, ChlType> chls2type = {
+        {{0, 2, 3, 1}, BDHS},
+        {{0, 1, 3, 2}, BHDS},
+        {{0, 2, 1, 3}, BSHD},
+        {{1, 2, 0, 3}, SBHD},
+        {{0, 3, 2, 1}, BDSH},
+        {{1, 2, 3, 0}, DBHS},
+        {{0, 1, 2, 3, 4}, BTHWC},
+        {{0, 2, 3, 4, 1}, BCTHW},
+        {{0, 3, 4, 1, 2}, BWCTH}};
+    return chls2type;
+}
 
 enum TensorType {
     INPUT_TENSOR = 0,
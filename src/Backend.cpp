@@ -1,4 +1,16 @@
 #include "Backend.hpp"
+#include "Tensor.hpp"
 namespace mllm {
 
+OpCost TensorFunction::cost(vector<Tensor *> outputs, vector<Tensor *> inputs, vector<float> args) {
+    OpCost cost;
+    for (auto *input : inputs) {
+        cost.bytes_read += input->cntSize();
+    }
+    for (auto *output : outputs) {
+        cost.bytes_written += output->cntSize();
+    }
+    return cost;
+}
+
 } // namespace mllm
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "MemoryManager.hpp"
 #include "OpDefined.hpp"
+#include "Profiler.hpp"
 #include "Types.hpp"
 #include <memory>
 using std::shared_ptr;
@@ -20,6 +21,10 @@ class TensorFunction{
 public:
     virtual void setup(vector<Tensor*> outputs, vector<Tensor*> inputs, vector<float> args)=0;
     virtual void execute(vector<Tensor*> outputs, vector<Tensor*> inputs, vector<float> args)=0;
+    /**
+     * \brief the work of an execute, for the Profiler, see Op::cost().
+     */
+    virtual OpCost cost(vector<Tensor*> outputs, vector<Tensor*> inputs, vector<float> args);
 };
 class Backend {
 public:
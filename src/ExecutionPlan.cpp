@@ -0,0 +1,178 @@
+#include "ExecutionPlan.hpp"
+#include <cstring>
+#include "Backend.hpp"
+#include "MemoryPlanner.hpp"
+#include "Op.hpp"
+#include "Profiler.hpp"
+#include "Tensor.hpp"
+
+namespace mllm {
+
+static thread_local ExecutionPlan *active_plan = nullptr;
+
+ExecutionPlan::~ExecutionPlan() {
+    if (active_plan == this) {
+        active_plan = nullptr;
+    }
+}
+
+ExecutionPlan *ExecutionPlan::active() {
+    return active_plan;
+}
+
+void ExecutionPlan::begin(std::vector<Tensor> &inputs) {
+    steps_.clear();
+    outputs_.clear();
+    inputs_.clear();
+    for (int i = 0; i < inputs.size(); ++i) {
+        auto input = std::make_shared<Tensor>(inputs[i].backend());
+        input->setName("input" + std::to_string(i));
+        input->setTtype(TensorType::NORMAL_TENSOR);
+        input->setDtype(inputs[i].dtype());
+        input->reshape(inputs[i].batch(), inputs[i].head(), inputs[i].sequence(), inputs[i].dimension());
+        input->alloc();
+        inputs_.push_back(input);
+    }
+    bind(inputs);
+    valid_ = true;
+    ready_ = false;
+    active_plan = this;
+}
+
+std::vector<Tensor> ExecutionPlan::inputs() const {
+    std::vector<Tensor> inputs;
+    for (const auto &input : inputs_) {
+        inputs.push_back(*input);
+    }
+    return inputs;
+}
+
+std::shared_ptr<Tensor> ExecutionPlan::resolve(Tensor *tensor) {
+    // the tensors an op is called with may be copies of the ones in Tensor::graphs or temporaries.
+    if (tensor == nullptr || tensor->name().empty()) {
+        return nullptr;
+    }
+    auto it = Tensor::graphs.find(tensor->name());
+    return it == Tensor::graphs.end() ? nullptr : it->second;
+}
+
+void ExecutionPlan::record(Op *op, const std::vector<std::shared_ptr<Tensor>> &inputs, const std::vector<std::shared_ptr<Tensor>> &outputs) {
+    std::vector<Tensor *> input_ptrs, output_ptrs;
+    for (const auto &input : inputs) {
+        input_ptrs.push_back(input.get());
+    }
+    for (const auto &output : outputs) {
+        output_ptrs.push_back(output.get());
+    }
+    record(nullptr, FUNC_NUM, input_ptrs, output_ptrs, {});
+    steps_.back().op = op;
+}
+
+void ExecutionPlan::record(TensorFunction *func, TensorFuncType type, const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs, const std::vector<float> &args) {
+    Step step{nullptr, func, type, nullptr, {}, {}, args, {}, {}};
+    for (auto *input : inputs) {
+        auto tensor = resolve(input);
+        valid_ = valid_ && tensor != nullptr;
+        step.inputs.push_back(tensor);
+        step.input_ptrs.push_back(tensor.get());
+    }
+    for (auto *output : outputs) {
+        auto tensor = resolve(output);
+        valid_ = valid_ && tensor != nullptr;
+        step.outputs.push_back(tensor);
+        step.output_ptrs.push_back(tensor.get());
+    }
+    steps_.push_back(std::move(step));
+}
+
+void ExecutionPlan::record(std::function<void()> update) {
+    steps_.push_back({nullptr, nullptr, FUNC_NUM, std::move(update), {}, {}, {}, {}, {}});
+}
+
+bool ExecutionPlan::finish(const std::vector<Tensor> &outputs) {
+    active_plan = nullptr;
+    for (const auto &output : outputs) {
+        auto tensor = Tensor::graphs.find(output.name());
+        if (tensor == Tensor::graphs.end() || tensor->second == nullptr) {
+            valid_ = false;
+            break;
+        }
+        outputs_.push_back(tensor->second);
+    }
+    ready_ = valid_ && !steps_.empty();
+    return ready_;
+}
+
+bool ExecutionPlan::matches(std::vector<Tensor> &inputs) const {
+    if (!ready_ || inputs.size() != inputs_.size()) {
+        return false;
+    }
+    for (int i = 0; i < inputs.size(); ++i) {
+        auto &input = inputs[i];
+        auto &captured = *inputs_[i];
+        if (input.dtype() != captured.dtype() || input.batch() != captured.batch() || input.head() != captured.head()
+            || input.sequence() != captured.sequence() || input.dimension() != captured.dimension()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ExecutionPlan::bind(std::vector<Tensor> &inputs) {
+    for (int i = 0; i < inputs.size(); ++i) {
+        memcpy(inputs_[i]->rawHostPtr(), inputs[i].rawHostPtr(), inputs_[i]->cntSize());
+        auto &entry = Tensor::graphs[inputs_[i]->name()];
+        if (entry != inputs_[i]) {
+            entry = inputs_[i];
+            ++Tensor::graphs_version;
+        }
+    }
+}
+
+void ExecutionPlan::setUp(MemoryPlanner *planner) {
+    if (planner != nullptr) {
+        planner->begin();
+    }
+    for (auto &step : steps_) {
+        if (step.update) {
+            continue;
+        }
+        if (step.op != nullptr) {
+            step.op->reshape(step.inputs, step.outputs);
+            if (planner != nullptr) {
+                planner->step(step.inputs, step.outputs);
+            }
+            step.op->setUp(step.inputs, step.outputs);
+        } else {
+            if (planner != nullptr) {
+                planner->step(step.input_ptrs, step.output_ptrs);
+            }
+            step.func->setup(step.output_ptrs, step.input_ptrs, step.args);
+        }
+    }
+    if (planner != nullptr) {
+        planner->finish(outputs());
+    }
+}
+
+void ExecutionPlan::execute() {
+    for (auto &step : steps_) {
+        if (step.update) {
+            step.update();
+        } else if (step.op != nullptr) {
+            Profiler::execute(step.op, step.inputs, step.outputs);
+        } else {
+            Profiler::execute(step.func, step.type, step.output_ptrs, step.input_ptrs, step.args);
+        }
+    }
+}
+
+std::vector<Tensor> ExecutionPlan::outputs() const {
+    std::vector<Tensor> outputs;
+    for (const auto &output : outputs_) {
+        outputs.push_back(*output);
+    }
+    return outputs;
+}
+
+} // namespace mllm
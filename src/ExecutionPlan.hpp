@@ -0,0 +1,125 @@
+#ifndef MLLM_EXECUTIONPLAN_HPP
+#define MLLM_EXECUTIONPLAN_HPP
+#include <functional>
+#include <memory>
+#include <vector>
+#include "OpDefined.hpp"
+
+namespace mllm {
+class Op;
+class Tensor;
+class TensorFunction;
+class MemoryPlanner;
+
+/**
+ * \brief the ops of a forward, captured once and replayed by the following forwards of the same input shapes.
+ *
+ * while the TENSOR_STATIC_INIT pass of a forward is captured, every op and TensorFunction records itself with
+ * its input and output tensors (record()). The following forwards do not run Forward again: setUp() reshapes
+ * and sets up the recorded ops in order, which updates the shapes that grow with the KV caches, and execute()
+ * runs them. This skips the two traversals of Forward per decoded token, with their Tensor::graphs lookups and
+ * names, which dominate the decode time of small models.
+ *
+ * a forward cannot be captured if an op reads a tensor which is not in Tensor::graphs (e.g. a temporary holding
+ * an int argument of a Layer); an argument which changes between forwards is recorded with the update that sets
+ * it, see KVCache::cacheSeqLen(). Forward must not depend on anything but the input shapes, e.g. on the values of
+ * tensors or on the number of forwards so far.
+ *
+ * Usage:
+ *   model.captureExecution();
+ *   model.generate(input_tensor, opt, ...);
+ */
+class ExecutionPlan {
+public:
+    ExecutionPlan() = default;
+    ~ExecutionPlan();
+    ExecutionPlan(const ExecutionPlan &) = delete;
+    ExecutionPlan &operator=(const ExecutionPlan &) = delete;
+
+    /**
+     * \brief the plan being captured, nullptr if there is none.
+     */
+    static ExecutionPlan *active();
+
+    /**
+     * \brief drop the recorded steps and start capturing, this plan becomes active().
+     * \param inputs the inputs of the forward, the plan keeps copies of them, see bind().
+     */
+    void begin(std::vector<Tensor> &inputs);
+    /**
+     * \brief the inputs the captured forward reads, named and in Tensor::graphs like the inputs of a Module.
+     */
+    std::vector<Tensor> inputs() const;
+    /**
+     * \brief record an op, called before it is set up.
+     */
+    void record(Op *op, const std::vector<std::shared_ptr<Tensor>> &inputs, const std::vector<std::shared_ptr<Tensor>> &outputs);
+    /**
+     * \brief record a TensorFunction, called before it is set up.
+     */
+    void record(TensorFunction *func, TensorFuncType type, const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs, const std::vector<float> &args);
+    /**
+     * \brief record an update of the tensors the following steps read, run in order by execute().
+     */
+    void record(std::function<void()> update);
+    /**
+     * \brief stop capturing.
+     * \param outputs the outputs of Forward.
+     * \return false if the forward cannot be replayed.
+     */
+    bool finish(const std::vector<Tensor> &outputs);
+
+    /**
+     * \brief whether `inputs` have the shapes of the captured ones.
+     */
+    bool matches(std::vector<Tensor> &inputs) const;
+    /**
+     * \brief copy the data of `inputs` to the inputs of the plan.
+     */
+    void bind(std::vector<Tensor> &inputs);
+    /**
+     * \brief reshape and set up the recorded steps, the TENSOR_STATIC_INIT pass.
+     * \param planner the MemoryPlanner of the Module, or nullptr.
+     */
+    void setUp(MemoryPlanner *planner);
+    /**
+     * \brief execute the recorded steps, the TENSOR_STATIC_READY pass, see Profiler::execute().
+     */
+    void execute();
+    /**
+     * \brief the outputs of Forward.
+     */
+    std::vector<Tensor> outputs() const;
+
+    bool ready() const {
+        return ready_;
+    }
+    size_t size() const {
+        return steps_.size();
+    }
+
+private:
+    struct Step {
+        Op *op;
+        TensorFunction *func;
+        TensorFuncType type;
+        std::function<void()> update;
+        std::vector<std::shared_ptr<Tensor>> inputs;
+        std::vector<std::shared_ptr<Tensor>> outputs;
+        std::vector<float> args;
+        std::vector<Tensor *> input_ptrs;
+        std::vector<Tensor *> output_ptrs;
+    };
+    // the tensor of Tensor::graphs `tensor` stands for, nullptr if there is none.
+    std::shared_ptr<Tensor> resolve(Tensor *tensor);
+
+    std::vector<Step> steps_;
+    std::vector<std::shared_ptr<Tensor>> inputs_;
+    std::vector<std::shared_ptr<Tensor>> outputs_;
+    bool valid_ = false;
+    bool ready_ = false;
+};
+
+} // namespace mllm
+
+#endif // MLLM_EXECUTIONPLAN_HPP
@@ -14,25 +14,32 @@
 
 namespace mllm {
 
-unsigned int _LlmTextGenerateGreedySearchMethod::generate(Tensor &t) {
+unsigned int _LlmTextGenerateGreedySearchMethod::generate(Tensor &t, int seq) {
     std::vector<float> scores;
-    this->_tensor_to_vec(t, scores);
+    this->_tensor_to_vec(t, scores, seq);
     return std::max_element(scores.begin(), scores.end()) - scores.begin();
 }
 
-unsigned int _LlmTextGenerateTopkSamplingMethod::generate(Tensor &t) {
+void _LlmTextGenerateGreedySearchMethod::probabilities(Tensor &t, int seq, std::vector<float> &probs) {
+    probs.assign(t.dimension(), 0.f);
+    probs[generate(t, seq)] = 1.f;
+}
+
+void _LlmTextGenerateTopkSamplingMethod::_candidates(Tensor &t, int seq, std::vector<unsigned int> &idx, std::vector<float> &probs) {
     auto argmax = [](const std::vector<float> &vec) -> unsigned int {
         return std::distance(vec.begin(), std::max_element(vec.begin(), vec.end()));
     };
 
     if (m_k == 0 || m_k == 1) {
         std::vector<float> scores;
-        this->_tensor_to_vec(t, scores);
-        return argmax(scores);
+        this->_tensor_to_vec(t, scores, seq);
+        idx = {argmax(scores)};
+        probs = {1.f};
+        return;
     }
 
     std::vector<std::pair<float, unsigned int>> scores;
-    this->_tensor_to_vec_with_idx(t, scores);
+    this->_tensor_to_vec_with_idx(t, scores, seq);
 
     // find top k
     std::partial_sort(scores.begin(), scores.begin() + m_k, scores.end(),
@@ -64,16 +71,36 @@ unsigned int _LlmTextGenerateTopkSamplingMethod::generate(Tensor &t) {
         value /= _sum;
     }
 
-    auto idx = _sample_element(top_k_elements_idx, softmax);
-    return idx;
+    idx = std::move(top_k_elements_idx);
+    probs = std::move(softmax);
+}
+
+unsigned int _LlmTextGenerateTopkSamplingMethod::generate(Tensor &t, int seq) {
+    std::vector<unsigned int> idx;
+    std::vector<float> probs;
+    _candidates(t, seq, idx, probs);
+    if (idx.size() == 1) {
+        return idx[0];
+    }
+    return _sample_element(idx, probs);
+}
+
+void _LlmTextGenerateTopkSamplingMethod::probabilities(Tensor &t, int seq, std::vector<float> &probs) {
+    std::vector<unsigned int> idx;
+    std::vector<float> candidate_probs;
+    _candidates(t, seq, idx, candidate_probs);
+    probs.assign(t.dimension(), 0.f);
+    for (size_t i = 0; i < idx.size(); ++i) {
+        probs[idx[i]] = candidate_probs[i];
+    }
 }
 
-unsigned int _LlmTextGenerateToppSamplingMethod::generate(Tensor &t) {
+void _LlmTextGenerateToppSamplingMethod::_candidates(Tensor &t, int seq, std::vector<unsigned int> &idx, std::vector<float> &probs) {
     auto argmax = [](const std::vector<float> &vec) -> unsigned int {
         return std::distance(vec.begin(), std::max_element(vec.begin(), vec.end()));
     };
     std::vector<std::pair<float, unsigned int>> scores;
-    this->_tensor_to_vec_with_idx(t, scores);
+    this->_tensor_to_vec_with_idx(t, scores, seq);
 
     std::sort(scores.begin(), scores.end(), [](std::pair<float, unsigned int> a, std::pair<float, unsigned int> b) { return a.first > b.first; });
     std::vector<float> top_k_elements;
@@ -84,16 +111,18 @@ unsigned int _LlmTextGenerateToppSamplingMethod::generate(Tensor &t) {
     }
 
     float p = 0.f;
-    size_t idx = 0;
+    size_t idx_ = 0;
     while (p < m_p) {
-        top_k_elements.emplace_back(scores[idx].first);
-        top_k_elements_idx.emplace_back(scores[idx].second);
-        p += scores[idx].first;
-        idx++;
+        top_k_elements.emplace_back(scores[idx_].first);
+        top_k_elements_idx.emplace_back(scores[idx_].second);
+        p += scores[idx_].first;
+        idx_++;
     }
 
     if (top_k_elements.size() == 1) {
-        return top_k_elements_idx[0];
+        idx = std::move(top_k_elements_idx);
+        probs = {1.f};
+        return;
     }
 
     // softmax with temperature
@@ -116,8 +145,28 @@ unsigned int _LlmTextGenerateToppSamplingMethod::generate(Tensor &t) {
         value /= _sum;
     }
 
-    auto ret = _sample_element(top_k_elements_idx, softmax);
-    return ret;
+    idx = std::move(top_k_elements_idx);
+    probs = std::move(softmax);
+}
+
+unsigned int _LlmTextGenerateToppSamplingMethod::generate(Tensor &t, int seq) {
+    std::vector<unsigned int> idx;
+    std::vector<float> probs;
+    _candidates(t, seq, idx, probs);
+    if (idx.size() == 1) {
+        return idx[0];
+    }
+    return _sample_element(idx, probs);
+}
+
+void _LlmTextGenerateToppSamplingMethod::probabilities(Tensor &t, int seq, std::vector<float> &probs) {
+    std::vector<unsigned int> idx;
+    std::vector<float> candidate_probs;
+    _candidates(t, seq, idx, candidate_probs);
+    probs.assign(t.dimension(), 0.f);
+    for (size_t i = 0; i < idx.size(); ++i) {
+        probs[idx[i]] = candidate_probs[i];
+    }
 }
 
 } // namespace mllm
\ No newline at end of file
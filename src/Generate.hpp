@@ -14,6 +14,7 @@
 #include <cstdint>
 #include <cassert>
 #include <vector>
+#include <memory>
 #include <random>
 #include <utility>
 #include "Tensor.hpp"
@@ -49,23 +50,30 @@ enum class LLmTextGeneratorType : int32_t {
 class _LlmTextGenerateMethod {
 public:
     virtual ~_LlmTextGenerateMethod() = default;
-    virtual unsigned int generate(Tensor &t) = 0;
-    inline void _tensor_to_vec(Tensor &t, std::vector<float> &scores) {
+    /**
+     * \brief pick the next token from the scores at position `seq` of t, the last position when seq < 0.
+     */
+    virtual unsigned int generate(Tensor &t, int seq) = 0;
+    /**
+     * \brief the distribution generate() samples from at position `seq` of t, over the whole vocabulary.
+     */
+    virtual void probabilities(Tensor &t, int seq, std::vector<float> &probs) = 0;
+    inline void _tensor_to_vec(Tensor &t, std::vector<float> &scores, int seq = -1) {
         assert(t.batch() == 1 && "Batch size of result is not 1. Which is not supported for now.");
         assert(t.head() == 1 && "The 3rd dim of result should be one. e.g.:[1, 1, seq, hidden]");
         int _dims = t.dimension();
-        int _seq = t.sequence() - 1;
+        int _seq = seq < 0 ? t.sequence() - 1 : seq;
         for (int i = 0; i < _dims; ++i) {
             auto value = t.dataAt<float>(0, 0, _seq, i);
             scores.push_back(value);
         }
     }
 
-    inline void _tensor_to_vec_with_idx(Tensor &t, std::vector<std::pair<float, unsigned int>> &scores) {
+    inline void _tensor_to_vec_with_idx(Tensor &t, std::vector<std::pair<float, unsigned int>> &scores, int seq = -1) {
         assert(t.batch() == 1 && "Batch size of result is not 1. Which is not supported for now.");
         assert(t.head() == 1 && "The 3rd dim of result should be one. e.g.:[1, 1, seq, hidden]");
         int _dims = t.dimension();
-        int _seq = t.sequence() - 1;
+        int _seq = seq < 0 ? t.sequence() - 1 : seq;
         for (int i = 0; i < _dims; ++i) {
             auto value = t.dataAt<float>(0, 0, _seq, i);
             scores.push_back(std::make_pair(value, i));
@@ -77,7 +85,8 @@ class _LlmTextGenerateGreedySearchMethod : public _LlmTextGenerateMethod {
 public:
     _LlmTextGenerateGreedySearchMethod() = default;
     ~_LlmTextGenerateGreedySearchMethod() = default;
-    unsigned int generate(Tensor &t) override;
+    unsigned int generate(Tensor &t, int seq) override;
+    void probabilities(Tensor &t, int seq, std::vector<float> &probs) override;
 };
 
 class _LlmTextGenerateTopkSamplingMethod : public _LlmTextGenerateMethod {
@@ -87,9 +96,12 @@ public:
         m_k(k),
         m_temperature(temperature) {
     }
-    unsigned int generate(Tensor &t) override;
+    unsigned int generate(Tensor &t, int seq) override;
+    void probabilities(Tensor &t, int seq, std::vector<float> &probs) override;
 
 private:
+    // the tokens generate() samples from and their probabilities.
+    void _candidates(Tensor &t, int seq, std::vector<unsigned int> &idx, std::vector<float> &probs);
     int32_t m_k;
     float m_temperature = 0.f;
 };
@@ -101,9 +113,12 @@ public:
         m_p(p),
         m_temperature(temperature) {
     }
-    unsigned int generate(Tensor &t) override;
+    unsigned int generate(Tensor &t, int seq) override;
+    void probabilities(Tensor &t, int seq, std::vector<float> &probs) override;
 
 private:
+    // the tokens generate() samples from and their probabilities.
+    void _candidates(Tensor &t, int seq, std::vector<unsigned int> &idx, std::vector<float> &probs);
     float m_p;
     float m_temperature = 0.f;
 };
@@ -146,8 +161,12 @@ public:
         }
     }
 
-    inline unsigned int generate(Tensor &t) {
-        return m_method_class->generate(t);
+    inline unsigned int generate(Tensor &t, int seq = -1) {
+        return m_method_class->generate(t, seq);
+    }
+
+    inline void probabilities(Tensor &t, int seq, std::vector<float> &probs) {
+        m_method_class->probabilities(t, seq, probs);
     }
 
     inline LLmTextGeneratorType type() {
@@ -159,6 +178,19 @@ private:
     _LlmTextGenerateMethod *m_method_class = nullptr;
 };
 
+/**
+ * \brief the generator for `opt`, the same choice as Module::generate.
+ */
+inline std::shared_ptr<LlmTextGenerator> makeLlmTextGenerator(const LlmTextGeneratorOpts &opt) {
+    if (opt.do_sample && !opt.top_k && opt.top_p != 0.f) {
+        return std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kToppSampling, opt);
+    }
+    if (opt.do_sample && opt.top_k) {
+        return std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kTopkSampling, opt);
+    }
+    return std::make_shared<LlmTextGenerator>(LLmTextGeneratorType::kGreedySearch, opt);
+}
+
 } // namespace mllm
 
 #endif //! MLLM_GENERATE_HPP
\ No newline at end of file
@@ -141,8 +141,8 @@ const vector<shared_ptr<Tensor>> &Graph::forward(bool autofree) {
 #ifdef DEBUGPRINT
             uint64_t t_start = mllm_time_us();
 #endif
-            ops_[op_name]->execute(ops_input_tensors_[op_name],
-                                   ops_output_tensors_[op_name]);
+            Profiler::execute(ops_[op_name].get(), ops_input_tensors_[op_name],
+                              ops_output_tensors_[op_name]);
 
 #ifdef SAVECHECK
             for (auto &t : ops_output_tensors_[op_name]) {
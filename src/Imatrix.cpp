@@ -0,0 +1,124 @@
+#include "Imatrix.hpp"
+#include <cstdio>
+#include <iostream>
+
+namespace mllm {
+
+static constexpr int32_t imatrix_magic = 0x78746d69; // "imtx"
+static thread_local Imatrix *active_imatrix = nullptr;
+
+Imatrix::~Imatrix() {
+    end();
+}
+
+Imatrix *Imatrix::active() {
+    return active_imatrix;
+}
+
+void Imatrix::begin() {
+    active_imatrix = this;
+}
+
+void Imatrix::end() {
+    if (active_imatrix == this) {
+        active_imatrix = nullptr;
+    }
+}
+
+void Imatrix::add(const std::string &name, const float *x, int64_t rows, int64_t cols, int64_t row_stride) {
+    auto &entry = entries_[name];
+    if (entry.sum.empty()) {
+        entry.sum.resize(cols);
+    } else if (entry.sum.size() != (size_t)cols) {
+        std::cerr << "Imatrix: " << name << " has " << cols << " columns, " << entry.sum.size() << " before" << std::endl;
+        return;
+    }
+    for (int64_t r = 0; r < rows; ++r) {
+        const float *row = x + r * row_stride;
+        for (int64_t j = 0; j < cols; ++j) {
+            entry.sum[j] += (double)row[j] * row[j];
+        }
+    }
+    entry.count += rows;
+}
+
+std::vector<float> Imatrix::weights(const std::string &name) const {
+    auto it = entries_.find(name);
+    if (it == entries_.end() || it->second.count == 0) {
+        return {};
+    }
+    std::vector<float> weights(it->second.sum.size());
+    for (size_t j = 0; j < weights.size(); ++j) {
+        weights[j] = (float)(it->second.sum[j] / it->second.count);
+    }
+    return weights;
+}
+
+bool Imatrix::save(const std::string &path) const {
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp == nullptr) {
+        std::cerr << "Can not open " << path << std::endl;
+        return false;
+    }
+    const uint64_t entries = entries_.size();
+    fwrite(&imatrix_magic, sizeof(imatrix_magic), 1, fp);
+    fwrite(&entries, sizeof(entries), 1, fp);
+    for (const auto &[name, entry] : entries_) {
+        const uint64_t name_size = name.size(), cols = entry.sum.size();
+        fwrite(&name_size, sizeof(name_size), 1, fp);
+        fwrite(name.data(), 1, name_size, fp);
+        fwrite(&entry.count, sizeof(entry.count), 1, fp);
+        fwrite(&cols, sizeof(cols), 1, fp);
+        fwrite(entry.sum.data(), sizeof(double), cols, fp);
+    }
+    const bool ok = ferror(fp) == 0;
+    fclose(fp);
+    return ok;
+}
+
+bool Imatrix::load(const std::string &path) {
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr) {
+        std::cerr << "Can not open " << path << std::endl;
+        return false;
+    }
+    int32_t magic = 0;
+    uint64_t entries = 0;
+    bool ok = fread(&magic, sizeof(magic), 1, fp) == 1 && magic == imatrix_magic && fread(&entries, sizeof(entries), 1, fp) == 1;
+    for (uint64_t i = 0; ok && i < entries; ++i) {
+        uint64_t name_size = 0, cols = 0;
+        int64_t count = 0;
+        std::string name;
+        ok = fread(&name_size, sizeof(name_size), 1, fp) == 1;
+        if (ok) {
+            name.resize(name_size);
+            ok = fread(name.data(), 1, name_size, fp) == name_size
+                 && fread(&count, sizeof(count), 1, fp) == 1
+                 && fread(&cols, sizeof(cols), 1, fp) == 1;
+        }
+        std::vector<double> sum(ok ? cols : 0);
+        ok = ok && fread(sum.data(), sizeof(double), cols, fp) == cols;
+        if (!ok) {
+            break;
+        }
+        auto &entry = entries_[name];
+        if (entry.sum.empty()) {
+            entry.sum.resize(cols);
+        }
+        if (entry.sum.size() != cols) {
+            std::cerr << "Imatrix: " << name << " in " << path << " has " << cols << " columns, " << entry.sum.size() << " before" << std::endl;
+            continue;
+        }
+        for (uint64_t j = 0; j < cols; ++j) {
+            entry.sum[j] += sum[j];
+        }
+        entry.count += count;
+    }
+    fclose(fp);
+    if (!ok) {
+        std::cerr << path << " is not an imatrix file" << std::endl;
+    }
+    return ok;
+}
+
+} // namespace mllm
@@ -0,0 +1,73 @@
+#ifndef MLLM_IMATRIX_HPP
+#define MLLM_IMATRIX_HPP
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mllm {
+
+/**
+ * \brief the importance matrix of the weights of a model: the mean of x[j]^2 over the inputs x of each Linear.
+ *
+ * the output of a Linear is the dot product of its input with each row of its weight, so the error of column j
+ * of a weight matters as much as the energy of input channel j. The quantizer weighs the errors of the weights
+ * by it (see quantize_q4_0() and others), which keeps the channels with large activations accurate.
+ *
+ * while an Imatrix is active(), CPULinear adds its inputs to it.
+ *
+ * Usage:
+ *   Imatrix imatrix;
+ *   imatrix.begin();
+ *   model({input_tensor}); // on some calibration text
+ *   imatrix.end();
+ *   imatrix.save("model.imatrix");
+ *   ./quantize model.mllm model_q4_k.mllm Q4_K -i model.imatrix
+ */
+class Imatrix {
+public:
+    Imatrix() = default;
+    ~Imatrix();
+    Imatrix(const Imatrix &) = delete;
+    Imatrix &operator=(const Imatrix &) = delete;
+
+    /**
+     * \brief the Imatrix the Linear layers add their inputs to, nullptr if there is none.
+     */
+    static Imatrix *active();
+    void begin();
+    void end();
+
+    /**
+     * \brief add the rows of x, each of cols values row_stride apart, to the statistics of the weight name.
+     */
+    void add(const std::string &name, const float *x, int64_t rows, int64_t cols, int64_t row_stride);
+
+    /**
+     * \brief the importance of the columns of the weight name, empty if none was collected.
+     */
+    std::vector<float> weights(const std::string &name) const;
+    size_t size() const {
+        return entries_.size();
+    }
+
+    /**
+     * \brief save the statistics, the sums are kept so that files can be merged by loading them one after another.
+     */
+    bool save(const std::string &path) const;
+    /**
+     * \brief add the statistics saved in path.
+     */
+    bool load(const std::string &path);
+
+private:
+    struct Entry {
+        std::vector<double> sum; // of x[j]^2
+        int64_t count = 0;       // the rows added
+    };
+    std::map<std::string, Entry> entries_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_IMATRIX_HPP
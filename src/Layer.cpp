@@ -5,5 +5,5 @@
 
 #include "Layer.hpp"
 namespace mllm {
-map<string, string> Layer::layername_2_tensorname;
+thread_local map<string, string> Layer::layername_2_tensorname;
 }; // namespace mllm
\ No newline at end of file
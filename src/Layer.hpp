@@ -7,6 +7,7 @@
 
 #include <cstddef>
 #include <cstdlib>
+#include <initializer_list>
 #include <iostream>
 #include <utility>
 
@@ -15,6 +16,7 @@
 #include "ParamLoader.hpp"
 #include "Backend.hpp"
 #include "Timing.hpp"
+#include "ExecutionPlan.hpp"
 
 #include <Module.hpp>
 
@@ -39,7 +41,8 @@ public:
         return init_;
     }
     bool inited_loaded = false;
-    static map<string, string> layername_2_tensorname;
+    // the names of the outputs of the ops, thread_local like Tensor::graphs.
+    static thread_local map<string, string> layername_2_tensorname;
 
     Tensor &operator()(Tensor &input) {
         return _1I1O_OP(input);
@@ -147,9 +150,31 @@ private:
     }
 
 protected:
+    void setUpOp(const vector<shared_ptr<Tensor>> &inputs, const vector<shared_ptr<Tensor>> &outputs) {
+        if (auto *plan = ExecutionPlan::active()) {
+            plan->record(op_, inputs, outputs);
+        }
+        op_->reshape(inputs, outputs);
+        if (auto *planner = MemoryPlanner::active()) {
+            planner->step(inputs, outputs);
+        }
+        op_->setUp(inputs, outputs);
+    }
     bool INIT_OP() {
+        // the entries of Tensor::graphs this call sets may replace the ones the layers resolved, see inputSlot().
+        ++Tensor::graphs_version;
         if (op_ == nullptr) {
             op_ = backend_->opCreate(param_, name_);
+            if (Module::loading_ops != nullptr) {
+                if (!tied_name_.empty()) {
+                    for (auto *op : *Module::loading_ops) {
+                        if (op->name() == tied_name_) {
+                            op_->tieWeight(op);
+                        }
+                    }
+                }
+                Module::loading_ops->push_back(op_);
+            }
         }
         if (Module::doLoad) {
             op_->load(*Module::loader);
@@ -163,6 +188,58 @@ protected:
         }
         return Module::doLoad;
     }
+    /**
+     * \brief Tensor::graphs[input.name()], resolved on the first call and kept while the name of the `i`-th input and
+     *        Tensor::graphs_version do not change, instead of looking it up on every call.
+     */
+    shared_ptr<Tensor> &inputSlot(int i, Tensor &input) {
+        if (input_slots_.size() <= i) {
+            input_slots_.resize(i + 1);
+        }
+        auto &slot = input_slots_[i];
+        if (slot.second == nullptr || slot.first != input.name()) {
+            slot.first = input.name();
+            slot.second = Tensor::graphs[input.name()];
+        }
+        return slot.second;
+    }
+    /**
+     * \brief the graph `inputs` resolved by inputSlot(), followed by the `host_inputs` as they are, in a vector kept
+     *        across the calls: only a host tensor other than that of the last call is wrapped again.
+     */
+    vector<shared_ptr<Tensor>> &inputSlots(std::initializer_list<Tensor *> inputs, std::initializer_list<Tensor *> host_inputs) {
+        op_inputs_.resize(inputs.size() + host_inputs.size());
+        int i = 0;
+        for (auto *input : inputs) {
+            op_inputs_[i] = inputSlot(i, *input);
+            ++i;
+        }
+        for (auto *input : host_inputs) {
+            if (op_inputs_[i].get() != input) {
+                op_inputs_[i] = std::shared_ptr<Tensor>(input, [](Tensor *) {});
+            }
+            ++i;
+        }
+        return op_inputs_;
+    }
+    /**
+     * \brief the outputs of the op, Tensor::graphs of the names prefix + op name (+ "-" + i for n outputs, 0 for one),
+     *        resolved like inputSlot(). the inputs are resolved again when the outputs are.
+     */
+    vector<shared_ptr<Tensor>> &outputSlots(const char *prefix, int n) {
+        if (slots_version_ != Tensor::graphs_version || output_slots_.size() != std::max(n, 1)) {
+            slots_version_ = Tensor::graphs_version;
+            input_slots_.clear();
+            output_slots_.clear();
+            if (n == 0) {
+                output_slots_.push_back(Tensor::graphs[layername_2_tensorname[prefix + op_->name()]]);
+            }
+            for (int i = 0; i < n; ++i) {
+                output_slots_.push_back(Tensor::graphs[layername_2_tensorname[prefix + op_->name() + "-" + std::to_string(i)]]);
+            }
+        }
+        return output_slots_;
+    }
     Tensor &_1I1O_OP(Tensor &input) {
         Module::runlistIdx = saved_list_idx;
         if (Module::doLoad || !inited_loaded) {
@@ -191,19 +268,17 @@ protected:
                 return *Tensor::graphs[next_name];
             }
         }
-        string layer_next_name = "out-" + op_->name();
-        auto next_name = layername_2_tensorname[layer_next_name];
+        auto &outputs = outputSlots("out-", 0);
 #ifdef DEBUGOPTIME
         auto start_t = mllm_time_us();
 #endif
         switch (Tensor::tensor_status) {
             case TENSOR_STATIC_INIT: {
-                op_->reshape({Tensor::graphs[input.name()]}, {Tensor::graphs[next_name]});
-                op_->setUp({Tensor::graphs[input.name()]}, {Tensor::graphs[next_name]});
+                setUpOp({inputSlot(0, input)}, outputs);
                 break;
             }
             case TENSOR_STATIC_READY: {
-                op_->execute({Tensor::graphs[input.name()]}, {Tensor::graphs[next_name]});
+                Profiler::execute(op_, {inputSlot(0, input)}, outputs);
                 break;
             }
             default: {
@@ -215,22 +290,24 @@ protected:
         std::cout<<op_->name() << " | "<<Tensor::tensor_status<<" time: " << (end_t - start_t)/1000.0F <<"ms"<< std::endl;
 #endif
 #ifdef DEBUGSAVETENSOR
-        Tensor::graphs[next_name]->saveNData<float>(layer_next_name);
+        outputs[0]->saveNData<float>("out-" + op_->name());
 #endif     
-        return *Tensor::graphs[next_name];        
+        return *outputs[0];        
     }
-    Tensor &_2I1O_OP(Tensor &input0, Tensor &input1) {
+    /**
+     * \brief the op on the graph tensors `inputs`, followed by `host_inputs`: small host tensors of scalars that are
+     *        not part of the graph (e.g. the cached lengths of Attention), passed to the op as they are.
+     */
+    Tensor &_NI1O_OP(std::initializer_list<Tensor *> inputs, std::initializer_list<Tensor *> host_inputs = {}) {
         Module::runlistIdx = saved_list_idx;
         if (Module::doLoad || !inited_loaded) {
             INIT_OP();
             string layer_next_name = "out-" + op_->name();
-            if (Tensor::graphs.find(input0.name()) == Tensor::graphs.end() || input0.count() != Tensor::graphs[input0.name()]->count()) {
-                Tensor::graphs[input0.name()] = std::shared_ptr<Tensor>(&input0, [](Tensor *) {});
-                Tensor::graphs[input0.name()]->setName(input0.name());
-            }
-            if (Tensor::graphs.find(input1.name()) == Tensor::graphs.end() || input1.count() != Tensor::graphs[input1.name()]->count()) {
-                Tensor::graphs[input1.name()] = std::shared_ptr<Tensor>(&input1, [](Tensor *) {});
-                Tensor::graphs[input1.name()]->setName(input1.name());
+            for (auto *input : inputs) {
+                if (Tensor::graphs.find(input->name()) == Tensor::graphs.end() || input->count() != Tensor::graphs[input->name()]->count()) {
+                    Tensor::graphs[input->name()] = std::shared_ptr<Tensor>(input, [](Tensor *) {});
+                    Tensor::graphs[input->name()]->setName(input->name());
+                }
             }
             if (layername_2_tensorname.find(layer_next_name) == layername_2_tensorname.end()) {
                 layername_2_tensorname[layer_next_name] = name_num_to_X(layer_next_name);
@@ -244,19 +321,18 @@ protected:
                 return *Tensor::graphs[next_name];
             }
         }
-        string layer_next_name = "out-" + op_->name();
-        auto next_name = layername_2_tensorname[layer_next_name];
+        auto &outputs = outputSlots("out-", 0);
+        auto &op_inputs = inputSlots(inputs, host_inputs);
 #ifdef DEBUGOPTIME
         auto start_t = mllm_time_us();
 #endif
         switch (Tensor::tensor_status) {
             case TENSOR_STATIC_INIT: {
-                op_->reshape({Tensor::graphs[input0.name()], Tensor::graphs[input1.name()]}, {Tensor::graphs[next_name]});
-                op_->setUp({Tensor::graphs[input0.name()], Tensor::graphs[input1.name()]}, {Tensor::graphs[next_name]});
+                setUpOp(op_inputs, outputs);
                 break;
             }
             case TENSOR_STATIC_READY: {
-                op_->execute({Tensor::graphs[input0.name()], Tensor::graphs[input1.name()]}, {Tensor::graphs[next_name]});
+                Profiler::execute(op_, op_inputs, outputs);
                 break;
             }
             default: {
@@ -268,69 +344,19 @@ protected:
         std::cout<<op_->name() << " | "<<Tensor::tensor_status<<" time: " << (end_t - start_t)/1000.0F <<"ms"<< std::endl;
 #endif
 #ifdef DEBUGSAVETENSOR
-        Tensor::graphs[next_name]->saveNData<float>(layer_next_name);
+        outputs[0]->saveNData<float>("out-" + op_->name());
 #endif
-        return *Tensor::graphs[next_name];
+        return *outputs[0];
+    }
+    Tensor &_2I1O_OP(Tensor &input0, Tensor &input1) {
+        return _NI1O_OP({&input0, &input1});
     }
     Tensor &_3I1O_OP(Tensor &input0, Tensor &input1, Tensor &input2) {
-        Module::runlistIdx = saved_list_idx;
-        if (Module::doLoad || !inited_loaded) {
-            INIT_OP();
-            string layer_next_name = "out-" + op_->name();   
-            if (Tensor::graphs.find(input0.name()) == Tensor::graphs.end() || input0.count() != Tensor::graphs[input0.name()]->count()) {
-                Tensor::graphs[input0.name()] = std::shared_ptr<Tensor>(&input0, [](Tensor *) {});
-                Tensor::graphs[input0.name()]->setName(input0.name());
-            }
-            if (Tensor::graphs.find(input1.name()) == Tensor::graphs.end() || input1.count() != Tensor::graphs[input1.name()]->count()) {
-                Tensor::graphs[input1.name()] = std::shared_ptr<Tensor>(&input1, [](Tensor *) {});
-                Tensor::graphs[input1.name()]->setName(input1.name());
-            }
-            if (Tensor::graphs.find(input2.name()) == Tensor::graphs.end() || input2.count() != Tensor::graphs[input2.name()]->count()) {
-                Tensor::graphs[input2.name()] = std::shared_ptr<Tensor>(&input2, [](Tensor *) {});
-                Tensor::graphs[input2.name()]->setName(input2.name());
-            }
-            if (layername_2_tensorname.find(layer_next_name) == layername_2_tensorname.end()) {
-                layername_2_tensorname[layer_next_name] = name_num_to_X(layer_next_name);
-            }
-            auto next_name = layername_2_tensorname[layer_next_name];
-            if (Tensor::graphs.find(next_name) == Tensor::graphs.end()) {
-                Tensor::graphs[next_name] = std::make_shared<Tensor>(backend_);
-                Tensor::graphs[next_name]->setName(next_name);
-            }
-            if(Module::doLoad){
-                return *Tensor::graphs[next_name];
-            }
-        }
-        string layer_next_name = "out-" + op_->name();
-        auto next_name = layername_2_tensorname[layer_next_name];
-#ifdef DEBUGOPTIME
-        auto start_t = mllm_time_us();
-#endif
-        switch (Tensor::tensor_status) {
-            case TENSOR_STATIC_INIT: {
-                op_->reshape({Tensor::graphs[input0.name()], Tensor::graphs[input1.name()], Tensor::graphs[input2.name()]}, 
-                            {Tensor::graphs[next_name]});
-                op_->setUp({Tensor::graphs[input0.name()], Tensor::graphs[input1.name()], Tensor::graphs[input2.name()]}, 
-                            {Tensor::graphs[next_name]});
-                break;
-            }
-            case TENSOR_STATIC_READY: {
-                op_->execute({Tensor::graphs[input0.name()], Tensor::graphs[input1.name()], Tensor::graphs[input2.name()]}, 
-                            {Tensor::graphs[next_name]});
-                break;
-            }
-            default: {
-                break;
-            }
-        }
-#ifdef DEBUGOPTIME
-        auto end_t = mllm_time_us();
-        std::cout<<op_->name() << " | "<<Tensor::tensor_status<<" time: " << (end_t - start_t)/1000.0F <<"ms"<< std::endl;
-#endif
-#ifdef DEBUGSAVETENSOR
-        Tensor::graphs[next_name]->saveNData<float>(layer_next_name);
-#endif
-        return *Tensor::graphs[next_name];
+        return _NI1O_OP({&input0, &input1, &input2});
+    }
+    // input3 is a small host tensor of scalars that is not part of the graph.
+    Tensor &_4I1O_OP(Tensor &input0, Tensor &input1, Tensor &input2, Tensor &input3) {
+        return _NI1O_OP({&input0, &input1, &input2}, {&input3});
     }
     Tensor &_3I1OO1_OP(Tensor &input0, Tensor &input1, Tensor &input2) {
         Module::runlistIdx = saved_list_idx;
@@ -353,28 +379,23 @@ protected:
                 return *Tensor::graphs[next_name];
             }
         }
-        string layer_next_name = "out-" + op_->name();
-        auto next_name = layername_2_tensorname[layer_next_name];
+        auto &outputs = outputSlots("out-", 0);
 #ifdef DEBUGOPTIME
         auto start_t = mllm_time_us();
 #endif
         switch (Tensor::tensor_status) {
             case TENSOR_STATIC_INIT: {
-                op_->reshape({Tensor::graphs[input0.name()], 
-                                std::shared_ptr<Tensor>(&input1, [](Tensor *) {}), 
-                                std::shared_ptr<Tensor>(&input2, [](Tensor *) {})}, 
-                            {Tensor::graphs[next_name]});
-                op_->setUp({Tensor::graphs[input0.name()], 
+                setUpOp({inputSlot(0, input0), 
                                 std::shared_ptr<Tensor>(&input1, [](Tensor *) {}), 
                                 std::shared_ptr<Tensor>(&input2, [](Tensor *) {})}, 
-                            {Tensor::graphs[next_name]});
+                            outputs);
                 break;
             }
             case TENSOR_STATIC_READY: {
-                op_->execute({Tensor::graphs[input0.name()], 
+                Profiler::execute(op_, {inputSlot(0, input0), 
                                 std::shared_ptr<Tensor>(&input1, [](Tensor *) {}), 
                                 std::shared_ptr<Tensor>(&input2, [](Tensor *) {})}, 
-                            {Tensor::graphs[next_name]});
+                            outputs);
                 break;
             }
             default: {
@@ -386,9 +407,9 @@ protected:
         std::cout<<op_->name() << " | "<<Tensor::tensor_status<<" time: " << (end_t - start_t)/1000.0F <<"ms"<< std::endl;
 #endif
 #ifdef DEBUGSAVETENSOR
-        Tensor::graphs[next_name]->saveNData<float>(layer_next_name);
+        outputs[0]->saveNData<float>("out-" + op_->name());
  #endif
-        return *Tensor::graphs[next_name];
+        return *outputs[0];
     }
     Tensor &_0I1O_OP() {
         Module::runlistIdx = saved_list_idx;
@@ -407,19 +428,17 @@ protected:
                 return *Tensor::graphs[next_name];
             }
         }
-        string layer_next_name = "param-" + op_->name();
-        auto next_name = layername_2_tensorname[layer_next_name];
+        auto &outputs = outputSlots("param-", 0);
 #ifdef DEBUGOPTIME
         auto start_t = mllm_time_us();
 #endif
         switch (Tensor::tensor_status) {
             case TENSOR_STATIC_INIT: {
-                op_->reshape({}, {Tensor::graphs[next_name]});
-                op_->setUp({}, {Tensor::graphs[next_name]});
+                setUpOp({}, outputs);
                 break;
             }
             case TENSOR_STATIC_READY: {
-                op_->execute({}, {Tensor::graphs[next_name]});
+                Profiler::execute(op_, {}, outputs);
                 break;
             }
             default: {
@@ -431,9 +450,9 @@ protected:
         std::cout<<op_->name() << " | "<<Tensor::tensor_status<<" time: " << (end_t - start_t)/1000.0F <<"ms"<< std::endl;
 #endif
 #ifdef DEBUGSAVETENSOR
-        Tensor::graphs[next_name]->saveNData<float>(layer_next_name);
+        outputs[0]->saveNData<float>("param-" + op_->name());
 #endif
-        return *Tensor::graphs[next_name];
+        return *outputs[0];
     }
     vector<Tensor> _1INO_OP(Tensor &input, int N) {
         Module::runlistIdx = saved_list_idx;
@@ -466,28 +485,17 @@ protected:
                 return output_result;
             }
         }
-        vector<string> layer_next_names = {};
-        for (int i = 0; i < N; ++i) {
-            layer_next_names.push_back("out-" + op_->name() + "-" + std::to_string(i));
-        }
-        vector<shared_ptr<Tensor>> shared_outputs = {};
-        vector<string> next_names = {};
-        for (const auto &layer_next_name : layer_next_names) {
-            auto next_name = layername_2_tensorname[layer_next_name];
-            next_names.push_back(next_name);
-            shared_outputs.push_back(Tensor::graphs[next_name]);
-        }
+        auto &shared_outputs = outputSlots("out-", N);
 #ifdef DEBUGOPTIME
         auto start_t = mllm_time_us();
 #endif
         switch (Tensor::tensor_status) {
             case TENSOR_STATIC_INIT: {
-                op_->reshape({ Tensor::graphs[input.name()]}, shared_outputs);
-                op_->setUp({ Tensor::graphs[input.name()]}, shared_outputs);
+                setUpOp({inputSlot(0, input)}, shared_outputs);
                 break;
             }
             case TENSOR_STATIC_READY: {
-                op_->execute({ Tensor::graphs[input.name()]}, shared_outputs);
+                Profiler::execute(op_, {inputSlot(0, input)}, shared_outputs);
                 break;
             }
             default: {
@@ -499,22 +507,29 @@ protected:
         std::cout<<op_->name() << " | "<<Tensor::tensor_status<<" time: " << (end_t - start_t)/1000.0F <<"ms"<< std::endl;
 #endif
         vector<Tensor> output_result = {};
-        for (const auto &layer_next_name : layer_next_names) {
-            auto next_name = layername_2_tensorname[layer_next_name];
+        for (int i = 0; i < N; ++i) {
 #ifdef DEBUGSAVETENSOR
-            Tensor::graphs[next_name]->saveNData<float>(layer_next_name);
+            shared_outputs[i]->saveNData<float>("out-" + op_->name() + "-" + std::to_string(i));
 #endif
-            output_result.push_back(*Tensor::graphs[next_name]);
+            output_result.push_back(*shared_outputs[i]);
         }
         return output_result;
     }
 
     std::string name_;
+    // the layer whose weight this layer uses, see Op::tieWeight.
+    std::string tied_name_;
     Op *op_ = nullptr;
     Backend *backend_{};
     OpParam param_;
     bool init_ = false;
     int saved_list_idx;
+    // the tensors resolved by inputSlot() and outputSlots(), and the Tensor::graphs_version they were resolved at.
+    vector<std::pair<string, shared_ptr<Tensor>>> input_slots_;
+    vector<shared_ptr<Tensor>> output_slots_;
+    // the inputs of the last call of _NI1O_OP, see inputSlots().
+    vector<shared_ptr<Tensor>> op_inputs_;
+    size_t slots_version_ = 0;
 };
 
 class Linear final : public Layer {
@@ -525,6 +540,14 @@ public:
         param_["bias"] = (float)bias;
         init(std::move(name), OpType::LINEAR);
     }
+    /**
+     * \brief an LM head tied to the table of the Embedding named `embedding_name`: the logits are computed with
+     *        the table in whatever type it was loaded, and no weight of its own is loaded.
+     */
+    explicit Linear(std::string embedding_name, int in_features, int out_features, std::string name) :
+        Linear(in_features, out_features, false, std::move(name)) {
+        tied_name_ = std::move(embedding_name);
+    }
     Tensor &operator()(Tensor &input){
         return _1I1O_OP(input);
     }
@@ -729,6 +752,17 @@ public:
         param_["partial_rotary_factor"] = partial_rotary_factor;
         init(std::move(name), OpType::ROPE);
     }
+    /**
+     * \brief the positions of the tokens in a KVCache with the same sink and cache_max, which evicts tokens.
+     */
+    explicit RoPE(int pose_type, float rope_theta, int max_position_embeddings, int sink, int cache_max, std::string name) {
+        param_["pose_type"] = pose_type;
+        param_["rope_theta"] = rope_theta;
+        param_["max_position_embeddings"] = max_position_embeddings;
+        param_["sink"] = sink;
+        param_["cache_max"] = cache_max;
+        init(std::move(name), OpType::ROPE);
+    }
     Tensor &operator()(Tensor &input) {
         return _1I1O_OP(input);
     }
@@ -747,6 +781,40 @@ public:
         param_["cache_max"] = cache_max;
         init(std::move(name), OpType::KVCACHE);
     }
+    /**
+     * \brief a ring of the last tokens for a sliding-window model, to be used with Attention of the same window.
+     */
+    explicit KVCache(int n_rep, int cache_max, int window, std::string name) {
+        param_["n_rep"] = n_rep;
+        param_["cache_max"] = cache_max;
+        param_["window"] = window;
+        init(std::move(name), OpType::KVCACHE);
+    }
+    /**
+     * \brief a cache of cache_type. MLLM_TYPE_Q8_0 or MLLM_TYPE_Q4_0 quantize the rows as they are cached,
+     *        such a cache can only be read by Attention.
+     */
+    explicit KVCache(int n_rep, int cache_max, int window, DataType cache_type, std::string name) {
+        param_["n_rep"] = n_rep;
+        param_["cache_max"] = cache_max;
+        param_["window"] = window;
+        param_["cache_type"] = cache_type;
+        init(std::move(name), OpType::KVCACHE);
+    }
+    /**
+     * \brief a cache of at most cache_max tokens that keeps the first `sink` ones and evicts the oldest of the others,
+     *        for a generation of any length (StreamingLLM). the keys are rotated to their new positions by rope_type,
+     *        NONE for the values; the RoPE layers need the same sink and cache_max.
+     */
+    explicit KVCache(int n_rep, int cache_max, int sink, RoPEType rope_type, float rope_theta, DataType cache_type, std::string name) {
+        param_["n_rep"] = n_rep;
+        param_["cache_max"] = cache_max;
+        param_["sink"] = sink;
+        param_["rope_type"] = rope_type;
+        param_["rope_theta"] = rope_theta;
+        param_["cache_type"] = cache_type;
+        init(std::move(name), OpType::KVCACHE);
+    }
     Tensor &operator()(Tensor &input) {
         return _1I1O_OP(input);
     }
@@ -756,6 +824,89 @@ public:
     void clearCache(){
         return op_->clearCache();
     }
+    void setCacheSeqLen(int cache_seq_len){
+        return op_->setCacheSeqLen(cache_seq_len);
+    }
+    /**
+     * \brief getCacheSeqLen() as the input of an Attention. the tensor is kept in Tensor::graphs and updated when
+     *        a captured forward is replayed (see ExecutionPlan), unlike the int argument of Attention.
+     */
+    Tensor &cacheSeqLen() {
+        auto &tensor = Tensor::graphs[name_ + ".cache_seq_len"];
+        if (tensor == nullptr) {
+            tensor = std::make_shared<Tensor>(1, 1, 1, 1, backend_, true);
+            tensor->setName(name_ + ".cache_seq_len");
+        }
+        tensor->setDataAt<float>(0, 0, 0, 0, (float)op_->getCacheSeqLen());
+        if (auto *plan = ExecutionPlan::active()) {
+            Op *op = op_;
+            plan->record([op, tensor]() { tensor->setDataAt<float>(0, 0, 0, 0, (float)op->getCacheSeqLen()); });
+        }
+        return *tensor;
+    }
+};
+
+class Attention final : public Layer {
+public:
+    Attention() = default;
+    explicit Attention(std::string name) {
+        param_["do_causal_mask"] = true;
+        init(std::move(name), OpType::ATTENTION);
+    }
+    explicit Attention(bool do_causal_mask, std::string name) {
+        param_["do_causal_mask"] = do_causal_mask;
+        init(std::move(name), OpType::ATTENTION);
+    }
+    explicit Attention(bool do_causal_mask, int window, std::string name) {
+        param_["do_causal_mask"] = do_causal_mask;
+        param_["window"] = window;
+        init(std::move(name), OpType::ATTENTION);
+    }
+    Tensor &operator()(Tensor &q, Tensor &k_cache, Tensor &v_cache, int cache_seq_len) {
+        if (cache_seq_len_ == nullptr) {
+            cache_seq_len_ = std::make_shared<Tensor>(1, 1, 1, 1, backend_, true);
+        }
+        cache_seq_len_->setDataAt<float>(0, 0, 0, 0, (float)cache_seq_len);
+        return _4I1O_OP(q, k_cache, v_cache, *cache_seq_len_);
+    }
+    Tensor &operator()(Tensor &q, Tensor &k_cache, Tensor &v_cache, KVCache &cache) {
+        return _4I1O_OP(q, k_cache, v_cache, cache.cacheSeqLen());
+    }
+
+private:
+    // the int cache_seq_len of the last call, overwritten by the next one.
+    shared_ptr<Tensor> cache_seq_len_;
+};
+
+/**
+ * \brief the attention of DeepSeek's MLA over a cache of its latent KV, see CPULatentAttention.
+ *        name is the kv_b_proj it absorbs, its weight is loaded from name + ".weight".
+ */
+class LatentAttention final : public Layer {
+public:
+    LatentAttention() = default;
+    explicit LatentAttention(int num_heads, int qk_nope_head_dim, int v_head_dim, int kv_lora_rank, bool do_causal_mask, std::string name) {
+        param_["num_heads"] = num_heads;
+        param_["qk_nope_head_dim"] = qk_nope_head_dim;
+        param_["v_head_dim"] = v_head_dim;
+        param_["kv_lora_rank"] = kv_lora_rank;
+        param_["do_causal_mask"] = do_causal_mask;
+        init(std::move(name), OpType::LATENTATTENTION);
+    }
+    Tensor &operator()(Tensor &q_nope, Tensor &q_pe, Tensor &latent_cache, int cache_seq_len) {
+        if (cache_seq_len_ == nullptr) {
+            cache_seq_len_ = std::make_shared<Tensor>(1, 1, 1, 1, backend_, true);
+        }
+        cache_seq_len_->setDataAt<float>(0, 0, 0, 0, (float)cache_seq_len);
+        return _4I1O_OP(q_nope, q_pe, latent_cache, *cache_seq_len_);
+    }
+    Tensor &operator()(Tensor &q_nope, Tensor &q_pe, Tensor &latent_cache, KVCache &cache) {
+        return _4I1O_OP(q_nope, q_pe, latent_cache, cache.cacheSeqLen());
+    }
+
+private:
+    // the int cache_seq_len of the last call, overwritten by the next one.
+    shared_ptr<Tensor> cache_seq_len_;
 };
 
 class LayerNorm final : public Layer {
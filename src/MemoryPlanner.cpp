@@ -0,0 +1,207 @@
+#include "MemoryPlanner.hpp"
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <numeric>
+#include "Backend.hpp"
+#include "Tensor.hpp"
+
+namespace mllm {
+
+// cache line, also enough for the widest vector loads.
+static constexpr size_t arena_alignment = 64;
+static thread_local MemoryPlanner *active_planner = nullptr;
+
+static size_t align_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+MemoryPlanner::~MemoryPlanner() {
+    if (active_planner == this) {
+        active_planner = nullptr;
+    }
+    if (arena_ != nullptr) {
+        backend_->free(arena_);
+    }
+}
+
+MemoryPlanner *MemoryPlanner::active() {
+    return active_planner;
+}
+
+void MemoryPlanner::begin() {
+    uses_.clear();
+    held_.clear();
+    outputs_.clear();
+    deferred_.clear();
+    steps_ = 0;
+    active_planner = this;
+}
+
+void MemoryPlanner::use(Tensor *tensor, bool input) {
+    if (tensor == nullptr) {
+        return;
+    }
+    if (tensor->aggregated()) {
+        for (auto &part : tensor->aggregated_tensors()) {
+            use(part.get(), input);
+        }
+        return;
+    }
+    // the tensors a function was called with may be copies of the ones in Tensor::graphs or temporaries,
+    // which are gone by finish(). the MasterTensor of a temporary is not.
+    auto it = Tensor::graphs.find(tensor->name());
+    if (it != Tensor::graphs.end() && it->second != nullptr) {
+        held_.push_back(it->second);
+        tensor = it->second.get();
+    } else if (input && std::find(deferred_.begin(), deferred_.end(), tensor) == deferred_.end()) {
+        tensor = tensor->masterTensor();
+        if (tensor == nullptr) {
+            return;
+        }
+    }
+    uses_.push_back({tensor, steps_, input});
+}
+
+void MemoryPlanner::step(const std::vector<std::shared_ptr<Tensor>> &inputs, const std::vector<std::shared_ptr<Tensor>> &outputs) {
+    std::vector<Tensor *> input_ptrs, output_ptrs;
+    for (const auto &input : inputs) {
+        input_ptrs.push_back(input.get());
+    }
+    for (const auto &output : outputs) {
+        output_ptrs.push_back(output.get());
+    }
+    step(input_ptrs, output_ptrs);
+}
+
+void MemoryPlanner::step(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs) {
+    steps_++;
+    for (auto *input : inputs) {
+        use(input, true);
+    }
+    outputs_.clear();
+    for (auto *output : outputs) {
+        outputs_.insert(output);
+        use(output, false);
+    }
+}
+
+bool MemoryPlanner::deferAlloc(Tensor *tensor) {
+    if (outputs_.find(tensor) == outputs_.end()) {
+        return false;
+    }
+    // the memory of the previous forward is not kept.
+    tensor->free();
+    if (std::find(deferred_.begin(), deferred_.end(), tensor) == deferred_.end()) {
+        deferred_.push_back(tensor);
+    }
+    if (backend_ == nullptr) {
+        backend_ = tensor->backend();
+    }
+    return true;
+}
+
+void MemoryPlanner::finish(const std::vector<Tensor> &outputs) {
+    active_planner = nullptr;
+    // ChildTensors use the memory of their MasterTensor.
+    auto resolve = [](Tensor *tensor) {
+        while (tensor->masterTensor() != nullptr) {
+            tensor = tensor->masterTensor();
+        }
+        return tensor;
+    };
+    std::map<Tensor *, int> index;
+    std::vector<Tensor *> tensors;
+    std::vector<Block> blocks;
+    std::vector<bool> read, kept;
+    for (auto *tensor : deferred_) {
+        // tensors that became ChildTensors of another Tensor (e.g. the inputs of a Cat) are not placed.
+        if (tensor->masterTensor() != nullptr || tensor->aggregated() || tensor->cntSize() == 0) {
+            continue;
+        }
+        index[tensor] = (int)tensors.size();
+        tensors.push_back(tensor);
+        blocks.push_back({tensor->cntSize(), INT_MAX, INT_MIN});
+    }
+    read.resize(tensors.size());
+    kept.resize(tensors.size());
+    for (const auto &use : uses_) {
+        auto it = index.find(resolve(use.tensor));
+        if (it == index.end()) {
+            continue;
+        }
+        auto &block = blocks[it->second];
+        block.first = std::min(block.first, use.step);
+        block.last = std::max(block.last, use.step);
+        read[it->second] = read[it->second] || use.input;
+    }
+    for (const auto &output : outputs) {
+        auto graph = Tensor::graphs.find(output.name());
+        if (graph == Tensor::graphs.end() || graph->second == nullptr) {
+            continue;
+        }
+        auto it = index.find(resolve(graph->second.get()));
+        if (it != index.end()) {
+            kept[it->second] = true;
+        }
+    }
+    planned_size_ = 0;
+    for (int i = 0; i < blocks.size(); ++i) {
+        // no op reads it, it is an output or read by the Module itself.
+        if (!read[i] || kept[i]) {
+            blocks[i].last = steps_;
+        }
+        planned_size_ += blocks[i].size;
+    }
+
+    size_t size = 0;
+    auto offsets = assignOffsets(blocks, arena_alignment, size);
+    if (size > arena_size_) {
+        if (arena_ != nullptr) {
+            backend_->free(arena_);
+        }
+        backend_->alloc(&arena_, size, arena_alignment);
+        arena_size_ = size;
+    }
+    for (int i = 0; i < tensors.size(); ++i) {
+        tensors[i]->setHostPtr((char *)arena_ + offsets[i]);
+    }
+    uses_.clear();
+    held_.clear();
+    outputs_.clear();
+    deferred_.clear();
+    steps_ = 0;
+}
+
+std::vector<size_t> MemoryPlanner::assignOffsets(const std::vector<Block> &blocks, size_t alignment, size_t &size) {
+    std::vector<size_t> offsets(blocks.size());
+    std::vector<int> order(blocks.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return blocks[a].size > blocks[b].size; });
+    std::vector<int> placed;
+    size = 0;
+    for (int i : order) {
+        const size_t block_size = align_up(blocks[i].size, alignment);
+        // the ranges of the placed blocks that are alive at the same time, by offset.
+        std::vector<std::pair<size_t, size_t>> busy;
+        for (int j : placed) {
+            if (blocks[j].first <= blocks[i].last && blocks[i].first <= blocks[j].last) {
+                busy.emplace_back(offsets[j], offsets[j] + align_up(blocks[j].size, alignment));
+            }
+        }
+        std::sort(busy.begin(), busy.end());
+        size_t offset = 0;
+        for (const auto &range : busy) {
+            if (offset + block_size <= range.first) {
+                break;
+            }
+            offset = std::max(offset, range.second);
+        }
+        offsets[i] = offset;
+        size = std::max(size, offset + block_size);
+        placed.push_back(i);
+    }
+    return offsets;
+}
+
+} // namespace mllm
@@ -0,0 +1,110 @@
+#ifndef MLLM_MEMORYPLANNER_HPP
+#define MLLM_MEMORYPLANNER_HPP
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace mllm {
+class Backend;
+class Tensor;
+
+/**
+ * \brief static placement of the activations of a Module in a single arena.
+ *
+ * while the TENSOR_STATIC_INIT pass sets up the ops, the planner records the inputs and outputs of every op
+ * (step()) and the outputs are not allocated (deferAlloc()). finish() then computes the first and last op that
+ * uses each of them and places them in one arena, so that tensors whose lifetimes do not overlap share memory.
+ * The arena is kept across forwards and only grows, the activations are no longer malloc'ed and freed when the
+ * shapes change between prefill and decode.
+ *
+ * the activations of a planned Module are valid until its next forward. The outputs of Forward and the tensors
+ * that no op reads are kept until the end of the forward.
+ *
+ * Usage:
+ *   model.planMemory();
+ *   model.generate(input_tensor, opt, ...);
+ */
+class MemoryPlanner {
+public:
+    struct Block {
+        size_t size;
+        int first; // the first and the last step that use the block
+        int last;
+    };
+
+    MemoryPlanner() = default;
+    ~MemoryPlanner();
+    MemoryPlanner(const MemoryPlanner &) = delete;
+    MemoryPlanner &operator=(const MemoryPlanner &) = delete;
+
+    /**
+     * \brief the planner of the TENSOR_STATIC_INIT pass being run, nullptr if there is none.
+     */
+    static MemoryPlanner *active();
+
+    /**
+     * \brief start recording, this planner becomes active().
+     */
+    void begin();
+    /**
+     * \brief record an op (or a TensorFunction), called before its outputs are set up.
+     */
+    void step(const std::vector<std::shared_ptr<Tensor>> &inputs, const std::vector<std::shared_ptr<Tensor>> &outputs);
+    void step(const std::vector<Tensor *> &inputs, const std::vector<Tensor *> &outputs);
+    /**
+     * \brief called by Tensor::alloc(). the outputs of the current step are placed by finish() instead.
+     * \return true if the allocation is deferred.
+     */
+    bool deferAlloc(Tensor *tensor);
+    /**
+     * \brief place the deferred tensors in the arena and stop recording.
+     * \param outputs the outputs of Forward, which are kept until the end of the forward.
+     */
+    void finish(const std::vector<Tensor> &outputs);
+
+    /**
+     * \brief the size of the arena in bytes, the largest peak memory of the activations so far.
+     */
+    size_t arenaSize() const {
+        return arena_size_;
+    }
+    /**
+     * \brief the bytes the activations placed by the last finish() would take without reuse.
+     */
+    size_t plannedSize() const {
+        return planned_size_;
+    }
+
+    /**
+     * \brief assign an offset to each block such that blocks whose [first, last] steps overlap do not overlap
+     *        in memory, largest blocks first.
+     * \param size the size of the memory the blocks are placed in.
+     * \return the offsets, aligned to alignment.
+     */
+    static std::vector<size_t> assignOffsets(const std::vector<Block> &blocks, size_t alignment, size_t &size);
+
+private:
+    struct Use {
+        Tensor *tensor; // the one in Tensor::graphs if there is one
+        int step;
+        bool input;
+    };
+    void use(Tensor *tensor, bool input);
+
+    std::vector<Use> uses_;
+    std::vector<std::shared_ptr<Tensor>> held_;
+    // the outputs of the current step.
+    std::set<Tensor *> outputs_;
+    std::vector<Tensor *> deferred_;
+    int steps_ = 0;
+
+    Backend *backend_ = nullptr;
+    void *arena_ = nullptr;
+    size_t arena_size_ = 0;
+    size_t planned_size_ = 0;
+};
+
+} // namespace mllm
+
+#endif // MLLM_MEMORYPLANNER_HPP
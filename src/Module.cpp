@@ -3,13 +3,190 @@
 //
 
 #include "Module.hpp"
+#include "Layer.hpp"
 
 namespace mllm {
 
 map<BackendType, Backend*> Module::backends;
-AbstructLoader *Module::loader;
-int Module::listIdx;
-int Module::runlistIdx;
+thread_local AbstructLoader *Module::loader;
+thread_local int Module::listIdx;
+thread_local int Module::runlistIdx;
 // TensorStatus Tensor::tensor_status;
-bool Module::doLoad = false;
-} // namespace mllm
\ No newline at end of file
+thread_local bool Module::doLoad = false;
+thread_local vector<Op *> *Module::loading_ops = nullptr;
+
+void Module::rewind(int tokens) {
+    for (auto *op : ops_) {
+        if (op->type() == KVCACHE) {
+            op->setCacheSeqLen(op->getCacheSeqLen() - tokens);
+        } else if (op->type() == ROPE) {
+            op->setPosition(op->getPosition() - tokens);
+        }
+    }
+    // no needSetup(): the next forward sets up all ops anyway, as the lengths of the KV caches differ from those of
+    // the last one, see operator().
+}
+
+Tensor Module::sliceSequence(Tensor &input, int begin, int length) {
+    Tensor chunk(input.backend());
+    chunk.setCtype(input.ctype());
+    chunk.setDtype(input.dtype());
+    chunk.reshape(input.batch(), input.head(), length, input.dimension());
+    chunk.alloc();
+    chunk.setTtype(TensorType::INPUT_TENSOR);
+    const size_t row_size = DataTypeSize(input.dtype(), input.dimension());
+    for (int b = 0; b < input.batch(); ++b) {
+        for (int h = 0; h < input.head(); ++h) {
+            for (int s = 0; s < length; ++s) {
+                memcpy(chunk.hostPtr<char>() + DataTypeSize(input.dtype(), chunk.offset(b, h, s, 0)),
+                       input.hostPtr<char>() + DataTypeSize(input.dtype(), input.offset(b, h, begin + s, 0)), row_size);
+            }
+        }
+    }
+    return chunk;
+}
+
+void Module::swapGraphs() {
+    Tensor::graphs.swap(graphs_);
+    Layer::layername_2_tensorname.swap(layer_names_);
+}
+
+vector<Tensor> Module::forwardPlanned(vector<Tensor> &inputs) {
+    if (execution_plan_ && execution_plan_->matches(inputs)) {
+        execution_plan_->bind(inputs);
+        Tensor::tensor_status = TENSOR_STATIC_INIT;
+        execution_plan_->setUp(memory_planner_.get());
+        Tensor::tensor_status = TENSOR_STATIC_READY;
+        execution_plan_->execute();
+        return execution_plan_->outputs();
+    }
+    if (!execution_plan_) {
+        execution_plan_ = std::make_shared<ExecutionPlan>();
+    }
+    execution_plan_->begin(inputs);
+    const auto plan_inputs = execution_plan_->inputs();
+    Tensor::tensor_status = TENSOR_STATIC_INIT;
+    if (memory_planner_) {
+        memory_planner_->begin();
+    }
+    auto setup_outputs = Forward(plan_inputs, {});
+    if (memory_planner_) {
+        memory_planner_->finish(setup_outputs);
+    }
+    if (!execution_plan_->finish(setup_outputs)) {
+        std::cerr << "[WARNING]: the forward can not be captured, running Forward instead" << std::endl;
+        capture_execution_ = false;
+        execution_plan_.reset();
+    }
+    Tensor::tensor_status = TENSOR_STATIC_READY;
+    return Forward(plan_inputs, {});
+}
+
+static unsigned int sample_from(const vector<float> &probs, std::mt19937 &gen) {
+    std::discrete_distribution<unsigned int> dist(probs.begin(), probs.end());
+    return dist(gen);
+}
+
+void Module::generate(Tensor &input_ids, const LlmTextGeneratorOpts &opt, Module &draft, int draft_tokens,
+                      const std::function<bool(unsigned int)> &call_back) {
+    auto target_generator = makeLlmTextGenerator(opt);
+    auto draft_generator = makeLlmTextGenerator(opt);
+    std::mt19937 gen(std::random_device{}());
+    std::uniform_real_distribution<float> uniform(0.f, 1.f);
+
+    // tokens[0, *_fed) are in the KV caches of each model, the rest is fed on its next forward.
+    vector<unsigned int> tokens;
+    for (int s = 0; s < input_ids.sequence(); ++s) {
+        tokens.push_back((unsigned int)input_ids.dataAt<float>(0, 0, s, 0));
+    }
+    size_t target_fed = 0;
+    size_t draft_fed = 0;
+    Tensor draft_ids(1, 1, 1, 1, input_ids.backend(), true);
+    draft_ids.setTtype(TensorType::INPUT_TENSOR);
+    auto feed = [](Module &model, Tensor &ids, const vector<unsigned int> &tokens, size_t begin, size_t end) -> Tensor {
+        ids.reshape(1, 1, end - begin, 1);
+        ids.alloc();
+        for (size_t s = begin; s < end; ++s) {
+            ids.setDataAt<float>(0, 0, s - begin, 0, tokens[s]);
+        }
+        // operator() sets up the ops again if the KV caches were rewound since the last forward of the same shape.
+        return model({ids})[0];
+    };
+    // scores the last `rows` tokens in one forward, the tokens before them may be fed in prefill chunks.
+    auto forward = [&feed](Module &model, Tensor &ids, const vector<unsigned int> &tokens, size_t begin, size_t rows) -> Tensor {
+        const int chunk = model.prefill_chunk_;
+        if (chunk > 0 && tokens.size() - begin > std::max<size_t>(chunk, rows)) {
+            feed(model, ids, tokens, begin, tokens.size() - rows);
+            begin = tokens.size() - rows;
+        }
+        model.prefill_chunk_ = 0;
+        auto out = feed(model, ids, tokens, begin, tokens.size());
+        model.prefill_chunk_ = chunk;
+        return out;
+    };
+
+    size_t generated = 0;
+    vector<vector<float>> draft_probs;
+    vector<float> target_probs;
+    while (generated < opt.max_new_tokens) {
+        // at least one token is left to the target model.
+        const int k = std::min<int>(draft_tokens, opt.max_new_tokens - generated - 1);
+        const size_t known = tokens.size();
+        draft_probs.resize(k);
+        for (int i = 0; i < k; ++i) {
+            auto out = forward(draft, draft_ids, tokens, draft_fed, 1);
+            draft_fed = tokens.size();
+            draft_generator->probabilities(out, -1, draft_probs[i]);
+            tokens.push_back(sample_from(draft_probs[i], gen));
+        }
+        auto out = forward(*this, input_ids, tokens, target_fed, k + 1);
+        target_fed = tokens.size();
+
+        // verify the proposals, rows [sequence - k - 1, sequence) score them and the token after them.
+        const int first_row = out.sequence() - k - 1;
+        int accepted = 0;
+        unsigned int next_token = 0;
+        for (; accepted < k; ++accepted) {
+            const unsigned int proposal = tokens[known + accepted];
+            target_generator->probabilities(out, first_row + accepted, target_probs);
+            const auto &q = draft_probs[accepted];
+            if (uniform(gen) * q[proposal] < target_probs[proposal]) {
+                continue;
+            }
+            float sum = 0.f;
+            for (size_t v = 0; v < target_probs.size(); ++v) {
+                target_probs[v] = std::max(0.f, target_probs[v] - q[v]);
+                sum += target_probs[v];
+            }
+            if (sum == 0.f) {
+                target_generator->probabilities(out, first_row + accepted, target_probs);
+            }
+            next_token = sample_from(target_probs, gen);
+            break;
+        }
+        if (accepted == k) {
+            target_generator->probabilities(out, first_row + k, target_probs);
+            next_token = sample_from(target_probs, gen);
+        }
+
+        // drop the rejected proposals, the draft model has not fed its last proposal yet.
+        tokens.resize(known + accepted);
+        rewind(target_fed - tokens.size());
+        target_fed = tokens.size();
+        if (draft_fed > tokens.size()) {
+            draft.rewind(draft_fed - tokens.size());
+            draft_fed = tokens.size();
+        }
+        tokens.push_back(next_token);
+        bool go_on = true;
+        for (size_t i = known; i < tokens.size() && go_on; ++i) {
+            ++generated;
+            go_on = call_back(tokens[i]);
+        }
+        if (!go_on) {
+            break;
+        }
+    }
+}
+
+} // namespace mllm
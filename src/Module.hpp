@@ -10,6 +10,8 @@
 #include "ParamLoader.hpp"
 #include "Backend.hpp"
 #include "Timing.hpp"
+#include "MemoryPlanner.hpp"
+#include "ExecutionPlan.hpp"
 #include "backends/cpu/CPUBackend.hpp"
 
 #include <any>
@@ -17,6 +19,7 @@
 #include <iostream>
 #include <memory/SystemMemoryManager.hpp>
 #include <memory>
+#include <mutex>
 #include <numeric>
 #include <utility>
 #include <vector>
@@ -30,18 +33,38 @@ private:
     int decoding_token_size_ = 0;
     vector<double> inference_times_;
     vector<vector<int>> last_shape_bshd_;
+    vector<int> last_cache_seq_lens_;
+    int prefill_chunk_ = 0;
     std::shared_ptr<LlmTextGenerator> text_generator_ = nullptr;
+    vector<Op *> ops_;
+    // the Tensor::graphs of this Module while it is not running, so that several loaded Modules
+    // (e.g. the draft and target models of speculative decoding) do not share their tensors.
+    map<string, shared_ptr<Tensor>> graphs_;
+    // the Layer::layername_2_tensorname of this Module, moved into the thread which runs it along with graphs_.
+    map<string, string> layer_names_;
+    bool loaded_ = false;
+    std::shared_ptr<MemoryPlanner> memory_planner_;
+    std::shared_ptr<ExecutionPlan> execution_plan_;
+    bool capture_execution_ = false;
+    // the inputs of the last forward, the tensors Tensor::graphs["input0"], ... stand for.
+    vector<Tensor> forward_inputs_;
 
 public:
+    // shared by the Modules of all threads, the state of loading and running a Module below is thread_local.
     static map<BackendType, Backend *> backends;
-    static AbstructLoader *loader;
+    static thread_local AbstructLoader *loader;
     // static TensorStatus tensor_status;
-    static bool doLoad;
+    static thread_local bool doLoad;
+    // collects the ops created by the Layers while a Module is loading, see ops().
+    static thread_local vector<Op *> *loading_ops;
 
     Module() = default;
     virtual ~Module() = default;
 
     static void initBackend(BackendType type = BackendType::MLLM_CPU) {
+        // the Layers of Modules created on different threads call it.
+        static std::mutex backends_mutex;
+        std::lock_guard<std::mutex> lock(backends_mutex);
         if (Module::backends.find(type) == Module::backends.end()) {
             switch (type) {
             case BackendType::MLLM_CPU: {
@@ -58,17 +81,26 @@ public:
     void to(BackendType type) {
         initBackend(type);
     }
-    static void initLoader(string path) {
-        loader = new ParamLoader(std::move(path));
+    static void initLoader(string path, bool use_mmap = false, bool prefetch = false) {
+        loader = new ParamLoader(std::move(path), use_mmap, prefetch);
     }
 
-    void load(string path) {
+    /**
+     * \brief load weights of this Module.
+     * \param path the .mllm weights file.
+     * \param use_mmap map the weights file and use the weights in-place instead of copying them, see ParamLoader.
+     * \param prefetch with use_mmap, ask the kernel to read the whole file ahead(madvise WILLNEED).
+     */
+    void load(string path, bool use_mmap = false, bool prefetch = false) {
         Tensor::graphs.clear();
+        ++Tensor::graphs_version;
         Tensor::tensor_status = TENSOR_STATIC_INIT;
 
         mllm_time_init();
-        initLoader(path);
+        initLoader(path, use_mmap, prefetch);
         Module::doLoad = true;
+        ops_.clear();
+        loading_ops = &ops_;
         vector<Tensor> tmps;
         int max_in_size = 5;
         for (int i = 0; i < max_in_size; ++i) {
@@ -101,15 +133,23 @@ public:
         uint64_t time_end = mllm_time_us();
         load_time_ = (time_end - time_start) / 1000.0F; // ms
         Module::doLoad = false;
+        loading_ops = nullptr;
+        graphs_.clear();
+        layer_names_.clear();
+        swapGraphs();
+        loaded_ = true;
         // Tensor::graphs.clear();
     }
 
     void load(AbstructLoader &param_loader) {
         Tensor::graphs.clear();
+        ++Tensor::graphs_version;
         Tensor::tensor_status = TENSOR_STATIC_INIT;
 
         loader = &param_loader;
         Module::doLoad = true;
+        ops_.clear();
+        loading_ops = &ops_;
         vector<Tensor> tmps;
         int max_in_size = 5;
         for (int i = 0; i < max_in_size; ++i) {
@@ -120,11 +160,69 @@ public:
         vector<int> tmpt = {0, 0};
         operator()(tmps, tmpt);
         Module::doLoad = false;
+        loading_ops = nullptr;
+        graphs_.clear();
+        layer_names_.clear();
+        swapGraphs();
+        loaded_ = true;
         // Tensor::graphs.clear();
     }
 
     virtual vector<Tensor> Forward(vector<Tensor> inputs, vector<std::any> args) = 0;
 
+    /**
+     * \brief the ops of this Module and its sub-Modules, in the order they were created while loading.
+     */
+    const vector<Op *> &ops() const {
+        return ops_;
+    }
+    /**
+     * \brief reshape and set up all ops on the next forward, e.g. after the KV caches were restored by a PrefixCache.
+     */
+    void needSetup() {
+        last_shape_bshd_.clear();
+    }
+    /**
+     * \brief feed longer inputs in forwards of at most `tokens` tokens, each appending to the KV caches,
+     *        so that the activations of a long prompt are bounded by those of one chunk. 0 feeds every input
+     *        in one forward.
+     *        the output of a chunked forward is that of its last chunk only, i.e. the rows of its last
+     *        (sequence - 1) % tokens + 1 tokens: enough to decode from the last row, not to read the scores of
+     *        every token of the input, which would take the memory the chunks save.
+     */
+    void setPrefillChunk(int tokens) {
+        prefill_chunk_ = tokens;
+    }
+    int prefillChunk() const {
+        return prefill_chunk_;
+    }
+    /**
+     * \brief place the activations of the following forwards in one arena planned from their lifetimes,
+     *        see MemoryPlanner. the activations are then only valid until the next forward.
+     */
+    void planMemory() {
+        if (!memory_planner_) {
+            memory_planner_ = std::make_shared<MemoryPlanner>();
+        }
+    }
+    MemoryPlanner *memoryPlanner() const {
+        return memory_planner_.get();
+    }
+    /**
+     * \brief run the single-token forwards (i.e. decoding) from an ExecutionPlan captured on the first one, instead
+     *        of running Forward twice for every token.
+     */
+    void captureExecution() {
+        capture_execution_ = true;
+    }
+    ExecutionPlan *executionPlan() const {
+        return execution_plan_.get();
+    }
+    /**
+     * \brief drop the last `tokens` tokens from the KV caches and the RoPE positions, see ops().
+     */
+    void rewind(int tokens);
+
     template <typename... Args>
     vector<std::any> convertArgsToAnyVector(Args... args) {
         return vector<std::any>{std::any(args)...};
@@ -136,6 +234,25 @@ public:
             return Forward(inputs, anyArgs);
         }
         if (inputs[0].ttype() == TensorType::INPUT_TENSOR) {
+            if (prefill_chunk_ > 0 && inputs.size() == 1 && inputs[0].sequence() > prefill_chunk_ && !Op::batched_rows.active()) {
+                const bool prefilling = prefilling_token_size_ == 0;
+                const int decoding_token_size = decoding_token_size_;
+                const size_t first_time = inference_times_.size();
+                vector<Tensor> output;
+                for (int begin = 0; begin < inputs[0].sequence(); begin += prefill_chunk_) {
+                    Tensor chunk = sliceSequence(inputs[0], begin, std::min(prefill_chunk_, inputs[0].sequence() - begin));
+                    output = (*this)({chunk}, args...);
+                    chunk.free();
+                }
+                // timed as one forward of the whole input.
+                double time = std::accumulate(inference_times_.begin() + first_time, inference_times_.end(), 0.0);
+                inference_times_.resize(first_time);
+                inference_times_.push_back(time);
+                prefilling_token_size_ = prefilling ? inputs[0].sequence() : prefilling_token_size_;
+                decoding_token_size_ = !prefilling && decoding_token_size == 0 ? inputs[0].sequence() : decoding_token_size;
+                // only the rows of the last chunk, see setPrefillChunk().
+                return output;
+            }
             if (prefilling_token_size_ == 0) { // first time init
                 // if(!Tensor::graphs.empty()){
                 //     Tensor::graphs.clear();
@@ -144,13 +261,38 @@ public:
             } else if (decoding_token_size_ == 0) {
                 decoding_token_size_ = inputs[0].sequence();
             }
+            if (loaded_) {
+                swapGraphs();
+            }
+            if (capture_execution_ && anyArgs.empty() && inputs[0].sequence() == 1 && !Op::batched_rows.active()) {
+                uint64_t time_start = mllm_time_us();
+                auto output = forwardPlanned(inputs);
+                uint64_t time_end = mllm_time_us();
+                inference_times_.push_back((time_end - time_start) / 1000.0F);
+                // the next forward of another shape sets up all ops.
+                last_shape_bshd_.clear();
+                if (loaded_) {
+                    swapGraphs();
+                }
+                return output;
+            }
             bool need_setup = true;
+            // the KVCache outputs grow with every forward, so the same input shape alone does not allow to skip the setup.
+            const vector<int> cache_seq_lens = cacheSeqLens();
+            // the inputs are kept at the same addresses, so that the Layers keep the tensors they resolved from Tensor::graphs.
+            forward_inputs_.resize(inputs.size());
             for (int i = 0; i < inputs.size(); i++) {
-                auto &input = inputs[i];
+                auto &input = forward_inputs_[i];
+                input = inputs[i];
                 input.setName("input" + std::to_string(i));
                 input.setTtype(TensorType::NORMAL_TENSOR);
-                Tensor::graphs[input.name()] = std::shared_ptr<Tensor>(&input, [](Tensor *) {});
-                if (inputs[0].sequence() != 1 && !last_shape_bshd_.empty()) {
+                auto &entry = Tensor::graphs[input.name()];
+                if (entry.get() != &input) {
+                    entry = std::shared_ptr<Tensor>(&input, [](Tensor *) {});
+                    ++Tensor::graphs_version;
+                }
+                // a batched forward (see LlmBatchScheduler) moves its rows to new positions every time.
+                if (inputs[0].sequence() != 1 && !last_shape_bshd_.empty() && !Op::batched_rows.active() && cache_seq_lens == last_cache_seq_lens_) {
                     // if LLM/VLLM model, the `need_setup` should be `true`
                     if (input.batch() == last_shape_bshd_[i][0] & input.sequence() == last_shape_bshd_[i][1] & input.head() == last_shape_bshd_[i][2] & input.dimension() == last_shape_bshd_[i][3]) {
                         need_setup = false;
@@ -161,20 +303,29 @@ public:
 
             uint64_t time_start = mllm_time_us();
             if (need_setup) {
-                Forward(inputs, anyArgs);
+                if (memory_planner_) {
+                    memory_planner_->begin();
+                    memory_planner_->finish(Forward(forward_inputs_, anyArgs));
+                } else {
+                    Forward(forward_inputs_, anyArgs);
+                }
             }
             Tensor::tensor_status = TENSOR_STATIC_READY;
             // uint64_t time_start = mllm_time_us();
-            auto output = Forward(inputs, anyArgs);
+            auto output = Forward(forward_inputs_, anyArgs);
             uint64_t time_end = mllm_time_us();
 
             double inference_time_ = (time_end - time_start) / 1000.0F; // ms
             inference_times_.push_back(inference_time_);
             last_shape_bshd_.clear();
-            for (auto &input : inputs) {
+            for (auto &input : forward_inputs_) {
                 last_shape_bshd_.push_back({input.batch(), input.sequence(),
                                             input.head(), input.dimension()});
             }
+            last_cache_seq_lens_ = cache_seq_lens;
+            if (loaded_) {
+                swapGraphs();
+            }
 
             return output;
         } else {
@@ -182,8 +333,28 @@ public:
         }
     }
 
-    static int listIdx;
-    static int runlistIdx;
+    static thread_local int listIdx;
+    static thread_local int runlistIdx;
+
+private:
+    vector<int> cacheSeqLens() {
+        vector<int> lens;
+        for (auto *op : ops_) {
+            if (op->type() == KVCACHE) {
+                lens.push_back(op->getCacheSeqLen());
+            }
+        }
+        return lens;
+    }
+    // move the tensors and names of this Module into the thread which runs it, or back. as they go with the Module, a
+    // Module loaded on a thread can run on another one.
+    void swapGraphs();
+    // rows [begin, begin + length) of the sequence of `input`, as a new input.
+    static Tensor sliceSequence(Tensor &input, int begin, int length);
+    // a forward without args from execution_plan_, captured first if it does not match the inputs.
+    vector<Tensor> forwardPlanned(vector<Tensor> &inputs);
+
+public:
 
     template <typename T>
     static vector<T> List(int n) {
@@ -225,6 +396,9 @@ public:
 
     void free() {
         Tensor::graphs.clear();
+        graphs_.clear();
+        ++Tensor::graphs_version;
+        execution_plan_.reset();
     }
 
     void profiling(string name = "") {
@@ -291,6 +465,17 @@ public:
             chatPostProcessing(out_token, input_ids, {});
         }
     }
+
+    /**
+     * \brief speculative decoding. `draft`, a small model with the same tokenizer, proposes `draft_tokens`
+     *        tokens one by one, this model scores them all in one forward. Each proposal is accepted with
+     *        probability min(1, p/q), the first rejected one is resampled from max(0, p - q), so the output
+     *        follows the same distribution as generate() with `opt`. Rejected tokens are rewound from the
+     *        KV caches of both models.
+     */
+    void generate(
+        Tensor &input_ids, const LlmTextGeneratorOpts &opt, Module &draft, int draft_tokens = 4,
+        const std::function<bool(unsigned int)> &call_back = [](unsigned int) -> bool { return true; });
 };
 
 } // namespace mllm
@@ -1,5 +1,5 @@
-
 #include "Op.hpp"
 
 namespace mllm {
+thread_local BatchedRows Op::batched_rows;
 }
\ No newline at end of file
@@ -3,11 +3,14 @@
 // #define DEBUGPRINT
 #include "Tensor.hpp"
 #include "Types.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <functional>
 #include <iostream>
 #include "ParamLoader.hpp"
 #include "Timing.hpp"
+#include "Profiler.hpp"
 using std::function;
 namespace mllm {
 
@@ -15,6 +18,44 @@ class Backend;
 class Tensor;
 class ParamLoader;
 
+/**
+ * \brief tokens of several independent sequences packed along the SEQUENCE axis of one forward.
+ *        row i of the forward belongs to the sequence in KV cache slot `slot[i]`, at position `position[i]`.
+ *        set by LlmBatchScheduler around the forward, empty when running a single sequence.
+ */
+struct BatchedRows {
+    int slots = 0;
+    vector<int> slot;
+    vector<int> position;
+
+    bool active() const {
+        return !slot.empty();
+    }
+    int maxPosition() const {
+        int max_pos = -1;
+        for (auto pos : position) {
+            max_pos = std::max(max_pos, pos);
+        }
+        return max_pos;
+    }
+    void clear() {
+        slots = 0;
+        slot.clear();
+        position.clear();
+    }
+    /**
+     * \brief stop if a forward is batched, called by the ops which mix the rows of the sequence (e.g. the scores
+     *        of a Matmul attention) and so would mix the sequences of a batched forward without an error.
+     */
+    void unsupported(const string &op_name) const {
+        if (active()) {
+            std::cerr << "[ERROR]: " << op_name << " does not support the batched forwards of LlmBatchScheduler,"
+                      << " the attention must run through KVCache and Attention (e.g. MultiHeadAttention)" << std::endl;
+            exit(1);
+        }
+    }
+};
+
 class Op {
 public:
     /**
@@ -124,6 +165,57 @@ public:
         assert(type_ == OpType::KVCACHE);
         std::cout << "only for KVCache" << std::endl;
     }
+    /**
+     * \brief keep only the first `cache_seq_len` cached tokens, e.g. to drop rejected draft tokens.
+     */
+    virtual void setCacheSeqLen(int cache_seq_len){
+        assert(type_ == OpType::KVCACHE);
+        std::cout << "only for KVCache" << std::endl;
+    }
+    /**
+     * \brief the position of the next token a RoPE rotates, i.e. the tokens rotated since the start of the sequence.
+     */
+    virtual int getPosition() const {
+        assert(type_ == OpType::ROPE);
+        std::cout << "only for RoPE" << std::endl;
+        return -1;
+    }
+    virtual void setPosition(int position) {
+        assert(type_ == OpType::ROPE);
+        std::cout << "only for RoPE" << std::endl;
+    }
+
+    /**
+     * \brief use the weight of `op`, loaded before this op, instead of loading one of its own, e.g. an LM head
+     *        tied to the table of the token embedding. must be called before load().
+     */
+    virtual void tieWeight(Op *op) {
+        std::cout << "only for Linear" << std::endl;
+    }
+    /**
+     * \brief the weight the ops tied to this op use, see tieWeight().
+     */
+    virtual Tensor *tiedWeight() {
+        std::cout << "only for Embedding" << std::endl;
+        return nullptr;
+    }
+
+    /**
+     * \brief the work of an execute on `inputs` and `outputs`, for the Profiler: the bytes of the inputs and the
+     *        outputs and no FLOPs unless the op counts them.
+     */
+    virtual OpCost cost(const vector<shared_ptr<Tensor>> &inputs, const vector<shared_ptr<Tensor>> &outputs) {
+        OpCost cost;
+        for (const auto &input : inputs) {
+            cost.bytes_read += input->cntSize();
+        }
+        for (const auto &output : outputs) {
+            cost.bytes_written += output->cntSize();
+        }
+        return cost;
+    }
+
+    static thread_local BatchedRows batched_rows;
 
 private:
     Backend *backend_;
@@ -131,7 +223,7 @@ private:
     vector<Tensor *> outputs_;
     string name_;
     DataType activation_dtype_ = MLLM_TYPE_F32;
-    OpType type_;
+    OpType type_ = INVALID_VALUE;
 };
 
 } // namespace mllm
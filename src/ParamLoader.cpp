@@ -1,5 +1,6 @@
 #include "ParamLoader.hpp"
 #include "Types.hpp"
+#include <cerrno>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -8,6 +9,9 @@
 #include <string>
 #include <tuple>
 #include <utility>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 // TODO:
 /*
  * ┌───────┬──────┬───────┬────────┬───────────┬─────────┬─────────┬──────┬──────────────────────┬─────────────────────────┐
@@ -30,28 +34,38 @@
 namespace mllm {
 bool ParamLoader::load(mllm::Tensor *tensor) {
     string name = tensor->name();
-#ifndef USE_MMAP
-    if (offsets_.find(name) == offsets_.end()) { return false; }
-    std::pair<uint64_t, uint64_t> offset = offsets_[name];
-    uint8_t *data = new uint8_t[offset.second];
-    fseek(fp_, offset.first, SEEK_SET);
-    fread(data, sizeof(uint8_t), offset.second, fp_);
-    // TODO:Data?
-    //  tenor. = data;
-    auto *p = tensor->hostPtr<char>();
-    memcpy(static_cast<void *>(p), static_cast<void *>(data),
-           offset.second); // Cast pointers to void*
-    delete[] data;         // Free the memory allocated by new
+    auto iter = offsets_.find(name);
+    if (iter == offsets_.end()) { return false; }
+    auto [offset, length] = iter->second;
+    if (buffer_ != nullptr && offset % sizeof(float) == 0 && length == tensor->cntSize()) {
+        tensor->setHostPtr(buffer_ + offset);
+        return true;
+    }
+    return loadCopy(tensor);
+}
+bool ParamLoader::loadCopy(mllm::Tensor *tensor) {
+    string name = tensor->name();
+    auto iter = offsets_.find(name);
+    if (iter == offsets_.end()) { return false; }
+    auto [offset, length] = iter->second;
+    if (buffer_ != nullptr) {
+        memcpy(tensor->rawHostPtr(), buffer_ + offset, length);
+        return true;
+    }
+    fseek(fp_, offset, SEEK_SET);
+    fread(tensor->rawHostPtr(), sizeof(uint8_t), length, fp_);
     return true;
-#endif
 }
 ParamLoader::~ParamLoader() {
+#ifndef _WIN32
+    if (buffer_ != nullptr) { munmap(buffer_, size_); }
+#endif
     if (fp_ != nullptr) { fclose(fp_); }
 }
 // #ifdef ANDROID_API
 // ParamLoader::ParamLoader(std::string filename, AAssetManager *asset_manager,
 // bool use_mmap ):asset_manager_(asset_manager), #else
-ParamLoader::ParamLoader(std::string filename, bool use_mmap) :
+ParamLoader::ParamLoader(std::string filename, bool use_mmap, bool prefetch) :
     // #endif
     path_(std::move(filename)), use_mmap_(use_mmap) {
     // #ifdef ANDROID_API
@@ -70,11 +84,7 @@ ParamLoader::ParamLoader(std::string filename, bool use_mmap) :
                errorMsg);
         exit(1);
     }
-#ifndef USE_MMAP
-    use_mmap_ = false;
-#endif
     fseek(fp_, 0, SEEK_SET);
-#ifndef USE_MMAP
     int magic = readInt(fp_);
     if (magic != _MAGIC_NUMBER) {
         std::cout << "magic number error" << std::endl;
@@ -90,19 +100,30 @@ ParamLoader::ParamLoader(std::string filename, bool use_mmap) :
         // std::cout<<name<<"   length:"<<length<<std::endl;
         data_type_[name] = readInt(fp_);
     }
-// int len = sizeof(int);
-// while (len<size) {
-//     int index = readInt(fp_);
-//     len+=sizeof(int);
-//     std::string name = readString(fp_);
-//     int length = readInt(fp_);
-//     len+=name.size()+sizeof(int)+sizeof(int);
-//     offsets_[name] = std::make_pair(len,length);
-//     len+=length; //Align?
-// }
-#endif
+    if (use_mmap_) {
+        mapFile(prefetch);
+    }
     // std::cout << "load param file success" << std::endl;
 }
+void ParamLoader::mapFile(bool prefetch) {
+#ifndef _WIN32
+    fseek(fp_, 0, SEEK_END);
+    size_ = ftell(fp_);
+    void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fileno(fp_), 0);
+    if (addr == MAP_FAILED) {
+        std::cerr << "mmap " << path_ << " failed(" << strerror(errno) << "), fall back to fread" << std::endl;
+        use_mmap_ = false;
+        size_ = 0;
+        return;
+    }
+    buffer_ = static_cast<uint8_t *>(addr);
+    if (prefetch) {
+        madvise(buffer_, size_, MADV_WILLNEED);
+    }
+#else
+    use_mmap_ = false;
+#endif
+}
 bool ParamLoader::load(std::shared_ptr<mllm::Tensor> tensor) {
     return load(tensor.get());
 }
@@ -118,8 +139,12 @@ for (auto &[fst, snd] : data_type_) {
 std::tuple<uint8_t *, uint64_t> ParamLoader::load(string name) {
     auto [offset, length] = offsets_[name];
     auto *data = new uint8_t[length];
-    fseek(fp_, offset, SEEK_SET);
-    fread(data, sizeof(uint8_t), length, fp_);
+    if (buffer_ != nullptr) {
+        memcpy(data, buffer_ + offset, length);
+    } else {
+        fseek(fp_, offset, SEEK_SET);
+        fread(data, sizeof(uint8_t), length, fp_);
+    }
     return std::make_tuple(data, length);
 }
 DataType ParamLoader::getDataType(string name) {
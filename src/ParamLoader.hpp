@@ -45,6 +45,8 @@ static std::string readString(mllm_file *fp_) {
 }
 
 #define _MAGIC_NUMBER 20012
+// weights contents are padded to this alignment by ParamWriter, so that they can be used in-place from a mmaped file.
+#define _PARAM_ALIGNMENT 32
 /**
  * \brief The AbstructLoader abstract class provides an interface for loading parameters. 
  */
@@ -52,25 +54,30 @@ class AbstructLoader {
 public:
     virtual bool load(mllm::Tensor *tensor) = 0;
     virtual bool load(std::shared_ptr<mllm::Tensor> tensor) = 0;
+    // loads into the memory of the Tensor itself, for the weights an Op writes into.
+    virtual bool loadCopy(mllm::Tensor *tensor) { return load(tensor); }
     virtual size_t getTensorSize(string name){fprintf(stderr,"loader not support getTensorSize");return NOT_SUPPORT;}
     virtual DataType getDataType(string name) {return MLLM_TYPE_COUNT;}
 };
 
 /**
  * \brief The ParamLoader class is the default and only(currently) implementation of the AbstructLoader class.
+ *
+ * With `use_mmap`, the whole file is mapped into memory and `load(Tensor *)` makes the Tensor point straight
+ * into the mapping instead of copying, so weights are neither read twice nor held twice at load time, and
+ * several processes using the same model share the page cache. The mapping is read-only: the weights an Op
+ * writes into are loaded with `loadCopy()`, which always copies. `prefetch` asks the kernel to read the file ahead.
+ * Tensors whose contents are not suitably aligned in the file(old files, see _PARAM_ALIGNMENT) are copied.
  */
 class ParamLoader : public AbstructLoader {
     friend class QuantWriter;
 
 public:
-    ParamLoader(std::string filename, bool use_mmap = false);
-
-#ifdef USE_MMAP
-    ParamLoader(void *buffer);
-#endif
+    ParamLoader(std::string filename, bool use_mmap = false, bool prefetch = false);
     ~ParamLoader();
     bool load(mllm::Tensor *tensor) override;
     bool load(std::shared_ptr<mllm::Tensor> tensor) override;
+    bool loadCopy(mllm::Tensor *tensor) override;
     vector<std::string> getParamNames();
     std::tuple<uint8_t *, uint64_t> load(string name);
     DataType getDataType(string name) override;
@@ -80,13 +87,17 @@ public:
     unsigned int getParamSize() const {
         return offsets_.size();
     }
-
+    bool isMmaped() const {
+        return buffer_ != nullptr;
+    }
 
 private:
+    void mapFile(bool prefetch);
+
     mllm_file *fp_;
-    uint8_t *buffer_;
+    uint8_t *buffer_ = nullptr; // start of the mapping when use_mmap_
     std::string path_;
-    std::uint64_t size_;
+    std::uint64_t size_ = 0;    // length of the mapping
     std::map<std::string, std::pair<uint64_t, uint64_t>> offsets_; // offsets,length
     std::map<std::string, int> data_type_;
     bool use_mmap_;
@@ -0,0 +1,121 @@
+#include "PrefixCache.hpp"
+#include <algorithm>
+#include "backends/cpu/CPUKVCache.hpp"
+
+namespace mllm {
+
+static size_t common_prefix(const std::vector<unsigned int> &a, const std::vector<unsigned int> &b) {
+    const size_t n = std::min(a.size(), b.size());
+    return std::mismatch(a.begin(), a.begin() + n, b.begin()).first - a.begin();
+}
+
+PrefixCache::PrefixCache(Module &model, size_t memory_budget) :
+    model_(model), memory_budget_(memory_budget) {
+    for (auto *op : model_.ops()) {
+        if (op->type() == KVCACHE) {
+            kv_caches_.push_back(op);
+        } else if (op->type() == ROPE) {
+            ropes_.push_back(op);
+        }
+    }
+}
+
+int PrefixCache::restore(Tensor &input_ids) {
+    for (auto *op : kv_caches_) {
+        if (op->getCacheSeqLen() > 0) {
+            return 0;
+        }
+    }
+    if (input_ids.sequence() == 0) {
+        return 0;
+    }
+    std::vector<unsigned int> ids(input_ids.sequence());
+    for (int s = 0; s < input_ids.sequence(); ++s) {
+        ids[s] = (unsigned int)input_ids.dataAt<float>(0, 0, s, 0);
+    }
+    auto best = entries_.end();
+    size_t length = 0;
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        auto common = std::min(common_prefix(it->ids, ids), ids.size() - 1);
+        if (common > length) {
+            best = it;
+            length = common;
+        }
+    }
+    if (best != entries_.end()) {
+        entries_.splice(entries_.begin(), entries_, best);
+        for (int i = 0; i < kv_caches_.size(); ++i) {
+            if (!static_cast<CPUKVCache *>(kv_caches_[i])->restoreCache(length, best->caches[i].data())) {
+                length = 0;
+            }
+        }
+        if (length == 0) {
+            for (auto *op : kv_caches_) {
+                op->clearCache();
+            }
+        }
+    }
+    // a new sequence starts at position 0, also on a miss.
+    for (auto *op : ropes_) {
+        op->setPosition(length);
+    }
+    if (length == 0) {
+        return 0;
+    }
+    input_ids.reshape(1, 1, ids.size() - length, 1);
+    input_ids.alloc();
+    for (size_t s = length; s < ids.size(); ++s) {
+        input_ids.setDataAt<float>(0, 0, s - length, 0, ids[s]);
+    }
+    model_.needSetup();
+    return length;
+}
+
+void PrefixCache::insert(const std::vector<unsigned int> &ids) {
+    if (ids.empty() || kv_caches_.empty()) {
+        return;
+    }
+    for (auto *op : kv_caches_) {
+        if (op->getCacheSeqLen() < (int)ids.size()) {
+            return;
+        }
+    }
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (common_prefix(it->ids, ids) == ids.size()) {
+            // already covered by a longer snapshot.
+            entries_.splice(entries_.begin(), entries_, it);
+            return;
+        }
+    }
+    Entry entry;
+    entry.ids = ids;
+    entry.bytes = ids.size() * sizeof(unsigned int);
+    entry.caches.resize(kv_caches_.size());
+    for (int i = 0; i < kv_caches_.size(); ++i) {
+        auto *kv_cache = static_cast<CPUKVCache *>(kv_caches_[i]);
+        if (ids.size() * kv_cache->tokenSize() > memory_budget_ || !kv_cache->saveCache(ids.size(), entry.caches[i])) {
+            return;
+        }
+        entry.bytes += entry.caches[i].size();
+    }
+    if (entry.bytes > memory_budget_) {
+        return;
+    }
+    // snapshots of a prefix of `ids` are covered by the new one.
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (common_prefix(it->ids, ids) == it->ids.size()) {
+            memory_usage_ -= it->bytes;
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    memory_usage_ += entry.bytes;
+    entries_.push_front(std::move(entry));
+    while (memory_usage_ > memory_budget_) {
+        memory_usage_ -= entries_.back().bytes;
+        entries_.pop_back();
+    }
+}
+
+} // namespace mllm
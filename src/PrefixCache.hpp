@@ -0,0 +1,70 @@
+#ifndef MLLM_PREFIXCACHE_HPP
+#define MLLM_PREFIXCACHE_HPP
+#include <list>
+#include <vector>
+#include "Module.hpp"
+
+namespace mllm {
+
+/**
+ * \brief reuse of the KV caches across requests that share a prompt prefix (system prompt, few-shot header, ...).
+ *
+ * insert() snapshots the KV caches of every KVCache op of the model for a sequence of token ids.
+ * restore() finds the longest cached prefix of a new prompt, copies it back into the KV caches, sets the
+ * RoPE positions after it and drops it from the prompt, so that only the new suffix is prefilled.
+ * Snapshots are evicted least recently used first to stay under the memory budget.
+ *
+ * Usage:
+ *   PrefixCache prefix_cache(model, 512 * 1024 * 1024);
+ *   auto prompt_ids = ...;                 // token ids of the prompt
+ *   model.clear_kvcache();
+ *   prefix_cache.restore(input_tensor);     // input_tensor keeps the uncached suffix
+ *   model.generate(input_tensor, opt, ...);
+ *   prefix_cache.insert(prompt_ids);
+ */
+class PrefixCache {
+public:
+    /**
+     * \param model a loaded Module, see Module::ops().
+     * \param memory_budget the maximum size of all snapshots in bytes.
+     */
+    PrefixCache(Module &model, size_t memory_budget);
+
+    /**
+     * \brief restore the longest cached prefix of `input_ids` [1, 1, sequence, 1] and remove it from `input_ids`.
+     *        the KV caches must be empty. the last token is always kept for the forward.
+     * \return the number of restored tokens, 0 on a miss.
+     */
+    int restore(Tensor &input_ids);
+    /**
+     * \brief snapshot the KV caches for `ids`, which must be the first ids.size() cached tokens.
+     */
+    void insert(const std::vector<unsigned int> &ids);
+
+    size_t memoryUsage() const {
+        return memory_usage_;
+    }
+    size_t size() const {
+        return entries_.size();
+    }
+
+private:
+    struct Entry {
+        std::vector<unsigned int> ids;
+        // one snapshot per KVCache op, token by token, see CPUKVCache::saveCache.
+        std::vector<std::vector<uint8_t>> caches;
+        size_t bytes = 0;
+    };
+
+    Module &model_;
+    size_t memory_budget_;
+    size_t memory_usage_ = 0;
+    std::vector<Op *> kv_caches_;
+    std::vector<Op *> ropes_;
+    // most recently used first.
+    std::list<Entry> entries_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_PREFIXCACHE_HPP
@@ -0,0 +1,201 @@
+#include "Profiler.hpp"
+#include "Backend.hpp"
+#include "Op.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+namespace mllm {
+
+static thread_local Profiler *active_profiler = nullptr;
+
+Profiler::~Profiler() {
+    end();
+}
+
+Profiler *Profiler::active() {
+    return active_profiler;
+}
+
+Profiler::WorkerTime *Profiler::workerTime() {
+    return active_profiler == nullptr ? nullptr : &active_profiler->worker_time_;
+}
+
+int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::execute(Op *op, const std::vector<std::shared_ptr<Tensor>> &inputs, const std::vector<std::shared_ptr<Tensor>> &outputs) {
+    auto *profiler = active_profiler;
+    if (profiler == nullptr) {
+        op->execute(inputs, outputs);
+        return;
+    }
+    const auto mark = profiler->start();
+    op->execute(inputs, outputs);
+    profiler->layer_ = layerOf(op->name());
+    profiler->stop(mark, OpNames[op->type()], op->name(), profiler->layer_, op->cost(inputs, outputs));
+}
+
+void Profiler::execute(TensorFunction *func, TensorFuncType type, const std::vector<Tensor *> &outputs, const std::vector<Tensor *> &inputs, const std::vector<float> &args) {
+    auto *profiler = active_profiler;
+    if (profiler == nullptr) {
+        func->execute(outputs, inputs, args);
+        return;
+    }
+    const auto mark = profiler->start();
+    func->execute(outputs, inputs, args);
+    profiler->stop(mark, TensorFuncNames[type], outputs.empty() ? std::string() : outputs[0]->name(), profiler->layer_,
+                   func->cost(outputs, inputs, args));
+}
+
+void Profiler::begin() {
+    if (events_.empty()) {
+        origin_ns_ = now();
+    }
+    active_profiler = this;
+}
+
+void Profiler::end() {
+    if (active_profiler == this) {
+        active_profiler = nullptr;
+    }
+}
+
+void Profiler::clear() {
+    events_.clear();
+    layer_.clear();
+    origin_ns_ = now();
+}
+
+Profiler::Mark Profiler::start() {
+    worker_time_.threads.store(1, std::memory_order_relaxed);
+    return {now(), worker_time_.busy_ns.load(std::memory_order_relaxed)};
+}
+
+void Profiler::stop(const Mark &mark, const char *type, const std::string &name, const std::string &layer, const OpCost &cost) {
+    const int64_t dur_ns = std::max<int64_t>(now() - mark.start_ns, 1);
+    // the calling thread works on the jobs as well, it is busy all along.
+    const int64_t busy_ns = dur_ns + worker_time_.busy_ns.load(std::memory_order_relaxed) - mark.busy_ns;
+    const int threads = worker_time_.threads.load(std::memory_order_relaxed);
+    const float utilization = std::min(1.0F, (float)busy_ns / ((float)dur_ns * threads));
+    events_.push_back({type, name, layer, mark.start_ns - origin_ns_, dur_ns, cost, utilization});
+}
+
+std::string Profiler::layerOf(const std::string &name) {
+    size_t begin = 0;
+    while (begin < name.size()) {
+        size_t end = name.find('.', begin);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+        if (end > begin && std::all_of(name.begin() + begin, name.begin() + end, ::isdigit)) {
+            return name.substr(0, end);
+        }
+        begin = end + 1;
+    }
+    return name;
+}
+
+namespace {
+struct Total {
+    int64_t calls = 0;
+    int64_t ns = 0;
+    int64_t busy_ns = 0; // utilization times ns
+    OpCost cost;
+};
+
+void printTable(std::ostream &os, const char *title, const std::map<std::string, Total> &totals, int64_t all_ns) {
+    std::vector<std::pair<std::string, Total>> rows(totals.begin(), totals.end());
+    std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) { return a.second.ns > b.second.ns; });
+    size_t width = std::string(title).size();
+    for (const auto &row : rows) {
+        width = std::max(width, row.first.size());
+    }
+    os << std::left << std::setw((int)width) << title << std::right
+       << std::setw(8) << "calls" << std::setw(12) << "total ms" << std::setw(8) << "%"
+       << std::setw(11) << "avg us" << std::setw(10) << "GFLOP/s" << std::setw(9) << "GB/s" << std::setw(7) << "util" << "\n";
+    for (const auto &row : rows) {
+        const auto &total = row.second;
+        const double seconds = total.ns / 1e9;
+        const double bytes = (double)total.cost.bytes_read + (double)total.cost.bytes_written;
+        os << std::left << std::setw((int)width) << row.first << std::right << std::fixed
+           << std::setw(8) << total.calls
+           << std::setw(12) << std::setprecision(3) << total.ns / 1e6
+           << std::setw(8) << std::setprecision(1) << 100.0 * total.ns / std::max<int64_t>(all_ns, 1)
+           << std::setw(11) << std::setprecision(1) << total.ns / 1e3 / total.calls
+           << std::setw(10) << std::setprecision(2) << total.cost.flops / seconds / 1e9
+           << std::setw(9) << std::setprecision(2) << bytes / seconds / 1e9
+           << std::setw(7) << std::setprecision(2) << (double)total.busy_ns / total.ns << "\n";
+    }
+    os << std::defaultfloat;
+}
+
+void add(Total &total, int64_t ns, float utilization, const OpCost &cost) {
+    total.calls++;
+    total.ns += ns;
+    total.busy_ns += (int64_t)(utilization * ns);
+    total.cost.flops += cost.flops;
+    total.cost.bytes_read += cost.bytes_read;
+    total.cost.bytes_written += cost.bytes_written;
+}
+
+std::string jsonString(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+} // namespace
+
+void Profiler::summary(std::ostream &os) const {
+    std::map<std::string, Total> by_type, by_layer;
+    int64_t all_ns = 0;
+    for (const auto &event : events_) {
+        add(by_type[event.type], event.dur_ns, event.utilization, event.cost);
+        add(by_layer[event.layer], event.dur_ns, event.utilization, event.cost);
+        all_ns += event.dur_ns;
+    }
+    os << events_.size() << " executes in " << std::fixed << std::setprecision(3) << all_ns / 1e6 << " ms" << std::defaultfloat << "\n";
+    printTable(os, "op type", by_type, all_ns);
+    os << "\n";
+    printTable(os, "layer", by_layer, all_ns);
+    os << std::flush;
+}
+
+bool Profiler::writeChromeTrace(const std::string &path) const {
+    FILE *fp = fopen(path.c_str(), "w");
+    if (fp == nullptr) {
+        std::cerr << "Can not open " << path << std::endl;
+        return false;
+    }
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < events_.size(); ++i) {
+        const auto &event = events_[i];
+        fprintf(fp, "{\"name\":%s,\"cat\":%s,\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":0,"
+                    "\"args\":{\"layer\":%s,\"flops\":%lld,\"bytes_read\":%lld,\"bytes_written\":%lld,\"utilization\":%.3f}}%s\n",
+                jsonString(event.name).c_str(), jsonString(event.type).c_str(), event.start_ns / 1e3, event.dur_ns / 1e3,
+                jsonString(event.layer).c_str(), (long long)event.cost.flops, (long long)event.cost.bytes_read, (long long)event.cost.bytes_written,
+                event.utilization, i + 1 == events_.size() ? "" : ",");
+    }
+    fprintf(fp, "]}\n");
+    const bool ok = ferror(fp) == 0;
+    fclose(fp);
+    return ok;
+}
+
+} // namespace mllm
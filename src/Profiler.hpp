@@ -0,0 +1,135 @@
+#ifndef MLLM_PROFILER_HPP
+#define MLLM_PROFILER_HPP
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "OpDefined.hpp"
+
+namespace mllm {
+class Op;
+class Tensor;
+class TensorFunction;
+
+/**
+ * \brief the work of one execute of an op or a TensorFunction, see Op::cost() and TensorFunction::cost().
+ */
+struct OpCost {
+    int64_t flops = 0;
+    int64_t bytes_read = 0;
+    int64_t bytes_written = 0;
+};
+
+/**
+ * \brief records every Op::execute and TensorFunction::execute of the forwards run on this thread while it is
+ *        active(): the wall time, the bytes read and written, the FLOPs and the utilization of the threads.
+ *
+ * the utilization of an execute is the time the threads of the ThreadPool worked for it over its wall time times
+ * the threads it ran on, 1 for an op that does not use the ThreadPool. While no Profiler is active, the cost of it
+ * is one check per execute, so it is built into every build.
+ *
+ * the ops and TensorFunctions are executed through execute(), which records them if a Profiler is active.
+ *
+ * Usage:
+ *   Profiler profiler;
+ *   profiler.begin();
+ *   model({input_tensor});
+ *   profiler.end();
+ *   profiler.summary(std::cout);
+ *   profiler.writeChromeTrace("trace.json"); // open in chrome://tracing or ui.perfetto.dev
+ */
+class Profiler {
+public:
+    /**
+     * \brief the time the workers of the ThreadPool spent on the jobs of a thread, see ThreadPool::run().
+     */
+    struct WorkerTime {
+        std::atomic<int64_t> busy_ns{0};
+        std::atomic<int> threads{1};
+    };
+    /**
+     * \brief the start of an execute, see start().
+     */
+    struct Mark {
+        int64_t start_ns;
+        int64_t busy_ns;
+    };
+
+    Profiler() = default;
+    ~Profiler();
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    /**
+     * \brief the Profiler of this thread, nullptr if there is none.
+     */
+    static Profiler *active();
+    /**
+     * \brief the WorkerTime the jobs submitted by this thread add to, nullptr if no Profiler is active.
+     */
+    static WorkerTime *workerTime();
+    static int64_t now();
+
+    /**
+     * \brief op->execute(inputs, outputs), recorded by the active Profiler.
+     */
+    static void execute(Op *op, const std::vector<std::shared_ptr<Tensor>> &inputs, const std::vector<std::shared_ptr<Tensor>> &outputs);
+    /**
+     * \brief func->execute(outputs, inputs, args), recorded by the active Profiler as `type`.
+     */
+    static void execute(TensorFunction *func, TensorFuncType type, const std::vector<Tensor *> &outputs, const std::vector<Tensor *> &inputs, const std::vector<float> &args);
+
+    void begin();
+    void end();
+    void clear();
+
+    Mark start();
+    /**
+     * \brief record an execute which started at `mark`.
+     * \param type the type of the op, e.g. OpNames[op->type()].
+     * \param name the name of the op, or of the output of a TensorFunction.
+     * \param layer the layer it belongs to, see layerOf().
+     */
+    void stop(const Mark &mark, const char *type, const std::string &name, const std::string &layer, const OpCost &cost);
+
+    size_t size() const {
+        return events_.size();
+    }
+
+    /**
+     * \brief the time, work and utilization of the executes by op type and by layer, the longest first.
+     */
+    void summary(std::ostream &os) const;
+    /**
+     * \brief write the executes in the Trace Event Format of chrome://tracing.
+     */
+    bool writeChromeTrace(const std::string &path) const;
+
+    /**
+     * \brief the layer of an op name, up to the index of its block (e.g. "model.layers.3" of
+     *        "model.layers.3.self_attn.q_proj"), the name if it has no index. The outputs of the TensorFunctions are
+     *        named after all the blocks ("layers.X"), a TensorFunction belongs to the layer of the op before it.
+     */
+    static std::string layerOf(const std::string &name);
+
+private:
+    struct Event {
+        const char *type;
+        std::string name;
+        std::string layer;
+        int64_t start_ns;
+        int64_t dur_ns;
+        OpCost cost;
+        float utilization;
+    };
+    std::vector<Event> events_;
+    int64_t origin_ns_ = 0;
+    std::string layer_; // of the last op
+    WorkerTime worker_time_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_PROFILER_HPP
@@ -0,0 +1,104 @@
+#include "Scheduler.hpp"
+#include <cstdint>
+
+namespace mllm {
+
+LlmBatchScheduler::LlmBatchScheduler(Module &model, int max_batch, int prefill_chunk) :
+    model_(model), max_batch_(max_batch), prefill_chunk_(prefill_chunk) {
+    assert(max_batch > 0 && prefill_chunk >= 0);
+    for (int slot = max_batch - 1; slot >= 0; --slot) {
+        free_slots_.push_back(slot);
+    }
+}
+
+int LlmBatchScheduler::addRequest(const std::vector<unsigned int> &prompt_ids, const LlmTextGeneratorOpts &opt,
+                                  const std::function<bool(unsigned int)> &call_back) {
+    assert(!prompt_ids.empty());
+    const int id = next_id_++;
+    Sequence sequence;
+    sequence.id = id;
+    sequence.tokens = prompt_ids;
+    sequence.opt = opt;
+    sequence.generator = makeLlmTextGenerator(opt);
+    sequence.call_back = call_back;
+    waiting_.push_back(std::move(sequence));
+    return id;
+}
+
+bool LlmBatchScheduler::step() {
+    while (!free_slots_.empty() && !waiting_.empty()) {
+        running_.push_back(std::move(waiting_.front()));
+        waiting_.pop_front();
+        running_.back().slot = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    if (running_.empty()) {
+        return false;
+    }
+
+    auto &rows = Op::batched_rows;
+    rows.clear();
+    rows.slots = max_batch_;
+    std::vector<unsigned int> token_ids;
+    // the row of the last token of each sequence, -1 while some of its prompt is left for the next steps.
+    std::vector<int> last_rows(running_.size(), -1);
+    auto feed = [&](int i, size_t count) {
+        auto &sequence = running_[i];
+        for (size_t t = 0; t < count; ++t) {
+            token_ids.push_back(sequence.tokens[t]);
+            rows.slot.push_back(sequence.slot);
+            rows.position.push_back(sequence.position++);
+        }
+        sequence.tokens.erase(sequence.tokens.begin(), sequence.tokens.begin() + count);
+        if (sequence.tokens.empty()) {
+            last_rows[i] = (int)token_ids.size() - 1;
+        }
+    };
+    // decoding sequences first, prompts share what is left of the prefill chunk.
+    size_t budget = prefill_chunk_ > 0 ? prefill_chunk_ : SIZE_MAX;
+    for (int i = 0; i < running_.size(); ++i) {
+        if (running_[i].generated > 0) {
+            feed(i, running_[i].tokens.size());
+        }
+    }
+    for (int i = 0; i < running_.size() && budget > 0; ++i) {
+        if (running_[i].generated == 0) {
+            const size_t count = std::min(budget, running_[i].tokens.size());
+            budget -= count;
+            feed(i, count);
+        }
+    }
+    Tensor input(1, 1, (int)token_ids.size(), 1, Module::backends[MLLM_CPU], true);
+    input.setTtype(INPUT_TENSOR);
+    for (int i = 0; i < token_ids.size(); ++i) {
+        input.setDataAt<float>(0, 0, i, 0, (float)token_ids[i]);
+    }
+    auto out = model_({input});
+    rows.clear();
+
+    std::vector<Sequence> still_running;
+    for (int i = 0; i < running_.size(); ++i) {
+        auto &sequence = running_[i];
+        if (last_rows[i] < 0) {
+            still_running.push_back(std::move(sequence));
+            continue;
+        }
+        auto out_token = sequence.generator->generate(out[0], last_rows[i]);
+        sequence.generated++;
+        if (sequence.call_back(out_token) && sequence.generated < sequence.opt.max_new_tokens) {
+            sequence.tokens = {out_token};
+            still_running.push_back(std::move(sequence));
+        } else {
+            free_slots_.push_back(sequence.slot);
+        }
+    }
+    running_ = std::move(still_running);
+    return true;
+}
+
+void LlmBatchScheduler::run() {
+    while (step()) {
+    }
+}
+
+} // namespace mllm
@@ -0,0 +1,87 @@
+#ifndef MLLM_SCHEDULER_HPP
+#define MLLM_SCHEDULER_HPP
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Module.hpp"
+
+namespace mllm {
+
+/**
+ * \brief continuous batching of several independent generation requests on one Module.
+ *
+ * Every step packs the next tokens of all running sequences along the SEQUENCE axis of a single
+ * forward (prompt tokens of newly admitted sequences and one decoded token of the others), so each
+ * Linear streams its weights once for all sequences. Each sequence owns one KV cache slot,
+ * see BatchedRows. Sequences are admitted and retired between steps, i.e. at token granularity.
+ * With a prefill chunk, long prompts are fed over several steps, at most that many prompt tokens per
+ * step, so the running sequences keep decoding one token per step meanwhile.
+ *
+ * The model must run its attention through KVCache and Attention (e.g. MultiHeadAttention), the ops which
+ * would mix the sequences instead (Matmul, the masks, ...) stop with an error. It must not be used outside
+ * of the scheduler since its KV caches hold one slot per sequence.
+ *
+ * Usage:
+ *   LlmBatchScheduler scheduler(model, 8);
+ *   scheduler.addRequest(prompt_ids, opt, [&](unsigned int out_token) -> bool { ...; return true; });
+ *   scheduler.run();
+ */
+class LlmBatchScheduler {
+public:
+    /**
+     * \param model the LLM, taking token ids [1, 1, sequence, 1] and returning scores [1, 1, sequence, vocab].
+     * \param max_batch the maximum number of sequences running together, i.e. the number of KV cache slots.
+     * \param prefill_chunk the maximum number of prompt tokens fed in one step, 0 to feed whole prompts.
+     */
+    LlmBatchScheduler(Module &model, int max_batch, int prefill_chunk = 0);
+
+    /**
+     * \brief queue a request, it starts at the next step with a free slot.
+     * \param call_back called with every new token, return false to stop the request.
+     * \return the id of the request.
+     */
+    int addRequest(const std::vector<unsigned int> &prompt_ids, const LlmTextGeneratorOpts &opt,
+                   const std::function<bool(unsigned int)> &call_back = [](unsigned int) -> bool { return true; });
+
+    /**
+     * \brief run one batched forward over all running sequences.
+     * \return false if there was nothing to run.
+     */
+    bool step();
+    /**
+     * \brief step until every request is finished.
+     */
+    void run();
+
+    size_t runningRequests() const {
+        return running_.size();
+    }
+    size_t waitingRequests() const {
+        return waiting_.size();
+    }
+
+private:
+    struct Sequence {
+        int id;
+        int slot = -1;
+        int position = 0;
+        std::vector<unsigned int> tokens; // tokens not fed to the model yet
+        size_t generated = 0;
+        LlmTextGeneratorOpts opt;
+        std::shared_ptr<LlmTextGenerator> generator;
+        std::function<bool(unsigned int)> call_back;
+    };
+
+    Module &model_;
+    int max_batch_;
+    int prefill_chunk_;
+    int next_id_ = 0;
+    std::deque<Sequence> waiting_;
+    std::vector<Sequence> running_;
+    std::vector<int> free_slots_;
+};
+
+} // namespace mllm
+
+#endif // MLLM_SCHEDULER_HPP
@@ -3,6 +3,7 @@
 #include <express/ExpressBase.hpp>
 #include "OpDefined.hpp"
 #include "Timing.hpp"
+#include "Profiler.hpp"
 #include "Types.hpp"
 #include "backends/cpu/CPUTensorFunction.hpp"
 
@@ -48,10 +49,16 @@ void Tensor::alloc() {
     if (!shape_offset_.empty() & !shape_master_.empty()) {
         return;
     }
+    if (auto *planner = MemoryPlanner::active(); planner != nullptr && planner->deferAlloc(this)) {
+        return;
+    }
     if (allocated_ != count_) {
         if (host_ptr_ != nullptr) {
-            backend_->free(host_ptr_);
+            if (!external_ptr_) {
+                backend_->free(host_ptr_);
+            }
             host_ptr_ = nullptr;
+            external_ptr_ = false;
         }
         if (count_ > 0) {
             backend_->alloc(&host_ptr_, cntSize(), 8);
@@ -73,23 +80,28 @@ bool Tensor::reshape(const int batch, const int channel, const int time, const i
     return reshape(shape);
 }
 
-map<string, shared_ptr<Tensor>> Tensor::graphs;
-TensorStatus Tensor::tensor_status;
+thread_local map<string, shared_ptr<Tensor>> Tensor::graphs;
+thread_local size_t Tensor::graphs_version = 0;
+thread_local TensorStatus Tensor::tensor_status;
 
 Tensor& Tensor::getFunc(const std::string& suffix, const TensorFuncType type, vector<float> float_args, vector<Tensor *> other_tensors){
     const std::string next_name = name_ + "-" + suffix;
-    if (Tensor::graphs.find(name_) == Tensor::graphs.end()) {
-        Tensor::graphs[name_] = std::shared_ptr<Tensor>(this, [](Tensor *) {});
+    // each entry is looked up once, the map is not searched again for every use below.
+    auto input = Tensor::graphs.find(name_);
+    if (input == Tensor::graphs.end()) {
+        input = Tensor::graphs.emplace(name_, std::shared_ptr<Tensor>(this, [](Tensor *) {})).first;
     }
-    if (Tensor::graphs.find(next_name) == Tensor::graphs.end()) {
-        Tensor::graphs[next_name] = std::make_shared<Tensor>(backend_);
-        Tensor::graphs[next_name]->setName(next_name);
+    auto next = Tensor::graphs.find(next_name);
+    if (next == Tensor::graphs.end()) {
+        next = Tensor::graphs.emplace(next_name, std::make_shared<Tensor>(backend_)).first;
+        next->second->setName(next_name);
     }
+    Tensor *output = next->second.get();
     if (Module::doLoad) { 
-        return  *Tensor::graphs[next_name];
+        return  *output;
     }
     TensorFunction *func = backend_->funcCreate(type);
-    std::vector<Tensor*> tensorPtrs = {Tensor::graphs[name_].get()};
+    std::vector<Tensor*> tensorPtrs = {input->second.get()};
     for (auto &other_tensor : other_tensors) {
         tensorPtrs.push_back(other_tensor);
     }
@@ -98,11 +110,17 @@ Tensor& Tensor::getFunc(const std::string& suffix, const TensorFuncType type, ve
 #endif
     switch (Tensor::tensor_status) {
     case TENSOR_STATIC_INIT: {
-        func->setup({Tensor::graphs[next_name].get()}, tensorPtrs, float_args);
+        if (auto *plan = ExecutionPlan::active()) {
+            plan->record(func, type, tensorPtrs, {output}, float_args);
+        }
+        if (auto *planner = MemoryPlanner::active()) {
+            planner->step(tensorPtrs, {output});
+        }
+        func->setup({output}, tensorPtrs, float_args);
         break;
     }
     case TENSOR_STATIC_READY: {
-        func->execute({Tensor::graphs[next_name].get()},tensorPtrs, float_args);
+        Profiler::execute(func, type, {output}, tensorPtrs, float_args);
         break;
     }
     default: {
@@ -113,9 +131,9 @@ Tensor& Tensor::getFunc(const std::string& suffix, const TensorFuncType type, ve
     std::cout<<next_name << " | "<<Tensor::tensor_status<<" time: " << (end_t - start_t)/1000.0F <<"ms"<< std::endl;
 #endif
 #ifdef DEBUGSAVETENSOR
-    Tensor::graphs[next_name]->saveNData<float>();
+    output->saveNData<float>();
 #endif
-    return  *Tensor::graphs[next_name];
+    return  *output;
 }
 
 Tensor &Tensor::operator+(float data) {
@@ -239,23 +257,31 @@ Tensor& Tensor::getStaticFunc(const std::string& suffix, const TensorFuncType ty
     }
     TensorFunction *func = backend_h->funcCreate(type);
     const std::string next_name = suffix;
-    if (Tensor::graphs.find(next_name) == Tensor::graphs.end()) {
-        Tensor::graphs[next_name] = std::make_shared<Tensor>(backend_h);
-        Tensor::graphs[next_name]->setName(next_name);
+    auto next = Tensor::graphs.find(next_name);
+    if (next == Tensor::graphs.end()) {
+        next = Tensor::graphs.emplace(next_name, std::make_shared<Tensor>(backend_h)).first;
+        next->second->setName(next_name);
     }
+    Tensor *output = next->second.get();
     if (Module::doLoad) { 
-        return  *Tensor::graphs[next_name];
+        return  *output;
     }
 #ifdef DEBUGOPTIME
     auto start_t = mllm_time_us();
 #endif
     switch (Tensor::tensor_status) {
     case TENSOR_STATIC_INIT: {
-        func->setup({Tensor::graphs[next_name].get()}, other_tensors, float_args);
+        if (auto *plan = ExecutionPlan::active()) {
+            plan->record(func, type, other_tensors, {output}, float_args);
+        }
+        if (auto *planner = MemoryPlanner::active()) {
+            planner->step(other_tensors, {output});
+        }
+        func->setup({output}, other_tensors, float_args);
         break;
     }
     case TENSOR_STATIC_READY: {
-        func->execute({Tensor::graphs[next_name].get()}, other_tensors, float_args);
+        Profiler::execute(func, type, {output}, other_tensors, float_args);
         break;
     }
     default: {
@@ -266,9 +292,9 @@ Tensor& Tensor::getStaticFunc(const std::string& suffix, const TensorFuncType ty
     std::cout<<next_name << " | "<<Tensor::tensor_status<<" time: " << (end_t - start_t)/1000.0F <<"ms"<< std::endl;
 #endif
 #ifdef DEBUGSAVETENSOR
-    Tensor::graphs[next_name]->saveNData<float>();
+    output->saveNData<float>();
 #endif
-    return *Tensor::graphs[next_name];
+    return *output;
 }
 
 Tensor &Tensor::cat(vector<Tensor> input_tensors, Chl axis) {
@@ -296,34 +322,39 @@ std::vector<Tensor> Tensor::getStaticFuncOupts(vector<std::string> out_names, co
     if(!input_tensors.empty() && input_tensors[0]->backend_!= nullptr){
         backend_h = input_tensors[0]->backend();
     }
-    for (auto out_name: out_names) {
-        if (Tensor::graphs.find(out_name) == Tensor::graphs.end()) {
-            Tensor::graphs[out_name] = std::make_shared<Tensor>(backend_h);
-            Tensor::graphs[out_name]->setName(out_name);
+    std::vector<Tensor*> outPtrs;
+    for (const auto &out_name: out_names) {
+        auto out = Tensor::graphs.find(out_name);
+        if (out == Tensor::graphs.end()) {
+            out = Tensor::graphs.emplace(out_name, std::make_shared<Tensor>(backend_h)).first;
+            out->second->setName(out_name);
         }
+        outPtrs.push_back(out->second.get());
     }
     if (Module::doLoad) {
         std::vector<Tensor> results;
-        for (auto out_name: out_names) {
-            results.push_back(*Tensor::graphs[out_name]);
+        for (auto *out : outPtrs) {
+            results.push_back(*out);
         }
         return results;
     }
     TensorFunction *func = backend_h->funcCreate(type);
-    std::vector<Tensor*> outPtrs;
-    for (auto out_name: out_names) {
-        outPtrs.push_back(Tensor::graphs[out_name].get());
-    }
 #ifdef DEBUGOPTIME
     auto start_t = mllm_time_us();
 #endif
     switch (Tensor::tensor_status) {
     case TENSOR_STATIC_INIT: {
+        if (auto *plan = ExecutionPlan::active()) {
+            plan->record(func, type, input_tensors, outPtrs, float_args);
+        }
+        if (auto *planner = MemoryPlanner::active()) {
+            planner->step(input_tensors, outPtrs);
+        }
         func->setup(outPtrs, input_tensors, float_args);
         break;
     }
     case TENSOR_STATIC_READY: {
-        func->execute(outPtrs, input_tensors, float_args);
+        Profiler::execute(func, type, outPtrs, input_tensors, float_args);
         break;
     }
     default: {
@@ -334,13 +365,13 @@ std::vector<Tensor> Tensor::getStaticFuncOupts(vector<std::string> out_names, co
     std::cout<<out_names[0] << " | "<<Tensor::tensor_status<<" time: " << (end_t - start_t)/1000.0F <<"ms"<< std::endl;
 #endif
 #ifdef DEBUGSAVETENSOR
-    for (auto out_name: out_names) {
-        Tensor::graphs[out_name]->saveNData<float>();
+    for (auto *out : outPtrs) {
+        out->saveNData<float>();
     }
 #endif
     std::vector<Tensor> results;
-    for (auto out_name: out_names) {
-        results.push_back(*Tensor::graphs[out_name]);
+    for (auto *out : outPtrs) {
+        results.push_back(*out);
     }
     return results;
 }
@@ -72,8 +72,18 @@ public:
         }
     }
     */
-    static map<string, shared_ptr<Tensor>> graphs;
-    static TensorStatus tensor_status;
+    /**
+     * \brief the tensors of the forward which runs on this thread, by name. Like tensor_status and the other state of
+     *        a forward (see Module::doLoad, Layer::layername_2_tensorname and Op::batched_rows), it is thread_local, so
+     *        that Modules run concurrently on different threads; the workers of parallel_for do not see it.
+     */
+    static thread_local map<string, shared_ptr<Tensor>> graphs;
+    /**
+     * \brief changed whenever an entry of graphs may be replaced or removed; the tensors the Layers resolved from graphs
+     *        are kept while it does not change.
+     */
+    static thread_local size_t graphs_version;
+    static thread_local TensorStatus tensor_status;
     // static double forward_times;
     // static double forward_times_2;
 private:
@@ -92,6 +102,7 @@ private:
     int count_{};
     int allocated_ = 0;
     bool transed_ = false;
+    bool external_ptr_ = false; // host_ptr_ is not owned by backend_ (e.g. a mmaped weight file)
 
     // used for ChildTensor
     vector<int> shape_offset_;
@@ -153,11 +164,33 @@ public:
     void free() {
         if (aggregated_) { return; }
         if (host_ptr_ != nullptr && masterTensor() == nullptr) {
-            backend_->free(host_ptr_);
+            if (!external_ptr_) {
+                backend_->free(host_ptr_);
+            }
             host_ptr_ = nullptr;
+            external_ptr_ = false;
             allocated_ = 0;
         }
     }
+    /**
+     * \brief let this Tensor use memory which is NOT owned by it, e.g. a read-only mapping of the weights file.
+     *        the memory previously allocated by this Tensor is freed, and the new memory will never be freed by the Tensor.
+     *        the ChildTensors of this Tensor use the new memory as well.
+     * \param ptr the start address of the data, which should hold at least cntSize() bytes.
+     */
+    void setHostPtr(void *ptr) {
+        assert(masterTensor() == nullptr);
+        free();
+        host_ptr_ = ptr;
+        external_ptr_ = true;
+        allocated_ = count_;
+        for (auto *child_tensor : child_tensors_) {
+            child_tensor->host_ptr_ = ptr;
+        }
+    }
+    bool externalHostPtr() const {
+        return external_ptr_;
+    }
 
     /**
      * \brief  get the number of bytes occupied by Tensor's data in memory.
@@ -740,10 +773,10 @@ public:
         }
         if(size == 4) {
             vector<int> a = {chls()[BATCH] , chls()[HEAD] , chls()[SEQUENCE] , chls()[DIMENSION]};
-            ctype_ = Chls2Type[a];
+            ctype_ = Chls2Type()[a];
         }else {
             vector<int> a = {chls()[BATCH] , chls()[TIME] , chls()[HEIGHT] , chls()[WIDTH] , chls()[CHANNLE]};
-            ctype_ = Chls2Type[a];
+            ctype_ = Chls2Type()[a];
         }
     }
 
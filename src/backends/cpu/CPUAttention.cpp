@@ -0,0 +1,158 @@
+#include "CPUAttention.hpp"
+#include <cmath>
+#include "compute/VecDot.hpp"
+#include "compute/VecDotType.hpp"
+
+namespace mllm {
+
+// keys/values folded into the running softmax at a time, the scores of one block stay in L1.
+static constexpr int KV_BLOCK = 64;
+// query rows sharing each key/value block while it is hot in cache.
+static constexpr int QUERY_TILE = 16;
+
+// row (b, h, s) of a cache, whose rows may be blocks of a quantized type.
+static inline const void *cache_row(Tensor *t, int b, int h, int s) {
+    return t->hostPtr<char>() + DataTypeSize(t->dtype(), t->offset(b, h, s, 0));
+}
+
+/*
+ * attends query rows [row_begin, row_end) of head h against cache batch kv_batch.
+ * row s sees the tokens [first[s], visible[s]). the rows walk the keys block by block together,
+ * keeping a running max and sum per row and rescaling the output row when the max grows.
+ * token t is at position t % sequence of the cache, which is t unless the cache is a ring (see CPUKVCache).
+ * the query is converted once to the vec_dot_type of the keys, so a quantized cache is read as it is.
+ */
+static void attend_rows(Tensor *q, Tensor *k, Tensor *v, Tensor *o, int q_batch, int kv_batch, int h,
+                        int row_begin, int row_end, const int *first, const int *visible, float scale, int v_dim) {
+    const int dim = q->dimension();
+    const int capacity = k->sequence();
+    const int kh = h / (q->head() / k->head());
+    const int vh = h / (q->head() / v->head());
+    const int rows = row_end - row_begin;
+    const auto &k_traits = type_traits[k->dtype()];
+    const auto add_row_to = type_traits[v->dtype()].add_row_to;
+    const DataType dot_type = k_traits.vec_dot_type;
+    const size_t q_row_size = row_size(dot_type, dim);
+    vector<char> q_dot(rows * q_row_size);
+    vector<float> max_score(rows, -INFINITY);
+    vector<float> sum(rows, 0);
+    float scores[KV_BLOCK];
+    int start = INT32_MAX, length = 0;
+    for (int r = 0; r < rows; ++r) {
+        const float *q_row = q->ptrAt<float>(q_batch, h, row_begin + r, 0);
+        if (dot_type == MLLM_TYPE_F32) {
+            memcpy(q_dot.data() + r * q_row_size, q_row, q_row_size);
+        } else {
+            type_traits[dot_type].from_float(q_row, q_dot.data() + r * q_row_size, dim);
+        }
+        memset(o->ptrAt<float>(q_batch, h, row_begin + r, 0), 0, v_dim * sizeof(float));
+        start = std::min(start, first[row_begin + r]);
+        length = std::max(length, visible[row_begin + r]);
+    }
+    for (int block = start; block < length; block += KV_BLOCK) {
+        for (int r = 0; r < rows; ++r) {
+            const int begin = std::max(block, first[row_begin + r]);
+            const int end = std::min(block + KV_BLOCK, visible[row_begin + r]);
+            if (end <= begin) {
+                continue;
+            }
+            const char *q_row = q_dot.data() + r * q_row_size;
+            float *o_row = o->ptrAt<float>(q_batch, h, row_begin + r, 0);
+            float block_max = max_score[r];
+            for (int t = begin, pos = begin % capacity; t < end; ++t, pos = pos + 1 == capacity ? 0 : pos + 1) {
+                k_traits.vec_dot(dim, &scores[t - block], cache_row(k, kv_batch, kh, pos), q_row);
+                scores[t - block] *= scale;
+                block_max = std::max(block_max, scores[t - block]);
+            }
+            if (block_max > max_score[r]) {
+                const float correction = std::exp(max_score[r] - block_max);
+                sum[r] *= correction;
+                vec_scale_f32(v_dim, o_row, correction);
+                max_score[r] = block_max;
+            }
+            for (int t = begin, pos = begin % capacity; t < end; ++t, pos = pos + 1 == capacity ? 0 : pos + 1) {
+                const float p = std::exp(scores[t - block] - block_max);
+                sum[r] += p;
+                add_row_to(v_dim, cache_row(v, kv_batch, vh, pos), o_row, p);
+            }
+        }
+    }
+    for (int r = 0; r < rows; ++r) {
+        vec_scale_f32(v_dim, o->ptrAt<float>(q_batch, h, row_begin + r, 0), 1.0F / sum[r]);
+    }
+}
+
+void attention_forward(Tensor *q, Tensor *k, Tensor *v, Tensor *o, int cache_len, bool do_causal_mask, int window, float scale, int v_dim, int thread_count) {
+    const int batch = q->batch();
+    const int head = q->head();
+    const int sequence = q->sequence();
+    vector<int> first(sequence), visible(sequence);
+    if (Op::batched_rows.active()) {
+        // batched_rows is thread_local, the workers read the rows of this thread.
+        const BatchedRows &rows = Op::batched_rows;
+        for (int s = 0; s < sequence; ++s) {
+            visible[s] = rows.position[s] + 1;
+            first[s] = window > 0 ? std::max(0, visible[s] - window) : 0;
+        }
+        parallel_for_2d(sequence, head, thread_count, [&](int s, int h) {
+            attend_rows(q, k, v, o, 0, rows.slot[s], h, s, s + 1, first.data(), visible.data(), scale, v_dim);
+        });
+        return;
+    }
+    // the new rows are the last `sequence` of the cache_len valid positions,
+    // the cache itself may be padded beyond them.
+    for (int s = 0; s < sequence; ++s) {
+        visible[s] = do_causal_mask ? cache_len - sequence + s + 1 : cache_len;
+        first[s] = window > 0 ? std::max(0, visible[s] - window) : 0;
+    }
+    const int tiles = (sequence + QUERY_TILE - 1) / QUERY_TILE;
+    parallel_for_3d(batch, head, tiles, thread_count, [&](int b, int h, int tile) {
+        const int row_begin = tile * QUERY_TILE;
+        const int row_end = std::min(row_begin + QUERY_TILE, sequence);
+        attend_rows(q, k, v, o, b, b, h, row_begin, row_end, first.data(), visible.data(), scale, v_dim);
+    });
+}
+
+CPUAttention::CPUAttention(Backend *bn, string opName, bool do_causal_mask, int threadCount, int window) :
+    thread_count(threadCount),
+    Op(bn, opName) {
+    do_causal_mask_ = do_causal_mask;
+    window_ = window;
+}
+
+ErrorCode CPUAttention::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    assert(inputs.size() == 4);
+    assert(outputs.size() == 1);
+    outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[2]->dimension());
+    return Op::reshape(inputs, outputs);
+}
+
+ErrorCode CPUAttention::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    assert(inputs[1]->dtype() == inputs[2]->dtype());
+    assert(inputs[0]->dimension() == inputs[1]->dimension());
+    if (inputs[1]->ctype() != BSHD || inputs[2]->ctype() != BSHD) {
+        std::cerr << "[ERROR]: " << name() << " needs the K and V caches in BSHD;" << std::endl;
+        return NOT_SUPPORT;
+    }
+    const int cache_len = (int)inputs[3]->dataAt<float>(0, 0, 0, 0);
+    attention_forward(inputs[0].get(), inputs[1].get(), inputs[2].get(), outputs[0].get(), cache_len, do_causal_mask_, window_,
+                      1.0F / std::sqrt((float)inputs[0]->dimension()), inputs[2]->dimension(), thread_count);
+    return Op::execute(inputs, outputs);
+}
+
+OpCost CPUAttention::cost(const vector<shared_ptr<Tensor>> &inputs, const vector<shared_ptr<Tensor>> &outputs) {
+    // the caches are read up to the valid positions, and each row reads at most the window of them.
+    const int cache_len = (int)inputs[3]->dataAt<float>(0, 0, 0, 0);
+    const int64_t keys = window_ > 0 ? std::min(window_, cache_len) : cache_len;
+    const int64_t rows = (int64_t)inputs[0]->batch() * inputs[0]->head() * inputs[0]->sequence();
+    OpCost cost;
+    cost.bytes_read = inputs[0]->cntSize();
+    for (int i = 1; i <= 2; ++i) {
+        cost.bytes_read += inputs[i]->sequence() == 0 ? 0 : inputs[i]->cntSize() / inputs[i]->sequence() * keys;
+    }
+    cost.bytes_written = outputs[0]->cntSize();
+    cost.flops = 2 * rows * keys * (inputs[0]->dimension() + inputs[2]->dimension());
+    return cost;
+}
+
+} // namespace mllm
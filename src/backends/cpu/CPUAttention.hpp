@@ -0,0 +1,52 @@
+#ifndef MLLM_CPUATTENTION_H
+#define MLLM_CPUATTENTION_H
+
+#include "Op.hpp"
+#include "CPUBackend.hpp"
+
+namespace mllm {
+
+/**
+ * \brief softmax(Q * K^T * scale) * V[:, :v_dim] into o, the kernel of CPUAttention for the ops that build their own Q.
+ *        k and v are caches of the same type, F16, F32, Q8_0 or Q4_0 (see CPUKVCache), and may be the same tensor.
+ *        with a window, each row sees only the last window tokens up to its own.
+ */
+void attention_forward(Tensor *q, Tensor *k, Tensor *v, Tensor *o, int cache_len, bool do_causal_mask, int window, float scale, int v_dim, int thread_count);
+
+/**
+ * \brief softmax(Q * K^T / sqrt(d)) * V over the KV cache, fused.
+ *        inputs are Q [batch, head, sequence, dim], the outputs of the K and V KVCache ops
+ *        and the number of valid cache positions.
+ *        the keys and values are streamed in blocks with an online softmax, so the
+ *        [head, sequence, cache_len] score matrix is never written.
+ *        query row s sees the last (sequence - s - 1) positions masked when do_causal_mask is set.
+ *        for a batched forward (see BatchedRows) row i attends to positions [0, position[i]] of cache slot slot[i].
+ *        with a window (a sliding-window model) a row sees the window tokens up to its own, and the caches may be
+ *        rings of the last tokens (see CPUKVCache). the window is applied here, no mask is needed.
+ */
+class CPUAttention final : public Op {
+public:
+    CPUAttention(Backend *bn, string opName, bool do_causal_mask, int threadCount, int window = 0);
+    virtual ~CPUAttention() = default;
+    virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    OpCost cost(const vector<shared_ptr<Tensor>> &inputs, const vector<shared_ptr<Tensor>> &outputs) override;
+
+private:
+    bool do_causal_mask_ = true;
+    int window_ = 0;
+    int thread_count = 4;
+};
+
+class CPUAttentionCreator : public CPUBackend::Creator {
+public:
+    virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
+        bool do_causal_mask = op_param["do_causal_mask"];
+        int window = (int)op_param["window"];
+        return new CPUAttention(bn, name, do_causal_mask, threadCount, window);
+    }
+};
+
+} // namespace mllm
+
+#endif // MLLM_CPUATTENTION_H
@@ -43,10 +43,13 @@
 #include "CPUElasticLinear.hpp"
 #include "CPUTensorFunction.hpp"
 #include "CPUPosition.hpp"
+#include "CPUAttention.hpp"
+#include "CPULatentAttention.hpp"
 
 namespace mllm {
 CPUBackend::CPUBackend(shared_ptr<MemoryManager> &mm) :
     Backend(mm) {
+    ThreadPool::worker_time = &Profiler::workerTime;
     registerOps();
     registerFuncs();
 }
@@ -59,6 +62,7 @@ Op *CPUBackend::opCreate(const OpParam &op_param, string name, int threadCount)
         return nullptr;
     }
     Op *exe = iter->second->create(op_param, this, name, cpu_threads);
+    exe->setOpType(optype);
     return exe;
 }
 void CPUBackend::registerOps() {
@@ -103,15 +107,16 @@ void CPUBackend::registerOps() {
     addCreator(SPARSEIDLINEAR, (CPUBackend::Creator *)(new CPUSparseIdLinearCreator()));
     addCreator(ELASTICLINEAR, (CPUBackend::Creator *)(new CPUElasticLinearCreator()));
     addCreator(POSITION, (CPUBackend::Creator *)(new CPUPositionCreator()));
+    addCreator(ATTENTION, (CPUBackend::Creator *)(new CPUAttentionCreator()));
+    addCreator(LATENTATTENTION, (CPUBackend::Creator *)(new CPULatentAttentionCreator()));
 }
 
 TensorFunction *CPUBackend::funcCreate(const TensorFuncType type) {
-    auto iter = map_function_.find(type);
-    if (iter == map_function_.end()) {
+    if (type < 0 || type >= FUNC_NUM || map_function_[type] == nullptr) {
         printf("Don't support type \n");
         return nullptr;
     }
-    return iter->second;
+    return map_function_[type];
 }
 
 void CPUBackend::registerFuncs() {
@@ -5,6 +5,7 @@
 #include "Op.hpp"
 #include "Types.hpp"
 #include "quantize/Quantize.hpp"
+#include "ThreadPool.hpp"
 
 namespace mllm {
 class CPUBackend final : public Backend {
@@ -31,10 +32,17 @@ public:
     void registerFuncs() override;
 
     static int cpu_threads;
+    /**
+     * \brief the workers the CPU ops run on, see parallel_for in ThreadPool.hpp.
+     */
+    static ThreadPool &threadPool() {
+        return ThreadPool::global();
+    }
 
 private:
     std::map<OpType, CPUBackend::Creator *> map_creator_;
-    std::map<TensorFuncType, TensorFunction *> map_function_;
+    // indexed by TensorFuncType, funcCreate() is called for every Tensor function call.
+    TensorFunction *map_function_[FUNC_NUM] = {};
 };
 
 } // namespace mllm
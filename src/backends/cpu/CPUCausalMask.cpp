@@ -10,6 +10,7 @@ CPUCausalMask::CPUCausalMask(Backend *bn, string opName, int threadCount) : thre
 }
 
 ErrorCode CPUCausalMask::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    batched_rows.unsupported(name());
     //std::cout << "CPUMask  reshape" << std::endl;
     // assert(inputs.size() == 1);
     assert(outputs.size() == 1);
@@ -32,21 +33,14 @@ ErrorCode CPUCausalMask::execute(vector<shared_ptr<Tensor>> inputs, vector<share
             old_dim = dimension - sequence;
 #endif
         }
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-        for (int n = 0; n < batch_size; ++n) {
-            for (int h = 0; h < head_num; ++h) {
-                for (int s = 0; s < sequence; ++s) {
-                    for (int d = 0; d < inputs[0]->dimension(); ++d) {
-                        if (d > s + old_dim) {
-                            outputs[0]->setDataAt<float>({n, h, s, d}, -INFINITY);
-                        }
-                        else{
-                            outputs[0]->setDataAt<float>({n, h, s, d}, inputs[0]->dataAt<float>(n, h, s, d));
-                        }
-                    }
-                }
+        parallel_for_4d(batch_size, head_num, sequence, inputs[0]->dimension(), thread_count, [&](int n, int h, int s, int d) {
+            if (d > s + old_dim) {
+                outputs[0]->setDataAt<float>({n, h, s, d}, -INFINITY);
             }
-        }
+            else{
+                outputs[0]->setDataAt<float>({n, h, s, d}, inputs[0]->dataAt<float>(n, h, s, d));
+            }
+        });
     }
     else{
         outputs[0]->copyFrom(inputs[0]);
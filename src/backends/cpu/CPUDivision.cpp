@@ -34,29 +34,23 @@ ErrorCode CPUDivision::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_
         auto in0_ptr = inputs[0]->hostPtr<float>();
         auto in1_ptr = inputs[1]->hostPtr<float>();
         auto out_ptr = outputs[0]->hostPtr<float>();
-#pragma omp parallel for num_threads(thread_count)
-        for (int is = 0; is < copy_size; ++is) {
+        parallel_for(0, copy_size, thread_count, [&](int is) {
             if (inputs[1]->count() == 1) {
                 out_ptr[is] = in0_ptr[is] / in1_000;
             }else {
                 out_ptr[is] = in0_ptr[is] / in1_ptr[is];
             }
-        }
+        });
     }else {
-        for (int n = 0; n < N; ++n) {
-            for (int c = 0; c < C; ++c) {
-                for (int h = 0; h < H; ++h) {
-#pragma omp parallel for num_threads(thread_count)
-                    for (int w = 0; w < W; ++w) {
-                        auto divisor = (inputs[1]->count() != 1) ?
-                                           inputs[1]->dataAt<float>(n, c, h, w) :
-                                           inputs[1]->dataAt<float>(0, 0, 0, 0);
-                        outputs[0]->setDataAt<float>(n, c, h, w,
-                                                     inputs[0]->dataAt<float>(n, c, h, w) / divisor);
-                    }
-                }
+        parallel_for_3d(N, C, H, thread_count, [&](int n, int c, int h) {
+            for (int w = 0; w < W; ++w) {
+                auto divisor = (inputs[1]->count() != 1) ?
+                                   inputs[1]->dataAt<float>(n, c, h, w) :
+                                   inputs[1]->dataAt<float>(0, 0, 0, 0);
+                outputs[0]->setDataAt<float>(n, c, h, w,
+                                             inputs[0]->dataAt<float>(n, c, h, w) / divisor);
             }
-        }
+        });
     }
     return Op::execute(inputs, outputs);
 }
@@ -1,7 +1,6 @@
 #include "CPUEmbedding.hpp"
 #include "ParamLoader.hpp"
-#include "quantize/QuantizeQ4.hpp"
-#include "quantize/QuantizeQ8.hpp"
+#include "compute/VecDotType.hpp"
 
 namespace mllm {
 CPUEmbedding::CPUEmbedding(Backend *bn,  string opName, int hiddenSize, int vocabSize, int threadCount) : thread_count(threadCount),
@@ -41,82 +40,30 @@ ErrorCode CPUEmbedding::execute(vector<shared_ptr<Tensor>> inputs, vector<shared
     assert(outputs.size() == 1);
     auto &input = inputs[0];
     auto &output = outputs[0];
-    switch (weight_.dtype()) {
-    case MLLM_TYPE_F32: {
-        for (int batch = 0; batch < input->batch(); ++batch) {
-            for (int head = 0; head < input->head(); ++head) { // NOLINT(*-use-default-none)
-                #pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
-                    memcpy(output->hostPtr<float>() + output->offset(batch, head, seq, 0),
-                           weight_.hostPtr<float>() + weight_.offset(0, 0, (int)input->dataAt<float>(batch, head, seq, 0), 0),
-                           weight_.dtypeSize() * hiddenSize_);
-                }
-            }
-        }
-        break;
-    }
-    case MLLM_TYPE_Q4_0: {
-        for (int batch = 0; batch < input->batch(); ++batch) {
-            for (int head = 0; head < input->head(); ++head) {
-            #pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
-                    dequantize_row_q4_0(weight_.hostPtr<block_q4_0>() + weight_.offset(0, 0, (int)input->dataAt<float>(batch, head, seq, 0), 0)/(QK4_0),
-                                        output->hostPtr<float>() + output->offset(batch, head, seq, 0),
-                                        hiddenSize_);
-                }
-            }
-        }
-        break;
-    }
-    case MLLM_TYPE_Q4_K: {
-        for (int batch = 0; batch < input->batch(); ++batch) {
-            for (int head = 0; head < input->head(); ++head) {
-                #pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
-                    dequantize_row_q4_K(weight_.hostPtr<block_q4_K>() + weight_.offset(0, 0, (int)inputs[0]->dataAt<float>(batch, head, seq, 0), 0)/(QK_K),
-                                        outputs[0]->hostPtr<float>() + outputs[0]->offset(batch, head, seq, 0),
-                                        hiddenSize_);
-                }
-            }
-        }
-        break;
+    const DataType type = weight_.dtype();
+    if (type != MLLM_TYPE_F32 && type_traits[type].to_float == nullptr) {
+        std::cerr << "[ERROR]: " << name() << " can not read a table of " << DataTypeName(type) << std::endl;
+        return NOT_SUPPORT;
     }
-    case MLLM_TYPE_Q8_0: {
-        for (int batch = 0; batch < input->batch(); ++batch) {
-            for (int head = 0; head < input->head(); ++head) {
-                #pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
-                    dequantize_row_q8_0(weight_.hostPtr<block_q8_0>() + weight_.offset(0, 0, (int)input->dataAt<float>(batch, head, seq, 0), 0)/(QK8_0),
-                                        output->hostPtr<float>() + output->offset(batch, head, seq, 0),
-                                        hiddenSize_);
-                }
-            }
+    const auto to_float = type_traits[type].to_float;
+    const size_t table_row_size = row_size(type, hiddenSize_);
+    const int head = input->head();
+    const int sequence = input->sequence();
+    // one parallel region over all the tokens.
+    parallel_for(0, (int64_t)input->batch() * head * sequence, thread_count, [&](int64_t i) {
+        const int batch = (int)(i / (head * sequence));
+        const int h = (int)(i / sequence % head);
+        const int seq = (int)(i % sequence);
+        const int token = (int)input->dataAt<float>(batch, h, seq, 0);
+        assert(token >= 0 && token < vocabSize_);
+        const char *row = weight_.hostPtr<char>() + table_row_size * token;
+        float *dst = output->ptrAt<float>(batch, h, seq, 0);
+        if (type == MLLM_TYPE_F32) {
+            memcpy(dst, row, hiddenSize_ * sizeof(float));
+        } else {
+            to_float(row, dst, hiddenSize_);
         }
-        break;
-    }
-    case MLLM_TYPE_Q8_K: {
-        for (int batch = 0; batch < input->batch(); ++batch) {
-            for (int head = 0; head < input->head(); ++head) {
-                #pragma omp parallel for num_threads(thread_count)
-                for (int seq = 0; seq < input->sequence(); ++seq) {
-                    dequantize_row_q8_K(weight_.hostPtr<block_q8_K>() + weight_.offset(0, 0, (int)input->dataAt<float>(batch, head, seq, 0), 0)/(QK_K),
-                                        output->hostPtr<float>() + output->offset(batch, head, seq, 0),
-                                        hiddenSize_);
-                }
-            }
-        }
-        break;
-    }
-    case MLLM_TYPE_F16: break;
-    case MLLM_TYPE_Q4_1: break;
-    case MLLM_TYPE_Q8_1: break;
-    case MLLM_TYPE_Q6_K: break;
-    case MLLM_TYPE_I8: break;
-    case MLLM_TYPE_I16: break;
-    case MLLM_TYPE_I32: break;
-    case MLLM_TYPE_COUNT: break;
-    default: break;
-    }
+    });
     return MLLM_NO_ERROR;
 }
 ErrorCode CPUEmbedding::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -4,6 +4,11 @@
 #include "CPUBackend.hpp"
 #include "Tensor.hpp"
 namespace mllm {
+/**
+ * \brief the rows of the table [vocab, hidden] of the tokens [batch, head, sequence, 1].
+ *        the table may be in F32 or any type with a to_float (F16, Q4_0, Q8_0, Q4_K, Q6_K, ...), only the rows
+ *        gathered are dequantized. an LM head may be tied to the table, see Op::tieWeight.
+ */
 class CPUEmbedding final : public Op {
 public:
     explicit CPUEmbedding(Backend *bn, string opName, int hiddenSize, int vocabSize, int threadCount);
@@ -16,6 +21,9 @@ public:
     Tensor &weight() {
         return weight_;
     }
+    Tensor *tiedWeight() override {
+        return &weight_;
+    }
 
 private:
     int thread_count = 4;
@@ -3,53 +3,321 @@
 #include "CPUKVCache.hpp"
 #include "ParamLoader.hpp"
 #include "Types.hpp"
+#include "quantize/Quantize.hpp"
+#include "compute/VecDotType.hpp"
+#include "CPURoPE.hpp"
+#include <cstdlib>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 int n_pack = 16;
 #define KVCache_TYPE_16
 namespace mllm {
-CPUKVCache::CPUKVCache(Backend *bn, string opName, int n_rep, int cache_max, int threadCount) : thread_count(threadCount),
+CPUKVCache::CPUKVCache(Backend *bn, string opName, int n_rep, int cache_max, int threadCount, int window, DataType cache_type,
+                       int sink, int rope_type, float rope_theta) : thread_count(threadCount),
     Op(bn, opName) {
     cache_.setBackend(bn);
+    if (cache_type == MLLM_TYPE_COUNT) {
 #ifdef KVCache_TYPE_16
-    cache_.setDtype(MLLM_TYPE_F16);
+        cache_type = MLLM_TYPE_F16;
 #else
-    cache_.setDtype(MLLM_TYPE_F32);
+        cache_type = MLLM_TYPE_F32;
 #endif
+    }
+    cache_.setDtype(cache_type);
+    quantized_ = cache_type != MLLM_TYPE_F16 && cache_type != MLLM_TYPE_F32;
+    assert(sink == 0 || window == 0);
+    sink_ = sink;
+    capacity_ = cache_max;
+    rope_type_ = rope_type;
+    rope_theta_ = rope_theta;
 #ifdef LLAMAFILE_SGEMM
     cache_max = ((cache_max + (n_pack-1)) / n_pack) * n_pack;
 #endif
+    if (window > 0) {
+        // grown in reshape when a forward has more than one token. only Attention reads a ring, it needs no padding.
+        cache_max = window;
+    }
     cache_limit_ = cache_max;
     n_rep_ = n_rep;
+    window_ = window;
+}
+
+CPUKVCache::~CPUKVCache() {
+    cache_.free();
+    releaseCache();
+}
+
+void CPUKVCache::reserveCache() {
+    cache_mem_size_ = cache_.cntSize();
+#ifndef _WIN32
+    void *mem = mmap(nullptr, cache_mem_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    cache_mem_ = mem == MAP_FAILED ? nullptr : mem;
+#else
+    cache_mem_ = std::calloc(1, cache_mem_size_);
+#endif
+    if (cache_mem_ == nullptr) {
+        std::cerr << "\n[ERROR]: Failed to reserve " << cache_mem_size_ << " bytes for " << cache_.name() << std::endl;
+        exit(1);
+    }
+    cache_.setHostPtr(cache_mem_);
+}
+
+void CPUKVCache::releaseCache() {
+    if (cache_mem_ == nullptr) {
+        return;
+    }
+#ifndef _WIN32
+    munmap(cache_mem_, cache_mem_size_);
+#else
+    std::free(cache_mem_);
+#endif
+    cache_mem_ = nullptr;
+    cache_mem_size_ = 0;
+}
+
+void CPUKVCache::growCache(int sequence) {
+    // a ring only needs to hold the window and the tokens of one forward.
+    int new_limit = window_ > 0 ? sequence : std::max(sequence, cache_limit_ * 2);
+#ifdef LLAMAFILE_SGEMM
+    if (window_ == 0) {
+        new_limit = ((new_limit + (n_pack - 1)) / n_pack) * n_pack;
+    }
+#endif
+    auto *old_mem = static_cast<char *>(cache_mem_);
+    auto old_mem_size = cache_mem_size_;
+    int old_limit = cache_limit_;
+    const int batch = cache_.batch();
+    const int head = cache_.head();
+    const int dim = cache_.dimension();
+    const size_t token_size = DataTypeSize(cache_.dtype(), head * dim);
+
+    cache_limit_ = new_limit;
+    cache_mem_ = nullptr;
+    cache_.reshape(batch, head, cache_limit_, dim);
+    reserveCache();
+    auto *new_mem = static_cast<char *>(cache_mem_);
+    if (cache_.ctype() == BSHD && window_ > 0) {
+        // the tokens move to their positions in the larger ring.
+        for (int b = 0; b < batch; ++b) {
+            for (int p = std::max(0, cache_seq_len_ - old_limit); p < cache_seq_len_; ++p) {
+                memcpy(new_mem + ((size_t)b * cache_limit_ + p % cache_limit_) * token_size,
+                       old_mem + ((size_t)b * old_limit + p % old_limit) * token_size, token_size);
+            }
+        }
+    } else if (cache_.ctype() == BSHD) {
+        for (int b = 0; b < batch; ++b) {
+            memcpy(new_mem + (size_t)b * cache_limit_ * token_size, old_mem + (size_t)b * old_limit * token_size, cache_seq_len_ * token_size);
+        }
+    } else if (cache_.ctype() == BHDS) {
+        const size_t type_size = DataTypeSize(cache_.dtype());
+        const int rows = batch * head * dim;
+        parallel_for(0, rows, thread_count, [&](int r) {
+            memcpy(new_mem + (size_t)r * cache_limit_ * type_size, old_mem + (size_t)r * old_limit * type_size, cache_seq_len_ * type_size);
+        });
+    } else {
+        std::cout << "ERROR Ctype in KVCcache;" << std::endl;
+    }
+#ifndef _WIN32
+    munmap(old_mem, old_mem_size);
+#else
+    std::free(old_mem);
+#endif
+}
+
+void CPUKVCache::evict(int tokens) {
+    assert(cache_.ctype() == BSHD);
+    const int head = cache_.head();
+    const int dim = cache_.dimension();
+    const size_t token_size = DataTypeSize(cache_.dtype(), head * dim);
+    const int moved = cache_seq_len_ - sink_ - tokens;
+    for (int b = 0; b < cache_.batch(); ++b) {
+        memmove(cacheRow(b, 0, sink_), cacheRow(b, 0, sink_ + tokens), moved * token_size);
+    }
+    cache_seq_len_ -= tokens;
+    evicted_ += tokens;
+    if (rope_type_ == NONE) {
+        return;
+    }
+    const bool kept = keepsKeys();
+    if (kept) {
+        memmove(keptKey(0, 0, sink_), keptKey(0, 0, sink_ + tokens), moved * cache_.batch() * token_size);
+        memmove(rotated_at_.data() + sink_, rotated_at_.data() + sink_ + tokens, moved * sizeof(int));
+    }
+    const auto &traits = type_traits[cache_.dtype()];
+    parallel_for_3d(cache_.batch(), head, moved, thread_count, [&](int b, int h, int s) {
+        const int pos = sink_ + s;
+        char *row = cacheRow(b, h, pos);
+        // a quantized key is rotated from its copy as appended, the others in place.
+        const char *src = kept ? keptKey(b, h, pos) : row;
+        thread_local vector<float> values;
+        values.resize(dim);
+        if (cache_.dtype() == MLLM_TYPE_F32) {
+            memcpy(values.data(), src, dim * sizeof(float));
+        } else {
+            traits.to_float(src, values.data(), dim);
+        }
+        if (!rope_shift_row(values.data(), dim, rope_type_, rope_theta_, kept ? pos - rotated_at_[pos] : -tokens)) {
+            return;
+        }
+        if (cache_.dtype() == MLLM_TYPE_F32) {
+            memcpy(row, values.data(), dim * sizeof(float));
+        } else {
+            traits.from_float(values.data(), row, dim);
+        }
+    });
+}
+
+void CPUKVCache::keepKeys(int begin, int end) {
+    assert(cache_.ctype() == BSHD);
+    const size_t token_size = DataTypeSize(cache_.dtype(), cache_.head() * cache_.dimension());
+    if (keys_.size() < end * cache_.batch() * token_size) {
+        keys_.resize(end * cache_.batch() * token_size);
+        rotated_at_.resize(end);
+    }
+    for (int pos = begin; pos < end; ++pos) {
+        for (int b = 0; b < cache_.batch(); ++b) {
+            memcpy(keptKey(b, 0, pos), cacheRow(b, 0, pos), token_size);
+        }
+        // RoPE follows the positions of the cache, a key is rotated at the position it is appended at.
+        rotated_at_[pos] = pos;
+    }
+}
+
+void CPUKVCache::clearCache() {
+    if (cache_seq_len_ < 0) {
+        // not reserved yet, see reshape().
+        return;
+    }
+    cache_seq_len_ = 0;
+    evicted_ = 0;
+#ifndef _WIN32
+    // hand the pages back to the system, they are zero-filled on the next write.
+    if (cache_mem_ != nullptr) {
+        madvise(cache_mem_, cache_mem_size_, MADV_DONTNEED);
+    }
+#endif
+}
+
+size_t CPUKVCache::tokenSize() {
+    return (size_t)cache_.batch() * (cache_.head() / n_rep_) * DataTypeSize(cache_.dtype(), cache_.dimension());
+}
+
+bool CPUKVCache::saveCache(int sequence, vector<uint8_t> &data) {
+    if (cache_seq_len_ < 0 || (window_ > 0 && cache_seq_len_ > cache_limit_) || evicted_ > 0) {
+        return false;
+    }
+    assert(sequence <= cache_seq_len_);
+    const size_t type_size = DataTypeSize(cache_.dtype());
+    const size_t row_size = DataTypeSize(cache_.dtype(), cache_.dimension());
+    const int dim = cache_.dimension();
+    const size_t begin = data.size();
+    data.resize(begin + sequence * tokenSize());
+    auto *dst = data.data() + begin;
+    const auto *src = cache_.hostPtr<uint8_t>();
+    for (int s = 0; s < sequence; ++s) {
+        for (int b = 0; b < cache_.batch(); ++b) {
+            for (int h = 0; h < cache_.head(); h += n_rep_) {
+                if (cache_.ctype() == BSHD) {
+                    memcpy(dst, cacheRow(b, h, s), row_size);
+                    dst += row_size;
+                } else {
+                    for (int d = 0; d < dim; ++d) {
+                        memcpy(dst, src + (size_t)cache_.offset(b, h, s, d) * type_size, type_size);
+                        dst += type_size;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool CPUKVCache::restoreCache(int sequence, const uint8_t *data) {
+    if (cache_seq_len_ < 0) {
+        return false;
+    }
+    int first = 0;
+    if (window_ > 0) {
+        // the ring keeps the last cache_limit_ tokens.
+        first = std::max(0, sequence - cache_limit_);
+        data += first * tokenSize();
+    } else if (sequence > cache_limit_) {
+        growCache(sequence);
+    }
+    const size_t type_size = DataTypeSize(cache_.dtype());
+    const size_t row_size = DataTypeSize(cache_.dtype(), cache_.dimension());
+    const int dim = cache_.dimension();
+    auto *dst = cache_.hostPtr<uint8_t>();
+    for (int pos = first; pos < sequence; ++pos) {
+        const int s = position(pos);
+        for (int b = 0; b < cache_.batch(); ++b) {
+            for (int h = 0; h < cache_.head(); h += n_rep_) {
+                for (int i_rep = 0; i_rep < n_rep_; ++i_rep) {
+                    if (cache_.ctype() == BSHD) {
+                        memcpy(cacheRow(b, h + i_rep, s), data, row_size);
+                    } else {
+                        for (int d = 0; d < dim; ++d) {
+                            memcpy(dst + (size_t)cache_.offset(b, h + i_rep, s, d) * type_size, data + d * type_size, type_size);
+                        }
+                    }
+                }
+                data += row_size;
+            }
+        }
+    }
+    cache_seq_len_ = sequence;
+    evicted_ = 0;
+    if (keepsKeys()) {
+        keepKeys(0, sequence);
+    }
+    return true;
 }
 
 ErrorCode CPUKVCache::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
 
     assert(inputs.size() == 1);
     assert(outputs.size() == 1);
+    // a batched forward keeps one cache slot per sequence in the BATCH axis.
+    const int batch = batched_rows.active() ? batched_rows.slots : inputs[0]->batch();
     if(cache_seq_len_ < 0) {
-        cache_.reshape(inputs[0]->batch(), inputs[0]->head()*n_rep_, cache_limit_, inputs[0]->dimension());
+        cache_.reshape(batch, inputs[0]->head()*n_rep_, cache_limit_, inputs[0]->dimension());
         cache_.setName(name() + ".Cache");
-        cache_.alloc();
-#ifdef KVCache_TYPE_16
-        memset(cache_.hostPtr<mllm_fp16_t>(),0,cache_.count() * sizeof(mllm_fp16_t));
-#else
-        memset(cache_.hostPtr<float>(),0,cache_.count() * sizeof(float));
-#endif
+        reserveCache();
         cache_seq_len_ = 0;
     }
-    int sequence = inputs[0]->sequence() + cache_seq_len_;
+    assert(cache_.batch() == batch);
+    // a quantized cache is read only by Attention, in rows of whole blocks.
+    assert(!quantized_ || (cache_.ctype() == BSHD && inputs[0]->dimension() % type_traits[cache_.dtype()].blck_size == 0));
+    if (window_ > 0) {
+        // the window before the first new token and the new tokens, the output is the whole ring.
+        const int needed = window_ - 1 + inputs[0]->sequence();
+        if (needed > cache_limit_) {
+            growCache(needed);
+        }
+        outputs[0]->reshape(batch, inputs[0]->head()*n_rep_, cache_limit_, inputs[0]->dimension());
+        return Op::reshape(inputs, outputs);
+    }
+    if (sink_ > 0 && !batched_rows.active()) {
+        const int tokens = evictedTokens(cache_seq_len_, inputs[0]->sequence(), sink_, capacity_);
+        if (tokens > 0) {
+            evict(tokens);
+        }
+    }
+    int sequence = batched_rows.active() ? std::max(cache_seq_len_, batched_rows.maxPosition() + 1) : inputs[0]->sequence() + cache_seq_len_;
 #ifdef LLAMAFILE_SGEMM
     if(sequence%n_pack != 0)
         sequence = ((sequence + (n_pack-1)) / n_pack) * n_pack;
 #endif
-    outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head()*n_rep_, sequence, inputs[0]->dimension());
     if(sequence >cache_limit_){
-        std::cerr<<"\n[ERROR]: Current tokens exceed cache limit: "<<sequence<<">"<<cache_limit_<<";";
-        std::cerr<<"\n         Please set args `--limits` >"<<cache_limit_<<std::endl;
-
-        exit(1);
-        outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head()*n_rep_, cache_limit_, inputs[0]->dimension());
+        growCache(sequence);
     }
+    if (batched_rows.active() || quantized_) {
+        // the rows are scattered over the slots or quantized into the cache, the output is the whole cache.
+        sequence = cache_limit_;
+    }
+    outputs[0]->reshape(batch, inputs[0]->head()*n_rep_, sequence, inputs[0]->dimension());
     return Op::reshape(inputs, outputs);
 }
 
@@ -60,51 +328,60 @@ ErrorCode CPUKVCache::load(AbstructLoader &loader) {
 
 ErrorCode CPUKVCache::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
 
+    if (batched_rows.active()) {
+        executeBatched(inputs[0]);
+        return Op::execute(inputs, outputs);
+    }
     int cache_seq_len_old = cache_seq_len_;
     cache_seq_len_ += inputs[0]->sequence();
+    if (copiesRows()) {
+        auto *input = inputs[0].get();
+        parallel_for_3d(input->batch(), input->head(), input->sequence(), thread_count, [&](int b, int h, int s) {
+            storeRow(input, b, h, s, b, cache_seq_len_old + s);
+        });
+        if (keepsKeys()) {
+            keepKeys(cache_seq_len_old, cache_seq_len_);
+        }
+        return Op::execute(inputs, outputs);
+    }
     if(n_rep_ >1) {
         if(cache_.ctype() == BSHD) {
             for (int b = 0; b < cache_.batch(); ++b) {
                 for (int h = inputs[0]->head()-1; h >= 0; --h) {
-#pragma omp parallel for collapse(2) num_threads(thread_count)
-                    for (int seq = cache_seq_len_old; seq < cache_seq_len_; ++seq) {
-                        for (int i_rep = 0; i_rep < n_rep_; ++i_rep) {
-                            auto cache_head = h * n_rep_ + i_rep;
-                            if(cache_.dtype() == MLLM_TYPE_F32) {
-                                auto src_ptr = inputs[0]->ptrAt<float>(b, h, seq-cache_seq_len_old, 0);
-                                auto dest_ptr = cache_.ptrAt<float>(b, cache_head, seq, 0);
-                                int copy_size = cache_.dimension();
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
-                            }else if(cache_.dtype() == MLLM_TYPE_F16) {
-                                auto src_ptr = inputs[0]->ptrAt<mllm_fp16_t>(b, h, seq-cache_seq_len_old, 0);
-                                auto dest_ptr = cache_.ptrAt<mllm_fp16_t>(b, cache_head, seq, 0);
-                                int copy_size = cache_.dimension();
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
-                            }
+                    parallel_for_2d(cache_seq_len_ - cache_seq_len_old, n_rep_, thread_count, [&](int i_seq, int i_rep) {
+                        const int seq = cache_seq_len_old + i_seq;
+                        auto cache_head = h * n_rep_ + i_rep;
+                        if(cache_.dtype() == MLLM_TYPE_F32) {
+                            auto src_ptr = inputs[0]->ptrAt<float>(b, h, seq-cache_seq_len_old, 0);
+                            auto dest_ptr = cache_.ptrAt<float>(b, cache_head, seq, 0);
+                            int copy_size = cache_.dimension();
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
+                        }else if(cache_.dtype() == MLLM_TYPE_F16) {
+                            auto src_ptr = inputs[0]->ptrAt<mllm_fp16_t>(b, h, seq-cache_seq_len_old, 0);
+                            auto dest_ptr = cache_.ptrAt<mllm_fp16_t>(b, cache_head, seq, 0);
+                            int copy_size = cache_.dimension();
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
                         }
-                    }
+                    });
                 }
             }
         }else if(cache_.ctype() == BHDS) {
             for (int b = 0; b < cache_.batch(); ++b) {
                 for (int h = inputs[0]->head() - 1; h >= 0; --h) {
-#pragma omp parallel for collapse(2) num_threads(thread_count)
-                    for (int d = 0; d < inputs[0]->dimension(); ++d) {
-                        for (int i_rep = 0; i_rep < n_rep_; ++i_rep) {
-                            auto cache_head = h * n_rep_ + i_rep;
-                            if (cache_.dtype() == MLLM_TYPE_F32) {
-                                auto src_ptr = inputs[0]->ptrAt<float>(b, h, 0, d);
-                                auto dest_ptr = cache_.ptrAt<float>(b, cache_head, cache_seq_len_old, d);
-                                int copy_size = cache_seq_len_ - cache_seq_len_old;
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
-                            } else if (cache_.dtype() == MLLM_TYPE_F16) {
-                                auto src_ptr = inputs[0]->ptrAt<mllm_fp16_t>(b, h, 0, d);
-                                auto dest_ptr = cache_.ptrAt<mllm_fp16_t>(b, cache_head, cache_seq_len_old, d);
-                                int copy_size = cache_seq_len_ - cache_seq_len_old;
-                                memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
-                            }
+                    parallel_for_2d(inputs[0]->dimension(), n_rep_, thread_count, [&](int d, int i_rep) {
+                        auto cache_head = h * n_rep_ + i_rep;
+                        if (cache_.dtype() == MLLM_TYPE_F32) {
+                            auto src_ptr = inputs[0]->ptrAt<float>(b, h, 0, d);
+                            auto dest_ptr = cache_.ptrAt<float>(b, cache_head, cache_seq_len_old, d);
+                            int copy_size = cache_seq_len_ - cache_seq_len_old;
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(float));
+                        } else if (cache_.dtype() == MLLM_TYPE_F16) {
+                            auto src_ptr = inputs[0]->ptrAt<mllm_fp16_t>(b, h, 0, d);
+                            auto dest_ptr = cache_.ptrAt<mllm_fp16_t>(b, cache_head, cache_seq_len_old, d);
+                            int copy_size = cache_seq_len_ - cache_seq_len_old;
+                            memcpy(dest_ptr, src_ptr, copy_size * sizeof(mllm_fp16_t));
                         }
-                    }
+                    });
                 }
             }
         }else {
@@ -114,6 +391,42 @@ ErrorCode CPUKVCache::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_p
     return Op::execute(inputs, outputs);
 }
 
+void CPUKVCache::storeRow(Tensor *input, int b, int h, int s, int cache_b, int pos) {
+    const int dim = input->dimension();
+    const size_t row_size = DataTypeSize(cache_.dtype(), dim);
+    const char *src = input->hostPtr<char>() + DataTypeSize(input->dtype(), input->offset(b, h, s, 0));
+    char *dst = cacheRow(cache_b, h * n_rep_, position(pos));
+    if (input->dtype() == cache_.dtype()) {
+        memcpy(dst, src, row_size);
+    } else {
+        const float *row = reinterpret_cast<const float *>(src);
+        if (input->dtype() == MLLM_TYPE_F16) {
+            // storeRow runs on the workers of parallel_for, each converts in a buffer of its own.
+            thread_local vector<float> converted;
+            converted.resize(dim);
+            mllm_fp16_to_fp32_row(reinterpret_cast<const mllm_fp16_t *>(src), converted.data(), dim);
+            row = converted.data();
+        }
+        if (cache_.dtype() == MLLM_TYPE_F32) {
+            memcpy(dst, row, row_size);
+        } else {
+            type_traits[cache_.dtype()].from_float(row, dst, dim);
+        }
+    }
+    for (int i_rep = 1; i_rep < n_rep_; ++i_rep) {
+        memcpy(cacheRow(cache_b, h * n_rep_ + i_rep, position(pos)), dst, row_size);
+    }
+}
+
+void CPUKVCache::executeBatched(shared_ptr<Tensor> input) {
+    // batched_rows is thread_local, the workers read the rows of this thread.
+    const BatchedRows &rows = batched_rows;
+    parallel_for_2d(input->sequence(), input->head(), thread_count, [&](int r, int h) {
+        storeRow(input.get(), 0, h, r, rows.slot[r], rows.position[r]);
+    });
+    cache_seq_len_ = std::max(cache_seq_len_, batched_rows.maxPosition() + 1);
+}
+
 ErrorCode CPUKVCache::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
 
     return Op::free(inputs, outputs);
@@ -124,6 +437,12 @@ ErrorCode CPUKVCache::setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr
     assert(inputs.size() == 1);
     assert(outputs.size() == 1);
     outputs[0]->setDtype(cache_.dtype());
+    if (batched_rows.active() || copiesRows()) {
+        // rows are copied into their slots in execute, the input keeps its own memory.
+        outputs[0]->deepCopyFrom(cache_, false, {0, 0, 0, 0});
+        repointChildren();
+        return MLLM_NO_ERROR;
+    }
     outputs[0]->deepCopyFrom(cache_, false, {0,0,cache_seq_len_/cache_limit_,0});
     if(inputs[0]->sequence() + cache_seq_len_ >cache_limit_) {
         outputs[0]->deepCopyFrom(cache_, false, {0,0,cache_seq_len_%cache_limit_ +1,0});
@@ -132,6 +451,24 @@ ErrorCode CPUKVCache::setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr
         inputs[0]->free();
     }
     inputs[0]->deepCopyFrom(cache_, false, {0,0,cache_seq_len_%cache_limit_,0});
+    repointChildren();
     return MLLM_NO_ERROR;
 }
+
+void CPUKVCache::repointChildren() {
+    // other views of the cache (e.g. the transposed K) still point to the memory before growCache.
+    auto children = cache_.childTensors();
+    for (auto *child : children) {
+        if (child->masterTensor() == &cache_ && child->rawHostPtr() != cache_.rawHostPtr()) {
+            child->deepCopyFrom(cache_, false, child->shape_offset());
+        }
+    }
+}
+
+OpCost CPUKVCache::cost(const vector<shared_ptr<Tensor>> &inputs, const vector<shared_ptr<Tensor>> &outputs) {
+    OpCost cost;
+    cost.bytes_read = inputs[0]->cntSize();
+    cost.bytes_written = outputs[0]->sequence() == 0 ? 0 : outputs[0]->cntSize() / outputs[0]->sequence() * inputs[0]->sequence();
+    return cost;
+}
 } // namespace mllm
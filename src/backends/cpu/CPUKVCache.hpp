@@ -8,13 +8,39 @@
 
 namespace mllm {
 
+/**
+ * \brief the K or V cache of an attention layer, its output is the cache of all the tokens so far.
+ *
+ * with a window, the cache is a ring that keeps only the last tokens: token p is at position p % capacity,
+ * where the capacity holds the window before the first new token and the new tokens. the output is the
+ * whole ring, Attention with the same window maps the tokens to their positions (see attention_forward()).
+ * the keys are cached after RoPE, so they keep the rotation of their own position.
+ *
+ * the cache is F16 unless a cache_type is given. a Q8_0 or Q4_0 cache quantizes each row as it is
+ * appended, in blocks of 32 along the dimension with a scale each, which halves or quarters the bytes
+ * Attention streams per token. Attention reads it with the quantized dot products of the weights;
+ * the Matmul path cannot, so a quantized cache is used only with Attention.
+ *
+ * with a sink the cache keeps at most cache_max tokens for an unbounded generation, as in StreamingLLM: the first
+ * `sink` tokens stay, and when a forward does not fit, the oldest of the other tokens are evicted (see
+ * evictedTokens()). the tokens after them move down, and the keys, given the RoPE that rotated them, are rotated
+ * to their new positions. RoPE with the same sink and cache_max moves its positions the same way, so a token is
+ * always at its position in the cache, and Attention needs nothing more. F32 and F16 keys are rotated in place. a
+ * quantized key is rotated from a copy of it as appended instead, so that its rounding does not add up over the
+ * evictions: a quantized sink cache with RoPE takes twice the memory of its keys.
+ */
 class CPUKVCache final : public Op {
 public:
-    CPUKVCache(Backend *bn, string opName, int n_rep, int cache_max=100, int threadCount=4);
-    virtual ~CPUKVCache() = default;
+    CPUKVCache(Backend *bn, string opName, int n_rep, int cache_max=100, int threadCount=4, int window=0, DataType cache_type=MLLM_TYPE_COUNT,
+               int sink=0, int rope_type=NONE, float rope_theta=10000);
+    virtual ~CPUKVCache();
     virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode load(AbstructLoader &loader) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    /**
+     * \brief the new tokens are read and written, not the whole cache the output is.
+     */
+    OpCost cost(const vector<shared_ptr<Tensor>> &inputs, const vector<shared_ptr<Tensor>> &outputs) override;
     virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode setUp(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
 
@@ -23,17 +49,114 @@ public:
     int getCacheSeqLen() override{
         return cache_seq_len_;
     }
-    void clearCache() override{
-        cache_seq_len_ = 0 ;
+    void clearCache() override;
+    void setCacheSeqLen(int cache_seq_len) override {
+        assert(cache_seq_len <= cache_seq_len_);
+        // a ring can only go back to tokens whose window has not been overwritten.
+        assert(window_ == 0 || cache_seq_len_ - cache_seq_len <= cache_limit_ - window_ + 1);
+        cache_seq_len_ = cache_seq_len;
+    }
+
+    /**
+     * \brief append the first `sequence` cached tokens to `data`, token by token.
+     *        the n_rep copies of a head are saved once, so `data` can be cut at any token.
+     * \return false if nothing has been cached yet, or a ring or a sink cache has dropped some of the tokens.
+     */
+    bool saveCache(int sequence, vector<uint8_t> &data);
+    /**
+     * \brief replace the cache contents by the first `sequence` tokens of `data` saved by saveCache.
+     * \return false if the cache has not been set up yet.
+     */
+    bool restoreCache(int sequence, const uint8_t *data);
+    /**
+     * \brief bytes saved by saveCache for each token.
+     */
+    size_t tokenSize();
+
+    /**
+     * \brief the tokens a cache of `capacity` tokens keeping `sink` evicts before `incoming` tokens are appended to
+     *        `cached` ones: none while they fit, else at least half of the tokens after the sink, so the tokens are
+     *        moved once every (capacity - sink) / 2 tokens. a forward too long for the cache evicts all but the sink
+     *        and the cache grows.
+     */
+    static int evictedTokens(int cached, int incoming, int sink, int capacity) {
+        if (cached + incoming <= capacity) {
+            return 0;
+        }
+        return std::max(0, std::min(cached - sink, std::max(cached + incoming - capacity, (capacity - sink) / 2)));
     }
 
 private:
+    /**
+     * \brief reserve the backing memory of cache_ for cache_limit_ tokens.
+     *        the memory is demand-paged: pages are zero-filled and only backed by physical memory
+     *        once a token is written to them, so memory grows with the actual context length.
+     */
+    void reserveCache();
+    /**
+     * \brief grow cache_ to hold at least `sequence` tokens, keeping the cached tokens.
+     *        the ChildTensors of cache_ are re-pointed to the new memory.
+     */
+    void growCache(int sequence);
+    void releaseCache();
+    void repointChildren();
+    /**
+     * \brief copy each row of a batched forward (see BatchedRows) into its slot and position.
+     */
+    void executeBatched(shared_ptr<Tensor> input);
+    /**
+     * \brief copy row (b, h, s) of input to position pos of batch cache_b, in all the n_rep heads of h.
+     */
+    void storeRow(Tensor *input, int b, int h, int s, int cache_b, int pos);
+    /**
+     * \brief drop the `tokens` tokens after the sink, moving the later ones down and rotating them if they are keys.
+     */
+    void evict(int tokens);
+    /**
+     * \brief keep the keys at positions [begin, end) as they are, see keys_.
+     */
+    void keepKeys(int begin, int end);
+    inline bool keepsKeys() const {
+        return sink_ > 0 && rope_type_ != NONE && quantized_;
+    }
+    inline char *keptKey(int b, int h, int pos) {
+        return keys_.data() + DataTypeSize(cache_.dtype(), (((size_t)pos * cache_.batch() + b) * cache_.head() + h) * cache_.dimension());
+    }
+    // where token pos is kept.
+    inline int position(int pos) const {
+        return window_ > 0 ? pos % cache_limit_ : pos;
+    }
+    // whether rows are copied into the cache in execute, instead of the input being a view of the cache.
+    inline bool copiesRows() const {
+        return window_ > 0 || quantized_;
+    }
+    // row (b, h, pos) of a BSHD cache, in bytes as the rows of a quantized cache are blocks.
+    inline char *cacheRow(int b, int h, int pos) {
+        return cache_.hostPtr<char>() + DataTypeSize(cache_.dtype(), cache_.offset(b, h, pos, 0));
+    }
+
     int thread_count = 4;
 
     int cache_seq_len_= -999;
     int n_rep_ = 1;
 
     int cache_limit_ ;
+    int window_ = 0;
+    bool quantized_ = false;
+    int sink_ = 0;
+    int capacity_ = 0;
+    int rope_type_ = NONE;
+    float rope_theta_ = 10000;
+    // the tokens evicted since the cache was last cleared or restored.
+    int evicted_ = 0;
+    // with a sink and a quantized cache, the keys as they were appended [pos][batch][head][dim] in the cache type,
+    // and the position each was rotated at: an eviction rotates a key from here to its new position at once, so it
+    // is rounded twice however many times it moves.
+    vector<char> keys_;
+    vector<int> rotated_at_;
+
+    void *cache_mem_ = nullptr;
+    size_t cache_mem_size_ = 0;
 };
 
 class CPUKVCacheCreator : public CPUBackend::Creator {
@@ -41,7 +164,12 @@ public:
     virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
         int n_rep = (int)op_param["n_rep"];
         int cache_max = (int)op_param["cache_max"];
-        return new CPUKVCache(bn, name, n_rep, cache_max, threadCount);
+        int window = (int)op_param["window"];
+        DataType cache_type = op_param.count("cache_type") ? (DataType)op_param["cache_type"] : MLLM_TYPE_COUNT;
+        int sink = (int)op_param["sink"];
+        int rope_type = (int)op_param["rope_type"];
+        float rope_theta = op_param["rope_theta"];
+        return new CPUKVCache(bn, name, n_rep, cache_max, threadCount, window, cache_type, sink, rope_type, rope_theta);
     }
 };
 
@@ -0,0 +1,127 @@
+#include "CPULatentAttention.hpp"
+#include <cmath>
+#include "CPUAttention.hpp"
+#include "compute/VecDot.hpp"
+#include "compute/VecDotType.hpp"
+
+namespace mllm {
+
+CPULatentAttention::CPULatentAttention(Backend *bn, string opName, int num_heads, int qk_nope_head_dim, int v_head_dim,
+                                       int kv_lora_rank, bool do_causal_mask, int threadCount) :
+    thread_count(threadCount),
+    Op(bn, opName) {
+    num_heads_ = num_heads;
+    qk_nope_head_dim_ = qk_nope_head_dim;
+    v_head_dim_ = v_head_dim;
+    kv_lora_rank_ = kv_lora_rank;
+    do_causal_mask_ = do_causal_mask;
+    k_absorb_.setBackend(bn);
+    v_absorb_.setBackend(bn);
+    q_latent_.setBackend(bn);
+    o_latent_.setBackend(bn);
+}
+
+ErrorCode CPULatentAttention::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    batched_rows.unsupported(name());
+    assert(inputs.size() == 4);
+    assert(outputs.size() == 1);
+    assert(inputs[0]->head() == num_heads_ && inputs[0]->dimension() == qk_nope_head_dim_);
+    assert(inputs[2]->dimension() == kv_lora_rank_ + inputs[1]->dimension());
+    outputs[0]->reshape(inputs[0]->batch(), num_heads_, inputs[0]->sequence(), v_head_dim_);
+    return Op::reshape(inputs, outputs);
+}
+
+ErrorCode CPULatentAttention::load(AbstructLoader &loader) {
+    // kv_b_proj.weight is [head * (qk_nope_head_dim + v_head_dim), kv_lora_rank], the k_nope rows of each head then its v rows.
+    Tensor weight(backend());
+    weight.setName(name() + ".weight");
+    weight.reshape(1, 1, num_heads_ * (qk_nope_head_dim_ + v_head_dim_), kv_lora_rank_);
+    k_absorb_.reshape(1, num_heads_, kv_lora_rank_, qk_nope_head_dim_);
+    k_absorb_.setDtype(MLLM_TYPE_F32);
+    k_absorb_.alloc();
+    v_absorb_.reshape(1, num_heads_, v_head_dim_, kv_lora_rank_);
+    v_absorb_.setDtype(MLLM_TYPE_F32);
+    v_absorb_.alloc();
+    const DataType type = loader.getDataType(weight.name());
+    if (type == MLLM_TYPE_COUNT) {
+        std::cerr << "[ERROR]: " << name() << " can not find " << weight.name() << std::endl;
+        return NOT_SUPPORT;
+    }
+    weight.setDtype(type);
+    weight.alloc();
+    loader.load(&weight);
+    if (type != MLLM_TYPE_F32 && type_traits[type].to_float == nullptr) {
+        std::cerr << "[ERROR]: " << name() << " can not read a weight of " << DataTypeName(type) << std::endl;
+        return NOT_SUPPORT;
+    }
+    const size_t weight_row_size = row_size(type, kv_lora_rank_);
+    vector<float> row(kv_lora_rank_);
+    for (int h = 0; h < num_heads_; ++h) {
+        for (int i = 0; i < qk_nope_head_dim_ + v_head_dim_; ++i) {
+            const char *src = weight.hostPtr<char>() + (size_t)(h * (qk_nope_head_dim_ + v_head_dim_) + i) * weight_row_size;
+            if (type == MLLM_TYPE_F32) {
+                memcpy(row.data(), src, kv_lora_rank_ * sizeof(float));
+            } else {
+                type_traits[type].to_float(src, row.data(), kv_lora_rank_);
+            }
+            if (i < qk_nope_head_dim_) {
+                for (int j = 0; j < kv_lora_rank_; ++j) {
+                    k_absorb_.setDataAt<float>(0, h, j, i, row[j]);
+                }
+            } else {
+                memcpy(v_absorb_.ptrAt<float>(0, h, i - qk_nope_head_dim_, 0), row.data(), kv_lora_rank_ * sizeof(float));
+            }
+        }
+    }
+    weight.free();
+    return Op::load(loader);
+}
+
+ErrorCode CPULatentAttention::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    auto &q_nope = inputs[0];
+    auto &q_pe = inputs[1];
+    auto &cache = inputs[2];
+    if (cache->ctype() != BSHD) {
+        std::cerr << "[ERROR]: " << name() << " needs the latent cache in BSHD;" << std::endl;
+        return NOT_SUPPORT;
+    }
+    const int batch = q_nope->batch();
+    const int sequence = q_nope->sequence();
+    const int rope_dim = q_pe->dimension();
+    const int cache_len = (int)inputs[3]->dataAt<float>(0, 0, 0, 0);
+    q_latent_.reshape(batch, num_heads_, sequence, kv_lora_rank_ + rope_dim);
+    q_latent_.setDtype(MLLM_TYPE_F32);
+    q_latent_.alloc();
+    o_latent_.reshape(batch, num_heads_, sequence, kv_lora_rank_);
+    o_latent_.setDtype(MLLM_TYPE_F32);
+    o_latent_.alloc();
+    parallel_for_3d(batch, num_heads_, sequence, thread_count, [&](int b, int h, int s) {
+        float *q = q_latent_.ptrAt<float>(b, h, s, 0);
+        const float *nope = q_nope->ptrAt<float>(b, h, s, 0);
+        for (int j = 0; j < kv_lora_rank_; ++j) {
+            vec_dot_fp32(qk_nope_head_dim_, q + j, k_absorb_.ptrAt<float>(0, h, j, 0), nope);
+        }
+        memcpy(q + kv_lora_rank_, q_pe->ptrAt<float>(b, h, s, 0), rope_dim * sizeof(float));
+    });
+    // the scores are those of the q_head_dim = qk_nope_head_dim + qk_rope_head_dim wide heads the latent stands for.
+    const float scale = 1.0F / std::sqrt((float)(qk_nope_head_dim_ + rope_dim));
+    attention_forward(&q_latent_, cache.get(), cache.get(), &o_latent_, cache_len, do_causal_mask_, 0, scale, kv_lora_rank_, thread_count);
+    parallel_for_3d(batch, num_heads_, sequence, thread_count, [&](int b, int h, int s) {
+        float *o = outputs[0]->ptrAt<float>(b, h, s, 0);
+        const float *latent = o_latent_.ptrAt<float>(b, h, s, 0);
+        for (int i = 0; i < v_head_dim_; ++i) {
+            vec_dot_fp32(kv_lora_rank_, o + i, v_absorb_.ptrAt<float>(0, h, i, 0), latent);
+        }
+    });
+    return Op::execute(inputs, outputs);
+}
+
+ErrorCode CPULatentAttention::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    k_absorb_.free();
+    v_absorb_.free();
+    q_latent_.free();
+    o_latent_.free();
+    return Op::free(inputs, outputs);
+}
+
+} // namespace mllm
@@ -0,0 +1,58 @@
+#ifndef MLLM_CPULATENTATTENTION_H
+#define MLLM_CPULATENTATTENTION_H
+
+#include "Op.hpp"
+#include "CPUBackend.hpp"
+
+namespace mllm {
+
+/**
+ * \brief the attention of DeepSeek's multi-head latent attention, over a cache of the latent KV.
+ *        inputs are q_nope [batch, head, sequence, qk_nope_head_dim], the roped q_pe [batch, head, sequence, qk_rope_head_dim],
+ *        the output of a KVCache of the latent [batch, 1, cache, kv_lora_rank + qk_rope_head_dim] (the normed compressed kv
+ *        followed by the roped k_pe) and the number of valid cache positions. the output is [batch, head, sequence, v_head_dim].
+ *
+ *        kv_b_proj is absorbed instead of applied to every cached position: with W_UK and W_UV the rows of its weight
+ *        that give the k_nope and v of head h,
+ *          q_nope . (W_UK c) = (W_UK^T q_nope) . c      and      sum_t p_t W_UV c_t = W_UV sum_t p_t c_t,
+ *        so each head attends to the latent c of the cache with the query cat(W_UK^T q_nope, q_pe), and W_UV is applied
+ *        to the result. the cache holds kv_lora_rank + qk_rope_head_dim values per position, shared by all the heads.
+ */
+class CPULatentAttention final : public Op {
+public:
+    CPULatentAttention(Backend *bn, string opName, int num_heads, int qk_nope_head_dim, int v_head_dim, int kv_lora_rank,
+                       bool do_causal_mask, int threadCount);
+    virtual ~CPULatentAttention() = default;
+    virtual ErrorCode reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode load(AbstructLoader &loader) override;
+    virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+
+private:
+    int num_heads_;
+    int qk_nope_head_dim_;
+    int v_head_dim_;
+    int kv_lora_rank_;
+    bool do_causal_mask_ = true;
+    int thread_count = 4;
+    Tensor k_absorb_;  // [1, head, kv_lora_rank, qk_nope_head_dim], W_UK^T of each head
+    Tensor v_absorb_;  // [1, head, v_head_dim, kv_lora_rank], W_UV of each head
+    Tensor q_latent_;  // [batch, head, sequence, kv_lora_rank + qk_rope_head_dim]
+    Tensor o_latent_;  // [batch, head, sequence, kv_lora_rank]
+};
+
+class CPULatentAttentionCreator : public CPUBackend::Creator {
+public:
+    virtual Op *create(OpParam op_param, Backend *bn, string name, int threadCount) const {
+        int num_heads = op_param["num_heads"];
+        int qk_nope_head_dim = op_param["qk_nope_head_dim"];
+        int v_head_dim = op_param["v_head_dim"];
+        int kv_lora_rank = op_param["kv_lora_rank"];
+        bool do_causal_mask = op_param["do_causal_mask"];
+        return new CPULatentAttention(bn, name, num_heads, qk_nope_head_dim, v_head_dim, kv_lora_rank, do_causal_mask, threadCount);
+    }
+};
+
+} // namespace mllm
+
+#endif // MLLM_CPULATENTATTENTION_H
@@ -53,37 +53,32 @@ ErrorCode CPULayerNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared
     int dim = input->dimension();
     int seq = input->sequence();
     int head = input->head();
-    for (int h = 0; h < head; h++) {
-        for (int n = 0; n < batch; n++) {
-            for (int s = 0; s < seq; s++) {
-                float sum_squares = 0.0F;
-                float sum = 0.0F;
+    parallel_for_3d(head, batch, seq, thread_count, [&](int h, int n, int s) {
+        float sum_squares = 0.0F;
+        float sum = 0.0F;
 // sum
 // #pragma omp parallel for reduction(+ : sum_squares) reduction(+ : sum) num_threads(thread_count)
-                for (int d = 0; d < dim; d++) {
-                    float value = input->dataAt<float>(n, h, s, d);
-                    sum += value;
-                }
-                float mean = sum / dim;
+        for (int d = 0; d < dim; d++) {
+            float value = input->dataAt<float>(n, h, s, d);
+            sum += value;
+        }
+        float mean = sum / dim;
 // #pragma omp parallel for reduction(+ : sum_squares) num_threads(thread_count)
-                for (int d = 0; d < dim; d++) {
-                    float value = input->dataAt<float>(n, h, s, d);
-                    sum_squares += (value - mean) * (value - mean);
-                    output->setDataAt(n, h, s, d, value - mean);
-                }
-                float rms = std::sqrt(sum_squares / dim + epsilon_);
-#pragma omp parallel for num_threads(thread_count)
-                for (int d = 0; d < dim; d++) {
-                    float value = output->dataAt<float>(n, h, s, d);
-                    if (bias) {
-                        output->setDataAt<float>(n, h, s, d, weight_.dataAt<float>(0, 0, 0, d) * value / rms + bias_.dataAt<float>(0, 0, 0, d));
-                    } else {
-                        output->setDataAt<float>(n, h, s, d, weight_.dataAt<float>(0, 0, 0, d) * value / rms);
-                    }
-                }
+        for (int d = 0; d < dim; d++) {
+            float value = input->dataAt<float>(n, h, s, d);
+            sum_squares += (value - mean) * (value - mean);
+            output->setDataAt(n, h, s, d, value - mean);
+        }
+        float rms = std::sqrt(sum_squares / dim + epsilon_);
+        for (int d = 0; d < dim; d++) {
+            float value = output->dataAt<float>(n, h, s, d);
+            if (bias) {
+                output->setDataAt<float>(n, h, s, d, weight_.dataAt<float>(0, 0, 0, d) * value / rms + bias_.dataAt<float>(0, 0, 0, d));
+            } else {
+                output->setDataAt<float>(n, h, s, d, weight_.dataAt<float>(0, 0, 0, d) * value / rms);
             }
         }
-    }
+    });
 
     return Op::execute(inputs, outputs);
 }
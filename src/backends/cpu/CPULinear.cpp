@@ -1,6 +1,7 @@
 
 #include "CPULinear.hpp"
 #include <iostream>
+#include "Imatrix.hpp"
 
 namespace mllm {
 
@@ -43,7 +44,13 @@ ErrorCode CPULinear::load(AbstructLoader &loader) {
     //std::cout << name() << "  CPULinear load" << std::endl;
     weight_.setName(name() + ".weight");
     weight_.reshape(1, 1, out_features_, in_features_);
-    if (loader.getDataType(weight_.name()) != MLLM_TYPE_COUNT) {
+    if (tied_ != nullptr) {
+        // the weight is the table of the op, kept in its type and memory.
+        Tensor *tied_weight = tied_->tiedWeight();
+        assert(tied_weight != nullptr && tied_weight->count() == weight_.count());
+        weight_.setDtype(tied_weight->dtype());
+        weight_.setHostPtr(tied_weight->rawHostPtr());
+    } else if (loader.getDataType(weight_.name()) != MLLM_TYPE_COUNT) {
         weight_.setDtype(loader.getDataType(weight_.name()));
         weight_.alloc();
         loader.load(&weight_);
@@ -71,6 +78,13 @@ ErrorCode CPULinear::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
     if(inputs[0]->count() == 0) {
         return Op::execute(inputs, outputs);
     }
+    if (auto *imatrix = Imatrix::active(); imatrix != nullptr && inputs[0]->dtype() == MLLM_TYPE_F32) {
+        for (int b = 0; b < inputs[0]->batch(); ++b) {
+            for (int s = 0; s < inputs[0]->sequence(); ++s) {
+                imatrix->add(weight_.name(), inputs[0]->ptrAt<float>(b, 0, s, 0), 1, in_features_, in_features_);
+            }
+        }
+    }
     mat_mul(inputs[0].get(), &weight_, outputs[0].get(), support_bias_, &bias_, false, true, thread_count);
     // std::cout << name() << "  CPULinear()" << std::endl;
     /*
@@ -108,4 +122,11 @@ ErrorCode CPULinear::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<T
     return Op::free(inputs, outputs);
 }
 
+OpCost CPULinear::cost(const vector<shared_ptr<Tensor>> &inputs, const vector<shared_ptr<Tensor>> &outputs) {
+    auto cost = Op::cost(inputs, outputs);
+    cost.bytes_read += weight_.cntSize() + (support_bias_ ? bias_.cntSize() : 0);
+    cost.flops = 2 * (int64_t)outputs[0]->count() * in_features_;
+    return cost;
+}
+
 } // namespace mllm
@@ -16,6 +16,7 @@ public:
     virtual ErrorCode load(AbstructLoader &loader) override;
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
+    OpCost cost(const vector<shared_ptr<Tensor>> &inputs, const vector<shared_ptr<Tensor>> &outputs) override;
 
     Tensor &weight() {
         return weight_;
@@ -23,6 +24,9 @@ public:
     Tensor &bias() {
         return bias_;
     }
+    void tieWeight(Op *op) override {
+        tied_ = op;
+    }
 
 private:
     int in_features_;
@@ -31,6 +35,7 @@ private:
     int thread_count = 4;
     Tensor weight_;
     Tensor bias_;
+    Op *tied_ = nullptr; // the op whose weight this one uses, see Op::tieWeight
 };
 
 class CPULinearCreator : public CPUBackend::Creator {
@@ -11,6 +11,7 @@ CPUMatmul::CPUMatmul(Backend *bn, string opName, bool transpose0, bool transpose
 }
 
 ErrorCode CPUMatmul::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    batched_rows.unsupported(name());
 
     assert(inputs.size() == 2);
     assert(outputs.size() == 1);
@@ -83,4 +84,11 @@ ErrorCode CPUMatmul::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_pt
     return Op::execute(inputs, outputs);
 }
 
+OpCost CPUMatmul::cost(const vector<shared_ptr<Tensor>> &inputs, const vector<shared_ptr<Tensor>> &outputs) {
+    auto cost = Op::cost(inputs, outputs);
+    const int64_t k = transpose0_ ? inputs[0]->sequence() : inputs[0]->dimension();
+    cost.flops = 2 * (int64_t)outputs[0]->count() * k;
+    return cost;
+}
+
 } // namespace mllm
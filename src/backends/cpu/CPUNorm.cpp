@@ -27,41 +27,32 @@ ErrorCode CPUNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
     int dim = input->dimension();
     int seq = input->sequence();
     int head = input->head();
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-    for (int h = 0; h < head; h++) {
-        for (int n = 0; n < batch; n++) {
-            for (int s = 0; s < seq; s++) {
-                if (L_n_ == 2) {
-                    // Calculate the sum of squares
-                    float sum_of_squares = 0.0f;
-// #pragma omp parallel for num_threads(thread_count)
-                    for (int d = 0; d < inputs[0]->dimension(); ++d) {
-                        sum_of_squares += inputs[0]->dataAt<float>(n, h, s,d) * inputs[0]->dataAt<float>(n, h, s,d);
-                    }
-                    // Calculate the L2 norm
-                    float l2_norm = std::sqrt(sum_of_squares);
-
-                    // Use the L2 norm in your code...
-#pragma omp parallel for num_threads(thread_count)
-                    for (int d = 0; d < dim; d++) {
-                        outputs[0]->setDataAt<float>(n, h, s,d, l2_norm);
-                    }
-                } else {
-                    float sum_of_abs_values = 0.0f;
+    parallel_for_3d(head, batch, seq, thread_count, [&](int h, int n, int s) {
+        if (L_n_ == 2) {
+            // Calculate the sum of squares
+            float sum_of_squares = 0.0f;
+            for (int d = 0; d < inputs[0]->dimension(); ++d) {
+                sum_of_squares += inputs[0]->dataAt<float>(n, h, s,d) * inputs[0]->dataAt<float>(n, h, s,d);
+            }
+            // Calculate the L2 norm
+            float l2_norm = std::sqrt(sum_of_squares);
 
-// #pragma omp parallel for num_threads(thread_count)
-                    for (int d = 0; d < inputs[0]->dimension(); ++d) {
-                        sum_of_abs_values += std::abs(inputs[0]->dataAt<float>(n, h, s,d));
-                    }
-#pragma omp parallel for num_threads(thread_count)
-                    for (int d = 0; d < dim; d++) {
-                        outputs[0]->setDataAt<float>(n, h, s,d, sum_of_abs_values);
-                    }
+            // Use the L2 norm in your code...
+            for (int d = 0; d < dim; d++) {
+                outputs[0]->setDataAt<float>(n, h, s,d, l2_norm);
+            }
+        } else {
+            float sum_of_abs_values = 0.0f;
 
-                }
+            for (int d = 0; d < inputs[0]->dimension(); ++d) {
+                sum_of_abs_values += std::abs(inputs[0]->dataAt<float>(n, h, s,d));
+            }
+            for (int d = 0; d < dim; d++) {
+                outputs[0]->setDataAt<float>(n, h, s,d, sum_of_abs_values);
             }
+
         }
-    }
+    });
 //     int size = inputs[0]->batch() * inputs[0]->head() * inputs[0]->sequence() * inputs[0]->dimension();
 //     if (L_n_ == 2) {
 //         // Calculate the sum of squares
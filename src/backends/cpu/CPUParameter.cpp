@@ -25,7 +25,8 @@ ErrorCode CPUParameter::load(AbstructLoader &loader) {
     if (loader.getDataType(weight_.name()) != MLLM_TYPE_COUNT) {
         weight_.setDtype(loader.getDataType(weight_.name()));
         weight_.alloc();
-        loader.load(&weight_);
+        // the output shares weight_, and the Ops after this one may write into it.
+        loader.loadCopy(&weight_);
     } else {
         weight_.setDtype(MLLM_TYPE_F32);
         weight_.alloc();
@@ -33,42 +33,30 @@ ErrorCode CPURMSNorm::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_p
     int dim = input->dimension();
     int seq = input->sequence();
     int head = input->head();
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-    for (int h = 0; h < head; h++) {
-        for (int n = 0; n < batch; n++) {
-            for (int s = 0; s < seq; s++) {
-                double sum_squares = 0.0F;
-                // sum
-                for (int d = 0; d < dim; d++) {
-                    float value = input->dataAt<float>(n, h, s, d);
-                    sum_squares += (double)value * value;
-                }
-                const float mean = sum_squares / dim;
-                const float rms = 1.0f / sqrtf(mean + epsilon_);
-
-                memcpy( outputs[0]->ptrAt<float>(n, h, s, 0), 
-                        inputs[0]->ptrAt<float>(n, h, s, 0), 
-                        dim * sizeof(float));
-                vec_scale_f32(dim, outputs[0]->ptrAt<float>(n, h, s, 0), rms);
-                }
-            }
+    parallel_for_3d(head, batch, seq, thread_count, [&](int h, int n, int s) {
+        double sum_squares = 0.0F;
+        // sum
+        for (int d = 0; d < dim; d++) {
+            float value = input->dataAt<float>(n, h, s, d);
+            sum_squares += (double)value * value;
         }
+        const float mean = sum_squares / dim;
+        const float rms = 1.0f / sqrtf(mean + epsilon_);
+
+        memcpy( outputs[0]->ptrAt<float>(n, h, s, 0), 
+                inputs[0]->ptrAt<float>(n, h, s, 0), 
+                dim * sizeof(float));
+        vec_scale_f32(dim, outputs[0]->ptrAt<float>(n, h, s, 0), rms);
+    });
 
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int h = 0; h < head; h++) {
-        for (int n = 0; n < batch; n++) {
-            for (int s = 0; s < seq; s++) {
-                for (int d = 0; d < dim; d++) {
-                    float weight = weight_.dataAt<float>(0, 0, 0, d);
-                    if (add_unit_offset_) {
-                        *outputs[0]->ptrAt<float>(n, h, s,d) *= (1 + weight);
-                    } else {
-                        *outputs[0]->ptrAt<float>(n, h, s,d) *= (weight);
-                    }
-                }
-            }
+    parallel_for_4d(head, batch, seq, dim, thread_count, [&](int h, int n, int s, int d) {
+        float weight = weight_.dataAt<float>(0, 0, 0, d);
+        if (add_unit_offset_) {
+            *outputs[0]->ptrAt<float>(n, h, s,d) *= (1 + weight);
+        } else {
+            *outputs[0]->ptrAt<float>(n, h, s,d) *= (weight);
         }
-    }
+    });
     return Op::execute(inputs, outputs);
 }
 ErrorCode CPURMSNorm::load(AbstructLoader &loader) {
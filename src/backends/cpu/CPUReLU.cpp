@@ -23,17 +23,10 @@ ErrorCode CPUReLU::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
     int head = input->head();
     int seq = input->sequence();
     int dim = input->dimension();
-#pragma omp parallel for collapse(4)
-    for (int b = 0; b <batch ; ++b) {
-        for (int h = 0; h < head; ++h) {
-            for (int s = 0; s < seq; ++s) {
-                for (int d = 0; d < dim; ++d) {
-                    float value = input->dataAt<float>(b, h, s, d);
-                    output->setDataAt<float>(b, h, s, d, value > 0 ? value : 0);
-                }
-            }
-        }
-    }
+    parallel_for_4d(batch, head, seq, dim, thread_count, [&](int b, int h, int s, int d) {
+        float value = input->dataAt<float>(b, h, s, d);
+        output->setDataAt<float>(b, h, s, d, value > 0 ? value : 0);
+    });
     return Op::execute(inputs, outputs);
 }
 ErrorCode CPUReLU::free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -1,17 +1,16 @@
 
 #include "CPURoPE.hpp"
+#include "CPUKVCache.hpp"
 #include "Timing.hpp"
 #include "Types.hpp"
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <mutex>
+#include <tuple>
 
 namespace mllm {
 
-vector<vector<float>> CPURoPE::sin_;
-vector<vector<float>> CPURoPE::cos_;
-int CPURoPE::global_pose_type_ = -1;
-int CPURoPE::ishape_old;
 
 void sinusoidal_position_embedding_llama(int seq_len, int output_dim, vector<vector<float>> &sin, vector<vector<float>> &cos) {
     sin.resize(seq_len);
@@ -22,8 +21,7 @@ void sinusoidal_position_embedding_llama(int seq_len, int output_dim, vector<vec
     for (int i = 0; i < seq_len; ++i) {
         cos[i].resize(output_dim);
     }
-#pragma omp parallel for num_threads(4)
-    for (int s = 0; s < seq_len; ++s) {
+    parallel_for(0, seq_len, 4, [&](int s) {
         for (int d = 0; d < output_dim; d += 2) {
             int i = (int)d / 2;
             float sin_value = std::sin(s / std::pow(10000, 2.0 * i / output_dim));
@@ -35,7 +33,7 @@ void sinusoidal_position_embedding_llama(int seq_len, int output_dim, vector<vec
                 cos[s][d + 1] = cos_value;
             }
         }
-    }
+    });
 }
 void sinusoidal_position_embedding_huggingface(int seq_len, int output_dim, vector<vector<float>> &sin, vector<vector<float>> &cos, int base = 10000) {
     sin.resize(seq_len);
@@ -46,8 +44,7 @@ void sinusoidal_position_embedding_huggingface(int seq_len, int output_dim, vect
     for (int i = 0; i < seq_len; ++i) {
         cos[i].resize(output_dim);
     }
-#pragma omp parallel for num_threads(4)
-    for (int s = 0; s < seq_len; ++s) {
+    parallel_for(0, seq_len, 4, [&](int s) {
         for (int d = 0; d < output_dim / 2; d += 1) {
             int i = (int)d / 1;
             float sin_value = sinf(s / std::pow(base, 2.0 * i / output_dim));
@@ -62,7 +59,33 @@ void sinusoidal_position_embedding_huggingface(int seq_len, int output_dim, vect
             sin[s][d] = sin_value;
             cos[s][d] = cos_value;
         }
+    });
+}
+
+bool rope_shift_row(float *row, int dim, int pose_type, float rope_theta, int delta) {
+    // the pairs rotated together and their frequencies, as in the tables above.
+    int stride;
+    double base;
+    if (pose_type == LLAMAROPE) {
+        stride = 1;
+        base = 10000;
+    } else if (pose_type == HFHUBROPE) {
+        stride = dim / 2;
+        base = rope_theta;
+    } else {
+        return false;
+    }
+    for (int i = 0; i < dim / 2; ++i) {
+        const double angle = delta / std::pow(base, 2.0 * i / dim);
+        const float sin_value = (float)std::sin(angle);
+        const float cos_value = (float)std::cos(angle);
+        float *x = pose_type == LLAMAROPE ? row + 2 * i : row + i;
+        const float x0 = x[0];
+        const float x1 = x[stride];
+        x[0] = x0 * cos_value - x1 * sin_value;
+        x[stride] = x0 * sin_value + x1 * cos_value;
     }
+    return true;
 }
 
 CPURoPE::CPURoPE(Backend *bn, string opName, int pose_type, int threadCount) :
@@ -95,47 +118,63 @@ ErrorCode CPURoPE::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
     outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[0]->dimension());
     ishape = inputs[0]->dimension() * partial_rotary_factor_;
     // pos_max_ = 16384;
-    if (sin_.empty() || ishape_old < ishape || global_pose_type_ != pose_type_) {
-        global_pose_type_ = pose_type_;
-        ishape_old = ishape;
-        if (pose_type_ == LLAMAROPE) {
-            sinusoidal_position_embedding_llama(pos_max_, ishape, sin_, cos_);
-        } else if (pose_type_ == PERSIMMONROPE) {
-            sinusoidal_position_embedding_huggingface(pos_max_, ishape / 2, sin_, cos_, 25000);
-        } else if (pose_type_ == HFHUBROPE || pose_type_ == MLAROPE) {
-            sinusoidal_position_embedding_huggingface(pos_max_, ishape, sin_, cos_, rope_theta_);
+    if (sink_ > 0 && !batched_rows.active()) {
+        h_cnt_ -= CPUKVCache::evictedTokens(h_cnt_, inputs[0]->sequence(), sink_, cache_max_);
+    }
+    const int positions = batched_rows.active() ? batched_rows.maxPosition() + 1 : h_cnt_ + inputs[0]->sequence();
+    if (positions > pos_max_) {
+        // a generation past max_position_embeddings, e.g. over a sliding-window KV cache, keeps its positions.
+        pos_max_ = std::max(positions, pos_max_ * 2);
+    }
+    if (table_ == nullptr || (int)table_->sin.size() < pos_max_ || table_ishape_ != ishape) {
+        table_ = table(pose_type_, ishape, rope_theta_, pos_max_);
+        table_ishape_ = ishape;
+    }
+    return Op::reshape(inputs, outputs);
+}
+
+std::shared_ptr<const CPURoPE::Table> CPURoPE::table(int pose_type, int ishape, int rope_theta, int positions) {
+    static std::mutex mutex;
+    static map<std::tuple<int, int, int>, std::shared_ptr<const Table>> tables;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto &shared = tables[{pose_type, ishape, rope_theta}];
+    if (shared == nullptr || (int)shared->sin.size() < positions) {
+        // the ops which still use a shorter table keep it until they need more positions.
+        auto built = std::make_shared<Table>();
+        if (pose_type == LLAMAROPE) {
+            sinusoidal_position_embedding_llama(positions, ishape, built->sin, built->cos);
+        } else if (pose_type == PERSIMMONROPE) {
+            sinusoidal_position_embedding_huggingface(positions, ishape / 2, built->sin, built->cos, 25000);
+        } else if (pose_type == HFHUBROPE || pose_type == MLAROPE) {
+            sinusoidal_position_embedding_huggingface(positions, ishape, built->sin, built->cos, rope_theta);
         } else {
         }
+        shared = built;
     }
-    return Op::reshape(inputs, outputs);
+    return shared;
 }
 
 
 void CPURoPE::rope_llama(shared_ptr<Tensor> input, shared_ptr<Tensor> output){
     auto out_dtype = output->dtype();
     int partial_dimension = (input->dimension()) * partial_rotary_factor_;
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int n = 0; n < input->batch(); ++n) {
-        for (int h = 0; h < input->head(); ++h) {
-            for (int s = 0; s < input->sequence(); ++s) { // sequance
-                for (int d = 0; d < partial_dimension; d+=2) {
-                    float in_value = input->dataAt<float>(n, h, s, d);
-                    float in_value_2 = input->dataAt<float>(n, h, s, d + 1);
-                    float sin_value = sin_[s + h_cnt_][d];
-                    float cos_value = cos_[s + h_cnt_][d];
-                    auto value = in_value * cos_value - in_value_2 * sin_value;
-                    auto value2 = in_value * sin_value + in_value_2 * cos_value;
-                    if (out_dtype == MLLM_TYPE_F32) {
-                        output->setDataAt<float>(n, h, s, d, value);
-                        output->setDataAt<float>(n, h, s, d+1, value2);
-                    } else if (out_dtype == MLLM_TYPE_F16) {
-                        output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                        output->setDataAt<mllm_fp16_t>(n, h, s, d+1, MLLM_FP32_TO_FP16(value2));
-                    }
-                }
+    parallel_for_3d(input->batch(), input->head(), input->sequence(), thread_count, [&](int n, int h, int s) {
+        for (int d = 0; d < partial_dimension; d+=2) {
+            float in_value = input->dataAt<float>(n, h, s, d);
+            float in_value_2 = input->dataAt<float>(n, h, s, d + 1);
+            float sin_value = table_->sin[position(s)][d];
+            float cos_value = table_->cos[position(s)][d];
+            auto value = in_value * cos_value - in_value_2 * sin_value;
+            auto value2 = in_value * sin_value + in_value_2 * cos_value;
+            if (out_dtype == MLLM_TYPE_F32) {
+                output->setDataAt<float>(n, h, s, d, value);
+                output->setDataAt<float>(n, h, s, d+1, value2);
+            } else if (out_dtype == MLLM_TYPE_F16) {
+                output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
+                output->setDataAt<mllm_fp16_t>(n, h, s, d+1, MLLM_FP32_TO_FP16(value2));
             }
         }
-    }
+    });
 }
 void CPURoPE::rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output){
     auto out_dtype = output->dtype();
@@ -144,145 +183,120 @@ void CPURoPE::rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output){
     assert(partial_dimension%2==0);
     if(output->ctype() == BSHD){        
         if (out_dtype == MLLM_TYPE_F32){
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-            for (int n = 0; n < input->batch(); ++n) {
-                for (int h = 0; h < input->head(); ++h) {
-                    for (int s = 0; s < input->sequence(); ++s) { // sequance
-                        for (int d = 0; d < partial_dimension/2; ++d) {
-                            auto v = input->ptrAt<float>(n, h, s, d);
-                            auto o = output->ptrAt<float>(n, h, s, d);
-                            float in_value = v[0];
-                            float in_value_2 = v[half];
-                            float sin_value = sin_[s + h_cnt_][d];
-                            float cos_value = cos_[s + h_cnt_][d];
-                            auto value = in_value * cos_value - in_value_2 * sin_value;
-                            auto value2 = in_value * sin_value + in_value_2 * cos_value;
-                            o[0] = value;
-                            o[half] = value2;
-                        }
-                    }
+            parallel_for_3d(input->batch(), input->head(), input->sequence(), thread_count, [&](int n, int h, int s) {
+                for (int d = 0; d < partial_dimension/2; ++d) {
+                    auto v = input->ptrAt<float>(n, h, s, d);
+                    auto o = output->ptrAt<float>(n, h, s, d);
+                    float in_value = v[0];
+                    float in_value_2 = v[half];
+                    float sin_value = table_->sin[position(s)][d];
+                    float cos_value = table_->cos[position(s)][d];
+                    auto value = in_value * cos_value - in_value_2 * sin_value;
+                    auto value2 = in_value * sin_value + in_value_2 * cos_value;
+                    o[0] = value;
+                    o[half] = value2;
                 }
-            }
+            });
         }else if(out_dtype == MLLM_TYPE_F16){
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-            for (int n = 0; n < input->batch(); ++n) {
-                for (int h = 0; h < input->head(); ++h) {
-                    for (int s = 0; s < input->sequence(); ++s) { // sequance
-                        for (int d = 0; d < partial_dimension/2; ++d) {
-                            auto v = input->ptrAt<float>(n, h, s, d);
-                            auto o = output->ptrAt<mllm_fp16_t>(n, h, s, d);
-                            float in_value = v[0];
-                            float in_value_2 = v[half];
-                            float sin_value = sin_[s + h_cnt_][d];
-                            float cos_value = cos_[s + h_cnt_][d];
-                            auto value = in_value * cos_value - in_value_2 * sin_value;
-                            auto value2 = in_value * sin_value + in_value_2 * cos_value;
-                            o[0] = MLLM_FP32_TO_FP16(value);
-                            o[half] = MLLM_FP32_TO_FP16(value2);
-                        }
-                    }
-                }
-            }
-        }
-        return;
-    }
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int n = 0; n < input->batch(); ++n) {
-        for (int h = 0; h < input->head(); ++h) {
-            for (int s = 0; s < input->sequence(); ++s) { // sequance
+            parallel_for_3d(input->batch(), input->head(), input->sequence(), thread_count, [&](int n, int h, int s) {
                 for (int d = 0; d < partial_dimension/2; ++d) {
-                    float in_value = input->dataAt<float>(n, h, s, d);
-                    float in_value_2 = input->dataAt<float>(n, h, s, d + partial_dimension / 2);
-                    float sin_value = sin_[s + h_cnt_][d];
-                    float cos_value = cos_[s + h_cnt_][d];
+                    auto v = input->ptrAt<float>(n, h, s, d);
+                    auto o = output->ptrAt<mllm_fp16_t>(n, h, s, d);
+                    float in_value = v[0];
+                    float in_value_2 = v[half];
+                    float sin_value = table_->sin[position(s)][d];
+                    float cos_value = table_->cos[position(s)][d];
                     auto value = in_value * cos_value - in_value_2 * sin_value;
                     auto value2 = in_value * sin_value + in_value_2 * cos_value;
-                    if (out_dtype == MLLM_TYPE_F32) {
-                        output->setDataAt<float>(n, h, s, d, value);
-                        output->setDataAt<float>(n, h, s, d+ partial_dimension / 2, value2);
-                    } else if (out_dtype == MLLM_TYPE_F16) {
-                        output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                        output->setDataAt<mllm_fp16_t>(n, h, s, d+ partial_dimension / 2, MLLM_FP32_TO_FP16(value2));
-                    }
+                    o[0] = MLLM_FP32_TO_FP16(value);
+                    o[half] = MLLM_FP32_TO_FP16(value2);
                 }
-            }
+            });
         }
+        return;
     }
+    parallel_for_3d(input->batch(), input->head(), input->sequence(), thread_count, [&](int n, int h, int s) {
+        for (int d = 0; d < partial_dimension/2; ++d) {
+            float in_value = input->dataAt<float>(n, h, s, d);
+            float in_value_2 = input->dataAt<float>(n, h, s, d + partial_dimension / 2);
+            float sin_value = table_->sin[position(s)][d];
+            float cos_value = table_->cos[position(s)][d];
+            auto value = in_value * cos_value - in_value_2 * sin_value;
+            auto value2 = in_value * sin_value + in_value_2 * cos_value;
+            if (out_dtype == MLLM_TYPE_F32) {
+                output->setDataAt<float>(n, h, s, d, value);
+                output->setDataAt<float>(n, h, s, d+ partial_dimension / 2, value2);
+            } else if (out_dtype == MLLM_TYPE_F16) {
+                output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
+                output->setDataAt<mllm_fp16_t>(n, h, s, d+ partial_dimension / 2, MLLM_FP32_TO_FP16(value2));
+            }
+        }
+    });
 }
 void CPURoPE::rope_permission(shared_ptr<Tensor> input, shared_ptr<Tensor> output){
     auto out_dtype = output->dtype();
     int partial_dimension = (input->dimension()) * partial_rotary_factor_;
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int n = 0; n < input->batch(); ++n) {
-        for (int h = 0; h < input->head(); ++h) {
-            for (int s = 0; s < input->sequence(); ++s) { // sequance
-                for (int d = 0; d < partial_dimension; ++d) {
-                float in_value = input->dataAt<float>(n, h, s, d);
-                    float in_value_2;
-                    float sin_value = sin_[s + h_cnt_][d];
-                    float cos_value = cos_[s + h_cnt_][d];
-                    if (d < partial_dimension / 4) {
-                        in_value_2 = -input->dataAt<float>(n, h, s, d + partial_dimension / 4);
-                        auto value = in_value * cos_value + in_value_2 * sin_value;
-                        if (out_dtype == MLLM_TYPE_F32) {
-                            output->setDataAt<float>(n, h, s, d, value);
-                        } else if (out_dtype == MLLM_TYPE_F16) {
-                            output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                        }
-                    } else if (d < (partial_dimension / 2)) {
-                        in_value_2 = input->dataAt<float>(n, h, s, d - partial_dimension / 4);
-                        auto value = in_value * cos_value + in_value_2 * sin_value;
-                        if (out_dtype == MLLM_TYPE_F32) {
-                            output->setDataAt<float>(n, h, s, d, value);
-                        } else if (out_dtype == MLLM_TYPE_F16) {
-                            output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                        }
-                    } else {
-                        if (out_dtype == MLLM_TYPE_F32) {
-                            output->setDataAt<float>(n, h, s, d, in_value);
-                        } else if (out_dtype == MLLM_TYPE_F16) {
-                            output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(in_value));
-                        }
-                    }
+    parallel_for_3d(input->batch(), input->head(), input->sequence(), thread_count, [&](int n, int h, int s) {
+        for (int d = 0; d < partial_dimension; ++d) {
+        float in_value = input->dataAt<float>(n, h, s, d);
+            float in_value_2;
+            float sin_value = table_->sin[position(s)][d];
+            float cos_value = table_->cos[position(s)][d];
+            if (d < partial_dimension / 4) {
+                in_value_2 = -input->dataAt<float>(n, h, s, d + partial_dimension / 4);
+                auto value = in_value * cos_value + in_value_2 * sin_value;
+                if (out_dtype == MLLM_TYPE_F32) {
+                    output->setDataAt<float>(n, h, s, d, value);
+                } else if (out_dtype == MLLM_TYPE_F16) {
+                    output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
+                }
+            } else if (d < (partial_dimension / 2)) {
+                in_value_2 = input->dataAt<float>(n, h, s, d - partial_dimension / 4);
+                auto value = in_value * cos_value + in_value_2 * sin_value;
+                if (out_dtype == MLLM_TYPE_F32) {
+                    output->setDataAt<float>(n, h, s, d, value);
+                } else if (out_dtype == MLLM_TYPE_F16) {
+                    output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
+                }
+            } else {
+                if (out_dtype == MLLM_TYPE_F32) {
+                    output->setDataAt<float>(n, h, s, d, in_value);
+                } else if (out_dtype == MLLM_TYPE_F16) {
+                    output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(in_value));
                 }
             }
         }
-    }
+    });
 }
 void CPURoPE::rope_mla(shared_ptr<Tensor> input, shared_ptr<Tensor> output){
     auto out_dtype = output->dtype();
     int partial_dimension = (input->dimension()) * partial_rotary_factor_;
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int n = 0; n < input->batch(); ++n) {
-        for (int h = 0; h < input->head(); ++h) {
-            for (int s = 0; s < input->sequence(); ++s) { // sequance
-                for (int d = 0; d < partial_dimension; ++d) {
-                    int half_dim = input->dimension() / 2;
-                    float in_value = input->dataAt<float>(n, h, s, d);
-                    if (d < half_dim) {
-                        in_value = input->dataAt<float>(n, h, s, d * 2);
-                    } else {
-                        in_value = input->dataAt<float>(n, h, s, 2 *(d - half_dim)+1);
-                    }
-                    float in_value_2;
-                    if (d < half_dim) {
-                        in_value_2 = -input->dataAt<float>(n, h, s, 2 *d+1);
-                    } else {
-                        in_value_2 = input->dataAt<float>(n, h, s, 2 *(d - half_dim));
-                    }
-                    // no change
-                    float sin_value = sin_[s + h_cnt_][d];
-                    float cos_value = cos_[s + h_cnt_][d];
-                    auto value = in_value * cos_value + in_value_2 * sin_value;
-                    if (out_dtype == MLLM_TYPE_F32) {
-                        output->setDataAt<float>(n, h, s, d, value);
-                    } else if (out_dtype == MLLM_TYPE_F16) {
-                        output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
-                    }
-                }
+    parallel_for_3d(input->batch(), input->head(), input->sequence(), thread_count, [&](int n, int h, int s) {
+        for (int d = 0; d < partial_dimension; ++d) {
+            int half_dim = input->dimension() / 2;
+            float in_value = input->dataAt<float>(n, h, s, d);
+            if (d < half_dim) {
+                in_value = input->dataAt<float>(n, h, s, d * 2);
+            } else {
+                in_value = input->dataAt<float>(n, h, s, 2 *(d - half_dim)+1);
+            }
+            float in_value_2;
+            if (d < half_dim) {
+                in_value_2 = -input->dataAt<float>(n, h, s, 2 *d+1);
+            } else {
+                in_value_2 = input->dataAt<float>(n, h, s, 2 *(d - half_dim));
+            }
+            // no change
+            float sin_value = table_->sin[position(s)][d];
+            float cos_value = table_->cos[position(s)][d];
+            auto value = in_value * cos_value + in_value_2 * sin_value;
+            if (out_dtype == MLLM_TYPE_F32) {
+                output->setDataAt<float>(n, h, s, d, value);
+            } else if (out_dtype == MLLM_TYPE_F16) {
+                output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(value));
             }
         }
-    }
+    });
 }
 
 ErrorCode CPURoPE::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
@@ -290,6 +304,7 @@ ErrorCode CPURoPE::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
     auto &output = outputs[0];
     auto out_dtype = output->dtype();
     int partial_dimension = (input->dimension()) * partial_rotary_factor_;
+    rows_ = batched_rows.active() ? &batched_rows : nullptr;
     // auto start_t = mllm_time_us();
     if (pose_type_ == LLAMAROPE) {
         rope_llama(input, output);
@@ -317,8 +332,8 @@ ErrorCode CPURoPE::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
                         } else {
                             in_value_2 = input->dataAt<float>(n, h, s, d - 1);
                         }
-                        float sin_value = sin_[s + h_cnt_][d];
-                        float cos_value = cos_[s + h_cnt_][d];
+                        float sin_value = table_->sin[position(s)][d];
+                        float cos_value = table_->cos[position(s)][d];
                         auto value = in_value * cos_value + in_value_2 * sin_value;
                         if (out_dtype == MLLM_TYPE_F32) {
                             output->setDataAt<float>(n, h, s, d, value);
@@ -328,8 +343,8 @@ ErrorCode CPURoPE::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
                     } else if (pose_type_ == PERSIMMONROPE) {
                         float in_value = input->dataAt<float>(n, h, s, d);
                         float in_value_2;
-                        float sin_value = sin_[s + h_cnt_][d];
-                        float cos_value = cos_[s + h_cnt_][d];
+                        float sin_value = table_->sin[position(s)][d];
+                        float cos_value = table_->cos[position(s)][d];
                         if (d < partial_dimension / 4) {
                             in_value_2 = -input->dataAt<float>(n, h, s, d + partial_dimension / 4);
                             auto value = in_value * cos_value + in_value_2 * sin_value;
@@ -361,8 +376,8 @@ ErrorCode CPURoPE::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
                         // } else {
                             in_value_2 = input->dataAt<float>(n, h, s, d - partial_dimension / 2);
                         }
-                        float sin_value = sin_[s + h_cnt_][d];
-                        float cos_value = cos_[s + h_cnt_][d];
+                        float sin_value = table_->sin[position(s)][d];
+                        float cos_value = table_->cos[position(s)][d];
                         auto value = in_value * cos_value + in_value_2 * sin_value;
                         if (output->dtypeAt(n, h, s, d) == MLLM_TYPE_F32) {
                             output->setDataAt<float>(n, h, s, d, value);
@@ -384,8 +399,8 @@ ErrorCode CPURoPE::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
                             in_value_2 = input->dataAt<float>(n, h, s, 2 *(d - half_dim));
                         }
                         // no change
-                        float sin_value = sin_[s + h_cnt_][d];
-                        float cos_value = cos_[s + h_cnt_][d];
+                        float sin_value = table_->sin[position(s)][d];
+                        float cos_value = table_->cos[position(s)][d];
                         auto value = in_value * cos_value + in_value_2 * sin_value;
                         if (out_dtype == MLLM_TYPE_F32) {
                             output->setDataAt<float>(n, h, s, d, value);
@@ -402,25 +417,19 @@ ErrorCode CPURoPE::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
     */
     // auto end_t = mllm_time_us();
     // std::cout << "RoPE time: " << (end_t - start_t)/1000.0F << " ms " <<partial_dimension<<"  "<<out_dtype<< std::endl;
-    h_cnt_ += input->sequence();
-    if (h_cnt_ > pos_max_) {
-        h_cnt_ = 0;
+    if (!batched_rows.active()) {
+        h_cnt_ += input->sequence();
     }
 
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int n = 0; n < input->batch(); ++n) {
-        for (int h = 0; h < input->head(); ++h) {
-            for (int s = 0; s < input->sequence(); ++s) {
-                for (int d = partial_dimension; d < input->dimension(); ++d) {
-                    if (out_dtype == MLLM_TYPE_F32) {
-                        output->setDataAt<float>(n, h, s, d, input->dataAt<float>(n, h, s, d));
-                    } else if (out_dtype == MLLM_TYPE_F16) {
-                        output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(input->dataAt<float>(n, h, s, d)));
-                    }
-                }
+    parallel_for_3d(input->batch(), input->head(), input->sequence(), thread_count, [&](int n, int h, int s) {
+        for (int d = partial_dimension; d < input->dimension(); ++d) {
+            if (out_dtype == MLLM_TYPE_F32) {
+                output->setDataAt<float>(n, h, s, d, input->dataAt<float>(n, h, s, d));
+            } else if (out_dtype == MLLM_TYPE_F16) {
+                output->setDataAt<mllm_fp16_t>(n, h, s, d, MLLM_FP32_TO_FP16(input->dataAt<float>(n, h, s, d)));
             }
         }
-    }
+    });
     return Op::execute(inputs, outputs);
 }
 
@@ -6,6 +6,13 @@
 
 namespace mllm {
 
+/**
+ * \brief rotate the dim values of a row roped by pose_type (LLAMAROPE or HFHUBROPE) as if its position moved by delta,
+ *        e.g. for the keys a KVCache moves.
+ * \return false for the other types.
+ */
+bool rope_shift_row(float *row, int dim, int pose_type, float rope_theta, int delta);
+
 class CPURoPE final : public Op {
 public:
     CPURoPE(Backend *bn, string opName, int pose_type, int threadCount);
@@ -17,16 +24,45 @@ public:
     virtual ErrorCode execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
     virtual ErrorCode free(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) override;
 
+    /**
+     * \brief the position of the next token, i.e. the number of tokens rotated since the start of the sequence.
+     */
+    int getPosition() const override {
+        return h_cnt_;
+    }
+    void setPosition(int position) override {
+        h_cnt_ = position;
+    }
+    /**
+     * \brief follow a KVCache of cache_max tokens that keeps `sink` tokens (see CPUKVCache): the position of the
+     *        next token drops by the tokens the cache evicts, so the positions stay within the cache.
+     */
+    void setSink(int sink, int cache_max) {
+        sink_ = sink;
+        cache_max_ = cache_max;
+    }
+
 private:
     //    Tensor freq_;
     // static Tensor sin_;
     // static Tensor cos_;
-    static vector<vector<float>> sin_;
-    static vector<vector<float>> cos_;
-    static int global_pose_type_;
-    static int ishape_old;
+    struct Table {
+        vector<vector<float>> sin;
+        vector<vector<float>> cos;
+    };
+    /**
+     * \brief the sin and cos of at least `positions` positions for pose_type, the rotated dimension ishape and
+     *        rope_theta; built once and shared by the RoPE ops of every Module and thread which use the same ones.
+     */
+    static std::shared_ptr<const Table> table(int pose_type, int ishape, int rope_theta, int positions);
+    std::shared_ptr<const Table> table_;
+    int table_ishape_ = 0;
+    // the rows of the batched forward being executed, read here instead of batched_rows by the workers of parallel_for.
+    const BatchedRows *rows_ = nullptr;
     int rope_theta_ = 10000;
     int h_cnt_ = 0;
+    int sink_ = 0;
+    int cache_max_ = 0;
     int pos_max_ = 16384;
     int pose_type_ = 4;
     int ishape;
@@ -34,6 +70,10 @@ private:
     float partial_rotary_factor_ = 1;
 
 
+    // position of row s, rows of a batched forward carry their own positions.
+    inline int position(int s) const {
+        return rows_ != nullptr ? rows_->position[s] : s + h_cnt_;
+    }
     void rope_llama(shared_ptr<Tensor> input, shared_ptr<Tensor> output);
     void rope_hf(shared_ptr<Tensor> input, shared_ptr<Tensor> output);
     void rope_permission(shared_ptr<Tensor> input, shared_ptr<Tensor> output);
@@ -50,7 +90,11 @@ public:
         float rope_theta = op_param["rope_theta"];
         int max_position_embeddings = op_param["max_position_embeddings"];
         if (op_param.find("partial_rotary_factor") == op_param.end()) {
-            return new CPURoPE(bn, name, pose_type, rope_theta, max_position_embeddings, threadCount);
+            auto *rope = new CPURoPE(bn, name, pose_type, rope_theta, max_position_embeddings, threadCount);
+            if (op_param.find("sink") != op_param.end()) {
+                rope->setSink((int)op_param["sink"], (int)op_param["cache_max"]);
+            }
+            return rope;
         }
         float partial_rotary_factor = op_param["partial_rotary_factor"];
         return new CPURoPE(bn, name, pose_type, rope_theta, partial_rotary_factor, max_position_embeddings, threadCount);
@@ -27,20 +27,15 @@ ErrorCode CPUSiLU::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<
     int n1 = input->head();
     int n2 = input->sequence();
     int n3 = input->dimension();
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-    for (int n = 0; n < batch; n++) {
-        for (int h = 0; h < n2; h++) {
-            for (int c = 0; c < n1; c++) {
+    parallel_for_3d(batch, n2, n1, thread_count, [&](int n, int h, int c) {
 //                #pragma omp parallel for num_threads(thread_count)
 //                for (int w = 0; w < n3; w++) {
 //                    float value = input->dataAt<float>(n, c, h, w);
 //                    outputs[0]->setDataAt<float>(n, c, h, w, value / (1 + std::exp(-value)));
 //                }
-                mllm_vec_silu_f32(n3,  outputs[0]->ptrAt<float>(n, c, h,0),
-                    inputs[0]->ptrAt<float>(n, c, h,0));
-            }
-        }
-    }
+        mllm_vec_silu_f32(n3,  outputs[0]->ptrAt<float>(n, c, h,0),
+            inputs[0]->ptrAt<float>(n, c, h,0));
+    });
 
     return Op::execute(inputs, outputs);
 }
@@ -8,6 +8,8 @@
  *
  */
 #include "CPUSlidingWindowMask.hpp"
+#include <algorithm>
+#include <cstring>
 #include <limits>
 
 namespace mllm {
@@ -19,6 +21,7 @@ CPUSlidingWindowMask::CPUSlidingWindowMask(Backend *bn, string opName, int windo
 }
 
 ErrorCode CPUSlidingWindowMask::reshape(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
+    batched_rows.unsupported(name());
     assert(inputs.size() == 1);
     assert(outputs.size() == 1);
     outputs[0]->reshape(inputs[0]->batch(), inputs[0]->head(), inputs[0]->sequence(), inputs[0]->dimension());
@@ -26,30 +29,25 @@ ErrorCode CPUSlidingWindowMask::reshape(vector<shared_ptr<Tensor>> inputs, vecto
 }
 
 ErrorCode CPUSlidingWindowMask::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr<Tensor>> outputs) {
-    if (inputs[0]->sequence() > 1) {
-        int batch_size = inputs[0]->batch();
-        int head_num = inputs[0]->head();
-        int sequence = inputs[0]->sequence();
-        int dimension = inputs[0]->dimension();
-        int old_dim = dimension - sequence;
-        int _t_window_size = winodw_size - 1;
-        for (int n = 0; n < batch_size; ++n) {
-            for (int h = 0; h < head_num; ++h) {
-                for (int s = 0; s < sequence; ++s) {
-#pragma omp parallel for num_threads(thread_count)
-                    for (int d = 0; d < dimension; ++d) {
-                        if (/*right bound of window*/ d > s + old_dim || /*left bound of window*/ d < s - _t_window_size) {
-                            outputs[0]->setDataAt<float>({n, h, s, d}, std::numeric_limits<float>::lowest());
-                        } else {
-                            outputs[0]->setDataAt<float>({n, h, s, d}, inputs[0]->dataAt<float>(n, h, s, d));
-                        }
-                    }
-                }
-            }
+    int batch_size = inputs[0]->batch();
+    int head_num = inputs[0]->head();
+    int sequence = inputs[0]->sequence();
+    int dimension = inputs[0]->dimension();
+    int old_dim = dimension - sequence;
+    const float lowest = std::numeric_limits<float>::lowest();
+    // row s is the token old_dim + s, it sees the winodw_size tokens up to its own: a range of each row is kept,
+    // the rest is filled. a decoded token is masked as well once the scores are longer than the window.
+    parallel_for_3d(batch_size, head_num, sequence, thread_count, [&](int n, int h, int s) {
+        const int end = std::min(dimension, s + old_dim + 1);
+        const int begin = std::max(0, std::min(end, s + old_dim + 1 - winodw_size));
+        const float *in = inputs[0]->ptrAt<float>(n, h, s, 0);
+        float *out = outputs[0]->ptrAt<float>(n, h, s, 0);
+        std::fill(out, out + begin, lowest);
+        if (out != in) {
+            memcpy(out + begin, in + begin, (end - begin) * sizeof(float));
         }
-    } else {
-        outputs[0]->copyFrom(inputs[0]);
-    }
+        std::fill(out + end, out + dimension, lowest);
+    });
     return Op::execute(inputs, outputs);
 }
 
@@ -56,6 +56,7 @@ class CPUmmFunction: public TensorFunction {
 
 public:
     void setup(vector<Tensor*> outputs, vector<Tensor*> inputs, vector<float> args) override {    
+        Op::batched_rows.unsupported(outputs[0]->name());
         if (inputs[1]->chls()[SEQUENCE] != 3) {
             tranTensorChl(*inputs[1]);
         }
@@ -83,7 +84,11 @@ public:
         }
         */
     }
-    
+    OpCost cost(vector<Tensor*> outputs, vector<Tensor*> inputs, vector<float> args) override {
+        auto cost = TensorFunction::cost(outputs, inputs, args);
+        cost.flops = 2 * (int64_t)outputs[0]->count() * inputs[0]->dimension();
+        return cost;
+    }
 };
 
 class CPUnormFunction: public TensorFunction {
@@ -96,32 +101,26 @@ public:
     }
     void execute(vector<Tensor*> outputs, vector<Tensor*> inputs, vector<float> args) override {
         int L_n = (int)args[0];
-        for (int h = 0; h < inputs[0]->head(); h++) {
-            for (int n = 0; n < inputs[0]->batch(); n++) {
-                for (int s = 0; s < inputs[0]->sequence(); s++) {
-                    if (L_n == 2) {
-                        float sum_of_squares = 0.0f;
-                        for (int d = 0; d < inputs[0]->dimension(); ++d) {
-                            sum_of_squares += inputs[0]->dataAt<float>(n, h, s, d) * inputs[0]->dataAt<float>(n, h, s, d);
-                        }
-                        float l2_norm = std::sqrt(sum_of_squares);
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-                        for (int d = 0; d < inputs[0]->dimension(); d++) {
-                            outputs[0]->setDataAt<float>(n, h, s, d, l2_norm);
-                        }
-                    } else {
-                        float sum_of_abs_values = 0.0f;
-                        for (int d = 0; d < inputs[0]->dimension(); ++d) {
-                            sum_of_abs_values += std::abs(inputs[0]->dataAt<float>(n, h, s, d));
-                        }
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-                        for (int d = 0; d < inputs[0]->dimension(); d++) {
-                            outputs[0]->setDataAt<float>(n, h, s, d, sum_of_abs_values);
-                        }
-                    }
+        parallel_for_3d(inputs[0]->head(), inputs[0]->batch(), inputs[0]->sequence(), CPUBackend::cpu_threads, [&](int h, int n, int s) {
+            if (L_n == 2) {
+                float sum_of_squares = 0.0f;
+                for (int d = 0; d < inputs[0]->dimension(); ++d) {
+                    sum_of_squares += inputs[0]->dataAt<float>(n, h, s, d) * inputs[0]->dataAt<float>(n, h, s, d);
+                }
+                float l2_norm = std::sqrt(sum_of_squares);
+                for (int d = 0; d < inputs[0]->dimension(); d++) {
+                    outputs[0]->setDataAt<float>(n, h, s, d, l2_norm);
+                }
+            } else {
+                float sum_of_abs_values = 0.0f;
+                for (int d = 0; d < inputs[0]->dimension(); ++d) {
+                    sum_of_abs_values += std::abs(inputs[0]->dataAt<float>(n, h, s, d));
+                }
+                for (int d = 0; d < inputs[0]->dimension(); d++) {
+                    outputs[0]->setDataAt<float>(n, h, s, d, sum_of_abs_values);
                 }
             }
-        }
+        });
     }
 };
 
@@ -136,23 +135,17 @@ public:
     template <typename Func>
     void execute(Tensor *input, Tensor *output, Func operation, float data) {
         if (input->masterTensor() == nullptr && output->masterTensor() == nullptr && input->ctype() == output->ctype()) {
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-            for (int is = 0; is < input->batch() * input->head() * input->sequence() * input->dimension(); ++is) {
+            parallel_for(0, input->batch() * input->head() * input->sequence() * input->dimension(), CPUBackend::cpu_threads, [&](int is) {
                 output->hostPtr<float>()[is] = operation(input->hostPtr<float>()[is], data);
-            }
+            });
         } else {
-            for (int n = 0; n < input->batch(); ++n) {
-                for (int c = 0; c < input->head(); ++c) {
-                    for (int h = 0; h < input->sequence(); ++h) {
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-                        for (int w = 0; w < input->dimension(); ++w) {
-                            output->ptrAt<float>(n, c, h, w)[0] =
-                                operation(input->ptrAt<float>(n, c, h, w)[0],
-                                          data);
-                        }
-                    }
+            parallel_for_3d(input->batch(), input->head(), input->sequence(), CPUBackend::cpu_threads, [&](int n, int c, int h) {
+                for (int w = 0; w < input->dimension(); ++w) {
+                    output->ptrAt<float>(n, c, h, w)[0] =
+                        operation(input->ptrAt<float>(n, c, h, w)[0],
+                                  data);
                 }
-            }
+            });
         }
     }
 };
@@ -218,27 +211,23 @@ public:
             for (int n = 0; n < batch_; ++n) {
                 auto n_0 = std::min(n, input0->batch() - 1);
                 auto n_1 = std::min(n, input1->batch() - 1);
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-                for (int is = 0; is < input0->head() * input0->sequence() * input0->dimension(); ++is) {
+                parallel_for(0, input0->head() * input0->sequence() * input0->dimension(), CPUBackend::cpu_threads, [&](int is) {
                     output->ptrAt<float>(n, 0, 0, 0)[is] =
                         operation(input0->ptrAt<float>(n_0, 0, 0, 0)[is],
                                   input1->ptrAt<float>(n_1, 0, 0, 0)[is]);
-                }
+                });
             }
         } else {
             for (int n = 0; n < batch_; ++n) {
                 auto n_0 = std::min(n, input0->batch() - 1);
                 auto n_1 = std::min(n, input1->batch() - 1);
-                for (int c = 0; c < input0->head(); ++c) {
-                    for (int h = 0; h < input0->sequence(); ++h) {
-#pragma omp parallel for num_threads(CPUBackend::cpu_threads)
-                        for (int w = 0; w < input0->dimension(); ++w) {
-                            output->ptrAt<float>(n, c, h, w)[0] =
-                                operation(input0->ptrAt<float>(n_0, c, h, w)[0],
-                                          input1->ptrAt<float>(n_1, c, h, w)[0]);
-                        }
+                parallel_for_2d(input0->head(), input0->sequence(), CPUBackend::cpu_threads, [&](int c, int h) {
+                    for (int w = 0; w < input0->dimension(); ++w) {
+                        output->ptrAt<float>(n, c, h, w)[0] =
+                            operation(input0->ptrAt<float>(n_0, c, h, w)[0],
+                                      input1->ptrAt<float>(n_1, c, h, w)[0]);
                     }
-                }
+                });
             }
         }
     }
@@ -894,7 +883,7 @@ public:
         vector<float> s_vec = {};
         vector<float> h_vec = {};
         vector<float> d_vec = {};
-#pragma omp parallel for collapse(4) num_threads(CPUBackend::cpu_threads)
+        // serial, the matches are appended in order.
         for (int b = 0; b < inputs[0]->batch(); b++) {
             for (auto s = 0; s < inputs[0]->sequence(); s++) {
                 for (auto h = 0; h < inputs[0]->head(); h++) {
@@ -19,7 +19,7 @@ ErrorCode CPUWhere::execute(vector<shared_ptr<Tensor>> inputs, vector<shared_ptr
     vector<float> s_vec = {};
     vector<float> h_vec = {};
     vector<float> d_vec = {};
-#pragma omp parallel for collapse(4) num_threads(thread_count)
+    // serial, the matches are appended in order.
     for (int b = 0; b < inputs[0]->batch(); b++) {
         for (auto s = 0; s < inputs[0]->sequence(); s++) {
             for (auto h = 0; h < inputs[0]->head(); h++) {
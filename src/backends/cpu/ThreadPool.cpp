@@ -0,0 +1,166 @@
+#include "ThreadPool.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define MLLM_CPU_RELAX() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define MLLM_CPU_RELAX() __asm__ volatile("yield")
+#else
+#define MLLM_CPU_RELAX()
+#endif
+
+namespace mllm {
+
+// iterations an idle thread spins before it sleeps or yields, some 100us.
+static constexpr int spin_count = 1 << 12;
+// set on the workers and on the thread that runs a job, a nested job runs on the calling thread.
+static thread_local bool in_job = false;
+
+Profiler::WorkerTime *(*ThreadPool::worker_time)() = nullptr;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ThreadPool &ThreadPool::global() {
+    static ThreadPool pool([] {
+        const char *affinity = std::getenv("MLLM_THREAD_AFFINITY");
+        return affinity == nullptr || strcmp(affinity, "0") != 0;
+    }());
+    return pool;
+}
+
+ThreadPool::ThreadPool(bool affinity, int max_threads) :
+    affinity_(affinity) {
+    max_threads_ = max_threads > 0 ? max_threads : std::max((int)std::thread::hardware_concurrency(), 1);
+#if defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus_.push_back(cpu);
+            }
+        }
+    }
+    if (max_threads <= 0 && !cpus_.empty()) {
+        max_threads_ = std::min(max_threads_, (int)cpus_.size());
+    }
+#endif
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        for (auto &slot : slots_) {
+            slot->ticket.fetch_add(1, std::memory_order_release);
+        }
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::grow(int threads) {
+    threads = std::min(threads, max_threads_);
+    while (this->threads() < threads) {
+        const int id = this->threads();
+        slots_.push_back(std::make_unique<Slot>());
+        workers_.emplace_back(&ThreadPool::work, this, slots_.back().get(), id);
+        idle_.push_back((int)slots_.size() - 1);
+    }
+}
+
+void ThreadPool::work(Slot *slot, int id) {
+    in_job = true;
+#if defined(__linux__)
+    // the calling thread is left alone, the workers get the next CPUs.
+    if (affinity_ && !cpus_.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus_[id % cpus_.size()], &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+    uint64_t seen = 0;
+    while (true) {
+        for (int i = 0; i < spin_count && slot->ticket.load(std::memory_order_acquire) == seen; ++i) {
+            MLLM_CPU_RELAX();
+        }
+        if (slot->ticket.load(std::memory_order_acquire) == seen) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return slot->ticket.load(std::memory_order_acquire) != seen; });
+        }
+        seen = slot->ticket.load(std::memory_order_acquire);
+        if (stop_) {
+            return;
+        }
+        Job *job = slot->job;
+        const int64_t start = job->worker_time == nullptr ? 0 : nowNs();
+        for (int ith = slot->index; ith < job->nth; ith += job->participants) {
+            (*job->fn)(ith, job->nth);
+        }
+        if (job->worker_time != nullptr) {
+            job->worker_time->busy_ns.fetch_add(nowNs() - start, std::memory_order_relaxed);
+        }
+        // the job lives on the stack of run(), it is not touched after this.
+        job->pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void ThreadPool::run(int nth, const std::function<void(int, int)> &fn) {
+    if (nth <= 1 || in_job) {
+        for (int ith = 0; ith < nth; ++ith) {
+            fn(ith, nth);
+        }
+        return;
+    }
+    // the workers of this job, a thread runs one job at a time.
+    static thread_local std::vector<int> claimed;
+    Job job{&fn, nth, 1, worker_time == nullptr ? nullptr : worker_time(), {0}};
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        grow(nth);
+        ++callers_;
+        const int share = (threads() + callers_ - 1) / callers_;
+        job.participants = std::min({nth, share, (int)idle_.size() + 1});
+        claimed.assign(idle_.end() - (job.participants - 1), idle_.end());
+        idle_.resize(idle_.size() - claimed.size());
+        job.pending.store((int)claimed.size(), std::memory_order_relaxed);
+        for (int i = 0; i < claimed.size(); ++i) {
+            Slot &slot = *slots_[claimed[i]];
+            slot.job = &job;
+            slot.index = i + 1;
+            slot.ticket.fetch_add(1, std::memory_order_release);
+        }
+    }
+    if (!claimed.empty()) {
+        wake_.notify_all();
+        if (job.worker_time != nullptr && job.worker_time->threads.load(std::memory_order_relaxed) < job.participants) {
+            job.worker_time->threads.store(job.participants, std::memory_order_relaxed);
+        }
+    }
+    in_job = true;
+    for (int ith = 0; ith < nth; ith += job.participants) {
+        fn(ith, nth);
+    }
+    in_job = false;
+    for (int i = 0; job.pending.load(std::memory_order_acquire) != 0; ++i) {
+        if (i < spin_count) {
+            MLLM_CPU_RELAX();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.insert(idle_.end(), claimed.begin(), claimed.end());
+    --callers_;
+}
+
+} // namespace mllm
@@ -0,0 +1,193 @@
+#ifndef MLLM_THREADPOOL_H
+#define MLLM_THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Profiler.hpp"
+
+namespace mllm {
+
+/**
+ * \brief the persistent workers of the CPU backend, which run the parallel parts of the CPU ops.
+ *
+ * the workers are started once and pinned to the CPUs of the process (unless MLLM_THREAD_AFFINITY=0).
+ * between two jobs they spin for a short while before they sleep, so the back to back small jobs
+ * of a decode step do not pay for a wake up each. the calling thread works on each job as well.
+ *
+ * several threads can run jobs at the same time (e.g. two Modules decoding concurrently): each job takes
+ * its workers from the idle ones, at most threads() / callers of them, so the concurrent callers share
+ * the workers instead of one of them running its jobs alone. a job that finds no idle worker runs on the
+ * calling thread; the workers are handed back when the job ends, so the shares even out from the next job.
+ */
+class ThreadPool {
+public:
+    static ThreadPool &global();
+
+    /**
+     * \param max_threads the threads a job can run on at most, by default the CPUs of the process.
+     */
+    explicit ThreadPool(bool affinity = true, int max_threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * \brief call fn(ith, nth) for every ith < nth and return when all calls are done.
+     *        the calls run on at most min(nth, max_threads) threads, fewer while other threads run jobs
+     *        as well (see above). nested jobs run on the calling thread.
+     *        the time the workers spend on the job is added to worker_time(), if it returns one.
+     */
+    void run(int nth, const std::function<void(int, int)> &fn);
+    /**
+     * \brief the threads a job can run on, the workers and the calling thread.
+     */
+    int threads() const {
+        return (int)workers_.size() + 1;
+    }
+
+    /**
+     * \brief where the workers add the time of the jobs the calling thread submits, nullptr if they are not timed.
+     *        set by the CPUBackend to Profiler::workerTime, the ThreadPool itself does not depend on the Profiler.
+     */
+    static Profiler::WorkerTime *(*worker_time)();
+
+private:
+    struct Job {
+        const std::function<void(int, int)> *fn;
+        int nth;
+        int participants;
+        // where the workers add the time of the job, nullptr if it is not profiled.
+        Profiler::WorkerTime *worker_time;
+        // the workers that have not finished the job yet.
+        std::atomic<int> pending;
+    };
+    // what a worker is given to do.
+    struct Slot {
+        // the job and the first ith of it the worker runs, set under mutex_ before ticket is bumped.
+        Job *job = nullptr;
+        int index = 0;
+        std::atomic<uint64_t> ticket{0};
+    };
+
+    void grow(int threads);
+    void work(Slot *slot, int id);
+
+    bool affinity_;
+    int max_threads_;
+    std::vector<int> cpus_;
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<Slot>> slots_;
+    // the workers without a job and the threads running a job, guarded by mutex_.
+    std::vector<int> idle_;
+    int callers_ = 0;
+    bool stop_ = false;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+};
+
+/**
+ * \brief split [0, n) into thread_count contiguous ranges and call fn(begin, end) for each of them.
+ */
+template <typename Func>
+void parallel_ranges(int64_t n, int thread_count, Func &&fn) {
+    if (n <= 0) {
+        return;
+    }
+    const int nth = (int)std::min<int64_t>(std::max(thread_count, 1), n);
+    if (nth == 1) {
+        fn((int64_t)0, n);
+        return;
+    }
+    ThreadPool::global().run(nth, [&](int ith, int) {
+        fn(n * ith / nth, n * (ith + 1) / nth);
+    });
+}
+
+/**
+ * \brief like `#pragma omp parallel for`, call fn(i) for every begin <= i < end.
+ */
+template <typename Func>
+void parallel_for(int64_t begin, int64_t end, int thread_count, Func &&fn) {
+    parallel_ranges(end - begin, thread_count, [&](int64_t r_begin, int64_t r_end) {
+        for (int64_t i = begin + r_begin; i < begin + r_end; ++i) {
+            fn(i);
+        }
+    });
+}
+
+/**
+ * \brief like `#pragma omp parallel for collapse(2)`, call fn(i0, i1) for every i0 < n0, i1 < n1.
+ */
+template <typename Func>
+void parallel_for_2d(int64_t n0, int64_t n1, int thread_count, Func &&fn) {
+    if (n1 <= 0) {
+        return;
+    }
+    parallel_ranges(n0 * n1, thread_count, [&](int64_t begin, int64_t end) {
+        int64_t i0 = begin / n1, i1 = begin % n1;
+        for (int64_t i = begin; i < end; ++i) {
+            fn(i0, i1);
+            if (++i1 == n1) {
+                i1 = 0, ++i0;
+            }
+        }
+    });
+}
+
+/**
+ * \brief like `#pragma omp parallel for collapse(3)`, call fn(i0, i1, i2) for every i0 < n0, i1 < n1, i2 < n2.
+ */
+template <typename Func>
+void parallel_for_3d(int64_t n0, int64_t n1, int64_t n2, int thread_count, Func &&fn) {
+    if (n1 <= 0 || n2 <= 0) {
+        return;
+    }
+    parallel_ranges(n0 * n1 * n2, thread_count, [&](int64_t begin, int64_t end) {
+        int64_t i0 = begin / (n1 * n2), i1 = begin / n2 % n1, i2 = begin % n2;
+        for (int64_t i = begin; i < end; ++i) {
+            fn(i0, i1, i2);
+            if (++i2 == n2) {
+                i2 = 0;
+                if (++i1 == n1) {
+                    i1 = 0, ++i0;
+                }
+            }
+        }
+    });
+}
+
+/**
+ * \brief like `#pragma omp parallel for collapse(4)`, call fn(i0, i1, i2, i3) for every i0 < n0, ..., i3 < n3.
+ */
+template <typename Func>
+void parallel_for_4d(int64_t n0, int64_t n1, int64_t n2, int64_t n3, int thread_count, Func &&fn) {
+    if (n1 <= 0 || n2 <= 0 || n3 <= 0) {
+        return;
+    }
+    parallel_ranges(n0 * n1 * n2 * n3, thread_count, [&](int64_t begin, int64_t end) {
+        int64_t i0 = begin / (n1 * n2 * n3), i1 = begin / (n2 * n3) % n1, i2 = begin / n3 % n2, i3 = begin % n3;
+        for (int64_t i = begin; i < end; ++i) {
+            fn(i0, i1, i2, i3);
+            if (++i3 == n3) {
+                i3 = 0;
+                if (++i2 == n2) {
+                    i2 = 0;
+                    if (++i1 == n1) {
+                        i1 = 0, ++i0;
+                    }
+                }
+            }
+        }
+    });
+}
+
+} // namespace mllm
+
+#endif // MLLM_THREADPOOL_H
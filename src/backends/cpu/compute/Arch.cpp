@@ -0,0 +1,221 @@
+#include "Arch.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "VecDot.hpp"
+#include "SGEMM.hpp"
+#include "GEMM_AArch64.hpp"
+#include "quantize/QuantizeQ8.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#define MLLM_ARCH_X86
+#endif
+
+#ifdef MLLM_DYNAMIC_ARCH
+// the copies of the kernels, see MLLM_ARCHS in src/backends/cpu/CMakeLists.txt.
+#define MLLM_ARCH_DECLARE(arch, name, ret, params, args) ret MLLM_ARCH_NAME(name, arch) params;
+MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_DECLARE, generic)
+#ifdef MLLM_HAVE_ARCH_AVX2
+MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_DECLARE, avx2)
+#endif
+#ifdef MLLM_HAVE_ARCH_AVXVNNI
+MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_DECLARE, avxvnni)
+#endif
+#ifdef MLLM_HAVE_ARCH_AVX512
+MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_DECLARE, avx512)
+#endif
+#ifdef MLLM_HAVE_ARCH_AVX512VNNI
+MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_DECLARE, avx512vnni)
+#endif
+#undef MLLM_ARCH_DECLARE
+#endif
+
+namespace mllm {
+
+#ifdef MLLM_ARCH_X86
+static void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+    __cpuidex((int *)regs, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// the register state the OS saves on a context switch.
+static uint64_t xgetbv() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static CPUFeatures detect_cpu_features() {
+    CPUFeatures features;
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    const unsigned int max_leaf = regs[0];
+    if (max_leaf < 7) {
+        return features;
+    }
+    cpuid(1, 0, regs);
+    const bool osxsave = regs[2] & (1U << 27);
+    const bool avx = regs[2] & (1U << 28);
+    features.fma = regs[2] & (1U << 12);
+    features.f16c = regs[2] & (1U << 29);
+    // XMM and YMM state, then opmask and ZMM state.
+    const uint64_t xcr0 = osxsave ? xgetbv() : 0;
+    const bool os_avx = (xcr0 & 0x6) == 0x6;
+    const bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+    if (!avx || !os_avx) {
+        features.fma = features.f16c = false;
+        return features;
+    }
+    cpuid(7, 0, regs);
+    const unsigned int ebx = regs[1];
+    const unsigned int ecx = regs[2];
+    features.avx2 = ebx & (1U << 5);
+    features.avx512 = os_avx512 && (ebx & (1U << 16)) && (ebx & (1U << 17)) && (ebx & (1U << 30)) && (ebx & (1U << 31));
+    features.avx512_vnni = features.avx512 && (ecx & (1U << 11));
+    cpuid(7, 1, regs);
+    features.avx_vnni = features.avx2 && (regs[0] & (1U << 4));
+    return features;
+}
+#else
+static CPUFeatures detect_cpu_features() {
+    return CPUFeatures();
+}
+#endif
+
+const CPUFeatures &cpu_features() {
+    static const CPUFeatures features = detect_cpu_features();
+    return features;
+}
+
+#define MLLM_ARCH_POINTER(arch, name, ret, params, args) MLLM_ARCH_NAME(name, arch),
+
+#ifdef MLLM_DYNAMIC_ARCH
+static bool generic_supported(const CPUFeatures &) {
+    return true;
+}
+static bool avx2_supported(const CPUFeatures &f) {
+    return f.avx2 && f.fma && f.f16c;
+}
+static bool avxvnni_supported(const CPUFeatures &f) {
+    return avx2_supported(f) && f.avx_vnni;
+}
+static bool avx512_supported(const CPUFeatures &f) {
+    return f.avx512 && f.fma && f.f16c;
+}
+static bool avx512vnni_supported(const CPUFeatures &f) {
+    return avx512_supported(f) && f.avx512_vnni;
+}
+
+static const ArchKernels generic_kernels = {"generic", generic_supported, MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_POINTER, generic)};
+#ifdef MLLM_HAVE_ARCH_AVX2
+static const ArchKernels avx2_kernels = {"avx2", avx2_supported, MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_POINTER, avx2)};
+#endif
+#ifdef MLLM_HAVE_ARCH_AVXVNNI
+static const ArchKernels avxvnni_kernels = {"avxvnni", avxvnni_supported, MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_POINTER, avxvnni)};
+#endif
+#ifdef MLLM_HAVE_ARCH_AVX512
+static const ArchKernels avx512_kernels = {"avx512", avx512_supported, MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_POINTER, avx512)};
+#endif
+#ifdef MLLM_HAVE_ARCH_AVX512VNNI
+static const ArchKernels avx512vnni_kernels = {"avx512vnni", avx512vnni_supported, MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_POINTER, avx512vnni)};
+#endif
+
+// best first.
+static const ArchKernels *const all_kernels[] = {
+#ifdef MLLM_HAVE_ARCH_AVX512VNNI
+    &avx512vnni_kernels,
+#endif
+#ifdef MLLM_HAVE_ARCH_AVX512
+    &avx512_kernels,
+#endif
+#ifdef MLLM_HAVE_ARCH_AVXVNNI
+    &avxvnni_kernels,
+#endif
+#ifdef MLLM_HAVE_ARCH_AVX2
+    &avx2_kernels,
+#endif
+    &generic_kernels,
+};
+#else
+static bool native_supported(const CPUFeatures &) {
+    return true;
+}
+
+// the kernels compiled for the build host.
+static const ArchKernels native_kernels = {
+    "native",
+    native_supported,
+    vec_dot_fp32,
+    vec_dot_fp16,
+    vec_dot_q4_0_q8_0,
+    vec_dot_q4_K_q8_K,
+    vec_dot_q6_K_q8_K,
+    vec_dot_q8_0_q8_0,
+    quantize_row_q8_0,
+    llamafile_sgemm,
+    check_llamafile_sgemm,
+    mllm_gemv_q4_0_4x4_q8_0,
+    mllm_gemm_q4_0_4x4_q8_0,
+    mllm_gemv_q8_0_4x4_q8_0,
+    mllm_gemm_q8_0_4x4_q8_0,
+};
+static const ArchKernels *const all_kernels[] = {&native_kernels};
+#endif
+#undef MLLM_ARCH_POINTER
+
+const std::vector<const ArchKernels *> &arch_variants() {
+    static const std::vector<const ArchKernels *> variants = [] {
+        std::vector<const ArchKernels *> supported;
+        for (const auto *kernels : all_kernels) {
+            if (kernels->supported(cpu_features())) {
+                supported.push_back(kernels);
+            }
+        }
+        return supported;
+    }();
+    return variants;
+}
+
+static const ArchKernels &select_arch_kernels() {
+    const auto &variants = arch_variants();
+    const char *name = std::getenv("MLLM_CPU_ARCH");
+    if (name == nullptr || *name == '\0') {
+        return *variants.front();
+    }
+    for (const auto *kernels : variants) {
+        if (strcmp(kernels->name, name) == 0) {
+            return *kernels;
+        }
+    }
+    std::cerr << "[WARNING]: MLLM_CPU_ARCH=" << name << " is not built or not supported by this CPU, using "
+              << variants.front()->name << std::endl;
+    return *variants.front();
+}
+
+const ArchKernels &arch_kernels() {
+    static const ArchKernels &kernels = select_arch_kernels();
+    return kernels;
+}
+
+} // namespace mllm
+
+#ifdef MLLM_DYNAMIC_ARCH
+#define MLLM_ARCH_DISPATCH(arch, name, ret, params, args) \
+    ret name params {                                    \
+        return mllm::arch_kernels().name args;           \
+    }
+MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_DISPATCH, )
+#undef MLLM_ARCH_DISPATCH
+#endif
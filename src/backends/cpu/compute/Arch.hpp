@@ -0,0 +1,107 @@
+#ifndef MLLM_ARCH_HPP
+#define MLLM_ARCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Types.hpp"
+
+/*
+ * runtime selection of the x86 kernels.
+ *
+ * with DYNAMIC_ARCH (see src/backends/cpu/CMakeLists.txt) VecDot.cpp, SGEMM.cpp, QuantizeQ8.cpp and GEMM_AArch64.cpp
+ * are compiled once per ISA with MLLM_ARCH set to the name of the variant. Each copy of a kernel in
+ * MLLM_ARCH_KERNEL_LIST is named after its variant, vec_dot_fp32 becomes mllm_avx2_vec_dot_fp32, and Arch.cpp defines
+ * the plain names, which call the best variant the host supports. Without DYNAMIC_ARCH the kernels are compiled once,
+ * for the build host.
+ *
+ * the copies run only after the cpuid check, but their static initializers and inline functions do not. the headers
+ * they include must not define globals with dynamic initialization (see Chls2Type in Types.hpp).
+ */
+
+#define MLLM_ARCH_NAME_(name, arch) mllm_##arch##_##name
+#define MLLM_ARCH_NAME(name, arch) MLLM_ARCH_NAME_(name, arch)
+
+// X(arch, name, return type, parameters, arguments)
+#define MLLM_ARCH_KERNEL_LIST(X, arch) \
+    X(arch, vec_dot_fp32, void, (const int n, float *__restrict s, const float *__restrict vx, const float *__restrict vy), (n, s, vx, vy)) \
+    X(arch, vec_dot_fp16, void, (const int n, float *__restrict s, const mllm_fp16_t *__restrict vx, const mllm_fp16_t *__restrict vy), (n, s, vx, vy)) \
+    X(arch, vec_dot_q4_0_q8_0, void, (const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy), (n, s, vx, vy)) \
+    X(arch, vec_dot_q4_K_q8_K, void, (const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy), (n, s, vx, vy)) \
+    X(arch, vec_dot_q6_K_q8_K, void, (const int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy), (n, s, vx, vy)) \
+    X(arch, vec_dot_q8_0_q8_0, void, (int n, float *__restrict s, const void *__restrict vx, const void *__restrict vy), (n, s, vx, vy)) \
+    X(arch, quantize_row_q8_0, void, (const float *__restrict x, void *__restrict y, int k), (x, y, k)) \
+    X(arch, llamafile_sgemm, bool, \
+      (int64_t m, int64_t n, int64_t k, const void *A, int64_t lda, const void *B, int64_t ldb, void *C, int64_t ldc, \
+       int ith, int nth, DataType Atype, DataType Btype, DataType Ctype), \
+      (m, n, k, A, lda, B, ldb, C, ldc, ith, nth, Atype, Btype, Ctype)) \
+    X(arch, check_llamafile_sgemm, bool, \
+      (int64_t m, int64_t n, int64_t k, DataType Atype, DataType Btype, DataType Ctype), \
+      (m, n, k, Atype, Btype, Ctype)) \
+    MLLM_ARCH_GEMM(X, arch, mllm_gemv_q4_0_4x4_q8_0) \
+    MLLM_ARCH_GEMM(X, arch, mllm_gemm_q4_0_4x4_q8_0) \
+    MLLM_ARCH_GEMM(X, arch, mllm_gemv_q8_0_4x4_q8_0) \
+    MLLM_ARCH_GEMM(X, arch, mllm_gemm_q8_0_4x4_q8_0)
+// the gemv/gemm kernels of the interleaved types, see GEMM_AArch64.hpp.
+#define MLLM_ARCH_GEMM(X, arch, name) \
+    X(arch, name, void, (int n, float *__restrict s, size_t bs, const void *__restrict vx, const void *__restrict vy, int nr, int nc), \
+      (n, s, bs, vx, vy, nr, nc))
+
+#ifdef MLLM_ARCH
+// this is one of the per-ISA copies of the kernels.
+#define vec_dot_fp32 MLLM_ARCH_NAME(vec_dot_fp32, MLLM_ARCH)
+#define vec_dot_fp16 MLLM_ARCH_NAME(vec_dot_fp16, MLLM_ARCH)
+#define vec_dot_q4_0_q8_0 MLLM_ARCH_NAME(vec_dot_q4_0_q8_0, MLLM_ARCH)
+#define vec_dot_q4_K_q8_K MLLM_ARCH_NAME(vec_dot_q4_K_q8_K, MLLM_ARCH)
+#define vec_dot_q6_K_q8_K MLLM_ARCH_NAME(vec_dot_q6_K_q8_K, MLLM_ARCH)
+#define vec_dot_q8_0_q8_0 MLLM_ARCH_NAME(vec_dot_q8_0_q8_0, MLLM_ARCH)
+#define quantize_row_q8_0 MLLM_ARCH_NAME(quantize_row_q8_0, MLLM_ARCH)
+#define llamafile_sgemm MLLM_ARCH_NAME(llamafile_sgemm, MLLM_ARCH)
+#define check_llamafile_sgemm MLLM_ARCH_NAME(check_llamafile_sgemm, MLLM_ARCH)
+#define mllm_gemv_q4_0_4x4_q8_0 MLLM_ARCH_NAME(mllm_gemv_q4_0_4x4_q8_0, MLLM_ARCH)
+#define mllm_gemm_q4_0_4x4_q8_0 MLLM_ARCH_NAME(mllm_gemm_q4_0_4x4_q8_0, MLLM_ARCH)
+#define mllm_gemv_q8_0_4x4_q8_0 MLLM_ARCH_NAME(mllm_gemv_q8_0_4x4_q8_0, MLLM_ARCH)
+#define mllm_gemm_q8_0_4x4_q8_0 MLLM_ARCH_NAME(mllm_gemm_q8_0_4x4_q8_0, MLLM_ARCH)
+#else
+
+namespace mllm {
+
+struct CPUFeatures {
+    bool avx2 = false;
+    bool fma = false;
+    bool f16c = false;
+    bool avx_vnni = false;
+    // AVX-512 F, BW, DQ and VL
+    bool avx512 = false;
+    bool avx512_vnni = false;
+};
+
+/**
+ * \brief the ISA extensions of the host, from cpuid and the register state enabled by the OS.
+ */
+const CPUFeatures &cpu_features();
+
+#define MLLM_ARCH_FIELD(arch, name, ret, params, args) ret(*name) params;
+/**
+ * \brief one copy of the kernels in MLLM_ARCH_KERNEL_LIST.
+ */
+struct ArchKernels {
+    const char *name;
+    bool (*supported)(const CPUFeatures &);
+    MLLM_ARCH_KERNEL_LIST(MLLM_ARCH_FIELD, )
+};
+#undef MLLM_ARCH_FIELD
+
+/**
+ * \brief the variants built into this binary that the host can run, best first.
+ */
+const std::vector<const ArchKernels *> &arch_variants();
+/**
+ * \brief the variant in use. this is the best one, unless the MLLM_CPU_ARCH environment variable names another.
+ */
+const ArchKernels &arch_kernels();
+
+} // namespace mllm
+
+#endif // MLLM_ARCH
+#endif // MLLM_ARCH_HPP
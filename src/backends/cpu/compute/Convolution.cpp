@@ -3,6 +3,7 @@
 //
 
 #include "Convolution.hpp"
+#include "ThreadPool.hpp"
 
 float **reshape_conv2d_kernal_fp32(Tensor *kernel) {
     int in_channel = kernel->sequence();
@@ -62,8 +63,7 @@ void conv2d_fp32_VALID(Tensor *input, Tensor *output, float **k_new, int kernel_
             }
         }
 
-#pragma omp parallel for num_threads(thread_count)
-        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
+        parallel_for(0, out_channel, thread_count, [&](int out_ch) {
             for (int out_h = 0; out_h < out_height; ++out_h) {
                 for (int out_w = 0; out_w < out_width; ++out_w) {
                     // set value;
@@ -76,7 +76,7 @@ void conv2d_fp32_VALID(Tensor *input, Tensor *output, float **k_new, int kernel_
                     *output->ptrAt<float>(b, out_h, out_ch, out_w) = value;
                 }
             }
-        }
+        });
     }
 }
 
@@ -127,8 +127,7 @@ void conv2d_fp32_SAME(Tensor *input, Tensor *output, float **k_new, int kernel_h
                 }
             }
         }
-#pragma omp parallel for num_threads(thread_count)
-        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
+        parallel_for(0, out_channel, thread_count, [&](int out_ch) {
             for (int out_h = 0; out_h < out_height; ++out_h) {
                 for (int out_w = 0; out_w < out_width; ++out_w) {
                     float value = 0;
@@ -140,7 +139,7 @@ void conv2d_fp32_SAME(Tensor *input, Tensor *output, float **k_new, int kernel_h
                     *output->ptrAt<float>(b, out_h, out_ch, out_w) = value;
                 }
             }
-        }
+        });
     }
 }
 
@@ -212,8 +211,7 @@ void conv3d_fp32_VALID(Tensor *input, Tensor *output, float **k_new, int kernel_
             }
         }
 
-#pragma omp parallel for num_threads(thread_count)
-        for (int out_ch = 0; out_ch < out_channel; ++out_ch) {
+        parallel_for(0, out_channel, thread_count, [&](int out_ch) {
             for (int out_t = 0; out_t < out_time; ++out_t) {
                 for (int out_h = 0; out_h < out_height; ++out_h) {
                     for (int out_w = 0; out_w < out_width; ++out_w) {
@@ -227,6 +225,6 @@ void conv3d_fp32_VALID(Tensor *input, Tensor *output, float **k_new, int kernel_
                     }
                 }
             }
-        }
+        });
     }
 }
\ No newline at end of file
@@ -6,8 +6,11 @@
 #include <float.h>
 #include <stdlib.h> // for qsort
 #include <stdio.h>  // for assert
+#include <vector>
 
 
+// with DYNAMIC_ARCH the Q4_0_4_4 and Q8_0_4_4 kernels are built once per ISA (see Arch.hpp) and the rest once.
+#ifndef MLLM_ARCH
 int mllm_cpu_has_sve(void) {
 #if defined(__ARM_FEATURE_SVE)
     return 1;
@@ -24,6 +27,13 @@ int mllm_cpu_has_matmul_int8(void) {
 #endif
 }
 
+// roundf(), rounding halfway cases away from zero, without a branch or a call into libm. truncf() is one
+// instruction, the roundf() of libm is SSE code that runs many times slower after AVX-512 code in libc.
+static inline float round_away(float x) {
+    const float t = truncf(x);
+    return t + copysignf(fabsf(x - t) >= 0.5f ? 1.0f : 0.0f, x);
+}
+
 // Functions to create the interleaved data layout formats
 
 // interleave 4 block_q4_0s in blocks of blck_size_interleave
@@ -166,7 +176,7 @@ void quantize_q8_0_4x4(const float * __restrict x, void * __restrict vy, int64_t
             src_offset += (j % blck_size_interleave);
 
             float x0 = srcv[src_id][src_offset] * id[src_id];
-            y[i].qs[j] = roundf(x0);
+            y[i].qs[j] = round_away(x0);
         }
     }
 #endif
@@ -284,7 +294,7 @@ void quantize_q8_0_4x8(const float * __restrict x, void * __restrict vy, int64_t
             src_offset += (j % blck_size_interleave);
 
             float x0 = srcv[src_id][src_offset] * id[src_id];
-            y[i].qs[j] = roundf(x0);
+            y[i].qs[j] = round_away(x0);
         }
     }
 #endif
@@ -302,7 +312,7 @@ void quantize_mat_q8_0(const float * __restrict x, void * __restrict vy, int64_t
     }
 }
 
-static size_t quantize_q4_0_nr_bl(const float * __restrict src, void * __restrict dst, int64_t nrow, int64_t n_per_row, int nrows_interleaved, int blck_size_interleave) {
+static size_t quantize_q4_0_nr_bl(const float * __restrict src, void * __restrict dst, int64_t nrow, int64_t n_per_row, int nrows_interleaved, int blck_size_interleave, const float * quant_weights = nullptr) {
     assert(n_per_row % QK4_0 == 0);
     const int nb = n_per_row / QK4_0;
 
@@ -315,13 +325,23 @@ static size_t quantize_q4_0_nr_bl(const float * __restrict src, void * __restric
     }
     assert(nrows_interleaved <= 8);
     block_q4_0 dst_tmp[8];
+    // with an importance matrix, the blocks depend on their whole row: the rows are quantized first.
+    std::vector<block_q4_0> rows_tmp(quant_weights ? nrows_interleaved * nb : 0);
 
     for (int b = 0; b < (nrow * n_per_row); b += nrows_interleaved * n_per_row) {
 
+        if (quant_weights) {
+            quantize_q4_0(src + b, rows_tmp.data(), nrows_interleaved, n_per_row, quant_weights);
+        }
+
         for (int64_t x = 0; x < nb; x++) {
 
             for (int i  = 0; i < nrows_interleaved; i++ ) {
-                quantize_row_q4_0(src + b + i * n_per_row + x * QK4_0, (block_q4_0 *) dst_tmp + i, QK4_0);
+                if (quant_weights) {
+                    dst_tmp[i] = rows_tmp[i * nb + x];
+                } else {
+                    quantize_row_q4_0(src + b + i * n_per_row + x * QK4_0, (block_q4_0 *) dst_tmp + i, QK4_0);
+                }
             }
 
             if (nrows_interleaved == 8) {
@@ -339,35 +359,67 @@ static size_t quantize_q4_0_nr_bl(const float * __restrict src, void * __restric
 }
 
 size_t quantize_q4_0_4x4(const float * __restrict src, void * __restrict dst, int64_t nrow, int64_t n_per_row, const float * quant_weights) {
-    if (!quant_weights) {
-        return quantize_q4_0_nr_bl(src, dst, nrow, n_per_row, 4, 4);
-    }
-    else {
-        assert(false);
-        return 0;
-    }
+    return quantize_q4_0_nr_bl(src, dst, nrow, n_per_row, 4, 4, quant_weights);
 }
 
 size_t quantize_q4_0_4x8(const float * __restrict src, void * __restrict dst, int64_t nrow, int64_t n_per_row, const float * quant_weights) {
-    if (!quant_weights) {
-        return quantize_q4_0_nr_bl(src, dst, nrow, n_per_row, 4, 8);
-    }
-    else {
-        assert(false);
-        return 0;
-    }
+    return quantize_q4_0_nr_bl(src, dst, nrow, n_per_row, 4, 8, quant_weights);
 }
 
 size_t quantize_q4_0_8x8(const float * __restrict src, void * __restrict dst, int64_t nrow, int64_t n_per_row, const float * quant_weights) {
-    if (!quant_weights) {
-        return quantize_q4_0_nr_bl(src, dst, nrow, n_per_row, 8, 8);
-    }
-    else {
-        assert(false);
-        return 0;
+    return quantize_q4_0_nr_bl(src, dst, nrow, n_per_row, 8, 8, quant_weights);
+}
+
+#endif
+
+#if defined(MLLM_ARCH) || !defined(MLLM_DYNAMIC_ARCH)
+#if defined(__AVX2__)
+// acc + the sums of 4 adjacent products of the unsigned bytes u and the signed bytes s, per int32 lane.
+static inline __m256i mul_add_us8_quads(const __m256i acc, const __m256i u, const __m256i s) {
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+    return _mm256_dpbusd_epi32(acc, u, s);
+#elif defined(__AVXVNNI__)
+    return _mm256_dpbusd_avx_epi32(acc, u, s);
+#else
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(u, s), _mm256_set1_epi16(1)));
+#endif
+}
+
+// same for two signed byte vectors.
+static inline __m256i mul_add_i8_quads(const __m256i acc, const __m256i x, const __m256i y) {
+    return mul_add_us8_quads(acc, _mm256_sign_epi8(x, x), _mm256_sign_epi8(y, x));
+}
+
+// lanes 0-3 + lanes 4-7: the two interleaved chunks of 4 bytes of each of the 4 rows.
+static inline __m128i sum_chunk_pairs(const __m256i x) {
+    return _mm_add_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+}
+
+static inline __m128 load_fp16x4(const mllm_fp16_t *d) {
+    return _mm_setr_ps(MLLM_FP16_TO_FP32(d[0]), MLLM_FP16_TO_FP32(d[1]), MLLM_FP16_TO_FP32(d[2]), MLLM_FP16_TO_FP32(d[3]));
+}
+
+// a dword of 4 quants for each of the 4 interleaved rows, from the chunks of 4 quants p and q of x.
+static inline __m256i broadcast_chunks(const __m256i x, int p, int q) {
+    return _mm256_permutevar8x32_epi32(x, _mm256_setr_epi32(p, p, p, p, q, q, q, q));
+}
+
+// the sum of each block of the activations, for the offset of 8 of the q4_0 nibbles.
+static inline int sum_q8_0(const int8_t *qs, int stride, int offset) {
+    int sum = 0;
+    for (int c = 0; c < QK8_0 / 4; c++) {
+        for (int i = 0; i < 4; i++) {
+            sum += qs[c * stride + offset + i];
+        }
     }
+    return sum;
 }
 
+// the block sums of the activations of one call stay on the stack up to this many blocks, i.e. rows of 131072 values
+// in gemv and of 32768 in gemm (which sums 4 rows at once), longer rows fall back to the heap.
+static constexpr int MAX_STACK_SUMS = 4096;
+#endif
+
 void mllm_gemv_q4_0_4x4_q8_0(int n, float * __restrict s, size_t bs, const void * __restrict vx, const void * __restrict vy, int nr, int nc) {
     const int qk = QK8_0;
     const int nb = n / qk;
@@ -453,6 +505,35 @@ void mllm_gemv_q4_0_4x4_q8_0(int n, float * __restrict s, size_t bs, const void
         : [a_ptr] "r" (a_ptr), [nb] "r" (nb)
         : "memory", "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31", "x20", "x21", "x22"
     );
+#elif defined(__AVX2__)
+    const block_q8_0 * a_ptr = (const block_q8_0 *) vy;
+    int stack_sums[MAX_STACK_SUMS];
+    std::vector<int> heap_sums(nb > MAX_STACK_SUMS ? nb : 0);
+    int *a_sums = nb > MAX_STACK_SUMS ? heap_sums.data() : stack_sums;
+    for (int l = 0; l < nb; l++) {
+        a_sums[l] = sum_q8_0(a_ptr[l].qs, 4, 0);
+    }
+    const __m256i m4b = _mm256_set1_epi8(0x0F);
+    const __m256i xor_mask = _mm256_set1_epi8((char)0x88);
+    for (int x = 0; x < nc / ncols_interleaved; x++) {
+        const block_q4_0x4 * b_ptr = (const block_q4_0x4 *) vx + (x * nb);
+        __m128 acc = _mm_setzero_ps();
+        for (int l = 0; l < nb; l++) {
+            const __m256i a = _mm256_loadu_si256((const __m256i *) a_ptr[l].qs);
+            // the nibbles back in the 0..15 range of q4_0, quants 0-7 | 16-23 and 8-15 | 24-31 of the 4 rows
+            const __m256i b0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) b_ptr[l].qs), xor_mask);
+            const __m256i b1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (b_ptr[l].qs + 32)), xor_mask);
+            __m256i sumi = _mm256_setzero_si256();
+            sumi = mul_add_us8_quads(sumi, _mm256_and_si256(b0, m4b), broadcast_chunks(a, 0, 1));
+            sumi = mul_add_us8_quads(sumi, _mm256_and_si256(b1, m4b), broadcast_chunks(a, 2, 3));
+            sumi = mul_add_us8_quads(sumi, _mm256_and_si256(_mm256_srli_epi16(b0, 4), m4b), broadcast_chunks(a, 4, 5));
+            sumi = mul_add_us8_quads(sumi, _mm256_and_si256(_mm256_srli_epi16(b1, 4), m4b), broadcast_chunks(a, 6, 7));
+            const __m128i sum4 = _mm_sub_epi32(sum_chunk_pairs(sumi), _mm_set1_epi32(8 * a_sums[l]));
+            const __m128 d = _mm_mul_ps(load_fp16x4(b_ptr[l].d), _mm_set1_ps(MLLM_FP16_TO_FP32(a_ptr[l].d)));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(sum4), d));
+        }
+        _mm_storeu_ps(s + x * ncols_interleaved, acc);
+    }
 #else
     float sumf[4];
     int sumi;
@@ -480,6 +561,61 @@ void mllm_gemv_q4_0_4x4_q8_0(int n, float * __restrict s, size_t bs, const void
 #endif
 }
 
+void mllm_gemv_q8_0_4x4_q8_0(int n, float * __restrict s, size_t bs, const void * __restrict vx, const void * __restrict vy, int nr, int nc) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+    const int ncols_interleaved = 4;
+    const int blocklen = 4;
+
+    assert (n % qk == 0);
+    assert (nc % ncols_interleaved == 0);
+
+    (void)bs;
+    (void)nr;
+
+    const block_q8_0 * a_ptr = (const block_q8_0 *) vy;
+#if defined(__AVX2__)
+    for (int x = 0; x < nc / ncols_interleaved; x++) {
+        const block_q8_0x4 * b_ptr = (const block_q8_0x4 *) vx + (x * nb);
+        __m128 acc = _mm_setzero_ps();
+        for (int l = 0; l < nb; l++) {
+            const __m256i a = _mm256_loadu_si256((const __m256i *) a_ptr[l].qs);
+            __m256i sumi = _mm256_setzero_si256();
+            for (int i = 0; i < 4; i++) {
+                const __m256i b = _mm256_loadu_si256((const __m256i *) (b_ptr[l].qs + 32 * i));
+                sumi = mul_add_i8_quads(sumi, b, broadcast_chunks(a, 2 * i, 2 * i + 1));
+            }
+            const __m128 d = _mm_mul_ps(load_fp16x4(b_ptr[l].d), _mm_set1_ps(MLLM_FP16_TO_FP32(a_ptr[l].d)));
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(sum_chunk_pairs(sumi)), d));
+        }
+        _mm_storeu_ps(s + x * ncols_interleaved, acc);
+    }
+#else
+    float sumf[4];
+    int sumi;
+
+    for (int x = 0; x < nc / ncols_interleaved; x++) {
+        const block_q8_0x4 * b_ptr = (const block_q8_0x4 *) vx + (x * nb);
+
+        for (int j = 0; j < ncols_interleaved; j++) sumf[j] = 0.0;
+        for (int l = 0; l < nb; l++) {
+            for (int j = 0; j < ncols_interleaved; j++) {
+                sumi = 0;
+                for (int k = 0; k < (qk / blocklen); k++) {
+                    for (int i = 0; i < blocklen; ++i) {
+                        sumi += b_ptr[l].qs[k * ncols_interleaved * blocklen + j * blocklen + i] * a_ptr[l].qs[k * blocklen + i];
+                    }
+                }
+                sumf[j] += sumi * MLLM_FP16_TO_FP32(b_ptr[l].d[j]) * MLLM_FP16_TO_FP32(a_ptr[l].d);
+            }
+        }
+        for (int j = 0; j < ncols_interleaved; j++) s[x * ncols_interleaved + j] = sumf[j];
+    }
+#endif
+}
+#endif
+
+#ifndef MLLM_ARCH
 void mllm_gemv_q4_0_4x8_q8_0(int n, float * __restrict s, size_t bs, const void * __restrict vx, const void * __restrict vy, int nr, int nc) {
     const int qk = QK8_0;
     const int nb = n / qk;
@@ -728,6 +864,8 @@ void mllm_gemv_q4_0_8x8_q8_0(int n, float * __restrict s, size_t bs, const void
 #endif
 }
 
+#endif
+#if defined(MLLM_ARCH) || !defined(MLLM_DYNAMIC_ARCH)
 void mllm_gemm_q4_0_4x4_q8_0(int n, float * __restrict s, size_t bs, const void * __restrict vx, const void * __restrict vy, int nr, int nc) {
     const int qk = QK8_0;
     const int nb = n / qk;
@@ -1213,6 +1351,45 @@ void mllm_gemm_q4_0_4x4_q8_0(int n, float * __restrict s, size_t bs, const void
         : [b_ptr] "r" (b_ptr), [nr] "r" (nr), [nb] "r" (nb), [res_stride] "r" (res_stride), [nc] "r" (nc)
         : "cc", "memory", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15", "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31", "x9", "x10", "x20", "x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28"
     );
+#elif defined(__AVX2__)
+    int stack_sums[MAX_STACK_SUMS];
+    std::vector<int> heap_sums(nb * 4 > MAX_STACK_SUMS ? nb * 4 : 0);
+    int *a_sums = nb * 4 > MAX_STACK_SUMS ? heap_sums.data() : stack_sums;
+    const __m256i m4b = _mm256_set1_epi8(0x0F);
+    const __m256i xor_mask = _mm256_set1_epi8((char)0x88);
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+        for (int l = 0; l < nb; l++) {
+            for (int m = 0; m < 4; m++) {
+                a_sums[l * 4 + m] = sum_q8_0(a_ptr[l].qs, 16, m * 4);
+            }
+        }
+        for (int x = 0; x < nc / ncols_interleaved; x++) {
+            const block_q4_0x4 * b_ptr = (const block_q4_0x4 *) vx + (x * nb);
+            __m128 acc[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+            for (int l = 0; l < nb; l++) {
+                const __m256i b0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) b_ptr[l].qs), xor_mask);
+                const __m256i b1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (b_ptr[l].qs + 32)), xor_mask);
+                // quants 0-7, 8-15, 16-23 and 24-31
+                const __m256i b[4] = {_mm256_and_si256(b0, m4b), _mm256_and_si256(b1, m4b),
+                                      _mm256_and_si256(_mm256_srli_epi16(b0, 4), m4b), _mm256_and_si256(_mm256_srli_epi16(b1, 4), m4b)};
+                const __m128 db = load_fp16x4(b_ptr[l].d);
+                for (int m = 0; m < 4; m++) {
+                    __m256i sumi = _mm256_setzero_si256();
+                    for (int i = 0; i < 4; i++) {
+                        const __m256i a = _mm256_loadu_si256((const __m256i *) (a_ptr[l].qs + 32 * i));
+                        sumi = mul_add_us8_quads(sumi, b[i], broadcast_chunks(a, m, m + 4));
+                    }
+                    const __m128i sum4 = _mm_sub_epi32(sum_chunk_pairs(sumi), _mm_set1_epi32(8 * a_sums[l * 4 + m]));
+                    const __m128 d = _mm_mul_ps(db, _mm_set1_ps(MLLM_FP16_TO_FP32(a_ptr[l].d[m])));
+                    acc[m] = _mm_add_ps(acc[m], _mm_mul_ps(_mm_cvtepi32_ps(sum4), d));
+                }
+            }
+            for (int m = 0; m < 4; m++) {
+                _mm_storeu_ps(s + (y * 4 + m) * bs + x * ncols_interleaved, acc[m]);
+            }
+        }
+    }
 #else
     float sumf[4][4];
     int sumi;
@@ -1249,6 +1426,79 @@ void mllm_gemm_q4_0_4x4_q8_0(int n, float * __restrict s, size_t bs, const void
 #endif
 }
 
+void mllm_gemm_q8_0_4x4_q8_0(int n, float * __restrict s, size_t bs, const void * __restrict vx, const void * __restrict vy, int nr, int nc) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+    const int ncols_interleaved = 4;
+    const int blocklen = 4;
+
+    assert (n % qk == 0);
+    assert (nr % 4 == 0);
+    assert (nc % ncols_interleaved == 0);
+
+#if defined(__AVX2__)
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+        for (int x = 0; x < nc / ncols_interleaved; x++) {
+            const block_q8_0x4 * b_ptr = (const block_q8_0x4 *) vx + (x * nb);
+            __m128 acc[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+            for (int l = 0; l < nb; l++) {
+                __m256i a[4], b[4];
+                for (int i = 0; i < 4; i++) {
+                    a[i] = _mm256_loadu_si256((const __m256i *) (a_ptr[l].qs + 32 * i));
+                    b[i] = _mm256_loadu_si256((const __m256i *) (b_ptr[l].qs + 32 * i));
+                }
+                const __m128 db = load_fp16x4(b_ptr[l].d);
+                for (int m = 0; m < 4; m++) {
+                    __m256i sumi = _mm256_setzero_si256();
+                    for (int i = 0; i < 4; i++) {
+                        sumi = mul_add_i8_quads(sumi, b[i], broadcast_chunks(a[i], m, m + 4));
+                    }
+                    const __m128 d = _mm_mul_ps(db, _mm_set1_ps(MLLM_FP16_TO_FP32(a_ptr[l].d[m])));
+                    acc[m] = _mm_add_ps(acc[m], _mm_mul_ps(_mm_cvtepi32_ps(sum_chunk_pairs(sumi)), d));
+                }
+            }
+            for (int m = 0; m < 4; m++) {
+                _mm_storeu_ps(s + (y * 4 + m) * bs + x * ncols_interleaved, acc[m]);
+            }
+        }
+    }
+#else
+    float sumf[4][4];
+    int sumi;
+
+    for (int y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+        for (int x = 0; x < nc / ncols_interleaved; x++) {
+            const block_q8_0x4 * b_ptr = (const block_q8_0x4 *) vx + (x * nb);
+            for (int m = 0; m < 4; m++) {
+                for (int j = 0; j < ncols_interleaved; j++) sumf[m][j] = 0.0;
+            }
+            for (int l = 0; l < nb; l++) {
+                for (int m = 0; m < 4; m++) {
+                    for (int j = 0; j < ncols_interleaved; j++) {
+                        sumi = 0;
+                        for (int k = 0; k < (qk / blocklen); k++) {
+                            for (int i = 0; i < blocklen; ++i) {
+                                sumi += b_ptr[l].qs[k * ncols_interleaved * blocklen + j * blocklen + i] *
+                                        a_ptr[l].qs[k * 4 * blocklen + m * blocklen + i];
+                            }
+                        }
+                        sumf[m][j] += sumi * MLLM_FP16_TO_FP32(b_ptr[l].d[j]) * MLLM_FP16_TO_FP32(a_ptr[l].d[m]);
+                    }
+                }
+            }
+            for (int m = 0; m < 4; m++) {
+                for (int j = 0; j < ncols_interleaved; j++)
+                    s[(y * 4 + m) * bs + x * ncols_interleaved + j] = sumf[m][j];
+            }
+        }
+    }
+#endif
+}
+#endif
+
+#ifndef MLLM_ARCH
 void mllm_gemm_q4_0_4x8_q8_0(int n, float * __restrict s, size_t bs, const void * __restrict vx, const void * __restrict vy, int nr, int nc) {
     const int qk = QK8_0;
     const int nb = n / qk;
@@ -2199,13 +2449,20 @@ void mllm_gemm_q4_0_8x8_q8_0(int n, float * __restrict s, size_t bs, const void
 
 void quantize_row_q4_0_4x4(const float * __restrict x, void * __restrict y, int k){   
     assert(k%QK4_0 == 0); 
-    std::cout<<"Quantize 4x4:"<<k<<"/4096="<<k/4096;
     auto size = quantize_q4_0_nr_bl(x, y, k/4096, 4096, 4, 4);
 }
 
 
 void quantize_row_q4_0_4x4(const float * __restrict x, void * __restrict y, int k, int raw){   
     assert(k%QK4_0 == 0); 
-    std::cout<<"Quantize 4x4:"<<k<<"/"<<raw<<"="<<k/raw;
     auto size = quantize_q4_0_nr_bl(x, y, k/raw, raw, 4, 4);
-}
\ No newline at end of file
+}
+
+void quantize_row_q8_0_4x4(const float * __restrict x, void * __restrict y, int k, int raw) {
+    assert(raw % QK8_0 == 0);
+    assert(k % (4 * raw) == 0);
+    for (int r = 0; r < k / raw; r += 4) {
+        quantize_q8_0_4x4(x + r * raw, (block_q8_0x4 *) y + r / 4 * (raw / QK8_0), raw);
+    }
+}
+#endif
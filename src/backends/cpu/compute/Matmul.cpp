@@ -7,6 +7,7 @@
 #include "VecDotType.hpp"
 #include <pthread.h>
 #include "SGEMM.hpp"
+#include "ThreadPool.hpp"
 
 #define ASSERT(x) \
     do { \
@@ -67,12 +68,11 @@ ErrorCode sparse_mat_mul_id(Tensor *x, Tensor *W, Tensor *ids, Tensor *dst, int
         auto row_size_dst = row_size(vec_dot_type, to->dimension());
         auto n_row = x->batch() * x->head() * x->sequence();
         auto n_ele = x->dimension();
-#pragma omp parallel for num_threads(thread_count)
-        for(int i = 0;i < n_row;i++){ // copy row by row
+        parallel_for(0, n_row, thread_count, [&](int i) { // copy row by row
             auto row1 = (char *)row_src + i * row_size_src;
             auto row2 = (char *)row_dst + i * row_size_dst;
             x_to_vec_dot_type(reinterpret_cast<const float *>(row1), row2, n_ele);
-        }
+        });
         x = to.get();
         x_dtype = vec_dot_type;
     }
@@ -89,27 +89,25 @@ ErrorCode sparse_mat_mul_id(Tensor *x, Tensor *W, Tensor *ids, Tensor *dst, int
             auto x_row = (char *)x->rawHostPtr() + x->offset(b,h,0,0) * x_type_size / x_blck_size;
             auto b_W = b % B_W;
             auto h_W = h % H_W;
-            for(int m = 0;m < M;m++){
-#pragma omp parallel for num_threads(thread_count)
-                for(int x_block=0; x_block < N; x_block += blck) {
-                    for (int n = x_block; n < x_block + blck && n < N; n++) {
-                        // predictor says that there is no need to calculate this position
-                        if (ids->dataAt<float>(b, h, m, n) <= 0.0) {
-                            dst->setDataAt<float>(b, h, m, n, 0.0);
-                            continue;
-                        }
+            parallel_for_2d(M, (N + blck - 1) / blck, thread_count, [&](int m, int block) {
+                const auto x_row_m = x_row + m * x_row_offset;
+                const int x_block = block * blck;
+                for (int n = x_block; n < x_block + blck && n < N; n++) {
+                    // predictor says that there is no need to calculate this position
+                    if (ids->dataAt<float>(b, h, m, n) <= 0.0) {
+                        dst->setDataAt<float>(b, h, m, n, 0.0);
+                        continue;
+                    }
 
-                        float tmp;
+                    float tmp;
 
-                        vec_dot(K,
-                                &tmp,
-                                (char *)W->rawHostPtr() + W->offset(b_W, h_W, n, 0) * w_type_size / w_blck_size, // cannot calc W_row like x_row, cause b_W,h_W may not be contiguous
-                                x_row);
-                        dst->setDataAt<float>(b, h, m, n, tmp); // it seems that currently activation can only be fp32
-                    }
+                    vec_dot(K,
+                            &tmp,
+                            (char *)W->rawHostPtr() + W->offset(b_W, h_W, n, 0) * w_type_size / w_blck_size, // cannot calc W_row like x_row, cause b_W,h_W may not be contiguous
+                            x_row_m);
+                    dst->setDataAt<float>(b, h, m, n, tmp); // it seems that currently activation can only be fp32
                 }
-                x_row = x_row + x_row_offset;
-            }
+            });
 
         }
     }
@@ -148,8 +146,7 @@ ErrorCode mat_mul_sparse(Tensor *x, Tensor *W, Tensor *dst, int thread_count){
         for(int h = 0; h < H; h ++){
             auto b_W = b % B_W;
             auto h_W = h % H_W;
-#pragma omp parallel for num_threads(thread_count) // can not put above for(int n = 0;n < N;n++). that will cause accessing dst line n at the same time
-            for(int m = 0; m < M;m++){
+            parallel_for(0, M, thread_count, [&](int m) { // can not put above for(int n = 0;n < N;n++). that will cause accessing dst line n at the same time
                 auto fill_row = dst->hostPtr<float>() + dst->offset(b,h,m,0);
                 memset(fill_row,
                        0,
@@ -163,7 +160,7 @@ ErrorCode mat_mul_sparse(Tensor *x, Tensor *W, Tensor *dst, int thread_count){
                                    alpha);
                     }
                 }
-            }
+            });
 
         }
     }
@@ -198,24 +195,19 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
         const int ld_src0 = src0->sequence_skip_dim();
         const int ld_dst = dst->sequence_skip_dim();
         int is_0 = (src1->batch() == 1 && src1->head() == 1&&src1->batch()!=src0->batch()) ? 0 : 1;
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int64_t b = 0; b < dst->batch(); b++){
-            for (int64_t h = 0; h < dst->head(); h++){
-                for (int id = 0; id < thread_count; id++){
-                    llamafile_sgemm(N, M, K/blck_size(src0->dtype()),
-                                    (char *)src1->rawHostPtr() + src1->offset(b*is_0, h*is_0, 0, 0) * src1_type_size / src1_blck_size,
-                                    ld_src1 / src1_blck_size,
-                                    (char *)src0->rawHostPtr() + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
-                                    ld_src0/ src0_blck_size,
-                                    (char *)dst->rawHostPtr() + dst->offset(b, h, 0, 0) * type_size(dst->dtype()) / blck_size(dst->dtype()),
-                                    ld_dst/blck_size(dst->dtype()),
-                                    id, thread_count,
-                                    src1->dtype(),
-                                    src0->dtype(),
-                                    dst->dtype());
-                }
-            }
-        }
+        parallel_for_3d(dst->batch(), dst->head(), thread_count, thread_count, [&](int b, int h, int id) {
+            llamafile_sgemm(N, M, K/blck_size(src0->dtype()),
+                            (char *)src1->rawHostPtr() + src1->offset(b*is_0, h*is_0, 0, 0) * src1_type_size / src1_blck_size,
+                            ld_src1 / src1_blck_size,
+                            (char *)src0->rawHostPtr() + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
+                            ld_src0/ src0_blck_size,
+                            (char *)dst->rawHostPtr() + dst->offset(b, h, 0, 0) * type_size(dst->dtype()) / blck_size(dst->dtype()),
+                            ld_dst/blck_size(dst->dtype()),
+                            id, thread_count,
+                            src1->dtype(),
+                            src0->dtype(),
+                            dst->dtype());
+        });
         return MLLM_NO_ERROR;
     }
 #endif
@@ -231,28 +223,21 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
         to->alloc();
         int64_t i_processed = 0;
         if (from_float_to_mat && gemv && dst->masterTensor()==nullptr){
-            for (int b = 0; b < src0->batch(); b++) {
-                for (int h = 0; h < src0->head(); h++) {
-#pragma omp parallel for collapse(1) num_threads(thread_count)
-                    for (int64_t s = 0; s < src0->sequence() - src0->sequence() % 4; s += 4) {
-                            from_float_to_mat(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
-                                            (char *)to->rawHostPtr() + to->offset(b, h, s, 0) * type_size(to->dtype()) / blck_size(to->dtype()),
-                                            4, src0->dimension(), blck_size_interleave);
-                    }
-                    i_processed = src0->sequence() - src0->sequence() % 4;
-                }
-            }
-        }
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int b = 0; b < src0->batch(); b++) {
-            for (int h = 0; h < src0->head(); h++) {
-                for (int s = i_processed; s < src0->sequence(); s++) {
-                    x_to_vec_dot_type(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
-                                      (char *)to->rawHostPtr() + to->offset(b, h, s, 0) * type_size(to->dtype()) / blck_size(to->dtype()),
-                                      src0->dimension());
-                }
-            }
+            // groups of 4 rows.
+            parallel_for_3d(src0->batch(), src0->head(), src0->sequence() / 4, thread_count, [&](int b, int h, int group) {
+                const int64_t s = group * 4;
+                from_float_to_mat(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
+                                  (char *)to->rawHostPtr() + to->offset(b, h, s, 0) * type_size(to->dtype()) / blck_size(to->dtype()),
+                                  4, src0->dimension(), blck_size_interleave);
+            });
+            i_processed = src0->sequence() - src0->sequence() % 4;
         }
+        parallel_for_3d(src0->batch(), src0->head(), src0->sequence() - i_processed, thread_count, [&](int b, int h, int i) {
+            const int s = i_processed + i;
+            x_to_vec_dot_type(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
+                              (char *)to->rawHostPtr() + to->offset(b, h, s, 0) * type_size(to->dtype()) / blck_size(to->dtype()),
+                              src0->dimension());
+        });
         src0 = to.get();
         src0_dtype = src0->dtype();
         src0_type_size = type_size(src0->dtype());
@@ -264,35 +249,23 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
         const int ld_src1 = src1->sequence_skip_dim();
         const int ld_src0 = src0->sequence_skip_dim();
         const int ld_dst = dst->sequence_skip_dim();
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int64_t b = 0; b < dst->batch(); b++){
-            for (int64_t h = 0; h < dst->head(); h++){
-                for (int id = 0; id < thread_count; id++){
-                    llamafile_sgemm(N, M, K/blck_size(src1->dtype()),
-                                    (char *)src1->rawHostPtr() + src1->offset(b, h, 0, 0) * src1_type_size / src1_blck_size,
-                                    ld_src1 / src1_blck_size,
-                                    (char *)src0->rawHostPtr() + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
-                                    ld_src0/ src0_blck_size,
-                                    (char *)dst->rawHostPtr() + dst->offset(b, h, 0, 0) * type_size(dst->dtype()) / blck_size(dst->dtype()),
-                                    ld_dst/blck_size(dst->dtype()),
-                                    id, thread_count,
-                                    src1->dtype(),
-                                    src0->dtype(),
-                                    dst->dtype());
-                }
-            }
-        }
+        parallel_for_3d(dst->batch(), dst->head(), thread_count, thread_count, [&](int b, int h, int id) {
+            llamafile_sgemm(N, M, K/blck_size(src1->dtype()),
+                            (char *)src1->rawHostPtr() + src1->offset(b, h, 0, 0) * src1_type_size / src1_blck_size,
+                            ld_src1 / src1_blck_size,
+                            (char *)src0->rawHostPtr() + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
+                            ld_src0/ src0_blck_size,
+                            (char *)dst->rawHostPtr() + dst->offset(b, h, 0, 0) * type_size(dst->dtype()) / blck_size(dst->dtype()),
+                            ld_dst/blck_size(dst->dtype()),
+                            id, thread_count,
+                            src1->dtype(),
+                            src0->dtype(),
+                            dst->dtype());
+        });
         if(support_bias){
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-            for (int b = 0; b < dst->batch(); b++) {
-                for (int h = 0; h < dst->head(); h++) {
-                    for (int m = 0; m < M; m++) {
-                        for (int n = 0;  n < N; n++) {
-                            *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
-                            }
-                    }
-                }
-            }
+            parallel_for_4d(dst->batch(), dst->head(), M, N, thread_count, [&](int b, int h, int m, int n) {
+                *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
+            });
         }
         return MLLM_NO_ERROR;
     }
@@ -300,8 +273,7 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
 
     if(gemv&&dst->dtypeAt(0,0,0,0) == MLLM_TYPE_F32){
         int nth=thread_count;
-#pragma omp parallel for collapse(1) num_threads(thread_count)
-        for (int ith = 0; ith < nth; ith++){
+        parallel_for(0, nth, thread_count, [&](int ith) {
             int64_t i_processed = 0;
             int64_t seq_start = (ith * N) / nth;
             int64_t seq_end   = ((ith + 1) * N) / nth;
@@ -317,18 +289,11 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
                     (char *)src0->rawHostPtr() + src0->offset(0, 0, iter, 0) * src0_type_size / src0_blck_size,
                     1,  N/nth);
             }
-        }
+        });
         if(support_bias){
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-            for (int b = 0; b < dst->batch(); b++) {
-                for (int h = 0; h < dst->head(); h++) {
-                    for (int m = 0; m < M; m++) {
-                        for (int n = 0;  n < N; n++) {
-                            *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
-                            }
-                    }
-                }
-            }
+            parallel_for_4d(dst->batch(), dst->head(), M, N, thread_count, [&](int b, int h, int m, int n) {
+                *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
+            });
         }
         return MLLM_NO_ERROR;
     }
@@ -337,42 +302,35 @@ ErrorCode mat_mul(Tensor *src0, Tensor *src1, Tensor *dst, bool support_bias, Te
     Tensor *src1_cal = src1;
     const int64_t blck_0 = 16;
     int is_0 = (src1->batch() == 1 && src1->head() == 1&&src1->batch()!=src0->batch()) ? 0 : 1;
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int b = 0; b < src0->batch(); b++) {
-        for (int h = 0; h < src0->head(); h++) {
-            for (int m = 0; m < M; m++) {
-                for (int block = 0; block < N / blck_0 + 1; block++) {
-                    for (int n = block * blck_0; n < (block + 1) * blck_0 & n < N; n++) {
-                        int s_1, d_1;
-                        int s_0, d_0;
-                        if (!transpose0 && transpose1) {
-                            s_1 = n; d_1 = 0; s_0 = m; d_0 = 0;
-                        } else if (!transpose0 && !transpose1) {
-                            s_1 = 0; d_1 = n; s_0 = m; d_0 = 0;
-                        } else {
-                            s_1 = 0; d_1 = n; s_0 = 0; d_0 = m;
-                        }
-                        float tmp = 0;
-                        vec_dot(K, &tmp,
-                                (char *)src1_cal->rawHostPtr() + src1_cal->offset(b*is_0, h*is_0, s_1, d_1) * src1_type_size / src1_blck_size,
-                                (char *)src0_cal->rawHostPtr() + src0_cal->offset(b, h, s_0, d_0) * src0_type_size / src0_blck_size);
-                        if(dst->dtypeAt(b,h,m,n) == MLLM_TYPE_F32) {
-                            dst->setDataAt<float>(b, h, m, n, tmp);
-                            if (support_bias) {
-                                *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
-                            }
-                        }else if(dst->dtypeAt(b,h,m,n) == MLLM_TYPE_F16) {
-                            if (support_bias) {
-                                *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp + bias->dataAt<float>(0, 0, 0, n));
-                            } else {
-                                *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp);
-                            }
-                        }else{std::cout<<"Not support type [Matmul]"<<std::endl;}
-                    }
-                }
+    parallel_for_4d(src0->batch(), src0->head(), M, N / blck_0 + 1, thread_count, [&](int b, int h, int m, int block) {
+        for (int n = block * blck_0; n < (block + 1) * blck_0 & n < N; n++) {
+            int s_1, d_1;
+            int s_0, d_0;
+            if (!transpose0 && transpose1) {
+                s_1 = n; d_1 = 0; s_0 = m; d_0 = 0;
+            } else if (!transpose0 && !transpose1) {
+                s_1 = 0; d_1 = n; s_0 = m; d_0 = 0;
+            } else {
+                s_1 = 0; d_1 = n; s_0 = 0; d_0 = m;
             }
+            float tmp = 0;
+            vec_dot(K, &tmp,
+                    (char *)src1_cal->rawHostPtr() + src1_cal->offset(b*is_0, h*is_0, s_1, d_1) * src1_type_size / src1_blck_size,
+                    (char *)src0_cal->rawHostPtr() + src0_cal->offset(b, h, s_0, d_0) * src0_type_size / src0_blck_size);
+            if(dst->dtypeAt(b,h,m,n) == MLLM_TYPE_F32) {
+                dst->setDataAt<float>(b, h, m, n, tmp);
+                if (support_bias) {
+                    *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
+                }
+            }else if(dst->dtypeAt(b,h,m,n) == MLLM_TYPE_F16) {
+                if (support_bias) {
+                    *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp + bias->dataAt<float>(0, 0, 0, n));
+                } else {
+                    *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp);
+                }
+            }else{std::cout<<"Not support type [Matmul]"<<std::endl;}
         }
-    }
+    });
     return MLLM_NO_ERROR;
 }
 /*
@@ -693,24 +651,19 @@ ErrorCode mat_mul_elastic(Tensor *src0, Tensor *src1, Tensor *dst, bool support_
         const int ld_src0 = src0->sequence_skip_dim();
         const int ld_dst = dst->sequence_skip_dim();
         int is_0 = (src1->batch() == 1 && src1->head() == 1) ? 0 : 1;
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int64_t b = 0; b < dst->batch(); b++){
-            for (int64_t h = 0; h < dst->head(); h++){
-                for (int id = 0; id < thread_count; id++){
-                    llamafile_sgemm(use_N, M, use_K/blck_size(src0->dtype()),
-                                    (char *)src1->rawHostPtr() + src1->offset(b*is_0, h*is_0, 0, 0) * src1_type_size / src1_blck_size,
-                                    ld_src1,
-                                    (char *)src0->rawHostPtr() + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
-                                    ld_src0,
-                                    (char *)dst->rawHostPtr() + dst->offset(b, h, 0, 0) * type_size(dst->dtype()) / blck_size(dst->dtype()),
-                                    ld_dst,
-                                    id, thread_count,
-                                    src1->dtype(),
-                                    src0->dtype(),
-                                    dst->dtype());
-                }
-            }
-        }
+        parallel_for_3d(dst->batch(), dst->head(), thread_count, thread_count, [&](int b, int h, int id) {
+            llamafile_sgemm(use_N, M, use_K/blck_size(src0->dtype()),
+                            (char *)src1->rawHostPtr() + src1->offset(b*is_0, h*is_0, 0, 0) * src1_type_size / src1_blck_size,
+                            ld_src1,
+                            (char *)src0->rawHostPtr() + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
+                            ld_src0,
+                            (char *)dst->rawHostPtr() + dst->offset(b, h, 0, 0) * type_size(dst->dtype()) / blck_size(dst->dtype()),
+                            ld_dst,
+                            id, thread_count,
+                            src1->dtype(),
+                            src0->dtype(),
+                            dst->dtype());
+        });
         return MLLM_NO_ERROR;
     }
 
@@ -726,28 +679,21 @@ ErrorCode mat_mul_elastic(Tensor *src0, Tensor *src1, Tensor *dst, bool support_
         to->alloc();
         int64_t i_processed = 0;
         if (from_float_to_mat && gemv && dst->masterTensor()==nullptr){
-            for (int b = 0; b < src0->batch(); b++) {
-                for (int h = 0; h < src0->head(); h++) {
-#pragma omp parallel for collapse(1) num_threads(thread_count)
-                    for (int64_t s = 0; s < src0->sequence() - src0->sequence() % 4; s += 4) {
-                            from_float_to_mat(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
-                                            (char *)to->rawHostPtr() + to->offset(b, h, s, 0) * type_size(to->dtype()) / blck_size(to->dtype()),
-                                            4, src0->dimension(), blck_size_interleave);
-                    }
-                    i_processed = src0->sequence() - src0->sequence() % 4;
-                }
-            }
-        }
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int b = 0; b < src0->batch(); b++) {
-            for (int h = 0; h < src0->head(); h++) {
-                for (int s = i_processed; s < src0->sequence(); s++) {
-                    x_to_vec_dot_type(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
-                                      (char *)to->rawHostPtr() + to->offset(b, h, s, 0) * type_size(to->dtype()) / blck_size(to->dtype()),
-                                      src0->dimension());
-                }
-            }
+            // groups of 4 rows.
+            parallel_for_3d(src0->batch(), src0->head(), src0->sequence() / 4, thread_count, [&](int b, int h, int group) {
+                const int64_t s = group * 4;
+                from_float_to_mat(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
+                                  (char *)to->rawHostPtr() + to->offset(b, h, s, 0) * type_size(to->dtype()) / blck_size(to->dtype()),
+                                  4, src0->dimension(), blck_size_interleave);
+            });
+            i_processed = src0->sequence() - src0->sequence() % 4;
         }
+        parallel_for_3d(src0->batch(), src0->head(), src0->sequence() - i_processed, thread_count, [&](int b, int h, int i) {
+            const int s = i_processed + i;
+            x_to_vec_dot_type(src0->hostPtr<float>() + src0->offset(b, h, s, 0),
+                              (char *)to->rawHostPtr() + to->offset(b, h, s, 0) * type_size(to->dtype()) / blck_size(to->dtype()),
+                              src0->dimension());
+        });
         src0 = to.get();
         src0_dtype = src0->dtype();
         src0_type_size = type_size(src0->dtype());
@@ -759,32 +705,26 @@ ErrorCode mat_mul_elastic(Tensor *src0, Tensor *src1, Tensor *dst, bool support_
         const int ld_src1 = src1->sequence_skip_dim();
         const int ld_src0 = src0->sequence_skip_dim();
         const int ld_dst = dst->sequence_skip_dim();
-#pragma omp parallel for collapse(3) num_threads(thread_count)
-        for (int64_t b = 0; b < dst->batch(); b++){
-            for (int64_t h = 0; h < dst->head(); h++){
-                for (int id = 0; id < thread_count; id++){
-                    llamafile_sgemm(use_N, M, use_K/blck_size(src1->dtype()),
-                                    (char *)src1->rawHostPtr() + src1->offset(b, h, 0, 0) * src1_type_size / src1_blck_size,
-                                    ld_src1 / src1_blck_size,
-                                    (char *)src0->rawHostPtr() + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
-                                    ld_src0/ src0_blck_size,
-                                    (char *)dst->rawHostPtr() + dst->offset(b, h, 0, 0) * type_size(dst->dtype()) / blck_size(dst->dtype()),
-                                    ld_dst/blck_size(dst->dtype()),
-                                    id, thread_count,
-                                    src1->dtype(),
-                                    src0->dtype(),
-                                    dst->dtype());
-                }
-            }
-        }
+        parallel_for_3d(dst->batch(), dst->head(), thread_count, thread_count, [&](int b, int h, int id) {
+            llamafile_sgemm(use_N, M, use_K/blck_size(src1->dtype()),
+                            (char *)src1->rawHostPtr() + src1->offset(b, h, 0, 0) * src1_type_size / src1_blck_size,
+                            ld_src1 / src1_blck_size,
+                            (char *)src0->rawHostPtr() + src0->offset(b, h, 0, 0) * src0_type_size / src0_blck_size,
+                            ld_src0/ src0_blck_size,
+                            (char *)dst->rawHostPtr() + dst->offset(b, h, 0, 0) * type_size(dst->dtype()) / blck_size(dst->dtype()),
+                            ld_dst/blck_size(dst->dtype()),
+                            id, thread_count,
+                            src1->dtype(),
+                            src0->dtype(),
+                            dst->dtype());
+        });
         return MLLM_NO_ERROR;
     }
 #endif
 
     if(gemv&&!support_bias){
         int nth=thread_count;
-#pragma omp parallel for collapse(1) num_threads(thread_count)
-        for (int ith = 0; ith < nth; ith++){
+        parallel_for(0, nth, thread_count, [&](int ith) {
             int64_t i_processed = 0;
             int64_t seq_start = (ith * use_N) / nth;
             int64_t seq_end   = ((ith + 1) * use_N) / nth;
@@ -800,7 +740,7 @@ ErrorCode mat_mul_elastic(Tensor *src0, Tensor *src1, Tensor *dst, bool support_
                     (char *)src0->rawHostPtr() + src0->offset(0, 0, iter, 0) * src0_type_size / src0_blck_size,
                     1,  use_N/nth);
             }
-        }
+        });
         return MLLM_NO_ERROR;
     }
 
@@ -809,41 +749,34 @@ ErrorCode mat_mul_elastic(Tensor *src0, Tensor *src1, Tensor *dst, bool support_
     Tensor *src1_cal = src1;
     const int64_t blck_0 = 16;
     int is_0 = (src1->batch() == 1 && src1->head() == 1) ? 0 : 1;
-#pragma omp parallel for collapse(4) num_threads(thread_count)
-    for (int b = 0; b < src0->batch(); b++) {
-        for (int h = 0; h < src0->head(); h++) {
-            for (int m = 0; m < M; m++) {
-                for (int block = 0; block < use_N / blck_0 + 1; block++) {
-                    for (int n = block * blck_0; n < (block + 1) * blck_0 & n < use_N; n++) {
-                        int s_1, d_1;
-                        int s_0, d_0;
-                        if (!transpose0 && transpose1) {
-                            s_1 = n; d_1 = 0; s_0 = m; d_0 = 0;
-                        } else if (!transpose0 && !transpose1) {
-                            s_1 = 0; d_1 = n; s_0 = m; d_0 = 0;
-                        } else {
-                            s_1 = 0; d_1 = n; s_0 = 0; d_0 = m;
-                        }
-                        float tmp = 0;
-                        vec_dot(use_K, &tmp,
-                                (char *)src1_cal->rawHostPtr() + src1_cal->offset(b*is_0, h*is_0, s_1, d_1) * src1_type_size / src1_blck_size,
-                                (char *)src0_cal->rawHostPtr() + src0_cal->offset(b, h, s_0, d_0) * src0_type_size / src0_blck_size);
-                        if(dst->dtypeAt(b,h,m,n) == MLLM_TYPE_F32) {
-                            dst->setDataAt<float>(b, h, m, n, tmp);
-                            if (support_bias) {
-                                *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
-                            }
-                        }else if(dst->dtypeAt(b,h,m,n) == MLLM_TYPE_F16) {
-                            if (support_bias) {
-                                *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp + bias->dataAt<float>(0, 0, 0, n));
-                            } else {
-                                *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp);
-                            }
-                        }else{std::cout<<"Not support type [Matmul]"<<std::endl;}
-                    }
-                }
+    parallel_for_4d(src0->batch(), src0->head(), M, use_N / blck_0 + 1, thread_count, [&](int b, int h, int m, int block) {
+        for (int n = block * blck_0; n < (block + 1) * blck_0 & n < use_N; n++) {
+            int s_1, d_1;
+            int s_0, d_0;
+            if (!transpose0 && transpose1) {
+                s_1 = n; d_1 = 0; s_0 = m; d_0 = 0;
+            } else if (!transpose0 && !transpose1) {
+                s_1 = 0; d_1 = n; s_0 = m; d_0 = 0;
+            } else {
+                s_1 = 0; d_1 = n; s_0 = 0; d_0 = m;
             }
+            float tmp = 0;
+            vec_dot(use_K, &tmp,
+                    (char *)src1_cal->rawHostPtr() + src1_cal->offset(b*is_0, h*is_0, s_1, d_1) * src1_type_size / src1_blck_size,
+                    (char *)src0_cal->rawHostPtr() + src0_cal->offset(b, h, s_0, d_0) * src0_type_size / src0_blck_size);
+            if(dst->dtypeAt(b,h,m,n) == MLLM_TYPE_F32) {
+                dst->setDataAt<float>(b, h, m, n, tmp);
+                if (support_bias) {
+                    *dst->ptrAt<float>(b, h, m, n) += bias->dataAt<float>(0, 0, 0, n);
+                }
+            }else if(dst->dtypeAt(b,h,m,n) == MLLM_TYPE_F16) {
+                if (support_bias) {
+                    *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp + bias->dataAt<float>(0, 0, 0, n));
+                } else {
+                    *dst->ptrAt<mllm_fp16_t>(b, h, m, n) = MLLM_FP32_TO_FP16(tmp);
+                }
+            }else{std::cout<<"Not support type [Matmul]"<<std::endl;}
         }
-    }
+    });
     return MLLM_NO_ERROR;
 }
\ No newline at end of file
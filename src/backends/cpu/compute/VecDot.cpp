@@ -95,26 +95,15 @@ void vec_dot_fp32(const int n, float *__restrict s, const float *__restrict vx,
     vec_dot_fp32_avx2(n, s, vx, vy);
 #elif defined(__ARM_NEON)
     vec_dot_fp32_arm(n, s, vx, vy);
-#endif
-}
-/*
-void vec_dot_fp32(const float * __restrict src0, const float * __restrict src1, Tensor *dst, bool support_bias, Tensor *bias, int hid_len, int batch, int head, int src0_inf, int sec1_outf) {
-    float value = 0;
-#ifdef __AVX2__
-    vec_dot_fp32_avx2(hid_len, &value, src1, src0);
-#elif defined(__ARM_NEON)
-    vec_dot_fp32_arm(hid_len, &value, src1, src0);
 #else
-    for (int k = 0; k < hid_len; k++) {
-        value += src0[k]* src1[k];
+    float sumf = 0.0F;
+    for (int i = 0; i < n; ++i) {
+        sumf += vx[i] * vy[i];
     }
+    *s = sumf;
 #endif
-    if (support_bias) {
-        value += bias->dataAt<float>(0, head, 0, sec1_outf);
-    }
-    dst->setDataAt<float>({batch, head, src0_inf, sec1_outf}, value);
 }
-*/
+
 void vec_dot_fp16(const int n, float * __restrict s, const mllm_fp16_t * __restrict vx, const mllm_fp16_t * __restrict vy) {
     float sumf = 0.0;
 
@@ -268,19 +257,27 @@ void vec_dot_q4_0_q8_0(const int n, float * __restrict s, const void * __restric
     vec_dot_q4_0_q8_0_avx(n, s, vx, vy);
 #elif defined(__ARM_NEON)
     vec_dot_q4_0_q8_0_arm(n, s, vx, vy);
-#endif
-}
-void vec_dot_q4_0_q8_0(const void * __restrict src0, const void * __restrict src1, Tensor *dst, bool support_bias, Tensor *bias, int hid_len, int batch, int head, int src0_inf, int sec1_outf) {
-    float value = 0;
-#ifdef __AVX2__
-    vec_dot_q4_0_q8_0_avx(hid_len, &value, src1, src0);
-#elif defined(__ARM_NEON)
-    vec_dot_q4_0_q8_0_arm(hid_len, &value, src1, src0);
-#endif
-    if (support_bias) {
-        value += bias->dataAt<float>(0, head, 0, sec1_outf);
+#else
+    const int qk = QK8_0;
+    const int nb = n / qk;
+
+    assert(n % qk == 0);
+
+    const block_q4_0 *__restrict x = (block_q4_0 *)vx;
+    const block_q8_0 *__restrict y = (block_q8_0 *)vy;
+
+    float sumf = 0.0F;
+    for (int i = 0; i < nb; i++) {
+        int sumi = 0;
+        for (int j = 0; j < qk / 2; ++j) {
+            const int v0 = (x[i].qs[j] & 0x0F) - 8;
+            const int v1 = (x[i].qs[j] >> 4) - 8;
+            sumi += (v0 * y[i].qs[j]) + (v1 * y[i].qs[j + qk / 2]);
+        }
+        sumf += sumi * MLLM_FP16_TO_FP32(x[i].d) * MLLM_FP16_TO_FP32(y[i].d);
     }
-    dst->setDataAt<float>({batch, head, src0_inf, sec1_outf}, value);
+    *s = sumf;
+#endif
 }
 
 #if QK_K == 256
@@ -676,13 +673,6 @@ void vec_dot_q4_K_q8_K(const int n, float * __restrict s, const void * __restric
 }
 #endif
 
-void vec_dot_q4_K_q8_K(const void * __restrict src0, const void * __restrict src1, Tensor *dst, bool support_bias, Tensor *bias, int hid_len, int batch, int head, int src0_inf, int sec1_outf) {
-    float value = 0;
-    vec_dot_q4_K_q8_K(hid_len, dst->ptrAt<float>(batch, head, src0_inf, sec1_outf), src1, src0);
-    if (support_bias) {
-        dst->setDataAt<float>({batch, head, src0_inf, sec1_outf}, dst->dataAt<float>(batch, head, src0_inf, sec1_outf)+ bias->dataAt<float>(0, head, 0, sec1_outf));
-    }
-}
 
 
 
@@ -1334,16 +1324,6 @@ void vec_dot_q6_K_q8_K(const int n, float * __restrict s, const void * __restric
 #endif
 
 
-void vec_dot_q6_K_q8_K(const void * __restrict src0, const void * __restrict src1, Tensor *dst, bool support_bias, Tensor *bias, int hid_len, int batch, int head, int src0_inf, int sec1_outf) {
-    float value = 0;
-
-    vec_dot_q6_K_q8_K(hid_len, &value, src1, src0);
-
-    if (support_bias) {
-        value += bias->dataAt<float>(0, head, 0, sec1_outf);
-    }
-    dst->setDataAt<float>({batch, head, src0_inf, sec1_outf}, value);
-}
 
 
 
@@ -1411,5 +1391,15 @@ void vec_dot_q8_0_q8_0(int n, float * __restrict s, const void * __restrict vx,
     }
 
     *s = hsum_float_8(acc);
+#else
+    float sumf = 0.0F;
+    for (int i = 0; i < nb; i++) {
+        int sumi = 0;
+        for (int j = 0; j < qk; ++j) {
+            sumi += x[i].qs[j] * y[i].qs[j];
+        }
+        sumf += sumi * MLLM_FP16_TO_FP32(x[i].d) * MLLM_FP16_TO_FP32(y[i].d);
+    }
+    *s = sumf;
 #endif
 }
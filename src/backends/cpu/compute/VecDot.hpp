@@ -31,6 +31,7 @@
 #include "Types.hpp"
 #include <functional>
 #include "ParamLoader.hpp"
+#include "Arch.hpp"
 #include "../quantize/QuantizeQ8.hpp"
 #include "../quantize/QuantizeQ4.hpp"
 
@@ -308,6 +309,20 @@ static inline float hsum_float_8(const __m256 x) {
     res = _mm_add_ss(res, _mm_movehdup_ps(res));
     return _mm_cvtss_f32(res);
 }
+#else
+// scalar, e.g. the generic copy of the kernels of a DYNAMIC_ARCH build.
+#define MLLM_F32_STEP 1
+#define MLLM_F32_EPR 1
+#define MLLM_F32_ARR 1
+#define MLLM_F32_VEC float
+#define MLLM_F32_VEC_ZERO 0.0F
+#define MLLM_F32_VEC_SET1(x) (x)
+#define MLLM_F32_VEC_LOAD(p) (*(p))
+#define MLLM_F32_VEC_STORE(p, r) (*(p) = (r))
+#define MLLM_F32_VEC_FMA(a, b, c) ((a) + (b) * (c))
+#define MLLM_F32_VEC_ADD(a, b) ((a) + (b))
+#define MLLM_F32_VEC_MUL(a, b) ((a) * (b))
+#define MLLM_F32_VEC_REDUCE(res, x) (res) = (x)[0]
 #endif
 
 #ifdef __ARM_NEON
@@ -382,12 +397,7 @@ inline static void vec_scale_f32(const int n, float *y, const float v) {
     //    }
 }
 
-// void vec_dot_fp32(const float * __restrict src0, const float * __restrict src1, Tensor *dst, bool support_bias, Tensor *bias, int hid_len, int batch, int head, int src0_inf, int sec1_outf);
-void vec_dot_q4_0_q8_0(const void * __restrict src0, const void * __restrict src1, Tensor *dst, bool support_bias, Tensor *bias, int hid_len, int batch, int head, int src0_inf, int sec1_outf);
-void vec_dot_q4_K_q8_K(const void * __restrict src0, const void * __restrict src1, Tensor *dst, bool support_bias, Tensor *bias, int hid_len, int batch, int head, int src0_inf, int sec1_outf);
-void vec_dot_q6_K_q8_K(const void * __restrict src0, const void * __restrict src1, Tensor *dst, bool support_bias, Tensor *bias, int hid_len, int batch, int head, int src0_inf, int sec1_outf);
-
-
+// the kernels below are built once per ISA with DYNAMIC_ARCH, see Arch.hpp.
 void vec_dot_q4_K_q8_K(const int n, float * __restrict s, const void * __restrict vx, const void * __restrict vy);
 void vec_dot_q6_K_q8_K(const int n, float * __restrict s, const void * __restrict vx, const void * __restrict vy);
 void vec_dot_q4_0_q8_0(const int n, float * __restrict s, const void * __restrict vx, const void * __restrict vy);
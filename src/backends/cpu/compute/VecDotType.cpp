@@ -80,7 +80,12 @@ void fp_16_add_row_to(int n, const mllm_fp16_t * MLLM_RESTRICT src, float * MLLM
         _mm256_storeu_ps(dst + i, res_vec); // store back to dst
     }
 #elif defined(__ARM_NEON)
-    std::cout<<"not support now"<<std::endl;
+    float32x4_t alpha_vec = vdupq_n_f32(alpha);
+    for (; i <= n - 4; i += 4) {
+        float32x4_t src_vec = vcvt_f32_f16(vld1_f16((const __fp16 *)(src + i)));
+        float32x4_t dst_vec = vld1q_f32(dst + i);
+        vst1q_f32(dst + i, vfmaq_f32(dst_vec, src_vec, alpha_vec));
+    }
 #endif
 
     // 处理剩余的元素
@@ -339,6 +344,33 @@ type_traits_t type_traits[] = {
         .gemv                     = (mllm_gemv_func)mllm_gemv_q4_0_8x8_q8_0,
         .gemm                     = (mllm_gemv_func)mllm_gemm_q4_0_8x8_q8_0,
     },
-    {},
+    /*[MLLM_TYPE_Q8_0_4_4] = */{
+        .size                = sizeof(block_q8_0),
+        .blck_size                = QK8_0,
+        .blck_size_interleave     = 4,
+        .to_float                 = NULL,
+        .from_float               = NULL,
+        .vec_dot                  = NULL,
+        .vec_dot_type             = MLLM_TYPE_Q8_0,
+        .gemv                     = (mllm_gemv_func)mllm_gemv_q8_0_4x4_q8_0,
+        .gemm                     = (mllm_gemm_func)mllm_gemm_q8_0_4x4_q8_0,
+    },
     // TODO: add support to more type
 };
+
+// with DYNAMIC_ARCH the kernels above dispatch on every call (see Arch.cpp), use the selected copies directly.
+static const bool type_traits_arch = [] {
+    const auto &arch = mllm::arch_kernels();
+    type_traits[MLLM_TYPE_F32].vec_dot = (mllm_vec_dot_func)arch.vec_dot_fp32;
+    type_traits[MLLM_TYPE_F16].vec_dot = (mllm_vec_dot_func)arch.vec_dot_fp16;
+    type_traits[MLLM_TYPE_Q4_0].vec_dot = (mllm_vec_dot_func)arch.vec_dot_q4_0_q8_0;
+    type_traits[MLLM_TYPE_Q8_0].from_float = (mllm_from_float_func)arch.quantize_row_q8_0;
+    type_traits[MLLM_TYPE_Q8_0].vec_dot = (mllm_vec_dot_func)arch.vec_dot_q8_0_q8_0;
+    type_traits[MLLM_TYPE_Q4_K].vec_dot = (mllm_vec_dot_func)arch.vec_dot_q4_K_q8_K;
+    type_traits[MLLM_TYPE_Q6_K].vec_dot = (mllm_vec_dot_func)arch.vec_dot_q6_K_q8_K;
+    type_traits[MLLM_TYPE_Q4_0_4_4].gemv = (mllm_gemv_func)arch.mllm_gemv_q4_0_4x4_q8_0;
+    type_traits[MLLM_TYPE_Q4_0_4_4].gemm = (mllm_gemm_func)arch.mllm_gemm_q4_0_4x4_q8_0;
+    type_traits[MLLM_TYPE_Q8_0_4_4].gemv = (mllm_gemv_func)arch.mllm_gemv_q8_0_4x4_q8_0;
+    type_traits[MLLM_TYPE_Q8_0_4_4].gemm = (mllm_gemm_func)arch.mllm_gemm_q8_0_4x4_q8_0;
+    return true;
+}();
@@ -34,7 +34,6 @@
 #include <string.h>
 #include <iostream>
 #include "Types.hpp"
-#include <omp.h>
 
 // #if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
 // #include <x86intrin.h>
@@ -104,7 +103,7 @@ inline static float lookup_fp16_to_fp32(uint16_t f) {
 #define MLLM_FP16_TO_FP32(x) lookup_fp16_to_fp32(x)
 #define MLLM_FP32_TO_FP16(x) MLLM_COMPUTE_FP32_TO_FP16(x)
 
-#else
+#elif defined(__F16C__)
 #define MLLM_COMPUTE_FP16_TO_FP32(x) _cvtsh_ss(x)
 #define MLLM_COMPUTE_FP32_TO_FP16(x) _cvtss_sh(x, 0)
 
@@ -126,6 +125,83 @@ inline static float lookup_fp16_to_fp32(uint16_t f) {
     return table_f32_f16[s];
 }
 
+#define MLLM_FP16_TO_FP32(x) lookup_fp16_to_fp32(x)
+#define MLLM_FP32_TO_FP16(x) MLLM_COMPUTE_FP32_TO_FP16(x)
+
+#else
+// no F16C, e.g. the baseline of a DYNAMIC_ARCH build: convert with integer arithmetic, as ggml does.
+inline static float fp32_from_bits(uint32_t w) {
+    float f;
+    memcpy(&f, &w, sizeof(f));
+    return f;
+}
+
+inline static uint32_t fp32_to_bits(float f) {
+    uint32_t w;
+    memcpy(&w, &f, sizeof(w));
+    return w;
+}
+
+inline static float compute_fp16_to_fp32(uint16_t h) {
+    const uint32_t w = (uint32_t)h << 16;
+    const uint32_t sign = w & UINT32_C(0x80000000);
+    const uint32_t two_w = w + w;
+
+    const uint32_t exp_offset = UINT32_C(0xE0) << 23;
+    const float exp_scale = 0x1.0p-112F;
+    const float normalized_value = fp32_from_bits((two_w >> 4) + exp_offset) * exp_scale;
+
+    const uint32_t magic_mask = UINT32_C(126) << 23;
+    const float magic_bias = 0.5F;
+    const float denormalized_value = fp32_from_bits((two_w >> 17) | magic_mask) - magic_bias;
+
+    const uint32_t denormalized_cutoff = UINT32_C(1) << 27;
+    const uint32_t result = sign | (two_w < denormalized_cutoff ? fp32_to_bits(denormalized_value) : fp32_to_bits(normalized_value));
+    return fp32_from_bits(result);
+}
+
+inline static uint16_t compute_fp32_to_fp16(float f) {
+    const float scale_to_inf = 0x1.0p+112F;
+    const float scale_to_zero = 0x1.0p-110F;
+    float base = (fabsf(f) * scale_to_inf) * scale_to_zero;
+
+    const uint32_t w = fp32_to_bits(f);
+    const uint32_t shl1_w = w + w;
+    const uint32_t sign = w & UINT32_C(0x80000000);
+    uint32_t bias = shl1_w & UINT32_C(0xFF000000);
+    if (bias < UINT32_C(0x71000000)) {
+        bias = UINT32_C(0x71000000);
+    }
+
+    base = fp32_from_bits((bias >> 1) + UINT32_C(0x07800000)) + base;
+    const uint32_t bits = fp32_to_bits(base);
+    const uint32_t exp_bits = (bits >> 13) & UINT32_C(0x00007C00);
+    const uint32_t mantissa_bits = bits & UINT32_C(0x00000FFF);
+    const uint32_t nonsign = exp_bits + mantissa_bits;
+    return (sign >> 16) | (shl1_w > UINT32_C(0xFF000000) ? UINT16_C(0x7E00) : nonsign);
+}
+
+#define MLLM_COMPUTE_FP16_TO_FP32(x) compute_fp16_to_fp32(x)
+#define MLLM_COMPUTE_FP32_TO_FP16(x) compute_fp32_to_fp16(x)
+
+static float table_f32_f16[1 << 16];
+static bool table_f32_f16_init = false;
+
+inline static float lookup_fp16_to_fp32(uint16_t f) {
+    if (!table_f32_f16_init) {
+        uint16_t ii;
+        for (int i = 0; i < (1 << 16); ++i) {
+            uint16_t ui = i;
+            memcpy(&ii, &ui, sizeof(ii));
+            table_f32_f16[i] = MLLM_COMPUTE_FP16_TO_FP32(ii);
+        }
+        table_f32_f16_init = true;
+    }
+    uint16_t s;
+    memcpy(&s, &f, sizeof(uint16_t));
+    return table_f32_f16[s];
+}
+
 #define MLLM_FP16_TO_FP32(x) lookup_fp16_to_fp32(x)
 #define MLLM_FP32_TO_FP16(x) MLLM_COMPUTE_FP32_TO_FP16(x)
 #endif
@@ -274,7 +350,8 @@ static inline int nearest_int(float fval) {
     return (i & 0x007fffff) - 0x00400000;
 }
 
-static float make_qx_quants(int n, int nmax, const float * __restrict x, int8_t * __restrict L, int rmse_type) {
+// qw, if given, weigh the squared errors of x (e.g. an importance matrix), otherwise x[i]^2 for an odd rmse_type.
+static float make_qx_quants(int n, int nmax, const float * __restrict x, int8_t * __restrict L, int rmse_type, const float * __restrict qw = nullptr) {
     float max = 0;
     float amax = 0;
     for (int i = 0; i < n; ++i) {
@@ -307,7 +384,7 @@ static float make_qx_quants(int n, int nmax, const float * __restrict x, int8_t
         int l = nearest_int(iscale * x[i]);
         l = MAX(-nmax, MIN(nmax-1, l));
         L[i] = l + nmax;
-        float w = weight_type == 1 ? x[i] * x[i] : 1;
+        float w = qw ? qw[i] : weight_type == 1 ? x[i] * x[i] : 1;
         sumlx += w*x[i]*l;
         suml2 += w*l*l;
     }
@@ -323,7 +400,7 @@ static float make_qx_quants(int n, int nmax, const float * __restrict x, int8_t
         for (int i = 0; i < n; ++i) {
             int l = nearest_int(iscale * x[i]);
             l = MAX(-nmax, MIN(nmax-1, l));
-            float w = weight_type == 1 ? x[i] * x[i] : 1;
+            float w = qw ? qw[i] : weight_type == 1 ? x[i] * x[i] : 1;
             sumlx += w*x[i]*l;
             suml2 += w*l*l;
         }
@@ -344,21 +421,21 @@ static float make_qx_quants(int n, int nmax, const float * __restrict x, int8_t
 // FP32_FP16
 
 
-inline mllm_fp16_t mllm_fp32_to_fp16(float x) {
+inline static mllm_fp16_t mllm_fp32_to_fp16(float x) {
     return MLLM_FP32_TO_FP16(x);
 }
 
-inline float mllm_fp16_to_fp32(mllm_fp16_t x) {
+inline static float mllm_fp16_to_fp32(mllm_fp16_t x) {
     return (float) MLLM_FP16_TO_FP32(x);
 }
 
-inline void mllm_fp16_to_fp32_row(const mllm_fp16_t *x, float *y, int n) {
+inline static void mllm_fp16_to_fp32_row(const mllm_fp16_t *x, float *y, int n) {
     for (int i = 0; i < n; i++) {
         y[i] = MLLM_FP16_TO_FP32(x[i]);
     }
 }
 
-inline void mllm_fp32_to_fp16_row(const float *x, mllm_fp16_t *y, int n) {
+inline static void mllm_fp32_to_fp16_row(const float *x, mllm_fp16_t *y, int n) {
     int i = 0;
 #if defined(__F16C__)
     for (; i + 7 < n; i += 8) {
@@ -71,6 +71,44 @@ void quantize_row_q4_0(const float * __restrict x, void * __restrict y, int k) {
     quantize_row_q4_0_reference(x, (block_q4_0 *)y, k);
 }
 
+// a row of n_per_row, the squared error of x[j] weighed by quant_weights[j] * sqrt(sigma2 + x[j]^2).
+static void quantize_row_q4_0_impl(const float * __restrict x, block_q4_0 * __restrict y, int64_t n_per_row, const float * __restrict quant_weights) {
+    float weight[QK4_0];
+    int8_t L[QK4_0];
+
+    float sum_x2 = 0;
+    for (int j = 0; j < n_per_row; ++j) sum_x2 += x[j]*x[j];
+    float sigma2 = sum_x2/n_per_row;
+
+    const int64_t nb = n_per_row/QK4_0;
+    for (int ib = 0; ib < nb; ++ib) {
+        const float * xb = x + QK4_0 * ib;
+        const float * qw = quant_weights + QK4_0 * ib;
+        for (int j = 0; j < QK4_0; ++j) weight[j] = qw[j] * sqrtf(sigma2 + xb[j]*xb[j]);
+        float d = make_qx_quants(QK4_0, 8, xb, L, 1, weight);
+        y[ib].d = MLLM_FP32_TO_FP16(d);
+        for (int j = 0; j < QK4_0/2; ++j) {
+            y[ib].qs[j] = L[j] | (L[j + QK4_0/2] << 4);
+        }
+    }
+}
+
+size_t quantize_q4_0(const float * __restrict src, void * __restrict dst, int64_t nrow, int64_t n_per_row, const float * quant_weights) {
+    assert(n_per_row % QK4_0 == 0);
+    const size_t row_size = n_per_row / QK4_0 * sizeof(block_q4_0);
+    if (!quant_weights) {
+        quantize_row_q4_0(src, dst, nrow * n_per_row);
+        return nrow * row_size;
+    }
+    char * qrow = (char *)dst;
+    for (int64_t row = 0; row < nrow; ++row) {
+        quantize_row_q4_0_impl(src, (block_q4_0 *)qrow, n_per_row, quant_weights);
+        src += n_per_row;
+        qrow += row_size;
+    }
+    return nrow * row_size;
+}
+
 void dequantize_row_q4_0(const void * __restrict vx, float * __restrict y, int k) {
     static const int Qk = QK4_0;
 
@@ -184,6 +222,78 @@ static inline void get_scale_min_k4(int j, const uint8_t * __restrict q, uint8_t
 }
 #endif
 
+// the scales of the sub-blocks of a super-block, quantized to [0, nmax] for the squared errors weighed by quant_weights.
+static float make_qp_quants(int n, int nmax, const float * __restrict x, uint8_t * __restrict L, const float * quant_weights) {
+    float max = 0;
+    for (int i = 0; i < n; ++i) {
+        max = MAX(max, x[i]);
+    }
+    if (!max) { // all zero
+        for (int i = 0; i < n; ++i) { L[i] = 0; }
+        return 0.F;
+    }
+    float iscale = nmax / max;
+    for (int i = 0; i < n; ++i) {
+        L[i] = nearest_int(iscale * x[i]);
+    }
+    float scale = 1/iscale;
+    float best_mse = 0;
+    for (int i = 0; i < n; ++i) {
+        float diff = x[i] - scale*L[i];
+        float w = quant_weights[i];
+        best_mse += w*diff*diff;
+    }
+    for (int is = -4; is <= 4; ++is) {
+        if (is == 0) continue;
+        float iscale_is = (0.1F*is + nmax)/max;
+        float scale_is = 1/iscale_is;
+        float mse = 0;
+        for (int i = 0; i < n; ++i) {
+            int l = MIN(nmax, nearest_int(iscale_is*x[i]));
+            float diff = x[i] - scale_is*l;
+            float w = quant_weights[i];
+            mse += w*diff*diff;
+        }
+        if (mse < best_mse) {
+            best_mse = mse;
+            iscale = iscale_is;
+        }
+    }
+    float sumlx = 0;
+    float suml2 = 0;
+    for (int i = 0; i < n; ++i) {
+        int l = MIN(nmax, nearest_int(iscale * x[i]));
+        L[i] = l;
+        float w = quant_weights[i];
+        sumlx += w*x[i]*l;
+        suml2 += w*l*l;
+    }
+    for (int itry = 0; itry < 5; ++itry) {
+        int n_changed = 0;
+        for (int i = 0; i < n; ++i) {
+            float w = quant_weights[i];
+            float slx = sumlx - w*x[i]*L[i];
+            float sl2 = suml2 - w*L[i]*L[i];
+            if (slx > 0 && sl2 > 0) {
+                int new_l = nearest_int(x[i] * sl2 / slx);
+                new_l = MIN(nmax, new_l);
+                if (new_l != L[i]) {
+                    slx += w*x[i]*new_l;
+                    sl2 += w*new_l*new_l;
+                    if (slx*slx*suml2 > sumlx*sumlx*sl2) {
+                        L[i] = new_l; sumlx = slx; suml2 = sl2;
+                        ++n_changed;
+                    }
+                }
+            }
+        }
+        if (!n_changed) {
+            break;
+        }
+    }
+    return sumlx / suml2;
+}
+
 void quantize_row_q4_K_reference(const float * __restrict x, block_q4_K * __restrict y, int k) {
     assert(k % QK_K == 0);
     const int nb = k / QK_K;
@@ -337,3 +447,93 @@ void quantize_row_q4_K(const float * __restrict x, void * __restrict vy, int k)
     block_q4_K * __restrict y = (block_q4_K *)vy;
     quantize_row_q4_K_reference(x, y, k);
 }
+
+#if QK_K == 256
+// as quantize_row_q4_K_reference(), the squared error of x[j] weighed by quant_weights[j] * sqrt(sigma2 + x[j]^2)
+// and the scales and mins of the sub-blocks fitted for the weights of their elements.
+static void quantize_row_q4_K_impl(const float * __restrict x, block_q4_K * __restrict y, int64_t n_per_row, const float * __restrict quant_weights) {
+    assert(n_per_row % QK_K == 0);
+    const int64_t nb = n_per_row / QK_K;
+
+    uint8_t L[QK_K];
+    uint8_t Laux[32];
+    uint8_t Ls[QK_K/32];
+    uint8_t Lm[QK_K/32];
+    float   weights[32];
+    float   sw[QK_K/32];
+    float   mins[QK_K/32];
+    float   scales[QK_K/32];
+
+    for (int i = 0; i < nb; i++) {
+
+        float sum_x2 = 0;
+        for (int l = 0; l < QK_K; ++l) sum_x2 += x[l] * x[l];
+        float sigma2 = 2*sum_x2/QK_K;
+
+        for (int j = 0; j < QK_K/32; ++j) {
+            const float * qw = quant_weights + QK_K*i + 32*j;
+            for (int l = 0; l < 32; ++l) weights[l] = qw[l] * sqrtf(sigma2 + x[32*j + l]*x[32*j + l]);
+            float sumw = 0;
+            for (int l = 0; l < 32; ++l) sumw += weights[l];
+            sw[j] = sumw;
+            scales[j] = make_qkx2_quants(32, 15, x + 32*j, weights, L + 32*j, &mins[j], Laux, -0.9F, 0.05F, 36, false);
+        }
+
+        float d_block = make_qp_quants(QK_K/32, 63, scales, Ls, sw);
+        float m_block = make_qp_quants(QK_K/32, 63, mins,   Lm, sw);
+        for (int j = 0; j < QK_K/32; ++j) {
+            uint8_t ls = Ls[j];
+            uint8_t lm = Lm[j];
+            if (j < 4) {
+                y[i].scales[j] = ls;
+                y[i].scales[j+4] = lm;
+            } else {
+                y[i].scales[j+4] = (ls & 0xF) | ((lm & 0xF) << 4);
+                y[i].scales[j-4] |= ((ls >> 4) << 6);
+                y[i].scales[j-0] |= ((lm >> 4) << 6);
+            }
+        }
+        y[i].d = MLLM_FP32_TO_FP16(d_block);
+        y[i].dmin = MLLM_FP32_TO_FP16(m_block);
+
+        uint8_t sc;
+        uint8_t m;
+        for (int j = 0; j < QK_K/32; ++j) {
+            get_scale_min_k4(j, y[i].scales, &sc, &m);
+            const float d = MLLM_FP16_TO_FP32(y[i].d) * sc;
+            if (d == 0.0F) continue;
+            const float dm = MLLM_FP16_TO_FP32(y[i].dmin) * m;
+            for (int ii = 0; ii < 32; ++ii) {
+                int l = nearest_int((x[32*j + ii] + dm)/d);
+                l = MAX(0, MIN(15, l));
+                L[32*j + ii] = l;
+            }
+        }
+        uint8_t * q = y[i].qs;
+        for (int j = 0; j < QK_K; j += 64) {
+            for (int l = 0; l < 32; ++l) q[l] = L[j + l] | (L[j + l + 32] << 4);
+            q += 32;
+        }
+
+        x += QK_K;
+    }
+}
+#endif
+
+size_t quantize_q4_K(const float * __restrict src, void * __restrict dst, int64_t nrow, int64_t n_per_row, const float * quant_weights) {
+    assert(n_per_row % QK_K == 0);
+    const size_t row_size = n_per_row / QK_K * sizeof(block_q4_K);
+#if QK_K == 256
+    if (quant_weights) {
+        char * qrow = (char *)dst;
+        for (int64_t row = 0; row < nrow; ++row) {
+            quantize_row_q4_K_impl(src, (block_q4_K *)qrow, n_per_row, quant_weights);
+            src += n_per_row;
+            qrow += row_size;
+        }
+        return nrow * row_size;
+    }
+#endif
+    quantize_row_q4_K(src, dst, nrow * n_per_row);
+    return nrow * row_size;
+}
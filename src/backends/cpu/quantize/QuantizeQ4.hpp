@@ -31,9 +31,13 @@
 #include "Quantize.hpp"
 
 void quantize_row_q4_0(const float * __restrict x, void * __restrict y, int k);
+// quantize nrow rows of n_per_row, the squared error of column j weighed by quant_weights[j] (an importance matrix,
+// see Imatrix) if it is given. returns the bytes written.
+size_t quantize_q4_0(const float * __restrict src, void * __restrict dst, int64_t nrow, int64_t n_per_row, const float * quant_weights);
 void dequantize_row_q4_0(const void * __restrict vx, float * __restrict y, int k);
 
 
 void quantize_row_q4_K(const float * __restrict x, void * __restrict vy, int k);
+size_t quantize_q4_K(const float * __restrict src, void * __restrict dst, int64_t nrow, int64_t n_per_row, const float * quant_weights);
 void dequantize_row_q4_K(const block_q4_K * __restrict x, float * __restrict y, int k);
 #endif // MLLM_QUANTIZEQ4_HPP
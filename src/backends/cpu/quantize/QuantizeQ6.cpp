@@ -29,7 +29,8 @@
 
 // ====================== 6-bit (de)-quantization
 
-void quantize_row_q6_K_reference(const float * __restrict x, block_q6_K * __restrict y, int k) {
+// quant_weights, if given, weigh the squared errors of the k elements of x.
+static void quantize_row_q6_K_impl(const float * __restrict x, block_q6_K * __restrict y, int k, const float * __restrict quant_weights) {
     assert(k % QK_K == 0);
     const int nb = k / QK_K;
 
@@ -43,7 +44,7 @@ void quantize_row_q6_K_reference(const float * __restrict x, block_q6_K * __rest
 
         for (int ib = 0; ib < QK_K/16; ++ib) {
 
-            const float scale = make_qx_quants(16, 32, x + 16*ib, L + 16*ib, 1);
+            const float scale = make_qx_quants(16, 32, x + 16*ib, L + 16*ib, 1, quant_weights ? quant_weights + 16*ib : nullptr);
             scales[ib] = scale;
 
             const float abs_scale = fabsf(scale);
@@ -58,6 +59,9 @@ void quantize_row_q6_K_reference(const float * __restrict x, block_q6_K * __rest
             memset(&y[i], 0, sizeof(block_q6_K));
             y[i].d = MLLM_FP32_TO_FP16(0.f);
             x += QK_K;
+            if (quant_weights) {
+                quant_weights += QK_K;
+            }
             continue;
         }
 
@@ -107,10 +111,17 @@ void quantize_row_q6_K_reference(const float * __restrict x, block_q6_K * __rest
 #endif
 
         x += QK_K;
+        if (quant_weights) {
+            quant_weights += QK_K;
+        }
 
     }
 }
 
+void quantize_row_q6_K_reference(const float * __restrict x, block_q6_K * __restrict y, int k) {
+    quantize_row_q6_K_impl(x, y, k, nullptr);
+}
+
 void dequantize_row_q6_K(const block_q6_K * __restrict x, float * __restrict y, int k) {
     assert(k % QK_K == 0);
     const int nb = k / QK_K;
@@ -162,4 +173,20 @@ void quantize_row_q6_K(const float * __restrict x, void * __restrict vy, int k)
     assert(k % QK_K == 0);
     block_q6_K * __restrict y = (block_q6_K *)vy;
     quantize_row_q6_K_reference(x, y, k);
-}
\ No newline at end of file
+}
+
+size_t quantize_q6_K(const float * __restrict src, void * __restrict dst, int64_t nrow, int64_t n_per_row, const float * quant_weights) {
+    assert(n_per_row % QK_K == 0);
+    const size_t row_size = n_per_row / QK_K * sizeof(block_q6_K);
+    if (!quant_weights) {
+        quantize_row_q6_K(src, dst, nrow * n_per_row);
+        return nrow * row_size;
+    }
+    char * qrow = (char *)dst;
+    for (int64_t row = 0; row < nrow; ++row) {
+        quantize_row_q6_K_impl(src, (block_q6_K *)qrow, n_per_row, quant_weights);
+        src += n_per_row;
+        qrow += row_size;
+    }
+    return nrow * row_size;
+}
@@ -27,7 +27,9 @@
 
 #include "QuantizeQ8.hpp"
 
-void quantize_row_q8_0_reference( float * __restrict x, block_q8_0 * __restrict y, int k) {
+// with DYNAMIC_ARCH quantize_row_q8_0 is built once per ISA (see compute/Arch.hpp) and the rest once.
+#if defined(MLLM_ARCH) || !defined(MLLM_DYNAMIC_ARCH)
+static void quantize_row_q8_0_reference(const float * __restrict x, block_q8_0 * __restrict y, int k) {
     assert(k % QK8_0 == 0);
     const int nb = k / QK8_0;
 
@@ -178,9 +180,9 @@ void quantize_row_q8_0(const float * __restrict x, void * __restrict vy, int k)
     quantize_row_q8_0_reference(x, y, k);
 #endif
 }
+#endif
 
-
-
+#ifndef MLLM_ARCH
 void dequantize_row_q8_0(const void * __restrict vx, float * __restrict y, int k) {
     static const int qk = QK8_0;
 
@@ -255,3 +257,4 @@ void dequantize_row_q8_K(const block_q8_K * __restrict x, float * __restrict y,
 void quantize_row_q8_K(const float * __restrict x, void * __restrict y, int k) {
     quantize_row_q8_K_reference(x, (block_q8_K  *)y, k);
 }
+#endif
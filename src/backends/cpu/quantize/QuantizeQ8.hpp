@@ -28,6 +28,7 @@
 #ifndef MLLM_QUANTIZEQ8_HPP
 #define MLLM_QUANTIZEQ8_HPP
 #include "Quantize.hpp"
+#include "../compute/Arch.hpp"
 
 
 void quantize_row_q8_0(const float * __restrict x, void * __restrict y, int k);
@@ -75,6 +75,9 @@ struct DeepseekConfig {
     float rms_norm_eps = 1e-6;
     int cache_limit;
     bool do_mask=true;
+    // cache the latent kv (kv_lora_rank + qk_rope_head_dim per token, shared by the heads) instead of the
+    // per-head k and v, kv_b_proj is absorbed into the attention (see CPULatentAttention).
+    bool latent_cache = false;
 
 
     DeepseekNameConfig names_config;
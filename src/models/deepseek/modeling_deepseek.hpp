@@ -20,6 +20,8 @@ class DeepseekMultiHeadLatentAttention final : public Module {
     Layer k_rope;
     KVCache k_cache;
     KVCache v_cache;
+    Attention attention;
+    LatentAttention latent_attention;
     Softmax softmax;
     Layer o_proj;
     int num_heads{};
@@ -50,12 +52,17 @@ public:
             base_name + names._kv_a_proj_with_mqa_name
         );
         kv_a_layernorm = RMSNorm(kv_lora_rank, config.rms_norm_eps, base_name + names._kv_a_layernorm_name);
-        kv_b_proj = Linear(
-            kv_lora_rank,
-            num_heads * (q_head_dim - qk_rope_head_dim + v_head_dim),
-            false,
-            base_name + names._kv_b_proj_name
-        );
+        if (config.latent_cache && config.cache_limit > 0) {
+            latent_attention = LatentAttention(num_heads, qk_nope_head_dim, v_head_dim, kv_lora_rank, config.do_mask,
+                                               base_name + names._kv_b_proj_name);
+        } else {
+            kv_b_proj = Linear(
+                kv_lora_rank,
+                num_heads * (q_head_dim - qk_rope_head_dim + v_head_dim),
+                false,
+                base_name + names._kv_b_proj_name
+            );
+        }
         o_proj = Linear(
             num_heads * v_head_dim,
             config.hidden_size,
@@ -64,9 +71,12 @@ public:
         );        
         q_rope = RoPE(RoPEType::MLAROPE, base_name + "q_rope");
         k_rope = RoPE(RoPEType::MLAROPE, base_name + "k_rope");        
-        if (config.cache_limit > 0) {
+        if (latent_attention.ready()) {
+            k_cache = KVCache(1, config.cache_limit, base_name + "k_cache");
+        } else if (config.cache_limit > 0) {
             k_cache = KVCache(num_heads/num_heads, config.cache_limit, base_name + "k_cache");
             v_cache = KVCache(num_heads/num_heads, config.cache_limit, base_name + "v_cache");
+            attention = Attention(config.do_mask, base_name + "attention");
         }
         softmax = Softmax(DIMENSION, config.do_mask, base_name + "softmax");
         softmax_scale = 1/std::sqrt(q_head_dim);
@@ -76,25 +86,37 @@ public:
     
         auto q = q_proj(hidden_states);
         auto qs = Tensor::split(q, {qk_nope_head_dim, qk_rope_head_dim}, D_HD, num_heads);
-        q = Tensor::cat({qs[0], q_rope(qs[1])}, DIMENSION);
 
         Tensor compressed_kv = kv_a_proj_with_mqa(hidden_states);        
         auto kvs = Tensor::split(compressed_kv, 
                         {kv_lora_rank, qk_rope_head_dim}, DIMENSION);
         auto k_pe = k_rope(kvs[1]);
+        if (latent_attention.ready()) {
+            // one "head" of [c, k_pe] per token is cached, kv_b_proj is applied through the queries and outputs.
+            auto latent = Tensor::cat({kv_a_layernorm(kvs[0]), k_pe}, DIMENSION);
+            latent = k_cache(latent);
+            auto o = latent_attention(qs[0], q_rope(qs[1]), latent, k_cache);
+            o = o.view(-1, 1, -1, v_head_dim * num_heads);
+            o = o_proj(o);
+            return {o};
+        }
+        q = Tensor::cat({qs[0], q_rope(qs[1])}, DIMENSION);
         auto kv = kv_b_proj(kv_a_layernorm(kvs[0]));//.view(-1, head_size_, -1, qk_nope_head_dim_ + v_head_dim_);
         kvs = Tensor::split(kv, {qk_nope_head_dim, v_head_dim}, D_HD, num_heads);
         auto v = kvs[1];
         auto k = Tensor::cat({kvs[0], k_pe}, DIMENSION);  
+        Tensor o;
         if (k_cache.ready() && v_cache.ready()) {
             k = k_cache(k);
             v = v_cache(v);
+            o = attention(q, k, v, k_cache);
+        } else {
+            k = k.transpose(SEQUENCE, DIMENSION);
+            auto qk = Tensor::mm(q, k);
+            qk = qk * softmax_scale;
+            qk = softmax(qk);
+            o = Tensor::mm(qk, v);
         }
-        k = k.transpose(SEQUENCE, DIMENSION);
-        auto qk = Tensor::mm(q, k);
-        qk = qk * softmax_scale;
-        qk = softmax(qk, k_cache.getCacheSeqLen());
-        auto o = Tensor::mm(qk, v);
         o = o.view(-1, 1, -1, v_head_dim * num_heads);
         o = o_proj(o);
         return {o};        
@@ -178,7 +200,7 @@ class DeepseekForCausalLM final : public Module {
 private:
     int hidden_size;
     Layer embedding;
-    Parameter lm_head;
+    Layer lm_head;
     DeepseekModel model;
 public:
     DeepseekForCausalLM(DeepseekConfig &config) {
@@ -188,13 +210,13 @@ public:
         model = DeepseekModel(config, names, names.blk_name);
 
         // lm_head and tok_embedding is tied together.
-        // They share same parameters. Use a Transpose to do the lm_head instead.
-        lm_head = Parameter(1, config.vocab_size, 1, config.hidden_size, names.lm_head_name + ".weight");
+        // They share same parameters, the lm_head uses the table of the embedding.
+        lm_head = Linear(names.token_embd_name, config.hidden_size, config.vocab_size, "lm_head");
     }
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
         auto x = embedding(inputs[0]);
         auto outputs = model({x})[0];
-        outputs = Tensor::mm(outputs, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
+        outputs = lm_head(outputs);
         return {outputs};
     }
 };
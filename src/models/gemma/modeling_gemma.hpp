@@ -109,8 +109,8 @@ public:
         model = GemmaModel(config, names, names.blk_name);
 
         // gemma's lm_head and tok_embedding is tied together.
-        // They share same parameters. Use a Transpose to do the lm_head instead.
-        lm_head = Parameter(1, config.vocab_size, 1, config.hidden_size, names.lm_head_name + ".weight");
+        // They share same parameters, the lm_head uses the table of the embedding.
+        lm_head = Linear(names.token_embd_name, config.hidden_size, config.vocab_size, "lm_head");
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
@@ -121,14 +121,14 @@ public:
 
         // go through model
         auto outputs = model({x})[0];
-        outputs = Tensor::mm(outputs, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
+        outputs = lm_head(outputs);
         return {outputs};
     }
 
 private:
     int hidden_size;
     Layer embedding;
-    Parameter lm_head;
+    Layer lm_head;
     GemmaModel model;
 };
 
@@ -74,6 +74,11 @@ public:
     LLaMANameConfig names_config;
     float rope_theta;
     int max_position_embeddings;
+    // the type of the KV cache, MLLM_TYPE_Q8_0 or MLLM_TYPE_Q4_0 to stream less of it at long contexts.
+    DataType kv_cache_type = MLLM_TYPE_F16;
+    // the first tokens the KV cache always keeps. with attention sinks the cache holds cache_limit tokens and evicts the
+    // oldest of the others when it is full, so a chat can go on forever in fixed memory. 0 grows the cache instead.
+    int attention_sink = 0;
 
     explicit LLaMAConfig(int token_limit, string billions = "7B", RoPEType type = LLAMAROPE, int vocab = 32000) {
         names_config.init(type);
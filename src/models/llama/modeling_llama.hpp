@@ -44,9 +44,11 @@ class LLaMABlock final : public Module {
 
 public:
     LLaMABlock() = default;
-    LLaMABlock(int hidden_dim, int head_size, int kv_head_size, int ffn_hidden, RoPEType RoPE_type, float rope_theta, int max_position_embeddings, int cache_limit, const LLaMANameConfig &names, const string &base_name) {
+    LLaMABlock(int hidden_dim, int head_size, int kv_head_size, int ffn_hidden, RoPEType RoPE_type, float rope_theta, int max_position_embeddings, int cache_limit, DataType kv_cache_type,
+               int attention_sink, const LLaMANameConfig &names, const string &base_name) {
         attention = MultiHeadAttention(hidden_dim, head_size, kv_head_size, hidden_dim / head_size, SPLIT_NONE, false, false,
-                                       RoPE_type, rope_theta, max_position_embeddings, cache_limit, true, false, names, base_name + names._attn_base_name);
+                                       RoPE_type, rope_theta, max_position_embeddings, cache_limit, true, false, names, base_name + names._attn_base_name,
+                                       0, kv_cache_type, attention_sink);
         mlp = LLaMAMLP(hidden_dim, ffn_hidden, names, base_name + names._ffn_base_name);
         norm1 = RMSNorm(hidden_dim, 1e-6, base_name + names._attn_norm_name);
         norm2 = RMSNorm(hidden_dim, 1e-6, base_name + names._ffn_norm_name);
@@ -76,12 +78,12 @@ public:
     explicit LLaMAModel(const LLaMAConfig &config) :
         LLaMAModel(config.vocab_size, config.hidden_dim, config.head_size, config.num_key_value_heads, config.ffn_hidden, config.block_num, 
                   config.RoPE_type, config.rope_theta, config.max_position_embeddings, config.cache_limit,
-                   config.names_config, config.names_config.blk_name) {
+                   config.names_config, config.names_config.blk_name, config.kv_cache_type, config.attention_sink) {
     }
     LLaMAModel(int vocab_size, int hidden_dim, int head_size, int kv_head_size, int ffn_hidden, int block_num, RoPEType RoPE_type, float rope_theta, int max_position_embeddings, int cache_limit,
-               const LLaMANameConfig &names, const string &base_name) {
+               const LLaMANameConfig &names, const string &base_name, DataType kv_cache_type = MLLM_TYPE_F16, int attention_sink = 0) {
         embedding = Embedding(vocab_size, hidden_dim, names.token_embd_name);
-        blocks = List<LLaMABlock>(block_num, hidden_dim, head_size, kv_head_size, ffn_hidden, RoPE_type, rope_theta, max_position_embeddings, cache_limit, names, base_name);
+        blocks = List<LLaMABlock>(block_num, hidden_dim, head_size, kv_head_size, ffn_hidden, RoPE_type, rope_theta, max_position_embeddings, cache_limit, kv_cache_type, attention_sink, names, base_name);
         norm = RMSNorm(hidden_dim, 1e-6, names.post_norm_name);
         lm_head = Linear(hidden_dim, vocab_size, false, names.lm_head_name);
     }
@@ -115,6 +115,11 @@ struct MistralConfig {
     double rms_norm_eps = 1e-05;
     float rope_theta = 1000000.0;
     int vocab_size = 32000;
+    // the tokens each token attends to, 0 for all of them. 4096 for Mistral 7B v0.1, whose KV cache is then
+    // a ring of the last 4096 tokens and a generation of any length runs in constant memory.
+    int sliding_window = 0;
+    // the type of the KV cache, MLLM_TYPE_Q8_0 or MLLM_TYPE_Q4_0 to stream less of it at long contexts.
+    DataType kv_cache_type = MLLM_TYPE_F16;
 
     int cache_limit;
     RoPEType RoPE_type = RoPEType::HFHUBROPE;
@@ -68,8 +68,7 @@ public:
         k_cache = KVCache(num_key_value_groups, config.cache_limit, base_name + "k_cache");
         v_cache = KVCache(num_key_value_groups, config.cache_limit, base_name + "v_cache");
         // mask = SlidingWindowMask(config.sliding_window, base_name + "mask");
-        mask = Causalmask(base_name + "mask");
-        softmax = Softmax(DIMENSION, base_name + "softmax");
+        attention = Attention(true, base_name + "attention");
     }
 
     std::vector<Tensor> Forward(std::vector<Tensor> inputs, std::vector<std::any> args) override {
@@ -90,13 +89,8 @@ public:
         key_states = k_cache(key_states);
         value_states = v_cache(value_states);
 
-        // attention weight
-        auto atten_weight = Tensor::mm(query_states, key_states.transpose(Chl::SEQUENCE, Chl::DIMENSION)) / std::sqrt(head_dim);
-        atten_weight = mask(atten_weight, k_cache.getCacheSeqLen());
-        atten_weight = softmax(atten_weight, k_cache.getCacheSeqLen());
-
         // attention output
-        auto atten_output = Tensor::mm(atten_weight, value_states);
+        auto atten_output = attention(query_states, key_states, value_states, k_cache);
         atten_output = atten_output.view(-1, 1, -1, head_dim * num_heads);
         atten_output = o_proj(atten_output);
         return {atten_output};
@@ -119,8 +113,7 @@ private:
     Layer k_rope;
     KVCache k_cache;
     KVCache v_cache;
-    Causalmask mask;
-    Softmax softmax;
+    Attention attention;
 };
 
 // Copied from GemmaDecoder with Gemma->Qwen and set RmsNorm(without add_unit_offset)
@@ -194,10 +187,9 @@ public:
         embedding = Embedding(config.vocab_size, config.hidden_size, names.token_embd_name);
         model = QWenModel(config, names, names.blk_name);
 
-        // FIXME Qwen-0.5 use tied embedding
-        // Others use nn.Linear()
+        // Qwen-0.5B and 1.8B tie the lm_head to the embedding, the others use nn.Linear()
         if (tie_embedding_words) {
-            lm_head = Parameter(1, config.vocab_size, 1, config.hidden_size, names.token_embd_name + ".weight");
+            lm_head_layer = Linear(names.token_embd_name, config.hidden_size, config.vocab_size, names.lm_head_name);
         } else{
             lm_head_layer = Linear(config.hidden_size, config.vocab_size, false, names.lm_head_name);
         }
@@ -208,11 +200,7 @@ public:
 
         // go through model
         auto outputs = model({x})[0];
-        if (tie_embedding_words) {
-            outputs = Tensor::mm(outputs, lm_head().transpose(Chl::SEQUENCE, Chl::DIMENSION));
-        } else {
-            outputs = lm_head_layer(outputs);
-        }
+        outputs = lm_head_layer(outputs);
         return {outputs};
     }
     void clear_kvcache() {
@@ -223,7 +211,6 @@ private:
     int hidden_size;
     bool tie_embedding_words;
     Layer embedding;
-    Parameter lm_head;
     Layer lm_head_layer;
     QWenModel model;
 };
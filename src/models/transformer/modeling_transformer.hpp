@@ -31,6 +31,8 @@ class MultiHeadAttention final : public Module {
     Layer k_norm;
     KVCache k_cache;
     KVCache v_cache;
+    Attention attention;
+    Layer mask;
     Softmax softmax;
     Layer o_proj;
     Parameter bias_k;
@@ -45,7 +47,8 @@ public:
                        AttnQKVSplitType do_qkv_proj, bool post_qkv_norm, bool bias_kv_cat,
                        RoPEType RoPE_type, float rope_theta, int max_position_embeddings, 
                        int cache_limit, bool do_mask, bool bias,
-                       const TransformerNameConfig &names, const string &base_name) {
+                       const TransformerNameConfig &names, const string &base_name, int sliding_window = 0,
+                       DataType kv_cache_type = MLLM_TYPE_F16, int attention_sink = 0) {
         attn_hidden_dim_ = attn_hidden_dim;
         head_size_ = head_size;
         kv_head_size_ = kv_head_size;
@@ -61,13 +64,26 @@ public:
             q_norm = LayerNorm(attn_hidden_dim, true, 1e-6, base_name + names._q_norm_name);
             k_norm = LayerNorm(attn_hidden_dim, true, 1e-6, base_name + names._k_norm_name);
         }
-        if (RoPE_type > 0) {
+        // with attention sinks the caches hold cache_limit tokens however long the generation is.
+        const bool streaming = cache_limit > 0 && attention_sink > 0;
+        if (RoPE_type > 0 && streaming) {
+            q_rope = RoPE(RoPE_type, rope_theta, max_position_embeddings, attention_sink, cache_limit, base_name + "q_rope");
+            k_rope = RoPE(RoPE_type, rope_theta, max_position_embeddings, attention_sink, cache_limit, base_name + "k_rope");
+        } else if (RoPE_type > 0) {
             q_rope = RoPE(RoPE_type, rope_theta, max_position_embeddings, base_name + "q_rope");
             k_rope = RoPE(RoPE_type, rope_theta, max_position_embeddings, base_name + "k_rope");
         }
-        if (cache_limit > 0) {
-            k_cache = KVCache(head_size/kv_head_size, cache_limit, base_name + "k_cache");
-            v_cache = KVCache(head_size/kv_head_size, cache_limit, base_name + "v_cache");
+        if (streaming) {
+            k_cache = KVCache(head_size/kv_head_size, cache_limit, attention_sink, RoPE_type, rope_theta, kv_cache_type, base_name + "k_cache");
+            v_cache = KVCache(head_size/kv_head_size, cache_limit, attention_sink, NONE, rope_theta, kv_cache_type, base_name + "v_cache");
+            attention = Attention(do_mask, base_name + "attention");
+        } else if (cache_limit > 0) {
+            // with a sliding window the caches are rings of the last sliding_window tokens.
+            k_cache = KVCache(head_size/kv_head_size, cache_limit, sliding_window, kv_cache_type, base_name + "k_cache");
+            v_cache = KVCache(head_size/kv_head_size, cache_limit, sliding_window, kv_cache_type, base_name + "v_cache");
+            attention = Attention(do_mask, sliding_window, base_name + "attention");
+        } else if (sliding_window > 0) {
+            mask = SlidingWindowMask(sliding_window, base_name + "mask");
         }
         softmax = Softmax(DIMENSION, do_mask, base_name + "softmax");
         o_proj = Linear(head_size * attn_hidden_dim, hidden_dim, bias, base_name + names._o_proj_name);
@@ -104,19 +120,21 @@ public:
             q = q_rope(q);
             k = k_rope(k);
         }
+        Tensor o;
         if (k_cache.ready() && v_cache.ready()) {
             k = k_cache(k);
             v = v_cache(v);
-        }
-        k = k.transpose(SEQUENCE, DIMENSION);
-        auto qk = Tensor::mm(q, k);
-        qk = qk / std::sqrt(attn_hidden_dim_);
-        if (k_cache.ready() && v_cache.ready()) {
-            qk = softmax(qk, k_cache.getCacheSeqLen());          
-        }else{
+            o = attention(q, k, v, k_cache);
+        } else {
+            k = k.transpose(SEQUENCE, DIMENSION);
+            auto qk = Tensor::mm(q, k);
+            qk = qk / std::sqrt(attn_hidden_dim_);
+            if (mask.ready()) {
+                qk = mask(qk);
+            }
             qk = softmax(qk);
+            o = Tensor::mm(qk, v);
         }
-        auto o = Tensor::mm(qk, v);
         o = o.view(-1, 1, -1, attn_hidden_dim_ * head_size_);
         o = o_proj(o);
         return {o};
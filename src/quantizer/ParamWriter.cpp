@@ -35,22 +35,38 @@ void ParamWriter::writeIndex() {
 }
 
 void ParamWriter::writeParam(string name, DataType type, void *data, uint64_t size) {
+    beginParam(std::move(name), type);
+    writeParamData(data, size);
+    endParam();
+}
+void ParamWriter::beginParam(string name, DataType type) {
     auto &param = param_info_[index_];
     param.name = std::move(name);
     param.type = type;
+    // pad so that the contents can be used in-place when the file is mmaped by ParamLoader.
+    static const char zeros[_PARAM_ALIGNMENT] = {0};
+    auto padding = (_PARAM_ALIGNMENT - ftell(fp_) % _PARAM_ALIGNMENT) % _PARAM_ALIGNMENT;
+    fwrite(zeros, sizeof(char), padding, fp_);
     param.offset = ftell(fp_);
+    param.size = 0;
+}
+void ParamWriter::writeParamData(const void *data, uint64_t size) {
     auto status = fwrite(data, sizeof(char), size, fp_);
-    fflush(fp_);  // make sure the data is written to the file immediately
     if (status != size) {
         // if write failed, print the error message and exit
         std::cout<<"fwrite error"<<status<<"!="<<size<<std::endl;
     }
+    param_info_[index_].size += size;
+}
+void ParamWriter::endParam() {
+    auto &param = param_info_[index_];
+    fflush(fp_);  // make sure the data is written to the file immediately
     auto foff_size_after = ftell(fp_);
     auto foff_size = foff_size_after - param.offset;
-    if (foff_size != size) {
-        std::cout << "Assertion failed: foff_size (" << foff_size << ") != size (" << size << ")" << std::endl;
+    if (foff_size != param.size) {
+        std::cout << "Assertion failed: foff_size (" << foff_size << ") != size (" << param.size << ")" << std::endl;
     }
-    assert(foff_size == size);
+    assert(foff_size == param.size);
     param.size = foff_size;
     index_++;
 }
@@ -33,6 +33,12 @@ public:
     int calcIndexSize(vector<string> names);
     void writeIndex();
     virtual void writeParam(string name, DataType type, void *data, uint64_t size);
+    /**
+     * \brief write a param in parts, beginParam(), writeParamData() for each part and endParam().
+     */
+    void beginParam(string name, DataType type);
+    void writeParamData(const void *data, uint64_t size);
+    void endParam();
     void paddingIndex(vector<string> names);
 
 private:
@@ -3,17 +3,89 @@
 #include "Types.hpp"
 #include "backends/cpu/quantize/QuantizeQ4.hpp"
 #include "backends/cpu/quantize/QuantizeQ8.hpp"
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include "QuantWriter.hpp"
+#include "backends/cpu/ThreadPool.hpp"
 #include "backends/cpu/quantize/QuantizeQ6.hpp"
 #include "backends/cpu/compute/GEMM_AArch64.hpp"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 namespace mllm {
+
+// the elements of a param that are read, quantized and written at a time.
+static constexpr uint64_t chunk_elements = 1 << 22;
+
+/**
+ * \brief runs the writes on a thread of its own, at most max_pending of them are queued.
+ */
+class WriteQueue {
+public:
+    explicit WriteQueue(size_t max_pending) :
+        max_pending_(max_pending), thread_([this] { work(); }) {
+    }
+    ~WriteQueue() {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        thread_.join();
+    }
+    void push(std::function<void()> job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return jobs_.size() < max_pending_; });
+        jobs_.push_back(std::move(job));
+        cond_.notify_all();
+    }
+    // wait until all the jobs are done.
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return jobs_.empty() && !busy_; });
+    }
+
+private:
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cond_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+            if (jobs_.empty()) {
+                return;
+            }
+            auto job = std::move(jobs_.front());
+            jobs_.pop_front();
+            busy_ = true;
+            lock.unlock();
+            cond_.notify_all();
+            job();
+            lock.lock();
+            busy_ = false;
+            cond_.notify_all();
+        }
+    }
+
+    size_t max_pending_;
+    std::deque<std::function<void()>> jobs_;
+    bool busy_ = false;
+    bool stop_ = false;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::thread thread_;
+};
+
 QuantWriter::QuantWriter(std::string output_path, std::string input_path) :
     ParamWriter(output_path), output_path_(output_path) {
-    param_loader_ = new mllm::ParamLoader(std::move(input_path));
+    param_loader_ = new mllm::ParamLoader(std::move(input_path), true);
     if (param_loader_ == nullptr) {
         __exit(-1);
     }
+    threads_ = (int)std::thread::hardware_concurrency();
 }
 QuantWriter::~QuantWriter() {
 #ifdef TEST
@@ -27,13 +99,51 @@ int QuantWriter::readParams() {
     paddingIndex(param_names_);
     return param_names_.size();
 }
-float *QuantWriter::getParam(std::string param_name) {
-    auto type = param_loader_->data_type_[param_name];
-    if (type != DataType::MLLM_TYPE_F32) {
-        return nullptr;
+
+bool QuantWriter::loadPolicy(const std::string &path) {
+    std::ifstream file(path);
+    if (!file.good()) {
+        std::cout << "Can not open " << path << "\n";
+        return false;
     }
-    auto [data, size] = param_loader_->load(param_name);
-    return static_cast<float *>((void *)data);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string name, type_name;
+        if (!(fields >> name) || name[0] == '#') {
+            continue;
+        }
+        fields >> type_name;
+        auto type = MLLM_TYPE_COUNT;
+        for (int t = 0; t < MLLM_TYPE_COUNT; ++t) {
+            if (DataTypeName((DataType)t) == type_name) {
+                type = (DataType)t;
+            }
+        }
+        if (type == MLLM_TYPE_COUNT) {
+            std::cout << "Unknown type " << type_name << " for " << name << " in " << path << "\n";
+            return false;
+        }
+        policy_.emplace_back(name, type);
+    }
+    return true;
+}
+
+bool QuantWriter::loadImatrix(const std::string &path) {
+    if (!imatrix_.load(path)) {
+        return false;
+    }
+    std::cout << "Load the imatrix of " << imatrix_.size() << " params from " << path << "\n";
+    return true;
+}
+
+DataType QuantWriter::policyType(const std::string &name) const {
+    for (const auto &[pattern, type] : policy_) {
+        if (name.find(pattern) != std::string::npos) {
+            return type;
+        }
+    }
+    return MLLM_TYPE_COUNT;
 }
 
 vector<string> fp32_layers = {"norm", "rope", "bias","rotary_emb", "embed_tokens",
@@ -55,218 +165,225 @@ bool find_names(const string &name, const vector<string> &layer_names) {
     return false;
 }
 
+// the elements one call of quantize_row() quantizes at least, 0 if type is not supported.
+static uint64_t block_elements(DataType type, int row_size) {
+    switch (type) {
+    case MLLM_TYPE_F32:
+        return 1;
+    case MLLM_TYPE_Q4_0:
+        return QK4_0;
+    case MLLM_TYPE_Q8_0:
+        return QK8_0;
+    case MLLM_TYPE_Q4_K:
+    case MLLM_TYPE_Q6_K:
+    case MLLM_TYPE_Q8_K:
+        return QK_K;
+    case MLLM_TYPE_Q4_0_4_4:
+    case MLLM_TYPE_Q8_0_4_4:
+        // groups of 4 rows are interleaved.
+        return row_size > 0 ? 4 * (uint64_t)row_size : 0;
+    default:
+        return 0;
+    }
+}
+
+// the elements of the rows of an importance matrix of cols columns that one call of quantize_row() quantizes
+// at least, 0 if type does not use one or the rows do not fit its blocks.
+static uint64_t imatrix_block_elements(DataType type, uint64_t cols) {
+    switch (type) {
+    case MLLM_TYPE_Q4_0:
+        return cols % QK4_0 == 0 ? cols : 0;
+    case MLLM_TYPE_Q4_K:
+    case MLLM_TYPE_Q6_K:
+        return cols % QK_K == 0 ? cols : 0;
+    case MLLM_TYPE_Q4_0_4_4:
+        return cols % QK4_0 == 0 ? 4 * cols : 0;
+    default:
+        return 0;
+    }
+}
+
+// with an imatrix, count is a multiple of imatrix_block_elements(type, row_size).
+static void quantize_row(DataType type, const float *src, void *dst, int count, int row_size, const float *imatrix) {
+    if (imatrix != nullptr) {
+        switch (type) {
+        case MLLM_TYPE_Q4_0:
+            quantize_q4_0(src, dst, count / row_size, row_size, imatrix);
+            return;
+        case MLLM_TYPE_Q4_K:
+            quantize_q4_K(src, dst, count / row_size, row_size, imatrix);
+            return;
+        case MLLM_TYPE_Q6_K:
+            quantize_q6_K(src, dst, count / row_size, row_size, imatrix);
+            return;
+        case MLLM_TYPE_Q4_0_4_4:
+            quantize_q4_0_4x4(src, dst, count / row_size, row_size, imatrix);
+            return;
+        default:
+            break;
+        }
+    }
+    switch (type) {
+    case MLLM_TYPE_F32:
+        memcpy(dst, src, count * sizeof(float));
+        break;
+    case MLLM_TYPE_Q4_0:
+        quantize_row_q4_0(src, dst, count);
+        break;
+    case MLLM_TYPE_Q8_0:
+        quantize_row_q8_0(src, dst, count);
+        break;
+    case MLLM_TYPE_Q4_K:
+        quantize_row_q4_K(src, dst, count);
+        break;
+    case MLLM_TYPE_Q6_K:
+        quantize_row_q6_K(src, dst, count);
+        break;
+    case MLLM_TYPE_Q8_K:
+        quantize_row_q8_K(src, dst, count);
+        break;
+    case MLLM_TYPE_Q4_0_4_4:
+        quantize_row_q4_0_4x4(src, dst, count, row_size);
+        break;
+    case MLLM_TYPE_Q8_0_4_4:
+        quantize_row_q8_0_4x4(src, dst, count, row_size);
+        break;
+    default:
+        break;
+    }
+}
+
+int QuantWriter::rowSize(const std::string &name, uint64_t size) const {
+    if (tmp_hidden_dim <= 0) {
+        return 0;
+    }
+    if (find_names(name, {"w2", "down_proj"})) {
+        return (int)(size / tmp_hidden_dim);
+    }
+    return tmp_hidden_dim;
+}
+
+void QuantWriter::quantParam(WriteQueue &writes, const std::string &name, DataType type, int row_size) {
+    const auto [offset, length] = param_loader_->offsets_[name];
+    const uint64_t count = length / sizeof(float);
+    // the importance of the columns, the rows are then quantized whole.
+    auto imatrix = imatrix_.weights(name);
+    if (!imatrix.empty()) {
+        const uint64_t imatrix_block = imatrix_block_elements(type, imatrix.size());
+        if (imatrix_block > 0 && count % imatrix_block == 0) {
+            row_size = (int)imatrix.size();
+        } else {
+            imatrix.clear();
+        }
+    }
+    uint64_t block = imatrix.empty() ? block_elements(type, row_size) : imatrix_block_elements(type, row_size);
+    if (block == 0) {
+        std::cout << "Can not quantize param " << name << " to " << DataTypeName(type) << "\n";
+        __exit(-1);
+    }
+    if (count % block != 0) {
+        std::cout << "Param " << name << " of " << count << " elements can not be quantized to " << DataTypeName(type) << ", keep it in F32\n";
+        type = MLLM_TYPE_F32;
+        block = 1;
+    }
+    std::cout << "Quantize param " << name << " to " << DataTypeName(type) << (imatrix.empty() ? "" : " with imatrix") << "\t";
+    writes.push([this, name, type] { beginParam(name, type); });
+#ifdef TEST
+    auto *test_data = new char[DataTypeSize(type, count)];
+#endif
+    const uint64_t chunk = std::max<uint64_t>(1, chunk_elements / block) * block;
+    std::vector<float> read_buffer;
+    for (uint64_t done = 0; done < count; done += chunk) {
+        const uint64_t n = std::min(chunk, count - done);
+        const float *src;
+        if (param_loader_->isMmaped()) {
+            src = (const float *)(param_loader_->buffer_ + offset) + done;
+#ifndef _WIN32
+            // read the next chunk while this one is quantized.
+            if (done + n < count) {
+                const uintptr_t page = sysconf(_SC_PAGESIZE);
+                const auto next = (uintptr_t)(src + n) / page * page;
+                madvise((void *)next, std::min(chunk, count - done - n) * sizeof(float) + (uintptr_t)(src + n) - next, MADV_WILLNEED);
+            }
+#endif
+        } else {
+            read_buffer.resize(n);
+            fseek(param_loader_->fp_, offset + done * sizeof(float), SEEK_SET);
+            if (fread(read_buffer.data(), sizeof(float), n, param_loader_->fp_) != n) {
+                std::cout << "Can not read param " << name << " from the input file\n";
+                __exit(-1);
+            }
+            src = read_buffer.data();
+        }
+        auto out = std::make_shared<std::vector<char>>(DataTypeSize(type, n));
+        parallel_ranges(n / block, threads_, [&](int64_t begin, int64_t end) {
+            quantize_row(type, src + begin * block, out->data() + DataTypeSize(type, begin * block), (end - begin) * block, row_size, imatrix.empty() ? nullptr : imatrix.data());
+        });
+#ifndef _WIN32
+        if (param_loader_->isMmaped()) {
+            // the chunk is not read again.
+            const uintptr_t page = sysconf(_SC_PAGESIZE);
+            const auto begin = (uintptr_t)src / page * page;
+            madvise((void *)begin, n * sizeof(float) + (uintptr_t)src - begin, MADV_DONTNEED);
+        }
+#endif
+#ifdef TEST
+        memcpy(test_data + DataTypeSize(type, done), out->data(), out->size());
+#endif
+        writes.push([this, out] { writeParamData(out->data(), out->size()); });
+    }
+    writes.push([this] { endParam(); });
+#ifdef TEST
+    data_[name] = test_data;
+#endif
+    std::cout << "  size:" << DataTypeSize(type, count) << " type:" << DataTypeName(type) << std::endl;
+}
+
 void QuantWriter::quantParams(DataType dataType) {
     quant_type_ = dataType;
+    if (dataType == MLLM_TYPE_F32) {
+        std::cout << "No need to quantize FP32 params\n";
+        __exit(-1);
+    }
+    WriteQueue writes(2);
     for (const auto &name : param_names_) {
-        //        int force_quant_type = -1;
-        auto *param = getParam(name);
-        if (param == nullptr) {
+        if (param_loader_->data_type_[name] != MLLM_TYPE_F32) {
             __exit(-1);
         }
         auto size = param_loader_->offsets_[name].second / sizeof(float);
         if(find_names(name, {"input_layernorm"})) {
             tmp_hidden_dim = size;
         }
-        void *quant_ptr = nullptr;
-        std::pair<void *, uint64_t> block_t;
-        if (find_names(name, q6_layers) && (dataType== MLLM_TYPE_Q6_K ||dataType == MLLM_TYPE_Q4_K)) {
-            if(tmp_hidden_dim>0 && (size/tmp_hidden_dim)%256!=0){
-                std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_F32) << "\t";
-                const auto s = param_loader_->offsets_[name].second / sizeof(float);
-                const auto tsize = alloc_quant_block(s, MLLM_TYPE_F32).second;
-                writeParam(name, MLLM_TYPE_F32, param, tsize);
-                std::cout << "  size:" << tsize << std::endl;
-                continue;
+        auto type = policyType(name);
+        if (type == MLLM_TYPE_COUNT) {
+            type = dataType;
+            if (find_names(name, q6_layers) && (dataType== MLLM_TYPE_Q6_K ||dataType == MLLM_TYPE_Q4_K)
+                && tmp_hidden_dim>0 && (size/tmp_hidden_dim)%256!=0) {
+                type = MLLM_TYPE_F32;
+            } else if (find_names(name, fp32_layers)) {
+                type = MLLM_TYPE_F32;
+            } else if (find_names(name, q4x4_2_q4_layers) && dataType == MLLM_TYPE_Q4_0_4_4) {
+                type = MLLM_TYPE_Q4_0;
             }
         }
-        if(find_names(name, fp32_layers)) {
-            std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_F32) << "\t";
-            const auto s = param_loader_->offsets_[name].second / sizeof(float);
-            const auto tsize = alloc_quant_block(s, MLLM_TYPE_F32).second;
-            writeParam(name, MLLM_TYPE_F32, param, tsize);
-            std::cout << "  size:" << tsize << std::endl;
-        }else if (find_names(name, q4x4_2_q4_layers) && dataType != MLLM_TYPE_Q6_K) {
-            // std::cout<<"q4x4_2_q4_layers"<<std::endl;
-            switch (dataType) {
-            case MLLM_TYPE_F32:
-                std::cout << "No need to quantize FP32 params\n";
-                __exit(-1);
-                break;
-            case MLLM_TYPE_Q4_0:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q4_K:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q6_K:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q6_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q8_0:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q8_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q8_K:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q8_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q4_0_4_4:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_Q4_0) << "\t";
-                block_t = alloc_quant_block(size, MLLM_TYPE_Q4_0);
-                quant_ptr = block_t.first;
-                quantize_row_q4_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            default:
-                break;
-            }
-            if (quant_ptr != nullptr) {
-                if (dataType ==MLLM_TYPE_Q4_0_4_4) {
-                    writeParam(name, MLLM_TYPE_Q4_0, quant_ptr, size);
-                    std::cout << "  size:" << size <<" type:"<< DataTypeName(MLLM_TYPE_Q4_0)<< std::endl;
-                } else {
-                    writeParam(name, quant_type_, quant_ptr, size);
-                    std::cout << "  size:" << size <<" type:"<< DataTypeName(quant_type_)<< std::endl;
-                }
-            }
-        } else if (find_names(name, q6_layers)) {
-            switch (dataType) {
-            case MLLM_TYPE_F32:
-                std::cout << "No need to quantize FP32 params\n";
-                __exit(-1);
-                break;
-            case MLLM_TYPE_Q4_0:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q4_K:
-            case MLLM_TYPE_Q6_K:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_Q6_K) << "\t";
-                block_t = alloc_quant_block(size, MLLM_TYPE_Q6_K);
-                quant_ptr = block_t.first;
-                quantize_row_q6_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q8_0:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q8_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q8_K:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q8_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q4_0_4_4:
-                std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_0_4x4(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            default:
-                break;
-            }
-            if (quant_ptr != nullptr) {
-                if ((dataType ==MLLM_TYPE_Q4_K)|(dataType ==MLLM_TYPE_Q6_K)) {
-                    writeParam(name, MLLM_TYPE_Q6_K, quant_ptr, size);
-                    std::cout << "  size:" << size <<" type:"<< DataTypeName(MLLM_TYPE_Q6_K)<< std::endl;
-                } else {
-                    writeParam(name, quant_type_, quant_ptr, size);
-                    std::cout << "  size:" << size <<" type:"<< DataTypeName(quant_type_)<< std::endl;
-                }
-            }
-        } else {
-            std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-            switch (dataType) {
-            case MLLM_TYPE_F32:
-                std::cout << "No need to quantize FP32 params\n";
-                __exit(-1);
-                break;
-            case MLLM_TYPE_Q4_0:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q8_0:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q8_0(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q4_K:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q6_K:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q6_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q8_K:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q8_K(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_Q4_0_4_4:
-                block_t = alloc_quant_block(size, dataType);
-                quant_ptr = block_t.first;
-                quantize_row_q4_0_4x4(param, quant_ptr, size);
-                size = block_t.second;
-                break;
-            case MLLM_TYPE_I8:
-            case MLLM_TYPE_Q4_1:
-            case MLLM_TYPE_Q8_1:
-            case MLLM_TYPE_I16:
-            case MLLM_TYPE_I32:
-            case MLLM_TYPE_F16:
-                NOT_IMPLEMENTED(dataType);
-                break;
-            case MLLM_TYPE_COUNT:
-                UNREACHABLE()
-                break;
-            default:
-                break;
-            }
-            if (quant_ptr != nullptr) {
-                writeParam(name, quant_type_, quant_ptr, size);
-                std::cout << "  size:" << size << std::endl;
-            }
-            // writeParam(name, quant_type_, quant_ptr, size);
-#ifndef TEST
-            delete[] (char *)quant_ptr;
-#endif
+        switch (type) {
+        case MLLM_TYPE_I8:
+        case MLLM_TYPE_Q4_1:
+        case MLLM_TYPE_Q8_1:
+        case MLLM_TYPE_I16:
+        case MLLM_TYPE_I32:
+        case MLLM_TYPE_F16:
+            NOT_IMPLEMENTED(type);
+            break;
+        case MLLM_TYPE_COUNT:
+            UNREACHABLE()
+            break;
+        default:
+            break;
         }
+        quantParam(writes, name, type, rowSize(name, size));
     }
+    writes.wait();
     writeIndex();
 }
 
@@ -279,58 +396,29 @@ void QuantWriter::quantParams_q4_(DataType dataType) {
         }
     }
     quant_type_ = dataType;
+    WriteQueue writes(2);
     for (const auto &name : param_names_) {
-        //        int force_quant_type = -1;
-        auto *param = getParam(name);
-        if (param == nullptr) {
+        if (param_loader_->data_type_[name] != MLLM_TYPE_F32) {
             __exit(-1);
         }
         auto size = param_loader_->offsets_[name].second / sizeof(float);
         if(find_names(name, {"norm"})) {
             tmp_hidden_dim = size;
         }
-        void *quant_ptr = nullptr;
-        std::pair<void *, uint64_t> block_t;
-        if(find_names(name, fp32_layers)) {
-            std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_F32) << "\t";
-            const auto s = param_loader_->offsets_[name].second / sizeof(float);
-            const auto tsize = alloc_quant_block(s, MLLM_TYPE_F32).second;
-            writeParam(name, MLLM_TYPE_F32, param, tsize);
-            std::cout << "  size:" << tsize << std::endl;
-        }else if (find_names(name, q4x4_2_q4_layers_)) {
-            // std::cout<<"q4x4_2_q4_layers"<<std::endl;
-            std::cout << "Quantize param " << name << " to " << DataTypeName(MLLM_TYPE_Q4_0) << "\t";
-            block_t = alloc_quant_block(size, MLLM_TYPE_Q4_0);
-            quant_ptr = block_t.first;
-            quantize_row_q4_0(param, quant_ptr, size);
-            size = block_t.second;
-            if (quant_ptr != nullptr) {
-                writeParam(name, MLLM_TYPE_Q4_0, quant_ptr, size);
-                std::cout << "  size:" << size <<" type:"<< DataTypeName(MLLM_TYPE_Q4_0)<< std::endl;
-            }
-        }else {
-            std::cout << "Quantize param " << name << " to " << DataTypeName(dataType) << "\t";
-            block_t = alloc_quant_block(size, dataType);
-            quant_ptr = block_t.first;
-            int tmp_hidden_dim_q4 = tmp_hidden_dim;
-            if (find_names(name, {"w2"})){
-                tmp_hidden_dim_q4 =(size/tmp_hidden_dim);
-            }
-            else if (find_names(name, {"down_proj"})){
-                tmp_hidden_dim_q4 =(size/tmp_hidden_dim);
+        auto type = policyType(name);
+        if (type == MLLM_TYPE_COUNT) {
+            if (find_names(name, fp32_layers)) {
+                type = MLLM_TYPE_F32;
+            } else if (find_names(name, q4x4_2_q4_layers_)) {
+                // the non-interleaved type of the same precision.
+                type = dataType == MLLM_TYPE_Q8_0_4_4 ? MLLM_TYPE_Q8_0 : MLLM_TYPE_Q4_0;
+            } else {
+                type = dataType;
             }
-            quantize_row_q4_0_4x4(param, quant_ptr, size, tmp_hidden_dim_q4);
-            size = block_t.second;
-            if (quant_ptr != nullptr) {
-                writeParam(name, quant_type_, quant_ptr, size);
-                std::cout << "  size:" << size << std::endl;
-            }
-            // writeParam(name, quant_type_, quant_ptr, size);
-#ifndef TEST
-            delete[] (char *)quant_ptr;
-#endif
         }
+        quantParam(writes, name, type, rowSize(name, size));
     }
+    writes.wait();
     writeIndex();
 }
 
@@ -1,5 +1,6 @@
 #include "ParamWriter.hpp"
 #include "ParamLoader.hpp"
+#include "Imatrix.hpp"
 #include "backends/cpu/quantize/QuantizeQ4.hpp"
 #include "backends/cpu/quantize/QuantizeQ8.hpp"
 #include <string>
@@ -29,6 +30,14 @@ static std::pair<void *, uint64_t> alloc_quant_block(uint64_t count, DataType ty
     return std::make_pair(data, size);
 }
 namespace mllm {
+class WriteQueue;
+/**
+ * \brief quantize the F32 params of a model file.
+ *
+ * each param is read, quantized and written in chunks of rows: the chunks are quantized on all threads,
+ * and written on a thread of its own while the next one is quantized. the input file is mmaped and the
+ * chunks that are done are dropped, so the memory used does not grow with the size of the model.
+ */
 class QuantWriter : public ParamWriter {
 public:
     ~QuantWriter();
@@ -36,6 +45,27 @@ public:
     int readParams();
     void quantParams(DataType dataType);
     void quantParams_q4_(DataType dataType);
+    /**
+     * \brief read the types of the params from a file of "<name> <type>" lines, e.g.
+     *          lm_head Q6_K
+     *          embed_tokens Q6_K
+     *        a param whose name contains <name> is quantized to <type> (F32 to keep it), the first line that
+     *        matches wins. the other params are quantized as quantParams() chooses. lines starting with '#' are
+     *        ignored.
+     * \return false if the file cannot be read or has an unknown type.
+     */
+    bool loadPolicy(const std::string &path);
+    /**
+     * \brief read an importance matrix (see Imatrix), the Q4_0, Q4_0_4_4, Q4_K and Q6_K params it has are
+     *        quantized for the squared errors it weighs.
+     */
+    bool loadImatrix(const std::string &path);
+    /**
+     * \brief the threads the params are quantized on, by default all CPUs.
+     */
+    void setThreads(int threads) {
+        threads_ = threads;
+    }
 
 #ifdef TEST
     std::unordered_map<string, char *> data_;
@@ -46,8 +76,16 @@ private:
     mllm::ParamLoader *param_loader_;
     DataType quant_type_;
     std::vector<std::string> param_names_;
-    float *getParam(std::string param_name);
+    std::vector<std::pair<std::string, DataType>> policy_;
+    Imatrix imatrix_;
+    int threads_;
+    // the type the policy file gives name, MLLM_TYPE_COUNT if none.
+    DataType policyType(const std::string &name) const;
+    // the elements of a row of name, for the interleaved types.
+    int rowSize(const std::string &name, uint64_t size) const;
+    // quantize name to type and write it.
+    void quantParam(WriteQueue &writes, const std::string &name, DataType type, int row_size);
     void writeParam(string name, DataType type, void *data, uint64_t size) override;
 };
 } // namespace mllm
-#endif
\ No newline at end of file
+#endif
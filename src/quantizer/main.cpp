@@ -5,19 +5,50 @@
 #include "ParamLoader.hpp"
 #include "backends/cpu/quantize/QuantizeQ4.hpp"
 #include "backends/cpu/quantize/QuantizeQ8.hpp"
+#include <cstdlib>
 #include <string>
 #include "QuantWriter.hpp"
 
 
+static int usage() {
+    std::cout << "Usage: ./quantize <input_path> <output_path> <quant_type> [-c <policy_file>] [-i <imatrix_file>] [-t <threads>]\n";
+    return -1;
+}
+
 int main(int argc, char **argv) {
-    if (argc != 4) {
-        std::cout << "Usage: ./quantize <input_path> <output_path> <quant_type>\n";
-        return -1;
+    if (argc < 4 || argc % 2 != 0) {
+        return usage();
     }
     auto input_path = std::string(argv[1]);
     auto output_path = std::string(argv[2]);
     auto quant_type = std::string(argv[3]);
     mllm::QuantWriter quant_writer(output_path, input_path);
+    for (int i = 4; i < argc; i += 2) {
+        auto option = std::string(argv[i]);
+        if (i + 1 >= argc) {
+            return usage();
+        }
+        if (option == "-c") {
+            if (!quant_writer.loadPolicy(argv[i + 1])) {
+                return -1;
+            }
+        } else if (option == "-i") {
+            if (!quant_writer.loadImatrix(argv[i + 1])) {
+                return -1;
+            }
+        } else if (option == "-t") {
+            char *end = nullptr;
+            const long threads = std::strtol(argv[i + 1], &end, 10);
+            if (end == argv[i + 1] || *end != '\0' || threads <= 0 || threads > 1024) {
+                std::cout << "Invalid number of threads " << argv[i + 1] << "\n";
+                return usage();
+            }
+            quant_writer.setThreads((int)threads);
+        } else {
+            std::cout << "Unknown option " << option << "\n";
+            return -1;
+        }
+    }
     int param_count = quant_writer.readParams();
     if (param_count <= 0) {
         std::cout << "No params to quantize\n";
@@ -36,6 +67,8 @@ int main(int argc, char **argv) {
         quant_writer.quantParams(MLLM_TYPE_Q8_K);
     }  else if (quant_type == "Q4_0_4_4") {
         quant_writer.quantParams_q4_(MLLM_TYPE_Q4_0_4_4);
+    } else if (quant_type == "Q8_0_4_4") {
+        quant_writer.quantParams_q4_(MLLM_TYPE_Q8_0_4_4);
     } else {
         std::cout << "Quant type " << quant_type << " is not supported\n";
         return -1;
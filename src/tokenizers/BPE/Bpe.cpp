@@ -4,7 +4,9 @@
 
 #include "Bpe.hpp"
 #include <iostream>
-#include <regex>
+#include <algorithm>
+#include <cstring>
+#include <functional>
 #include <codecvt>
 #include <unordered_map>
 
@@ -13,84 +15,171 @@ static size_t utf8_len(char src) {
     uint8_t highbits = static_cast<uint8_t>(src) >> 4;
     return lookup[highbits];
 }
-static std::vector<std::pair<string, string>> get_pairs(vector<string> word) {
-    std::vector<std::pair<string, string>> pairs;
-    for (int i = 1; i < word.size(); ++i) {
-        pairs.emplace_back(word[i - 1], word[i]);
+static bool is_word_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+static bool is_space_char(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// the next word of text at or after pos, its length is 0 at the end of the text.
+static size_t next_word(const std::string &text, size_t &pos) {
+    static const char *specials[] = {"<|startoftext|>", "<|endoftext|>", "'s", "'t", "'re", "'ve", "'m", "'ll", "'d"};
+    const size_t size = text.size();
+    while (pos < size && is_space_char(text[pos])) {
+        ++pos;
+    }
+    if (pos == size) {
+        return 0;
+    }
+    if (text[pos] == '<' || text[pos] == '\'') {
+        for (const char *special : specials) {
+            const size_t length = strlen(special);
+            if (text.compare(pos, length, special) == 0) {
+                return length;
+            }
+        }
+    }
+    // \w+, or \S+ (which also takes the word characters after it).
+    const bool word = is_word_char(text[pos]);
+    size_t length = 1;
+    while (pos + length < size && (word ? is_word_char(text[pos + length]) : !is_space_char(text[pos + length]))) {
+        ++length;
     }
-    return pairs;
+    return length;
 }
-vector<std::string> mllm::BPETokenizer::bpe(const std::string &token, std::string end_symbol) {
-    std::wstring_convert<std::codecvt_utf8_utf16<char32_t>, char32_t> converter;
-    std::u32string u32_token = converter.from_bytes(token);
 
-    std::vector<std::string> word_splits;
-    for (char32_t c : u32_token) {
-        word_splits.push_back(converter.to_bytes(c));
+std::vector<std::string> mllm::BPETokenizer::pretokenize(const std::string &text) {
+    std::vector<std::string> words;
+    size_t pos = 0;
+    for (size_t length = next_word(text, pos); length > 0; pos += length, length = next_word(text, pos)) {
+        words.emplace_back(text, pos, length);
     }
-    std::string last_str = word_splits.back();
-    word_splits.pop_back();
-    // word_splits.push_back(last_str + "</w>");
-    word_splits.push_back(last_str + end_symbol);
+    return words;
+}
 
-    auto pairs = get_pairs(word_splits);
-    if (pairs.empty()) {
-        // return {token + "</w>"};
-        return {token + end_symbol};
+void mllm::BPETokenizer::tryMergePair(int left, int right) {
+    if (left == -1 || right == -1) {
+        return;
+    }
+    const auto &first = word_symbols_[left];
+    const auto &second = word_symbols_[right];
+    if (first.piece < 0 || second.piece < 0) {
+        return;
+    }
+    auto merge = merge_pieces_.find((uint64_t)first.piece << 32 | (uint32_t)second.piece);
+    if (merge == merge_pieces_.end()) {
+        return;
     }
+    word_pairs_.push_back({merge->second.rank, left, right, first.piece, second.piece, merge->second.piece});
+    std::push_heap(word_pairs_.begin(), word_pairs_.end(), std::greater<>());
+}
 
-    while (true) {
-        auto bigram = *std::min_element(pairs.begin(), pairs.end(), [this](const auto &a, const auto &b) {
-            auto string_a = std::string(a.first) + " " + std::string(a.second);
-            auto string_b = std::string(b.first) + " " + std::string(b.second);
-            auto rank_a = merge_rank.count(string_a) ? merge_rank.at(string_a) : INFINITY;
-            auto rank_b = merge_rank.count(string_b) ? merge_rank.at(string_b) : INFINITY;
-            return rank_a < rank_b;
-        });
-        auto bigram_string = std::string(bigram.first) + " " + std::string(bigram.second);
-        if (merge_rank.find(bigram_string) == merge_rank.end()) {
-            break;
+void mllm::BPETokenizer::mergeWord(const std::string &token, const std::string &end_symbol) {
+    word_ = token;
+    word_ += end_symbol;
+    word_symbols_.clear();
+    word_pairs_.clear();
+    // one symbol per character, the end_symbol belongs to the last one.
+    for (size_t offset = 0; offset < token.size();) {
+        const size_t length = std::min(token.size() - offset, utf8_len(token[offset]));
+        const int idx = (int)word_symbols_.size();
+        word_symbols_.push_back({offset, length, -1, idx - 1, idx + 1});
+        offset += length;
+    }
+    if (word_symbols_.empty()) {
+        return;
+    }
+    word_symbols_.back().length += end_symbol.size();
+    word_symbols_.back().next = -1;
+    for (auto &symbol : word_symbols_) {
+        auto piece = piece_ids_.find(word_.substr(symbol.begin, symbol.length));
+        symbol.piece = piece == piece_ids_.end() ? -1 : piece->second;
+    }
+    for (int i = 1; i < word_symbols_.size(); ++i) {
+        tryMergePair(i - 1, i);
+    }
+    // the pair with the lowest rank first, and the leftmost one of those.
+    while (!word_pairs_.empty()) {
+        std::pop_heap(word_pairs_.begin(), word_pairs_.end(), std::greater<>());
+        const auto pair = word_pairs_.back();
+        word_pairs_.pop_back();
+        auto &first = word_symbols_[pair.left];
+        auto &second = word_symbols_[pair.right];
+        // one of the symbols has been merged since.
+        if (first.length == 0 || second.length == 0 || first.next != pair.right
+            || first.piece != pair.left_piece || second.piece != pair.right_piece) {
+            continue;
+        }
+        first.length += second.length;
+        first.piece = pair.piece;
+        first.next = second.next;
+        second.length = 0;
+        if (second.next != -1) {
+            word_symbols_[second.next].prev = pair.left;
         }
+        tryMergePair(first.prev, pair.left);
+        tryMergePair(pair.left, first.next);
+    }
+}
 
-        string first = bigram.first, second = bigram.second;
-        vector<std::string> new_word;
-        int i = 0;
-        int j = 0;
-        while (i < word_splits.size()) {
-            // find first at word_splits[i:]
-            bool found = false;
-            for (j = i; j < word_splits.size(); ++j) {
-                if (word_splits[j] == first) {
-                    found = true;
-                    for (int k = i; k < j; ++k) {
-                        new_word.emplace_back(word_splits[k]);
-                    }
-                    i = j;
-                    break;
-                }
-            }
-            if (!found) {
-                new_word.insert(new_word.end(), word_splits.begin() + i, word_splits.end());
-                break;
-            }
-            if (word_splits[i] == first && i < word_splits.size() - 1 && word_splits[i + 1] == second) {
-                new_word.emplace_back(first + second);
-                i += 2;
-            } else {
-                new_word.emplace_back(word_splits[i]);
-                i++;
-            }
+vector<std::string> mllm::BPETokenizer::bpe(const std::string &token, std::string end_symbol) {
+    mergeWord(token, end_symbol);
+    std::vector<std::string> word_splits;
+    for (const auto &symbol : word_symbols_) {
+        if (symbol.length > 0) {
+            word_splits.emplace_back(word_, symbol.begin, symbol.length);
         }
-        word_splits = new_word;
-        if (word_splits.size() == 1) {
-            break;
+    }
+    return word_splits;
+}
+
+const std::vector<mllm::token_id_t> &mllm::BPETokenizer::encodeWord(const std::string &word, const std::string &end_symbol, bool byte_fallback) {
+    if (end_symbol != word_cache_end_symbol_ || byte_fallback != word_cache_byte_fallback_) {
+        word_cache_.clear();
+        word_cache_index_.clear();
+        word_cache_end_symbol_ = end_symbol;
+        word_cache_byte_fallback_ = byte_fallback;
+    }
+    auto cached = word_cache_index_.find(word);
+    if (cached != word_cache_index_.end()) {
+        word_cache_.splice(word_cache_.end(), word_cache_, cached->second);
+        return cached->second->second;
+    }
+    mergeWord(word, end_symbol);
+    std::vector<token_id_t> ids;
+    for (const auto &symbol : word_symbols_) {
+        if (symbol.length == 0) {
+            continue;
+        }
+        int64_t vocab_id = symbol.piece >= 0 ? piece_vocab_[symbol.piece] : -1;
+        if (symbol.piece < 0) {
+            auto result = this->vocab_map_.find(word_.substr(symbol.begin, symbol.length));
+            vocab_id = result != this->vocab_map_.end() ? (int64_t)result->second : -1;
+        }
+        if (vocab_id >= 0) {
+            ids.emplace_back(id_token_[vocab_id].score);
+        } else if (!byte_fallback) {
+            ids.emplace_back(mllm::BPETokenizer::TokenUnk);
         } else {
-            pairs = get_pairs(word_splits);
+            for (size_t j = symbol.begin; j < symbol.begin + symbol.length; ++j) {
+                token_id_t token_id = static_cast<uint8_t>(word_[j]) + 3;
+                ids.emplace_back(token_id);
+            }
         }
     }
-
-    // cache[token] = word_splits;
-    return word_splits;
+    if (word_cache_size_ == 0) {
+        word_cache_.clear();
+        word_cache_.emplace_back(word, std::move(ids));
+        return word_cache_.back().second;
+    }
+    if (word_cache_.size() >= word_cache_size_) {
+        word_cache_index_.erase(word_cache_.front().first);
+        word_cache_.pop_front();
+    }
+    word_cache_.emplace_back(word, std::move(ids));
+    word_cache_index_[word] = std::prev(word_cache_.end());
+    return word_cache_.back().second;
 }
 
 void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos, std::vector<std::string> &special_tokens, bool byte_fallback) {
@@ -121,33 +210,12 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
         tokens.emplace_back(mllm::BPETokenizer::TokenBos);
     }
     if (!merge_rank.empty()) {
-        std::vector<std::string> words;
-        std::regex pattern("<\\|startoftext\\|>|<\\|endoftext\\|>|'s|'t|'re|'ve|'m|'ll|'d|\\w+|\\d+|\\S+");
-        std::smatch match;
-
-        std::string::const_iterator searchStart(text.cbegin());
-        while (std::regex_search(searchStart, text.cend(), match, pattern)) {
-            words.push_back(match.str());
-            searchStart = match.suffix().first;
-        }
-
-        for (const auto &word : words) {
-            auto word_splits = bpe(word, end_symbol);
-            for (const auto &word_split : word_splits) {
-                if (auto result = this->vocab_map_.find(word_split); result != this->vocab_map_.end()) {
-                    auto token_idx = result->second;
-                    tokens.emplace_back(id_token_[token_idx].score);
-                } else {
-                    if (!byte_fallback) {
-                        tokens.emplace_back(mllm::BPETokenizer::TokenUnk);
-                    } else {
-                        for (const char j : word_split) {
-                            token_id_t token_id = static_cast<uint8_t>(j) + 3;
-                            tokens.emplace_back(token_id);
-                        }
-                    }
-                }
-            }
+        std::string word;
+        size_t pos = 0;
+        for (size_t length = next_word(text, pos); length > 0; pos += length, length = next_word(text, pos)) {
+            word.assign(text, pos, length);
+            const auto &ids = encodeWord(word, end_symbol, byte_fallback);
+            tokens.insert(tokens.end(), ids.begin(), ids.end());
         }
         if (TokenEos > 0) {
             tokens.push_back(TokenEos);
@@ -214,6 +282,40 @@ void mllm::BPETokenizer::tokenize(const std::string &text, std::vector<token_id_
 
 void mllm::BPETokenizer::setMergeRank(const std::unordered_map<string, unsigned> &merge_rank) {
     this->merge_rank = merge_rank;
+    merge_pieces_.clear();
+    piece_ids_.clear();
+    piece_vocab_.clear();
+    word_cache_.clear();
+    word_cache_index_.clear();
+    auto piece_id = [this](const std::string &piece) {
+        auto it = piece_ids_.find(piece);
+        if (it != piece_ids_.end()) {
+            return it->second;
+        }
+        const auto id = (int32_t)piece_vocab_.size();
+        auto vocab = this->vocab_map_.find(piece);
+        piece_vocab_.push_back(vocab != this->vocab_map_.end() ? (int64_t)vocab->second : -1);
+        piece_ids_[piece] = id;
+        return id;
+    };
+    // a merge is "first second".
+    for (const auto &[merge, rank] : merge_rank) {
+        auto space = merge.find(' ');
+        if (space == std::string::npos || space == 0 || space + 1 == merge.size()) {
+            continue;
+        }
+        const auto first = merge.substr(0, space);
+        const auto second = merge.substr(space + 1);
+        const auto left = piece_id(first);
+        const auto right = piece_id(second);
+        merge_pieces_[(uint64_t)left << 32 | (uint32_t)right] = {rank, piece_id(first + second)};
+    }
+}
+
+void mllm::BPETokenizer::setWordCacheSize(size_t size) {
+    word_cache_size_ = size;
+    word_cache_.clear();
+    word_cache_index_.clear();
 }
 
 void mllm::BPETokenizer::tryMergeSymbol(size_t start, size_t end) {
@@ -4,6 +4,7 @@
 
 #ifndef MLLM_BPE_HPP
 #define MLLM_BPE_HPP
+#include <list>
 #include <queue>
 #include "tokenizers/Tokenizer.hpp"
 #include <unordered_map>
@@ -32,6 +33,52 @@ class BPETokenizer final : public Tokenizer {
     void tryMergeSymbol(size_t start, size_t end);
     std::unordered_map<unsigned char, std::string> bytes_to_unicode_;
 
+    /**
+     * the merges, with the strings they are made of numbered as pieces. merge_pieces_[a << 32 | b] is the rank
+     * of the merge of the pieces a and b and the piece it gives.
+     */
+    struct Merge {
+        unsigned rank;
+        int32_t piece;
+    };
+    std::unordered_map<uint64_t, Merge> merge_pieces_;
+    std::unordered_map<std::string, int32_t> piece_ids_;
+    // the vocab id of each piece, -1 if it is not in the vocab.
+    std::vector<int64_t> piece_vocab_;
+    // a symbol of the word being merged, a range of word_.
+    struct WordSymbol {
+        size_t begin;
+        size_t length;
+        int32_t piece;
+        int prev;
+        int next;
+    };
+    struct WordPair {
+        unsigned rank;
+        int left;
+        int right;
+        int32_t left_piece;
+        int32_t right_piece;
+        int32_t piece;
+        bool operator>(const WordPair &other) const {
+            return rank > other.rank || (rank == other.rank && left > other.left);
+        }
+    };
+    std::string word_;
+    std::vector<WordSymbol> word_symbols_;
+    std::vector<WordPair> word_pairs_;
+    void mergeWord(const std::string &token, const std::string &end_symbol);
+    void tryMergePair(int left, int right);
+
+    // the ids of the last words, least recently used first.
+    using WordIds = std::pair<std::string, std::vector<token_id_t>>;
+    std::list<WordIds> word_cache_;
+    std::unordered_map<std::string, std::list<WordIds>::iterator> word_cache_index_;
+    size_t word_cache_size_ = 4096;
+    std::string word_cache_end_symbol_;
+    bool word_cache_byte_fallback_ = false;
+    const std::vector<token_id_t> &encodeWord(const std::string &word, const std::string &end_symbol, bool byte_fallback);
+
 public:
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos) override;
     vector<std::string> bpe(const std::string &token, std::string end_symbol);
@@ -39,6 +86,15 @@ public:
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos, bool byte_fallback, std::string end_symbol);
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, const std::vector<std::string> &special);
     void setMergeRank(const std::unordered_map<string, unsigned> &merge_rank);
+    /**
+     * \brief the number of words whose token ids are kept, 0 disables the cache.
+     */
+    void setWordCacheSize(size_t size);
+    /**
+     * \brief split text into the words that are merged, as the pattern
+     *        <|startoftext|>|<|endoftext|>|'s|'t|'re|'ve|'m|'ll|'d|\\w+|\\d+|\\S+ does.
+     */
+    static std::vector<std::string> pretokenize(const std::string &text);
     explicit BPETokenizer(const std::string &vocab_file);
 };
 } // namespace mllm
@@ -8,10 +8,12 @@ using namespace mllm;
 
 UnigramTokenizer::UnigramTokenizer(const std::string &vocab_file) :
     Tokenizer(std::move(vocab_file)) {
-    for (auto &item : this->id_token_) {
-        std::vector<char> vec(item.token.begin(), item.token.end());
-        trie_.insert(vec);
+    std::vector<DoubleArrayTrie::Entry> entries;
+    entries.reserve(this->vocab_map_.size());
+    for (auto &item : this->vocab_map_) {
+        entries.push_back({item.first, (int32_t)item.second, this->id_token_[item.second].score});
     }
+    trie_.build(std::move(entries));
 }
 
 void UnigramTokenizer::tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos, bool byte_fallback) {
@@ -22,39 +24,26 @@ void UnigramTokenizer::tokenize(const std::string &text, std::vector<token_id_t>
         tokens.emplace_back(TokenBos);
     }
 
+    const std::string_view view(text);
     auto size = text.size();
     std::vector<BestPath> best_path(size + 1);
     auto unk_score = this->min_score_ - K_UNK_PENALTY;
-    auto starts_at = 0;
-    while (starts_at < size) {
+    const size_t mblen = 1;
+    for (size_t starts_at = 0; starts_at < size; starts_at += mblen) {
         auto best_path_score = best_path[starts_at].best_path_score;
         bool has_single_char = false;
-        auto sub_str = text.substr(starts_at);
-        auto mblen = 1;
-        std::vector<char> vec(sub_str.begin(), sub_str.end());
-        auto sub_len = sub_str.length();
-        auto iter = trie_.commonPrefixSearch(vec);
-        auto item = iter->next();
-        // for (std::vector<char> item = iter.next(); !item.empty(); item = iter.next()) {
-        while (!item.empty()) {
-            auto key_pos = starts_at + item.size();
-            auto token = std::string(item.begin(), item.end());
-            auto token_id = this->vocab_map_.find(token);
-            auto &target_node = best_path[key_pos];
-            if (token_id != this->vocab_map_.end()) {
-                auto score = this->id_token_[token_id->second].score;
-                auto new_score = best_path_score + score;
-                if (new_score > target_node.best_path_score || target_node.starts_at == -1) {
-                    target_node.best_path_score = new_score;
-                    target_node.starts_at = starts_at;
-                    target_node.id = token_id->second;
-                }
-                if (!has_single_char && item.size() == mblen) {
-                    has_single_char = true;
-                }
+        trie_.commonPrefixSearch(view.substr(starts_at), [&](size_t length, int32_t id, float score) {
+            auto &target_node = best_path[starts_at + length];
+            auto new_score = best_path_score + score;
+            if (new_score > target_node.best_path_score || target_node.starts_at == -1) {
+                target_node.best_path_score = new_score;
+                target_node.starts_at = starts_at;
+                target_node.id = id;
             }
-            item = iter->next();
-        }
+            if (length == mblen) {
+                has_single_char = true;
+            }
+        });
         if (!has_single_char) {
             auto &target_node = best_path[starts_at + mblen];
             auto new_score = best_path_score + unk_score;
@@ -64,45 +53,36 @@ void UnigramTokenizer::tokenize(const std::string &text, std::vector<token_id_t>
                 target_node.id = TokenUnk;
             }
         }
-        starts_at += mblen;
     }
-    auto ends_at = size;
-    std::vector<std::string> result;
-    //    std::vector<std::string> token_;
-    std::string token_;
-    while (ends_at > 0) {
-        auto target_node = best_path[ends_at];
-        //        starts_at = target_node.starts_at;
-        auto sub_str = text.substr(target_node.starts_at, ends_at - target_node.starts_at);
-
-        if (target_node.id == TokenUnk) {
-            token_.append(sub_str);
+    // the path backwards, a run of unknown bytes is kept as one piece.
+    std::vector<std::pair<size_t, size_t>> pieces;
+    for (size_t ends_at = size; ends_at > 0;) {
+        const auto &target_node = best_path[ends_at];
+        const size_t starts_at = target_node.starts_at;
+        if (target_node.id == TokenUnk && !pieces.empty() && best_path[pieces.back().second].id == TokenUnk) {
+            pieces.back().first = starts_at;
         } else {
-            if (!token_.empty()) {
-                std::reverse(token_.begin(), token_.end());
-                result.emplace_back(token_);
-                token_.clear();
-            }
-            result.emplace_back(sub_str);
+            pieces.emplace_back(starts_at, ends_at);
         }
-        ends_at = target_node.starts_at;
+        ends_at = starts_at;
     }
-    if (!token_.empty()) {
-        std::reverse(token_.begin(), token_.end());
-        result.emplace_back(token_);
-        token_.clear();
-    }
-    std::reverse(result.begin(), result.end());
+    std::reverse(pieces.begin(), pieces.end());
 
-    for (auto &item : result) {
+    for (const auto &piece : pieces) {
+        const auto &node = best_path[piece.second];
+        if (node.id != TokenUnk) {
+            tokens.emplace_back(node.id);
+            continue;
+        }
+        const auto item = text.substr(piece.first, piece.second - piece.first);
         auto token_id = this->vocab_map_.find(item);
         if (token_id != this->vocab_map_.end()) {
             tokens.emplace_back(token_id->second);
         } else {
             if (byte_fallback) {
                 for (char j : item) {
-                    char *byte_string = new char[10];
-                    sprintf(byte_string, "<0x%02X>", j);
+                    char byte_string[16];
+                    snprintf(byte_string, sizeof(byte_string), "<0x%02X>", (unsigned char)j);
                     auto result = this->vocab_map_.find(byte_string);
                     if (result != this->vocab_map_.end()) {
                         tokens.emplace_back(result->second);
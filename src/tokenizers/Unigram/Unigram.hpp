@@ -13,7 +13,7 @@ class UnigramTokenizer final : public Tokenizer {
         float best_path_score = 0.0;
         int64_t starts_at = -1;
     };
-    Trie<char> trie_;
+    DoubleArrayTrie trie_;
 
 public:
     void tokenize(const std::string &text, std::vector<token_id_t> &tokens, bool bos) override;
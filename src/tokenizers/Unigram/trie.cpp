@@ -0,0 +1,84 @@
+//
+// Created by Xiang Li on 2023/12/3.
+//
+#include <algorithm>
+#include "trie.hpp"
+
+namespace mllm {
+
+void DoubleArrayTrie::build(std::vector<Entry> entries) {
+    // std::string compares its bytes as unsigned char, the children of a node are then sorted by label.
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.key < b.key; });
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry &entry) { return entry.key.empty(); }), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.key == b.key; }), entries.end());
+    units_.assign(1, Unit());
+    used_base_.assign(1, false);
+    // the root, bases start at 1 so that it is no node's child.
+    units_[0].check = 0;
+    next_free_ = 1;
+    if (!entries.empty()) {
+        insert(0, entries, 0, entries.size(), 0);
+    }
+    while (units_.size() > 1 && units_.back().check < 0) {
+        units_.pop_back();
+    }
+    units_.shrink_to_fit();
+    used_base_.clear();
+    used_base_.shrink_to_fit();
+}
+
+void DoubleArrayTrie::insert(int32_t node, const std::vector<Entry> &entries, size_t begin, size_t end, size_t depth) {
+    // the keys in [begin, end) share their first `depth` bytes, only the first one can end here.
+    if (entries[begin].key.size() == depth) {
+        units_[node].id = entries[begin].id;
+        units_[node].score = entries[begin].score;
+        ++begin;
+    }
+    if (begin == end) {
+        return;
+    }
+    // the children, by label, and the range of keys below each of them.
+    std::vector<std::pair<uint8_t, size_t>> children;
+    for (size_t i = begin; i < end; ++i) {
+        const auto label = (uint8_t)entries[i].key[depth];
+        if (children.empty() || children.back().first != label) {
+            children.emplace_back(label, i);
+        }
+    }
+    const int32_t first_label = children.front().first;
+    int32_t base = 0;
+    for (size_t pos = std::max(next_free_, (size_t)first_label + 1);; ++pos) {
+        if (pos + 256 >= units_.size()) {
+            units_.resize(pos + 257 + units_.size() / 2);
+            used_base_.resize(units_.size(), false);
+        }
+        if (units_[pos].check >= 0 || used_base_[pos - first_label]) {
+            continue;
+        }
+        base = (int32_t)pos - first_label;
+        bool fits = true;
+        for (const auto &child : children) {
+            if (units_[base + child.first].check >= 0) {
+                fits = false;
+                break;
+            }
+        }
+        if (fits) {
+            break;
+        }
+    }
+    used_base_[base] = true;
+    units_[node].base = base;
+    for (const auto &child : children) {
+        units_[base + child.first].check = node;
+    }
+    while (next_free_ < units_.size() && units_[next_free_].check >= 0) {
+        ++next_free_;
+    }
+    for (size_t i = 0; i < children.size(); ++i) {
+        const size_t child_end = i + 1 < children.size() ? children[i + 1].second : end;
+        insert(base + children[i].first, entries, children[i].second, child_end, depth + 1);
+    }
+}
+
+} // namespace mllm
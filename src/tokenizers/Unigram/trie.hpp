@@ -4,92 +4,75 @@
 
 #ifndef MLLM_TRIE_HPP
 #define MLLM_TRIE_HPP
-#include "vector"
-#include "unordered_map"
-#include "string"
-class TrieIterator;
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace mllm {
-template <typename Value>
-class TrieIterator;
-
-template <typename Value>
-class Trie {
+/**
+ * \brief a double-array trie of byte strings, each with a token id and a score.
+ *
+ * the nodes are kept in one array. The child of node s for byte c is node base(s) + c if its check is s,
+ * so a lookup takes one array access per byte and no allocation. The id and score of a key are stored in
+ * the node the key ends at.
+ */
+class DoubleArrayTrie {
 public:
-    struct Node {
-        std::unordered_map<Value, Node *> children;
-        //        Value value;
-        bool is_leaf = false;
+    struct Entry {
+        std::string key;
+        int32_t id;
+        float score;
     };
 
-private:
-    Node *root;
-
-public:
-    Trie():
-        root(new Node()) {
-    }
+    /**
+     * \brief build the trie. empty keys are ignored, of duplicate keys the first one is kept.
+     */
+    void build(std::vector<Entry> entries);
 
-    void insert(const std::vector<Value> &key) {
-        auto node = root;
-        for (auto ch : key) {
-            auto next = node->children.find(ch);
-            if (next == node->children.end()) {
-                auto new_node = new Node();
-                node->children[ch] = new_node;
-                node = new_node;
-            } else {
-                node = next->second;
+    /**
+     * \brief call fn(length, id, score) for every key that is a prefix of text, shortest first.
+     */
+    template <typename Func>
+    void commonPrefixSearch(std::string_view text, Func &&fn) const {
+        if (units_.empty()) {
+            return;
+        }
+        int32_t node = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            const int32_t next = units_[node].base + (uint8_t)text[i];
+            if (next >= (int32_t)units_.size() || units_[next].check != node) {
+                return;
+            }
+            node = next;
+            if (units_[node].id >= 0) {
+                fn(i + 1, units_[node].id, units_[node].score);
             }
         }
-        node->is_leaf = true;
     }
 
-    TrieIterator<Value> *iterator() {
-        return new TrieIterator<Value>(root, std::vector<char>());
+    /**
+     * \brief the number of nodes, including the unused ones.
+     */
+    size_t size() const {
+        return units_.size();
     }
 
-    TrieIterator<Value> *commonPrefixSearch(const std::vector<Value> &labels) {
-        auto node = root;
-        auto tmp = new TrieIterator<Value>(node, labels);
-        return tmp;
-    }
-};
-
-template <typename Value>
-class TrieIterator {
-public:
-    typename Trie<Value>::Node *node;
-    std::vector<char> path;
-    std::vector<Value> labels;
-    typename std::vector<Value>::iterator end;
-    typename std::vector<Value>::iterator iter;
+private:
+    struct Unit {
+        int32_t base = 0;
+        int32_t check = -1; // the parent, -1 if the node is unused
+        int32_t id = -1;    // the id of the key ending here, -1 if none
+        float score = 0;
+    };
 
-    TrieIterator(typename Trie<Value>::Node *node, std::vector<Value> labels) :
-        node(node), labels(labels) {
-        path.clear();
-        iter = this->labels.begin();
-        end = this->labels.end();
-    }
+    void insert(int32_t node, const std::vector<Entry> &entries, size_t begin, size_t end, size_t depth);
 
-    std::vector<char> next() {
-        while (iter != end) {
-            auto next = node->children.find(*iter);
-            if (next != node->children.end()) {
-                node = next->second;
-                path.push_back(*iter);
-                if (node->is_leaf) {
-                    ++iter;
-                    return path;
-                }
-            } else {
-                ++iter;
-                return {};
-            }
-            ++iter;
-        }
-        return {};
-    }
+    std::vector<Unit> units_;
+    std::vector<bool> used_base_;
+    // no node before it is unused.
+    size_t next_free_ = 1;
 };
 } // namespace mllm
 
@@ -0,0 +1,193 @@
+#include "CPUTest.hpp"
+#include "backends/cpu/compute/Arch.hpp"
+#include "backends/cpu/compute/GEMM_AArch64.hpp"
+#include "backends/cpu/compute/VecDotType.hpp"
+#include "backends/cpu/quantize/QuantizeQ4.hpp"
+#include "backends/cpu/quantize/QuantizeQ6.hpp"
+#include "backends/cpu/quantize/QuantizeQ8.hpp"
+
+static vector<float> archTestRow(int n, int seed) {
+    vector<float> row(n);
+    for (int i = 0; i < n; ++i) {
+        row[i] = (float)((i * 37 + seed * 101) % 97) / 48.0F - 1.0F;
+    }
+    return row;
+}
+
+static float archTestDot(const vector<float> &x, const vector<float> &y) {
+    double sum = 0;
+    for (int i = 0; i < x.size(); ++i) {
+        sum += (double)x[i] * y[i];
+    }
+    return (float)sum;
+}
+
+TEST_F(CPUTest, CPUArchSelect) {
+    const auto &variants = mllm::arch_variants();
+    ASSERT_FALSE(variants.empty());
+    const auto &kernels = mllm::arch_kernels();
+    ASSERT_NE(std::find(variants.begin(), variants.end(), &kernels), variants.end());
+    // type_traits uses the selected copies directly.
+    ASSERT_EQ(type_traits[MLLM_TYPE_F32].vec_dot, (mllm_vec_dot_func)kernels.vec_dot_fp32);
+    ASSERT_EQ(type_traits[MLLM_TYPE_Q4_0].vec_dot, kernels.vec_dot_q4_0_q8_0);
+    ASSERT_EQ(type_traits[MLLM_TYPE_Q4_K].vec_dot, kernels.vec_dot_q4_K_q8_K);
+    ASSERT_EQ(type_traits[MLLM_TYPE_Q8_0].from_float, (mllm_from_float_func)kernels.quantize_row_q8_0);
+}
+
+TEST_F(CPUTest, CPUArchVecDot) {
+    const int n = 2 * QK_K;
+    const auto x = archTestRow(n, 1);
+    const auto y = archTestRow(n, 2);
+    vector<mllm_fp16_t> x_fp16(n), y_fp16(n);
+    for (int i = 0; i < n; ++i) {
+        x_fp16[i] = MLLM_FP32_TO_FP16(x[i]);
+        y_fp16[i] = MLLM_FP32_TO_FP16(y[i]);
+    }
+    vector<block_q4_0> x_q4_0(n / QK4_0);
+    vector<block_q8_0> x_q8_0(n / QK8_0), y_q8_0(n / QK8_0);
+    vector<block_q4_K> x_q4_K(n / QK_K);
+    vector<block_q6_K> x_q6_K(n / QK_K);
+    vector<block_q8_K> y_q8_K(n / QK_K);
+    quantize_row_q4_0(x.data(), x_q4_0.data(), n);
+    quantize_row_q8_0(x.data(), x_q8_0.data(), n);
+    quantize_row_q8_0(y.data(), y_q8_0.data(), n);
+    quantize_row_q4_K(x.data(), x_q4_K.data(), n);
+    quantize_row_q6_K(x.data(), x_q6_K.data(), n);
+    quantize_row_q8_K(y.data(), y_q8_K.data(), n);
+    // the references use the dequantized rows, so only the accumulation order differs.
+    vector<float> dx(n), dy(n);
+    dequantize_row_q8_0(y_q8_0.data(), dy.data(), n);
+    dequantize_row_q4_0(x_q4_0.data(), dx.data(), n);
+    const float ref_q4_0 = archTestDot(dx, dy);
+    dequantize_row_q8_0(x_q8_0.data(), dx.data(), n);
+    const float ref_q8_0 = archTestDot(dx, dy);
+    dequantize_row_q8_K(y_q8_K.data(), dy.data(), n);
+    dequantize_row_q4_K(x_q4_K.data(), dx.data(), n);
+    const float ref_q4_K = archTestDot(dx, dy);
+    dequantize_row_q6_K(x_q6_K.data(), dx.data(), n);
+    const float ref_q6_K = archTestDot(dx, dy);
+    for (int i = 0; i < n; ++i) {
+        dx[i] = MLLM_FP16_TO_FP32(x_fp16[i]);
+        dy[i] = MLLM_FP16_TO_FP32(y_fp16[i]);
+    }
+    const float ref_fp16 = archTestDot(dx, dy);
+    const float ref_fp32 = archTestDot(x, y);
+    for (const auto *kernels : mllm::arch_variants()) {
+        float s;
+        kernels->vec_dot_fp32(n, &s, x.data(), y.data());
+        EXPECT_NEAR(s, ref_fp32, 1e-3) << kernels->name;
+        kernels->vec_dot_fp16(n, &s, x_fp16.data(), y_fp16.data());
+        EXPECT_NEAR(s, ref_fp16, 1e-2) << kernels->name;
+        kernels->vec_dot_q4_0_q8_0(n, &s, x_q4_0.data(), y_q8_0.data());
+        EXPECT_NEAR(s, ref_q4_0, 1e-2) << kernels->name;
+        kernels->vec_dot_q8_0_q8_0(n, &s, x_q8_0.data(), y_q8_0.data());
+        EXPECT_NEAR(s, ref_q8_0, 1e-2) << kernels->name;
+        kernels->vec_dot_q4_K_q8_K(n, &s, x_q4_K.data(), y_q8_K.data());
+        EXPECT_NEAR(s, ref_q4_K, 1e-2) << kernels->name;
+        kernels->vec_dot_q6_K_q8_K(n, &s, x_q6_K.data(), y_q8_K.data());
+        EXPECT_NEAR(s, ref_q6_K, 1e-2) << kernels->name;
+    }
+}
+
+TEST_F(CPUTest, CPUArchQuantize) {
+    const int n = 4 * QK8_0;
+    const auto x = archTestRow(n, 3);
+    for (const auto *kernels : mllm::arch_variants()) {
+        vector<block_q8_0> q(n / QK8_0);
+        kernels->quantize_row_q8_0(x.data(), q.data(), n);
+        vector<float> dq(n);
+        dequantize_row_q8_0(q.data(), dq.data(), n);
+        for (int i = 0; i < n; ++i) {
+            // half a quantization step of a block with max |x| <= 1, plus the fp16 scale.
+            EXPECT_NEAR(dq[i], x[i], 1.0F / 127) << kernels->name << " @" << i;
+        }
+    }
+}
+
+TEST_F(CPUTest, CPUArchSgemm) {
+    const int m = 8, n = 5, k = 64;
+    vector<float> a(m * k), b(n * k);
+    for (int i = 0; i < m; ++i) {
+        auto row = archTestRow(k, i);
+        std::copy(row.begin(), row.end(), a.begin() + i * k);
+    }
+    for (int j = 0; j < n; ++j) {
+        auto row = archTestRow(k, 100 + j);
+        std::copy(row.begin(), row.end(), b.begin() + j * k);
+    }
+    for (const auto *kernels : mllm::arch_variants()) {
+        if (!kernels->check_llamafile_sgemm(m, n, k, MLLM_TYPE_F32, MLLM_TYPE_F32, MLLM_TYPE_F32)) {
+            continue;
+        }
+        vector<float> c(m * n, 0);
+        ASSERT_TRUE(kernels->llamafile_sgemm(m, n, k, a.data(), k, b.data(), k, c.data(), m, 0, 1,
+                                             MLLM_TYPE_F32, MLLM_TYPE_F32, MLLM_TYPE_F32))
+            << kernels->name;
+        for (int j = 0; j < n; ++j) {
+            for (int i = 0; i < m; ++i) {
+                vector<float> ai(a.begin() + i * k, a.begin() + (i + 1) * k);
+                vector<float> bj(b.begin() + j * k, b.begin() + (j + 1) * k);
+                EXPECT_NEAR(c[j * m + i], archTestDot(ai, bj), 1e-3) << kernels->name << " @" << i << "," << j;
+            }
+        }
+    }
+}
+
+TEST_F(CPUTest, CPUArchGemm) {
+    // 8 weight rows in two groups of 4 and 4 activation rows, the smallest gemm.
+    const int k = 2 * QK8_0, nc = 8, nr = 4;
+    vector<float> w(nc * k), a(nr * k);
+    for (int j = 0; j < nc; ++j) {
+        auto row = archTestRow(k, j);
+        std::copy(row.begin(), row.end(), w.begin() + j * k);
+    }
+    for (int i = 0; i < nr; ++i) {
+        auto row = archTestRow(k, 100 + i);
+        std::copy(row.begin(), row.end(), a.begin() + i * k);
+    }
+    vector<block_q4_0> w_q4_0_4_4(nc * k / QK4_0);
+    vector<block_q8_0> w_q8_0_4_4(nc * k / QK8_0), a_q8_0(nr * k / QK8_0), a_mat(nr * k / QK8_0);
+    quantize_q4_0_4x4(w.data(), w_q4_0_4_4.data(), nc, k, nullptr);
+    quantize_row_q8_0_4x4(w.data(), w_q8_0_4_4.data(), nc * k, k);
+    quantize_mat_q8_0(a.data(), a_mat.data(), nr, k, 4);
+    for (int i = 0; i < nr; ++i) {
+        quantize_row_q8_0(a.data() + i * k, a_q8_0.data() + i * k / QK8_0, k);
+    }
+    // the interleaved types quantize like Q4_0 and Q8_0, the references use the dequantized plain rows.
+    vector<float> ref_q4_0(nr * nc), ref_q8_0(nr * nc);
+    vector<float> dw(k), da(k);
+    for (int i = 0; i < nr; ++i) {
+        dequantize_row_q8_0(a_q8_0.data() + i * k / QK8_0, da.data(), k);
+        for (int j = 0; j < nc; ++j) {
+            vector<block_q4_0> w_q4_0(k / QK4_0);
+            vector<block_q8_0> w_q8_0(k / QK8_0);
+            quantize_row_q4_0(w.data() + j * k, w_q4_0.data(), k);
+            dequantize_row_q4_0(w_q4_0.data(), dw.data(), k);
+            ref_q4_0[i * nc + j] = archTestDot(dw, da);
+            quantize_row_q8_0(w.data() + j * k, w_q8_0.data(), k);
+            dequantize_row_q8_0(w_q8_0.data(), dw.data(), k);
+            ref_q8_0[i * nc + j] = archTestDot(dw, da);
+        }
+    }
+    ASSERT_EQ(type_traits[MLLM_TYPE_Q4_0_4_4].gemm, (mllm_gemm_func)mllm::arch_kernels().mllm_gemm_q4_0_4x4_q8_0);
+    ASSERT_EQ(type_traits[MLLM_TYPE_Q8_0_4_4].gemv, (mllm_gemv_func)mllm::arch_kernels().mllm_gemv_q8_0_4x4_q8_0);
+    for (const auto *kernels : mllm::arch_variants()) {
+        const std::pair<const void *, const vector<float> *> types[] = {{w_q4_0_4_4.data(), &ref_q4_0}, {w_q8_0_4_4.data(), &ref_q8_0}};
+        for (int t = 0; t < 2; ++t) {
+            auto gemv = t == 0 ? kernels->mllm_gemv_q4_0_4x4_q8_0 : kernels->mllm_gemv_q8_0_4x4_q8_0;
+            auto gemm = t == 0 ? kernels->mllm_gemm_q4_0_4x4_q8_0 : kernels->mllm_gemm_q8_0_4x4_q8_0;
+            const auto &ref = *types[t].second;
+            vector<float> s(nr * nc);
+            gemm(k, s.data(), nc, types[t].first, a_mat.data(), nr, nc);
+            for (int i = 0; i < nr * nc; ++i) {
+                EXPECT_NEAR(s[i], ref[i], 2e-2) << kernels->name << " gemm " << t << " @" << i;
+            }
+            for (int i = 0; i < nr; ++i) {
+                gemv(k, s.data() + i * nc, nc, types[t].first, a_q8_0.data() + i * k / QK8_0, 1, nc);
+            }
+            for (int i = 0; i < nr * nc; ++i) {
+                EXPECT_NEAR(s[i], ref[i], 2e-2) << kernels->name << " gemv " << t << " @" << i;
+            }
+        }
+    }
+}
@@ -0,0 +1,262 @@
+#include "CPUTest.hpp"
+#include "backends/cpu/CPUAttention.hpp"
+#include "backends/cpu/quantize/QuantizeQ4.hpp"
+
+TEST_F(CPUTest, CPUAttentionBatchedRows) {
+    SETUP_OP(CPUAttention, true, 1);
+    TENSOR(q);
+    TENSOR(k_cache);
+    TENSOR(v_cache);
+    TENSOR(cache_seq_len);
+    TENSOR(output);
+    // two rows of two sequences in slots 1 and 0, at positions 2 and 0.
+    Op::batched_rows.slots = 2;
+    Op::batched_rows.slot = {1, 0};
+    Op::batched_rows.position = {2, 0};
+    q->reshape(1, 2, 2, 4);
+    q->setDtype(MLLM_TYPE_F32);
+    q->alloc();
+    k_cache->reshape(2, 2, 8, 4);
+    k_cache->setDtype(MLLM_TYPE_F16);
+    k_cache->alloc();
+    v_cache->reshape(2, 2, 8, 4);
+    v_cache->setDtype(MLLM_TYPE_F16);
+    v_cache->alloc();
+    cache_seq_len->reshape(1, 1, 1, 1);
+    cache_seq_len->alloc();
+    cache_seq_len->setDataAt<float>(0, 0, 0, 0, 3);
+    for (int b = 0; b < 2; ++b) {
+        for (int h = 0; h < 2; ++h) {
+            for (int s = 0; s < 8; ++s) {
+                for (int d = 0; d < 4; ++d) {
+                    // equal keys give equal weights, the output is the mean of the visible values.
+                    k_cache->setDataAt<mllm_fp16_t>(b, h, s, d, MLLM_FP32_TO_FP16(0.5F));
+                    v_cache->setDataAt<mllm_fp16_t>(b, h, s, d, MLLM_FP32_TO_FP16((float)(b * 100 + h * 10 + s)));
+                    if (b == 0) {
+                        q->setDataAt<float>(0, h, s % 2, d, (float)d);
+                    }
+                }
+            }
+        }
+    }
+    TEST_RESHAPE({q, k_cache, v_cache, cache_seq_len}, {output});
+    TEST_SETUP({q, k_cache, v_cache, cache_seq_len}, {output});
+    TEST_EXCUTE({q, k_cache, v_cache, cache_seq_len}, {output});
+    Op::batched_rows.clear();
+    for (int h = 0; h < 2; ++h) {
+        for (int d = 0; d < 4; ++d) {
+            ASSERT_NEAR(output->dataAt<float>(0, h, 0, d), 100 + h * 10 + 1, 1e-3);
+            ASSERT_NEAR(output->dataAt<float>(0, h, 1, d), h * 10, 1e-3);
+        }
+    }
+    delete op;
+}
+
+TEST_F(CPUTest, CPUAttentionCausal) {
+    SETUP_OP(CPUAttention, true, 1);
+    TENSOR(q);
+    TENSOR(k_cache);
+    TENSOR(v_cache);
+    TENSOR(cache_seq_len);
+    TENSOR(output);
+    // 20 new rows at the end of 150 valid positions of a padded cache, several key blocks per row.
+    const int head = 2, sequence = 20, cache_len = 150, dim = 8;
+    q->reshape(1, head, sequence, dim);
+    q->setDtype(MLLM_TYPE_F32);
+    q->alloc();
+    k_cache->reshape(1, head, cache_len + 10, dim);
+    k_cache->setDtype(MLLM_TYPE_F16);
+    k_cache->alloc();
+    v_cache->reshape(1, head, cache_len + 10, dim);
+    v_cache->setDtype(MLLM_TYPE_F16);
+    v_cache->alloc();
+    cache_seq_len->reshape(1, 1, 1, 1);
+    cache_seq_len->alloc();
+    cache_seq_len->setDataAt<float>(0, 0, 0, 0, cache_len);
+    for (int h = 0; h < head; ++h) {
+        for (int s = 0; s < cache_len + 10; ++s) {
+            for (int d = 0; d < dim; ++d) {
+                k_cache->setDataAt<mllm_fp16_t>(0, h, s, d, MLLM_FP32_TO_FP16(std::sin((float)(h * 7 + s * 3 + d))));
+                v_cache->setDataAt<mllm_fp16_t>(0, h, s, d, MLLM_FP32_TO_FP16(std::cos((float)(h * 5 + s + d * 2))));
+                if (s < sequence) {
+                    q->setDataAt<float>(0, h, s, d, 2 * std::cos((float)(h + s * 11 + d * 3)));
+                }
+            }
+        }
+    }
+    TEST_RESHAPE({q, k_cache, v_cache, cache_seq_len}, {output});
+    TEST_SETUP({q, k_cache, v_cache, cache_seq_len}, {output});
+    TEST_EXCUTE({q, k_cache, v_cache, cache_seq_len}, {output});
+    for (int h = 0; h < head; ++h) {
+        for (int s = 0; s < sequence; ++s) {
+            const int visible = cache_len - sequence + s + 1;
+            vector<double> p(visible);
+            double max_score = -INFINITY, sum = 0;
+            for (int t = 0; t < visible; ++t) {
+                p[t] = 0;
+                for (int d = 0; d < dim; ++d) {
+                    p[t] += q->dataAt<float>(0, h, s, d) * MLLM_FP16_TO_FP32(k_cache->dataAt<mllm_fp16_t>(0, h, t, d));
+                }
+                p[t] /= std::sqrt((double)dim);
+                max_score = std::max(max_score, p[t]);
+            }
+            for (int t = 0; t < visible; ++t) {
+                p[t] = std::exp(p[t] - max_score);
+                sum += p[t];
+            }
+            for (int d = 0; d < dim; ++d) {
+                double expect = 0;
+                for (int t = 0; t < visible; ++t) {
+                    expect += p[t] / sum * MLLM_FP16_TO_FP32(v_cache->dataAt<mllm_fp16_t>(0, h, t, d));
+                }
+                ASSERT_NEAR(output->dataAt<float>(0, h, s, d), expect, 2e-3) << "Data @" << h << "," << s << "," << d;
+            }
+        }
+    }
+    delete op;
+}
+
+TEST_F(CPUTest, CPUAttentionWindowRing) {
+    // rows see the last 6 tokens, the caches are rings of 9 positions and hold tokens 11..19 at t % 9.
+    const int head = 2, sequence = 4, cache_len = 20, dim = 8, window = 6, capacity = 9;
+    SETUP_OP(CPUAttention, true, 1, window);
+    TENSOR(q);
+    TENSOR(k_cache);
+    TENSOR(v_cache);
+    TENSOR(cache_seq_len);
+    TENSOR(output);
+    q->reshape(1, head, sequence, dim);
+    q->setDtype(MLLM_TYPE_F32);
+    q->alloc();
+    k_cache->reshape(1, head, capacity, dim);
+    k_cache->setDtype(MLLM_TYPE_F32);
+    k_cache->alloc();
+    v_cache->reshape(1, head, capacity, dim);
+    v_cache->setDtype(MLLM_TYPE_F32);
+    v_cache->alloc();
+    cache_seq_len->reshape(1, 1, 1, 1);
+    cache_seq_len->alloc();
+    cache_seq_len->setDataAt<float>(0, 0, 0, 0, cache_len);
+    auto key = [](int h, int t, int d) { return std::sin((float)(h * 7 + t * 3 + d)); };
+    auto value = [](int h, int t, int d) { return std::cos((float)(h * 5 + t + d * 2)); };
+    for (int h = 0; h < head; ++h) {
+        for (int t = cache_len - capacity; t < cache_len; ++t) {
+            for (int d = 0; d < dim; ++d) {
+                k_cache->setDataAt<float>(0, h, t % capacity, d, key(h, t, d));
+                v_cache->setDataAt<float>(0, h, t % capacity, d, value(h, t, d));
+            }
+        }
+        for (int s = 0; s < sequence; ++s) {
+            for (int d = 0; d < dim; ++d) {
+                q->setDataAt<float>(0, h, s, d, 2 * std::cos((float)(h + s * 11 + d * 3)));
+            }
+        }
+    }
+    TEST_RESHAPE({q, k_cache, v_cache, cache_seq_len}, {output});
+    TEST_SETUP({q, k_cache, v_cache, cache_seq_len}, {output});
+    TEST_EXCUTE({q, k_cache, v_cache, cache_seq_len}, {output});
+    for (int h = 0; h < head; ++h) {
+        for (int s = 0; s < sequence; ++s) {
+            const int end = cache_len - sequence + s + 1;
+            vector<double> p(window);
+            double max_score = -INFINITY, sum = 0;
+            for (int t = end - window; t < end; ++t) {
+                double score = 0;
+                for (int d = 0; d < dim; ++d) {
+                    score += q->dataAt<float>(0, h, s, d) * key(h, t, d);
+                }
+                p[t - end + window] = score / std::sqrt((double)dim);
+                max_score = std::max(max_score, p[t - end + window]);
+            }
+            for (auto &x : p) {
+                x = std::exp(x - max_score);
+                sum += x;
+            }
+            for (int d = 0; d < dim; ++d) {
+                double expect = 0;
+                for (int t = end - window; t < end; ++t) {
+                    expect += p[t - end + window] / sum * value(h, t, d);
+                }
+                ASSERT_NEAR(output->dataAt<float>(0, h, s, d), expect, 2e-3) << "Data @" << h << "," << s << "," << d;
+            }
+        }
+    }
+    delete op;
+}
+
+TEST_F(CPUTest, CPUAttentionQ4_0) {
+    // Q4_0 caches are read block by block, the result is the attention over their dequantized rows.
+    const int head = 2, sequence = 3, cache_len = 30, dim = 64;
+    SETUP_OP(CPUAttention, true, 1);
+    TENSOR(q);
+    TENSOR(k_cache);
+    TENSOR(v_cache);
+    TENSOR(cache_seq_len);
+    TENSOR(output);
+    q->reshape(1, head, sequence, dim);
+    q->setDtype(MLLM_TYPE_F32);
+    q->alloc();
+    k_cache->reshape(1, head, cache_len, dim);
+    k_cache->setDtype(MLLM_TYPE_Q4_0);
+    k_cache->alloc();
+    v_cache->reshape(1, head, cache_len, dim);
+    v_cache->setDtype(MLLM_TYPE_Q4_0);
+    v_cache->alloc();
+    cache_seq_len->reshape(1, 1, 1, 1);
+    cache_seq_len->alloc();
+    cache_seq_len->setDataAt<float>(0, 0, 0, 0, cache_len);
+    auto row = [](Tensor *t, int h, int s) { return t->hostPtr<char>() + DataTypeSize(t->dtype(), t->offset(0, h, s, 0)); };
+    vector<vector<vector<float>>> key(head, vector<vector<float>>(cache_len, vector<float>(dim)));
+    auto value = key;
+    vector<float> x(dim);
+    for (int h = 0; h < head; ++h) {
+        for (int t = 0; t < cache_len; ++t) {
+            for (int d = 0; d < dim; ++d) {
+                x[d] = 0.3F * std::sin((float)(h * 7 + t * 3 + d));
+            }
+            quantize_row_q4_0(x.data(), row(k_cache.get(), h, t), dim);
+            dequantize_row_q4_0(row(k_cache.get(), h, t), key[h][t].data(), dim);
+            for (int d = 0; d < dim; ++d) {
+                x[d] = std::cos((float)(h * 5 + t + d * 2));
+            }
+            quantize_row_q4_0(x.data(), row(v_cache.get(), h, t), dim);
+            dequantize_row_q4_0(row(v_cache.get(), h, t), value[h][t].data(), dim);
+        }
+        for (int s = 0; s < sequence; ++s) {
+            for (int d = 0; d < dim; ++d) {
+                q->setDataAt<float>(0, h, s, d, std::cos((float)(h + s * 11 + d * 3)));
+            }
+        }
+    }
+    TEST_RESHAPE({q, k_cache, v_cache, cache_seq_len}, {output});
+    TEST_SETUP({q, k_cache, v_cache, cache_seq_len}, {output});
+    TEST_EXCUTE({q, k_cache, v_cache, cache_seq_len}, {output});
+    for (int h = 0; h < head; ++h) {
+        for (int s = 0; s < sequence; ++s) {
+            const int visible = cache_len - sequence + s + 1;
+            vector<double> p(visible);
+            double max_score = -INFINITY, sum = 0;
+            for (int t = 0; t < visible; ++t) {
+                p[t] = 0;
+                for (int d = 0; d < dim; ++d) {
+                    p[t] += q->dataAt<float>(0, h, s, d) * key[h][t][d];
+                }
+                p[t] /= std::sqrt((double)dim);
+                max_score = std::max(max_score, p[t]);
+            }
+            for (auto &e : p) {
+                e = std::exp(e - max_score);
+                sum += e;
+            }
+            for (int d = 0; d < dim; ++d) {
+                double expect = 0;
+                for (int t = 0; t < visible; ++t) {
+                    expect += p[t] / sum * value[h][t][d];
+                }
+                // the query is quantized to Q8_0 for the dot products.
+                ASSERT_NEAR(output->dataAt<float>(0, h, s, d), expect, 1e-2) << "Data @" << h << "," << s << "," << d;
+            }
+        }
+    }
+    delete op;
+}
@@ -0,0 +1,121 @@
+#include "CPUTinyLLaMA.hpp"
+#include "Scheduler.hpp"
+#include "backends/cpu/CPUKVCache.hpp"
+
+namespace {
+vector<CPUKVCache *> kvCaches(Module &model) {
+    vector<CPUKVCache *> caches;
+    for (auto *op : model.ops()) {
+        if (op->type() == KVCACHE) {
+            caches.push_back(static_cast<CPUKVCache *>(op));
+        }
+    }
+    return caches;
+}
+} // namespace
+
+TEST_F(CPUTest, CPUChunkedPrefill) {
+    SineLoader loader;
+    vector<int> prompt;
+    for (int i = 0; i < 23; ++i) {
+        prompt.push_back((i * 37 + 11) % 100);
+    }
+    auto whole = tinyLLaMA(10000);
+    whole.load(loader);
+    Tensor input = tokenInput(prompt);
+    auto whole_logits = whole({input})[0];
+    ASSERT_EQ(whole_logits.sequence(), prompt.size());
+    vector<float> expected(whole_logits.dimension());
+    for (int v = 0; v < whole_logits.dimension(); ++v) {
+        expected[v] = whole_logits.dataAt<float>(0, 0, prompt.size() - 1, v);
+    }
+
+    auto chunked = tinyLLaMA(10000);
+    chunked.load(loader);
+    chunked.setPrefillChunk(8);
+    input = tokenInput(prompt);
+    auto chunked_logits = chunked({input})[0];
+    // only the rows of the last chunk, tokens [16, 23).
+    ASSERT_EQ(chunked_logits.sequence(), 7);
+    for (int v = 0; v < chunked_logits.dimension(); ++v) {
+        ASSERT_NEAR(chunked_logits.dataAt<float>(0, 0, 6, v), expected[v], 1e-4) << "logit " << v;
+    }
+
+    // the chunks appended the same keys and values as the whole prompt.
+    auto whole_caches = kvCaches(whole);
+    auto chunked_caches = kvCaches(chunked);
+    ASSERT_EQ(whole_caches.size(), chunked_caches.size());
+    ASSERT_FALSE(whole_caches.empty());
+    for (int i = 0; i < whole_caches.size(); ++i) {
+        auto &a = whole_caches[i]->cache_;
+        auto &b = chunked_caches[i]->cache_;
+        ASSERT_EQ(whole_caches[i]->getCacheSeqLen(), prompt.size());
+        ASSERT_EQ(chunked_caches[i]->getCacheSeqLen(), prompt.size());
+        for (int h = 0; h < a.head(); ++h) {
+            for (int s = 0; s < prompt.size(); ++s) {
+                for (int d = 0; d < a.dimension(); ++d) {
+                    ASSERT_NEAR(MLLM_FP16_TO_FP32(a.dataAt<mllm_fp16_t>(0, h, s, d)), MLLM_FP16_TO_FP32(b.dataAt<mllm_fp16_t>(0, h, s, d)), 1e-3)
+                        << "cache " << i << " @" << h << "," << s << "," << d;
+                }
+            }
+        }
+    }
+
+    // and both decode the same tokens.
+    auto next = argmax(chunked_logits, 6);
+    ASSERT_EQ(next, std::max_element(expected.begin(), expected.end()) - expected.begin());
+    ASSERT_EQ(greedy(chunked, {next}, 6), greedy(whole, {next}, 6));
+    whole.free();
+    chunked.free();
+}
+
+TEST_F(CPUTest, CPUChunkedPrefillScheduler) {
+    SineLoader loader;
+    const vector<int> short_prompt = {1, 5, 9};
+    vector<int> long_prompt;
+    for (int i = 0; i < 10; ++i) {
+        long_prompt.push_back((i * 13 + 7) % 100);
+    }
+    auto reference = tinyLLaMA(10000);
+    reference.load(loader);
+    const auto expected_short = greedy(reference, short_prompt, 8);
+    reference.free();
+    auto reference_long = tinyLLaMA(10000);
+    reference_long.load(loader);
+    const auto expected_long = greedy(reference_long, long_prompt, 3);
+    reference_long.free();
+
+    auto model = tinyLLaMA(10000);
+    model.load(loader);
+    // at most 4 prompt tokens per step.
+    LlmBatchScheduler scheduler(model, 2, 4);
+    LlmTextGeneratorOpts opt;
+    opt.do_sample = false;
+    int steps = 0;
+    vector<int> short_tokens, long_tokens, long_steps;
+    opt.max_new_tokens = 8;
+    scheduler.addRequest(vector<unsigned int>(short_prompt.begin(), short_prompt.end()), opt, [&](unsigned int token) {
+        short_tokens.push_back((int)token);
+        return true;
+    });
+    ASSERT_TRUE(scheduler.step());
+    ++steps;
+    ASSERT_EQ(short_tokens.size(), 1);
+    opt.max_new_tokens = 3;
+    scheduler.addRequest(vector<unsigned int>(long_prompt.begin(), long_prompt.end()), opt, [&](unsigned int token) {
+        long_tokens.push_back((int)token);
+        long_steps.push_back(steps);
+        return true;
+    });
+    // the 10 prompt tokens take 3 steps, the short request keeps decoding one token per step meanwhile.
+    while (scheduler.step()) {
+        ++steps;
+        if (steps <= 4) {
+            ASSERT_EQ(short_tokens.size(), steps);
+        }
+    }
+    ASSERT_EQ(long_steps, vector<int>({3, 4, 5}));
+    ASSERT_EQ(short_tokens, expected_short);
+    ASSERT_EQ(long_tokens, expected_long);
+    model.free();
+}
@@ -0,0 +1,32 @@
+#include "CPUTinyLLaMA.hpp"
+#include <thread>
+
+TEST_F(CPUTest, CPUConcurrentModules) {
+    SineLoader loader;
+    const vector<int> prompt_a = {1, 5, 9, 33};
+    const vector<int> prompt_b = {7, 2, 64};
+    // two models of different rope_theta, one after the other on this thread.
+    auto model_a = tinyLLaMA(10000);
+    model_a.load(loader);
+    auto model_b = tinyLLaMA(500000);
+    model_b.load(loader);
+    const auto expected_a = greedy(model_a, prompt_a, 8);
+    const auto expected_b = greedy(model_b, prompt_b, 8);
+    model_a.free();
+    model_b.free();
+
+    // the same, loaded on this thread and run at the same time on two others.
+    auto concurrent_a = tinyLLaMA(10000);
+    concurrent_a.load(loader);
+    auto concurrent_b = tinyLLaMA(500000);
+    concurrent_b.load(loader);
+    vector<int> tokens_a, tokens_b;
+    std::thread thread_a([&] { tokens_a = greedy(concurrent_a, prompt_a, 8); });
+    std::thread thread_b([&] { tokens_b = greedy(concurrent_b, prompt_b, 8); });
+    thread_a.join();
+    thread_b.join();
+    ASSERT_EQ(tokens_a, expected_a);
+    ASSERT_EQ(tokens_b, expected_b);
+    concurrent_a.free();
+    concurrent_b.free();
+}
@@ -3,6 +3,8 @@
 //
 #include "CPUTest.hpp"
 #include "backends/cpu/CPUEmbedding.hpp"
+#include "backends/cpu/CPULinear.hpp"
+#include "backends/cpu/quantize/QuantizeQ4.hpp"
 
 TEST_F(CPUTest, CPUEmbedding1) {
     SETUP_OP(CPUEmbedding, 128, 180, 4);
@@ -17,4 +19,87 @@ TEST_F(CPUTest, CPUEmbedding1) {
     op->load(loader);
     op->execute({input0}, {output});
     COMPARE_TENSOR(p_output.get(), output.get(), true);
-}
\ No newline at end of file
+}
+// serves a table of Q4_K rows from memory.
+class QuantizedTableLoader : public AbstructLoader {
+public:
+    explicit QuantizedTableLoader(vector<char> table) :
+        table_(std::move(table)) {
+    }
+    bool load(Tensor *tensor) override {
+        memcpy(tensor->hostPtr<char>(), table_.data(), table_.size());
+        return true;
+    }
+    bool load(std::shared_ptr<Tensor> tensor) override {
+        return load(tensor.get());
+    }
+    DataType getDataType(string name) override {
+        return name == "CPUEmbedding.weight" ? MLLM_TYPE_Q4_K : MLLM_TYPE_COUNT;
+    }
+
+private:
+    vector<char> table_;
+};
+
+TEST_F(CPUTest, CPUEmbeddingQ4_KTied) {
+    const int vocab = 40, hidden = 2 * QK_K, sequence = 6;
+    auto op = new CPUEmbedding(bn_, "CPUEmbedding", hidden, vocab, 2);
+    const size_t row_bytes = DataTypeSize(MLLM_TYPE_Q4_K, hidden);
+    vector<char> table(vocab * row_bytes);
+    vector<float> row(hidden);
+    for (int v = 0; v < vocab; ++v) {
+        for (int d = 0; d < hidden; ++d) {
+            row[d] = std::sin((float)(v * 31 + d) * 0.37F);
+        }
+        quantize_row_q4_K(row.data(), table.data() + v * row_bytes, hidden);
+    }
+    QuantizedTableLoader loader(table);
+    TENSOR(input0);
+    TENSOR(output);
+    input0->reshape(1, 1, sequence, 1);
+    input0->alloc();
+    for (int s = 0; s < sequence; ++s) {
+        input0->setDataAt<float>(0, 0, s, 0, (float)((s * 17 + 3) % vocab));
+    }
+    TEST_WEIGHTS_LOAD(loader);
+    TEST_RESHAPE({input0}, {output});
+    TEST_SETUP({input0}, {output});
+    TEST_EXCUTE({input0}, {output});
+    for (int s = 0; s < sequence; ++s) {
+        dequantize_row_q4_K((const block_q4_K *)(table.data() + ((s * 17 + 3) % vocab) * row_bytes), row.data(), hidden);
+        for (int d = 0; d < hidden; ++d) {
+            ASSERT_EQ(output->dataAt<float>(0, 0, s, d), row[d]) << "Data @" << s << "," << d;
+        }
+    }
+
+    // an LM head tied to the table computes the logits with it, without a weight of its own.
+    auto lm_head = new CPULinear(bn_, "CPULinear", hidden, vocab, false, 2);
+    lm_head->tieWeight(op);
+    ASSERT_FALSE(lm_head->load(loader));
+    ASSERT_EQ(lm_head->weight().rawHostPtr(), op->weight().rawHostPtr());
+    TENSOR(hidden_states);
+    TENSOR(logits);
+    hidden_states->reshape(1, 1, 3, hidden);
+    hidden_states->alloc();
+    for (int s = 0; s < 3; ++s) {
+        for (int d = 0; d < hidden; ++d) {
+            hidden_states->setDataAt<float>(0, 0, s, d, std::cos((float)(s * 7 + d) * 0.11F));
+        }
+    }
+    ASSERT_FALSE(lm_head->reshape({hidden_states}, {logits}));
+    ASSERT_FALSE(lm_head->setUp({hidden_states}, {logits}));
+    ASSERT_FALSE(lm_head->execute({hidden_states}, {logits}));
+    for (int s = 0; s < 3; ++s) {
+        for (int v = 0; v < vocab; ++v) {
+            dequantize_row_q4_K((const block_q4_K *)(table.data() + v * row_bytes), row.data(), hidden);
+            double expect = 0;
+            for (int d = 0; d < hidden; ++d) {
+                expect += row[d] * hidden_states->dataAt<float>(0, 0, s, d);
+            }
+            // the hidden states are quantized to Q8_K for the dot products.
+            ASSERT_NEAR(logits->dataAt<float>(0, 0, s, v), expect, 0.2) << "Data @" << s << "," << v;
+        }
+    }
+    delete lm_head;
+    delete op;
+}
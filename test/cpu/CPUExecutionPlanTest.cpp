@@ -0,0 +1,89 @@
+#include "CPUTest.hpp"
+#include "CPUTinyLLaMA.hpp"
+#include "ExecutionPlan.hpp"
+#include "backends/cpu/CPUScale.hpp"
+#include "backends/cpu/CPUTensorFunction.hpp"
+
+TEST_F(CPUTest, CPUExecutionPlanReplay) {
+    SETUP_OP(CPUScale, 2.0, 0.0);
+    CPUaddFunction add;
+    TENSOR(input);
+    input->reshape(1, 1, 2, 8);
+    input->alloc();
+    input->fullData<float>(1.0);
+    TENSOR(scaled);
+    TENSOR(output);
+    Tensor::graphs["scaled"] = scaled;
+    Tensor::graphs["output"] = output;
+    vector<Tensor> inputs = {*input};
+    ExecutionPlan plan;
+    plan.begin(inputs);
+    ASSERT_EQ(ExecutionPlan::active(), &plan);
+    // the forward reads the inputs of the plan, op then function as in Layer::setUpOp and Tensor::getFunc.
+    auto captured = Tensor::graphs[plan.inputs()[0].name()];
+    plan.record(op, {captured}, {scaled});
+    op->reshape({captured}, {scaled});
+    op->setUp({captured}, {scaled});
+    plan.record(&add, FUNC_ADD, {scaled.get()}, {output.get()}, {1.0});
+    add.setup({output.get()}, {scaled.get()}, {1.0});
+    ASSERT_TRUE(plan.finish({*output}));
+    ASSERT_EQ(ExecutionPlan::active(), nullptr);
+    ASSERT_EQ(plan.size(), 2);
+
+    input->fullData<float>(3.0);
+    ASSERT_TRUE(plan.matches(inputs));
+    plan.bind(inputs);
+    plan.setUp(nullptr);
+    plan.execute();
+    auto outputs = plan.outputs();
+    ASSERT_EQ(outputs.size(), 1);
+    for (int i = 0; i < outputs[0].count(); ++i) {
+        ASSERT_FLOAT_EQ(outputs[0].hostPtr<float>()[i], 7.0);
+    }
+    // another shape is not replayed.
+    Tensor longer(1, 1, 3, 8, bn_, true);
+    vector<Tensor> longer_inputs = {longer};
+    ASSERT_FALSE(plan.matches(longer_inputs));
+    Tensor::graphs.clear();
+}
+
+TEST_F(CPUTest, CPUExecutionPlanTemporary) {
+    SETUP_OP(CPUScale, 2.0, 0.0);
+    TENSOR(input);
+    input->reshape(1, 1, 1, 8);
+    input->alloc();
+    TENSOR(output);
+    Tensor::graphs["output"] = output;
+    vector<Tensor> inputs = {*input};
+    ExecutionPlan plan;
+    plan.begin(inputs);
+    // a temporary is not in Tensor::graphs, the plan can not read it again.
+    auto temporary = std::make_shared<Tensor>(1, 1, 1, 8, bn_, true);
+    plan.record(op, {temporary}, {output});
+    ASSERT_FALSE(plan.finish({*output}));
+    ASSERT_FALSE(plan.ready());
+    Tensor::graphs.clear();
+}
+
+TEST_F(CPUTest, CPUExecutionPlanDecode) {
+    SineLoader loader;
+    const vector<int> prompt = {1, 5, 9, 33};
+    const vector<int> tokens = {7, 42, 42, 3, 99, 0, 18, 64};
+    auto model = tinyLLaMA(10000);
+    model.load(loader);
+    const auto expected = decodeLogits(model, prompt, tokens);
+    model.free();
+
+    auto captured = tinyLLaMA(10000);
+    captured.load(loader);
+    captured.captureExecution();
+    const auto logits = decodeLogits(captured, prompt, tokens);
+    // the decoding after the first token replays the plan.
+    ASSERT_NE(captured.executionPlan(), nullptr);
+    ASSERT_TRUE(captured.executionPlan()->ready());
+    ASSERT_EQ(logits.size(), expected.size());
+    for (int step = 0; step < logits.size(); ++step) {
+        ASSERT_EQ(logits[step], expected[step]) << "step " << step;
+    }
+    captured.free();
+}
@@ -0,0 +1,274 @@
+#include "CPUTest.hpp"
+#include "backends/cpu/CPUKVCache.hpp"
+#include "backends/cpu/quantize/Quantize.hpp"
+#include "backends/cpu/quantize/QuantizeQ8.hpp"
+
+static float kvValue(int h, int s, int d) {
+    return (float)(h * 100 + s) + (float)d / 8;
+}
+
+TEST_F(CPUTest, CPUKVCacheGrow) {
+    SETUP_OP(CPUKVCache, 1, 16, 1);
+    TENSOR(input0);
+    TENSOR(output);
+    const int steps[] = {5, 14, 1};
+    int cached = 0;
+    for (int seq : steps) {
+        input0->reshape(1, 2, seq, 4);
+        TEST_RESHAPE({input0}, {output});
+        TEST_SETUP({input0}, {output});
+        for (int h = 0; h < 2; ++h) {
+            for (int s = 0; s < seq; ++s) {
+                for (int d = 0; d < 4; ++d) {
+                    input0->setDataAt<mllm_fp16_t>(0, h, s, d, MLLM_FP32_TO_FP16(kvValue(h, cached + s, d)));
+                }
+            }
+        }
+        TEST_EXCUTE({input0}, {output});
+        cached += seq;
+    }
+    // 20 tokens do not fit in the initial 16, the cache grows instead of exiting.
+    ASSERT_EQ(op->getCacheSeqLen(), cached);
+    ASSERT_GE(op->cache_.sequence(), cached);
+    ASSERT_EQ(output->rawHostPtr(), op->cache_.rawHostPtr());
+    for (int h = 0; h < 2; ++h) {
+        for (int s = 0; s < cached; ++s) {
+            for (int d = 0; d < 4; ++d) {
+                ASSERT_EQ(MLLM_FP16_TO_FP32(output->dataAt<mllm_fp16_t>(0, h, s, d)), kvValue(h, s, d)) << "Data @" << h << "," << s << "," << d;
+            }
+        }
+    }
+    op->clearCache();
+    ASSERT_EQ(op->getCacheSeqLen(), 0);
+    ASSERT_EQ(MLLM_FP16_TO_FP32(op->cache_.dataAt<mllm_fp16_t>(0, 1, 3, 2)), 0.0f);
+    delete op;
+}
+
+TEST_F(CPUTest, CPUKVCacheSaveRestore) {
+    SETUP_OP(CPUKVCache, 2, 16, 1);
+    TENSOR(input0);
+    TENSOR(output);
+    input0->reshape(1, 1, 10, 4);
+    TEST_RESHAPE({input0}, {output});
+    TEST_SETUP({input0}, {output});
+    for (int s = 0; s < 10; ++s) {
+        for (int d = 0; d < 4; ++d) {
+            // with n_rep 2 the cache holds each head twice.
+            for (int h = 0; h < 2; ++h) {
+                op->cache_.setDataAt<mllm_fp16_t>(0, h, s, d, MLLM_FP32_TO_FP16(kvValue(0, s, d)));
+            }
+        }
+    }
+    TEST_EXCUTE({input0}, {output});
+    vector<uint8_t> data;
+    ASSERT_TRUE(op->saveCache(10, data));
+    ASSERT_EQ(data.size(), 10 * op->tokenSize());
+    ASSERT_EQ(op->tokenSize(), 4 * sizeof(mllm_fp16_t));
+    op->clearCache();
+    // any prefix of the saved tokens can be restored, also beyond the current cache limit.
+    ASSERT_TRUE(op->restoreCache(6, data.data()));
+    ASSERT_EQ(op->getCacheSeqLen(), 6);
+    for (int h = 0; h < 2; ++h) {
+        for (int s = 0; s < 6; ++s) {
+            for (int d = 0; d < 4; ++d) {
+                ASSERT_EQ(MLLM_FP16_TO_FP32(op->cache_.dataAt<mllm_fp16_t>(0, h, s, d)), kvValue(0, s, d)) << "Data @" << h << "," << s << "," << d;
+            }
+        }
+    }
+    vector<uint8_t> longer(data);
+    for (int i = 0; i < 3; ++i) {
+        longer.insert(longer.end(), data.begin(), data.end());
+    }
+    ASSERT_TRUE(op->restoreCache(40, longer.data()));
+    ASSERT_EQ(op->getCacheSeqLen(), 40);
+    ASSERT_GE(op->cache_.sequence(), 40);
+    ASSERT_EQ(MLLM_FP16_TO_FP32(op->cache_.dataAt<mllm_fp16_t>(0, 1, 37, 3)), kvValue(0, 7, 3));
+    delete op;
+}
+
+TEST_F(CPUTest, CPUKVCacheRing) {
+    // a window of 8: 2 kv heads repeated twice, F32 rows converted into the F16 ring.
+    SETUP_OP(CPUKVCache, 2, 1024, 1, 8);
+    TENSOR(input0);
+    TENSOR(output);
+    const int steps[] = {5, 1, 1, 12, 1, 1, 1};
+    int cached = 0;
+    for (int seq : steps) {
+        input0->reshape(1, 2, seq, 4);
+        input0->setDtype(MLLM_TYPE_F32);
+        TEST_RESHAPE({input0}, {output});
+        TEST_SETUP({input0}, {output});
+        input0->alloc();
+        for (int h = 0; h < 2; ++h) {
+            for (int s = 0; s < seq; ++s) {
+                for (int d = 0; d < 4; ++d) {
+                    input0->setDataAt<float>(0, h, s, d, kvValue(h, cached + s, d));
+                }
+            }
+        }
+        TEST_EXCUTE({input0}, {output});
+        cached += seq;
+        // the ring holds the window before the forward and its tokens, at their positions modulo the ring.
+        const int capacity = output->sequence();
+        ASSERT_GE(capacity, 8 - 1 + seq);
+        ASSERT_EQ(output->rawHostPtr(), op->cache_.rawHostPtr());
+        for (int t = std::max(0, cached - (8 - 1 + seq)); t < cached; ++t) {
+            for (int h = 0; h < 4; ++h) {
+                for (int d = 0; d < 4; ++d) {
+                    ASSERT_EQ(MLLM_FP16_TO_FP32(output->dataAt<mllm_fp16_t>(0, h, t % capacity, d)), kvValue(h / 2, t, d)) << "Data @" << h << "," << t << "," << d;
+                }
+            }
+        }
+    }
+    ASSERT_EQ(op->getCacheSeqLen(), cached);
+    // the 12 token forward grew the ring once, it does not grow with the number of tokens.
+    ASSERT_EQ(op->cache_.sequence(), 8 - 1 + 12);
+    vector<uint8_t> data;
+    ASSERT_FALSE(op->saveCache(cached, data));
+    delete op;
+}
+
+TEST_F(CPUTest, CPUKVCacheQ8_0) {
+    // F32 rows quantized into a Q8_0 cache of 2 kv heads repeated twice, grown past its limit of 16.
+    const int dim = 64;
+    SETUP_OP(CPUKVCache, 2, 16, 1, 0, MLLM_TYPE_Q8_0);
+    TENSOR(input0);
+    TENSOR(output);
+    const int steps[] = {12, 1, 9};
+    int cached = 0;
+    vector<float> row(dim);
+    for (int seq : steps) {
+        input0->reshape(1, 2, seq, dim);
+        input0->setDtype(MLLM_TYPE_F32);
+        TEST_RESHAPE({input0}, {output});
+        TEST_SETUP({input0}, {output});
+        input0->alloc();
+        for (int h = 0; h < 2; ++h) {
+            for (int s = 0; s < seq; ++s) {
+                for (int d = 0; d < dim; ++d) {
+                    input0->setDataAt<float>(0, h, s, d, std::sin((float)kvValue(h, cached + s, d)));
+                }
+            }
+        }
+        TEST_EXCUTE({input0}, {output});
+        cached += seq;
+        ASSERT_EQ(output->dtype(), MLLM_TYPE_Q8_0);
+        ASSERT_EQ(output->rawHostPtr(), op->cache_.rawHostPtr());
+        for (int t = 0; t < cached; ++t) {
+            for (int h = 0; h < 4; ++h) {
+                dequantize_row_q8_0(output->hostPtr<char>() + DataTypeSize(MLLM_TYPE_Q8_0, output->offset(0, h, t, 0)), row.data(), dim);
+                for (int d = 0; d < dim; ++d) {
+                    // a block keeps 127 steps of its largest value.
+                    ASSERT_NEAR(row[d], std::sin((float)kvValue(h / 2, t, d)), 1.0 / 127) << "Data @" << h << "," << t << "," << d;
+                }
+            }
+        }
+    }
+    ASSERT_GE(op->cache_.sequence(), cached);
+    // a token is saved as the blocks of each kv head.
+    vector<uint8_t> data;
+    ASSERT_TRUE(op->saveCache(cached, data));
+    ASSERT_EQ(op->tokenSize(), 2 * DataTypeSize(MLLM_TYPE_Q8_0, dim));
+    vector<uint8_t> expect(op->cache_.hostPtr<uint8_t>(), op->cache_.hostPtr<uint8_t>() + op->cache_.cntSize());
+    op->clearCache();
+    ASSERT_TRUE(op->restoreCache(cached, data.data()));
+    ASSERT_EQ(memcmp(op->cache_.hostPtr<uint8_t>(), expect.data(), cached * 2 * op->tokenSize()), 0);
+    delete op;
+}
+
+TEST_F(CPUTest, CPUKVCacheSink) {
+    // 12 tokens, the first 2 kept. keys roped as in HFHUBROPE are rotated to their positions when they move down.
+    const int head = 2, dim = 8, sink = 2, capacity = 12;
+    SETUP_OP(CPUKVCache, 1, capacity, 1, 0, MLLM_TYPE_F32, sink, HFHUBROPE, 10000);
+    TENSOR(input0);
+    TENSOR(output);
+    auto key = [&](int h, int t, int pos, int d) {
+        const int i = d % (dim / 2);
+        const double angle = pos / std::pow(10000.0, 2.0 * i / dim);
+        const double x0 = std::sin(h + t * 0.37 + i), x1 = std::sin(h + t * 0.37 + i + dim / 2);
+        return (float)(d < dim / 2 ? x0 * std::cos(angle) - x1 * std::sin(angle) : x0 * std::sin(angle) + x1 * std::cos(angle));
+    };
+    const int steps[] = {8, 1, 1, 1, 1, 1, 1, 1, 1, 1, 3, 1, 1};
+    vector<int> kept; // the token at each position of the cache
+    int fed = 0;
+    for (int seq : steps) {
+        const int evicted = CPUKVCache::evictedTokens(kept.size(), seq, sink, capacity);
+        kept.erase(kept.begin() + sink, kept.begin() + sink + evicted);
+        input0->reshape(1, head, seq, dim);
+        TEST_RESHAPE({input0}, {output});
+        TEST_SETUP({input0}, {output});
+        for (int h = 0; h < head; ++h) {
+            for (int s = 0; s < seq; ++s) {
+                for (int d = 0; d < dim; ++d) {
+                    input0->setDataAt<float>(0, h, s, d, key(h, fed + s, kept.size() + s, d));
+                }
+            }
+        }
+        TEST_EXCUTE({input0}, {output});
+        for (int s = 0; s < seq; ++s) {
+            kept.push_back(fed + s);
+        }
+        fed += seq;
+        ASSERT_EQ(op->getCacheSeqLen(), kept.size());
+        ASSERT_LE(op->getCacheSeqLen(), capacity);
+        for (int p = 0; p < (int)kept.size(); ++p) {
+            for (int h = 0; h < head; ++h) {
+                for (int d = 0; d < dim; ++d) {
+                    ASSERT_NEAR(op->cache_.dataAt<float>(0, h, p, d), key(h, kept[p], p, d), 1e-4) << "Data @" << h << "," << p << "," << d;
+                }
+            }
+        }
+    }
+    // tokens 0 and 1 stay, the tokens were moved twice.
+    ASSERT_EQ(kept[0], 0);
+    ASSERT_EQ(kept[1], 1);
+    ASSERT_EQ(kept.back(), fed - 1);
+    ASSERT_EQ(fed - (int)kept.size(), 10);
+    vector<uint8_t> data;
+    ASSERT_FALSE(op->saveCache(kept.size(), data));
+    delete op;
+}
+
+TEST_F(CPUTest, CPUKVCacheSinkQ8) {
+    // a quantized sink cache evicting 40 times: a key is rotated from the values it was appended with, its error
+    // stays that of rounding to Q8_0 twice instead of growing with the evictions.
+    const int head = 2, dim = 32, sink = 2, capacity = 12, tokens = 200;
+    SETUP_OP(CPUKVCache, 1, capacity, 1, 0, MLLM_TYPE_Q8_0, sink, HFHUBROPE, 10000);
+    TENSOR(input0);
+    TENSOR(output);
+    auto key = [&](int h, int t, int pos, int d) {
+        const int i = d % (dim / 2);
+        const double angle = pos / std::pow(10000.0, 2.0 * i / dim);
+        const double x0 = std::sin(h + t * 0.37 + i), x1 = std::sin(h + t * 0.37 + i + dim / 2);
+        return (float)(d < dim / 2 ? x0 * std::cos(angle) - x1 * std::sin(angle) : x0 * std::sin(angle) + x1 * std::cos(angle));
+    };
+    vector<int> kept;
+    vector<float> row(dim);
+    for (int fed = 0; fed < tokens; ++fed) {
+        const int evicted = CPUKVCache::evictedTokens(kept.size(), 1, sink, capacity);
+        kept.erase(kept.begin() + sink, kept.begin() + sink + evicted);
+        input0->reshape(1, head, 1, dim);
+        input0->setDtype(MLLM_TYPE_F32);
+        TEST_RESHAPE({input0}, {output});
+        TEST_SETUP({input0}, {output});
+        input0->alloc();
+        for (int h = 0; h < head; ++h) {
+            for (int d = 0; d < dim; ++d) {
+                input0->setDataAt<float>(0, h, 0, d, key(h, fed, kept.size(), d));
+            }
+        }
+        TEST_EXCUTE({input0}, {output});
+        kept.push_back(fed);
+    }
+    for (int p = 0; p < (int)kept.size(); ++p) {
+        for (int h = 0; h < head; ++h) {
+            dequantize_row_q8_0(op->cache_.hostPtr<char>() + DataTypeSize(MLLM_TYPE_Q8_0, op->cache_.offset(0, h, p, 0)), row.data(), dim);
+            for (int d = 0; d < dim; ++d) {
+                // the keys are at most sqrt(2), a block keeps 127 steps of its largest value.
+                ASSERT_NEAR(row[d], key(h, kept[p], p, d), 2 * 1.5 / 127) << "Data @" << h << "," << p << "," << d;
+            }
+        }
+    }
+    ASSERT_GE(tokens - (int)kept.size(), 180);
+    delete op;
+}
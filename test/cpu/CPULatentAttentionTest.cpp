@@ -0,0 +1,129 @@
+#include "CPUTest.hpp"
+#include "backends/cpu/CPULatentAttention.hpp"
+
+// serves the kv_b_proj weight of the test from memory.
+class LatentWeightLoader : public AbstructLoader {
+public:
+    explicit LatentWeightLoader(vector<float> weight) :
+        weight_(std::move(weight)) {
+    }
+    bool load(Tensor *tensor) override {
+        memcpy(tensor->hostPtr<float>(), weight_.data(), weight_.size() * sizeof(float));
+        return true;
+    }
+    bool load(std::shared_ptr<Tensor> tensor) override {
+        return load(tensor.get());
+    }
+    DataType getDataType(string name) override {
+        return name == "CPULatentAttention.weight" ? MLLM_TYPE_F32 : MLLM_TYPE_COUNT;
+    }
+
+private:
+    vector<float> weight_;
+};
+
+TEST_F(CPUTest, CPULatentAttention) {
+    const int head = 3, nope = 8, rope = 4, v_dim = 6, rank = 16;
+    const int sequence = 5, cache_len = 70;
+    auto op = new CPULatentAttention(bn_, "CPULatentAttention", head, nope, v_dim, rank, true, 2);
+    TENSOR(q_nope);
+    TENSOR(q_pe);
+    TENSOR(latent_cache);
+    TENSOR(cache_seq_len);
+    TENSOR(output);
+    // kv_b_proj: for each head nope rows of k, then v_dim rows of v.
+    vector<float> weight(head * (nope + v_dim) * rank);
+    for (size_t i = 0; i < weight.size(); ++i) {
+        weight[i] = 0.3F * std::sin((float)i * 0.7F);
+    }
+    LatentWeightLoader loader(weight);
+    q_nope->reshape(1, head, sequence, nope);
+    q_nope->setDtype(MLLM_TYPE_F32);
+    q_nope->alloc();
+    q_pe->reshape(1, head, sequence, rope);
+    q_pe->setDtype(MLLM_TYPE_F32);
+    q_pe->alloc();
+    latent_cache->reshape(1, 1, cache_len + 6, rank + rope);
+    latent_cache->setDtype(MLLM_TYPE_F32);
+    latent_cache->alloc();
+    cache_seq_len->reshape(1, 1, 1, 1);
+    cache_seq_len->alloc();
+    cache_seq_len->setDataAt<float>(0, 0, 0, 0, cache_len);
+    for (int t = 0; t < cache_len + 6; ++t) {
+        for (int d = 0; d < rank + rope; ++d) {
+            latent_cache->setDataAt<float>(0, 0, t, d, std::cos((float)(t * 5 + d * 3)));
+        }
+    }
+    for (int h = 0; h < head; ++h) {
+        for (int s = 0; s < sequence; ++s) {
+            for (int d = 0; d < nope; ++d) {
+                q_nope->setDataAt<float>(0, h, s, d, std::sin((float)(h * 13 + s * 7 + d)));
+            }
+            for (int d = 0; d < rope; ++d) {
+                q_pe->setDataAt<float>(0, h, s, d, std::cos((float)(h * 3 + s * 11 + d)));
+            }
+        }
+    }
+    TEST_WEIGHTS_LOAD(loader);
+    TEST_RESHAPE({q_nope, q_pe, latent_cache, cache_seq_len}, {output});
+    TEST_SETUP({q_nope, q_pe, latent_cache, cache_seq_len}, {output});
+    TEST_EXCUTE({q_nope, q_pe, latent_cache, cache_seq_len}, {output});
+    ASSERT_EQ(output->dimension(), v_dim);
+    // the attention of the expanded heads: k = cat(W_UK c, k_pe) and v = W_UV c.
+    auto w = [&](int h, int row, int j) { return (double)weight[(h * (nope + v_dim) + row) * rank + j]; };
+    for (int h = 0; h < head; ++h) {
+        vector<vector<double>> k(cache_len, vector<double>(nope + rope)), v(cache_len, vector<double>(v_dim));
+        for (int t = 0; t < cache_len; ++t) {
+            for (int i = 0; i < nope + v_dim; ++i) {
+                double x = 0;
+                for (int j = 0; j < rank; ++j) {
+                    x += w(h, i, j) * latent_cache->dataAt<float>(0, 0, t, j);
+                }
+                if (i < nope) {
+                    k[t][i] = x;
+                } else {
+                    v[t][i - nope] = x;
+                }
+            }
+            for (int d = 0; d < rope; ++d) {
+                k[t][nope + d] = latent_cache->dataAt<float>(0, 0, t, rank + d);
+            }
+        }
+        for (int s = 0; s < sequence; ++s) {
+            const int visible = cache_len - sequence + s + 1;
+            vector<double> p(visible);
+            double max_score = -INFINITY, sum = 0;
+            for (int t = 0; t < visible; ++t) {
+                p[t] = 0;
+                for (int d = 0; d < nope; ++d) {
+                    p[t] += q_nope->dataAt<float>(0, h, s, d) * k[t][d];
+                }
+                for (int d = 0; d < rope; ++d) {
+                    p[t] += q_pe->dataAt<float>(0, h, s, d) * k[t][nope + d];
+                }
+                p[t] /= std::sqrt((double)(nope + rope));
+                max_score = std::max(max_score, p[t]);
+            }
+            for (int t = 0; t < visible; ++t) {
+                p[t] = std::exp(p[t] - max_score);
+                sum += p[t];
+            }
+            for (int d = 0; d < v_dim; ++d) {
+                double expect = 0;
+                for (int t = 0; t < visible; ++t) {
+                    expect += p[t] / sum * v[t][d];
+                }
+                ASSERT_NEAR(output->dataAt<float>(0, h, s, d), expect, 1e-3) << "Data @" << h << "," << s << "," << d;
+            }
+        }
+    }
+    delete op;
+}
+
+TEST_F(CPUTest, CPULatentAttentionNoWeight) {
+    // without kv_b_proj the absorbed weights would stay zero, the load fails instead.
+    auto op = new CPULatentAttention(bn_, "CPULatentAttentionOther", 2, 8, 6, 16, true, 1);
+    LatentWeightLoader loader({});
+    ASSERT_EQ(op->load(loader), NOT_SUPPORT);
+    delete op;
+}
@@ -0,0 +1,98 @@
+#include "CPUTest.hpp"
+#include "CPUTinyLLaMA.hpp"
+#include "ExecutionPlan.hpp"
+#include "MemoryPlanner.hpp"
+
+TEST_F(CPUTest, CPUMemoryPlannerOffsets) {
+    vector<MemoryPlanner::Block> blocks = {{100, 0, 1}, {200, 1, 2}, {50, 2, 3}, {300, 3, 4}, {64, 0, 4}};
+    size_t size = 0;
+    auto offsets = MemoryPlanner::assignOffsets(blocks, 64, size);
+    ASSERT_EQ(offsets.size(), blocks.size());
+    for (int i = 0; i < blocks.size(); ++i) {
+        ASSERT_EQ(offsets[i] % 64, 0);
+        ASSERT_LE(offsets[i] + blocks[i].size, size);
+        for (int j = 0; j < i; ++j) {
+            if (blocks[i].first <= blocks[j].last && blocks[j].first <= blocks[i].last) {
+                ASSERT_TRUE(offsets[i] + blocks[i].size <= offsets[j] || offsets[j] + blocks[j].size <= offsets[i]) << i << " and " << j << " overlap";
+            }
+        }
+    }
+    // 128 + 256 + 64 + 320 + 64 without reuse.
+    ASSERT_LT(size, 832);
+}
+
+TEST_F(CPUTest, CPUMemoryPlannerChain) {
+    TENSOR(a);
+    TENSOR(b);
+    TENSOR(c);
+    MemoryPlanner planner;
+    planner.begin();
+    ASSERT_EQ(MemoryPlanner::active(), &planner);
+    // a -> b -> c, a is dead when c is written.
+    vector<std::pair<shared_ptr<Tensor>, shared_ptr<Tensor>>> chain = {{nullptr, a}, {a, b}, {b, c}};
+    for (auto &[input, output] : chain) {
+        planner.step(input ? vector<shared_ptr<Tensor>>{input} : vector<shared_ptr<Tensor>>{}, {output});
+        output->reshape(1, 1, 4, 16);
+        output->alloc();
+        ASSERT_EQ(output->rawHostPtr(), nullptr);
+    }
+    // an allocation that is not an output of the step is not deferred.
+    TENSOR(buffer);
+    buffer->reshape(1, 1, 1, 16);
+    buffer->alloc();
+    ASSERT_NE(buffer->rawHostPtr(), nullptr);
+    planner.finish({*c});
+    ASSERT_EQ(MemoryPlanner::active(), nullptr);
+    ASSERT_NE(a->rawHostPtr(), nullptr);
+    ASSERT_NE(a->rawHostPtr(), b->rawHostPtr());
+    ASSERT_NE(b->rawHostPtr(), c->rawHostPtr());
+    ASSERT_EQ(a->rawHostPtr(), c->rawHostPtr());
+    ASSERT_EQ(planner.plannedSize(), 3 * a->cntSize());
+    ASSERT_EQ(planner.arenaSize(), 2 * a->cntSize());
+    // the arena is kept for the next forward.
+    auto *arena = a->rawHostPtr();
+    planner.begin();
+    planner.step({}, {a});
+    a->alloc();
+    planner.finish({*a});
+    ASSERT_EQ(a->rawHostPtr(), arena);
+    buffer->free();
+}
+
+TEST_F(CPUTest, CPUMemoryPlannerLLaMA) {
+    SineLoader loader;
+    const vector<int> prompt = {1, 5, 9, 33};
+    const vector<int> tokens = {7, 42, 42, 3, 99, 0, 18, 64};
+    auto model = tinyLLaMA(10000);
+    model.load(loader);
+    const auto expected = decodeLogits(model, prompt, tokens);
+    model.free();
+
+    // the prefill and the decoding forwards of a planned model.
+    auto planned = tinyLLaMA(10000);
+    planned.load(loader);
+    planned.planMemory();
+    auto logits = decodeLogits(planned, prompt, tokens);
+    ASSERT_EQ(logits.size(), expected.size());
+    for (int step = 0; step < logits.size(); ++step) {
+        ASSERT_EQ(logits[step], expected[step]) << "step " << step;
+    }
+    // the arena of the prefill is kept for the decoding.
+    ASSERT_GT(planned.memoryPlanner()->plannedSize(), 0);
+    ASSERT_GE(planned.memoryPlanner()->arenaSize(), planned.memoryPlanner()->plannedSize());
+    planned.free();
+
+    // the decoding replays an ExecutionPlan set up in the arena.
+    auto captured = tinyLLaMA(10000);
+    captured.load(loader);
+    captured.planMemory();
+    captured.captureExecution();
+    logits = decodeLogits(captured, prompt, tokens);
+    ASSERT_NE(captured.executionPlan(), nullptr);
+    ASSERT_TRUE(captured.executionPlan()->ready());
+    ASSERT_EQ(logits.size(), expected.size());
+    for (int step = 0; step < logits.size(); ++step) {
+        ASSERT_EQ(logits[step], expected[step]) << "step " << step;
+    }
+    captured.free();
+}
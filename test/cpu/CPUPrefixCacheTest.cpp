@@ -0,0 +1,84 @@
+#include "CPUTinyLLaMA.hpp"
+#include "PrefixCache.hpp"
+
+namespace {
+vector<unsigned int> ids(const vector<int> &tokens) {
+    return vector<unsigned int>(tokens.begin(), tokens.end());
+}
+
+// restore the longest cached prefix of `prompt` into the empty KV caches, then prefill the rest and decode.
+vector<int> cachedGreedy(LLaMAModel &model, PrefixCache &cache, const vector<int> &prompt, int steps, int &restored) {
+    model.clear_kvcache();
+    Tensor input = tokenInput(prompt);
+    restored = cache.restore(input);
+    auto tokens = greedy(model, input, steps);
+    cache.insert(ids(prompt));
+    return tokens;
+}
+} // namespace
+
+TEST_F(CPUTest, CPUPrefixCacheRestore) {
+    SineLoader loader;
+    const vector<int> system = {1, 17, 23, 5, 60, 8, 42, 3};
+    vector<int> prompt_a = system, prompt_b = system;
+    prompt_a.insert(prompt_a.end(), {9, 33, 71});
+    prompt_b.insert(prompt_b.end(), {12, 4, 88, 30});
+
+    auto cold = tinyLLaMA(10000);
+    cold.load(loader);
+    const auto expected = greedy(cold, prompt_b, 8);
+    cold.free();
+
+    auto model = tinyLLaMA(10000);
+    model.load(loader);
+    PrefixCache cache(model, 1 << 20);
+    int restored = -1;
+    cachedGreedy(model, cache, prompt_a, 8, restored);
+    ASSERT_EQ(restored, 0);
+    ASSERT_EQ(cache.size(), 1);
+    // the shared system prompt is restored, only the question of b is prefilled.
+    ASSERT_EQ(cachedGreedy(model, cache, prompt_b, 8, restored), expected);
+    ASSERT_EQ(restored, system.size());
+    // all but the last token of a prompt seen before.
+    ASSERT_EQ(cachedGreedy(model, cache, prompt_b, 8, restored), expected);
+    ASSERT_EQ(restored, prompt_b.size() - 1);
+    model.free();
+}
+
+TEST_F(CPUTest, CPUPrefixCacheEviction) {
+    SineLoader loader;
+    auto model = tinyLLaMA(10000);
+    model.load(loader);
+    const vector<vector<int>> prompts = {{1, 2, 3, 4, 5, 6}, {7, 8, 9, 10, 11, 12}, {13, 14, 15, 16, 17, 18}};
+    int restored = -1;
+    size_t entry_bytes = 0;
+    {
+        // the size of a snapshot of 6 tokens.
+        PrefixCache probe(model, 1 << 20);
+        cachedGreedy(model, probe, prompts[0], 1, restored);
+        entry_bytes = probe.memoryUsage();
+        ASSERT_GT(entry_bytes, 0);
+    }
+
+    // room for two snapshots.
+    PrefixCache cache(model, entry_bytes * 5 / 2);
+    cachedGreedy(model, cache, prompts[0], 1, restored);
+    cachedGreedy(model, cache, prompts[1], 1, restored);
+    ASSERT_EQ(cache.size(), 2);
+    // a hit makes prompts[0] the most recently used, so prompts[1] is evicted for prompts[2].
+    cachedGreedy(model, cache, prompts[0], 1, restored);
+    ASSERT_EQ(restored, prompts[0].size() - 1);
+    cachedGreedy(model, cache, prompts[2], 1, restored);
+    ASSERT_EQ(restored, 0);
+    ASSERT_EQ(cache.size(), 2);
+    ASSERT_LE(cache.memoryUsage(), entry_bytes * 5 / 2);
+
+    // prompts[1] comes back in place of prompts[0], now the least recently used.
+    cachedGreedy(model, cache, prompts[1], 1, restored);
+    ASSERT_EQ(restored, 0);
+    cachedGreedy(model, cache, prompts[2], 1, restored);
+    ASSERT_EQ(restored, prompts[2].size() - 1);
+    cachedGreedy(model, cache, prompts[0], 1, restored);
+    ASSERT_EQ(restored, 0);
+    model.free();
+}
@@ -0,0 +1,73 @@
+#include "CPUTest.hpp"
+#include "Profiler.hpp"
+#include "backends/cpu/CPUScale.hpp"
+#include "backends/cpu/CPUTensorFunction.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+TEST_F(CPUTest, CPUProfiler) {
+    SETUP_OP(CPUScale, 2.0, 0.0);
+    op->setOpType(SCALE);
+    CPUaddFunction add;
+    TENSOR(input);
+    input->reshape(1, 1, 2, 8);
+    input->alloc();
+    TENSOR(scaled);
+    TENSOR(output);
+    op->reshape({input}, {scaled});
+    op->setUp({input}, {scaled});
+    add.setup({output.get()}, {scaled.get()}, {1.0});
+
+    // nothing is recorded while no Profiler is active.
+    Profiler profiler;
+    Profiler::execute(op, {input}, {scaled});
+    ASSERT_EQ(profiler.size(), 0);
+
+    // the scale runs in place, the input is filled after it is set up.
+    input->fullData<float>(1.0);
+    profiler.begin();
+    ASSERT_EQ(Profiler::active(), &profiler);
+    Profiler::execute(op, {input}, {scaled});
+    Profiler::execute(&add, FUNC_ADD, {output.get()}, {scaled.get()}, {1.0});
+    profiler.end();
+    ASSERT_EQ(Profiler::active(), nullptr);
+    ASSERT_EQ(profiler.size(), 2);
+    for (int i = 0; i < output->count(); ++i) {
+        ASSERT_FLOAT_EQ(output->hostPtr<float>()[i], 3.0);
+    }
+
+    std::ostringstream summary;
+    profiler.summary(summary);
+    ASSERT_NE(summary.str().find("Scale"), string::npos);
+    ASSERT_NE(summary.str().find("add"), string::npos);
+
+    const string path = "CPUProfilerTest.json";
+    ASSERT_TRUE(profiler.writeChromeTrace(path));
+    std::ifstream file(path);
+    const string trace((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::remove(path.c_str());
+    ASSERT_EQ(trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0), 0);
+    ASSERT_NE(trace.find("\"name\":\"CPUScale\",\"cat\":\"Scale\",\"ph\":\"X\""), string::npos);
+    ASSERT_NE(trace.find("\"name\":\"output\",\"cat\":\"add\",\"ph\":\"X\""), string::npos);
+    // the bytes of the 16 floats read and written by the scale.
+    ASSERT_NE(trace.find("\"bytes_read\":64,\"bytes_written\":64"), string::npos);
+    // the add belongs to the layer of the scale before it.
+    const auto add_event = trace.find("\"name\":\"output\"");
+    ASSERT_NE(trace.find("\"layer\":\"CPUScale\"", add_event), string::npos);
+    delete op;
+}
+
+TEST_F(CPUTest, CPUProfilerCost) {
+    CPUmmFunction mm;
+    TENSOR(a);
+    a->reshape(1, 2, 4, 8);
+    TENSOR(b);
+    TENSOR(c);
+    c->reshape(1, 2, 4, 6);
+    ASSERT_EQ(mm.cost({c.get()}, {a.get(), b.get()}, {}).flops, 2 * 2 * 4 * 6 * 8);
+
+    ASSERT_EQ(Profiler::layerOf("model.layers.3.self_attn.q_proj"), "model.layers.3");
+    ASSERT_EQ(Profiler::layerOf("model.layers.12.mlp.down_proj-00_view_"), "model.layers.12");
+    ASSERT_EQ(Profiler::layerOf("lm_head"), "lm_head");
+}
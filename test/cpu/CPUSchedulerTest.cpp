@@ -0,0 +1,85 @@
+#include "CPUTinyLLaMA.hpp"
+#include "Scheduler.hpp"
+
+namespace {
+LlmTextGeneratorOpts greedyOpts(int max_new_tokens) {
+    LlmTextGeneratorOpts opt;
+    opt.do_sample = false;
+    opt.max_new_tokens = max_new_tokens;
+    return opt;
+}
+} // namespace
+
+TEST_F(CPUTest, CPUBatchScheduler) {
+    SineLoader loader;
+    const vector<vector<int>> prompts = {{1, 5, 9, 33}, {7, 2, 64, 20, 11}, {40, 3}};
+    const vector<int> lengths = {3, 8, 5};
+    vector<vector<int>> expected;
+    for (int i = 0; i < prompts.size(); ++i) {
+        auto model = tinyLLaMA(10000);
+        model.load(loader);
+        expected.push_back(greedy(model, prompts[i], lengths[i]));
+        model.free();
+    }
+
+    auto model = tinyLLaMA(10000);
+    model.load(loader);
+    LlmBatchScheduler scheduler(model, 2);
+    vector<vector<int>> outputs(prompts.size());
+    auto request = [&](int i) {
+        return scheduler.addRequest(vector<unsigned int>(prompts[i].begin(), prompts[i].end()), greedyOpts(lengths[i]),
+                                    [&outputs, i](unsigned int token) {
+                                        outputs[i].push_back((int)token);
+                                        return true;
+                                    });
+    };
+    ASSERT_EQ(request(0), 0);
+    ASSERT_EQ(request(1), 1);
+    ASSERT_TRUE(scheduler.step());
+    ASSERT_EQ(scheduler.runningRequests(), 2);
+    // both slots are taken, the third request waits.
+    ASSERT_EQ(request(2), 2);
+    ASSERT_TRUE(scheduler.step());
+    ASSERT_EQ(scheduler.waitingRequests(), 1);
+    // request 0 retires after its third token, request 2 takes its slot on the next step.
+    ASSERT_TRUE(scheduler.step());
+    ASSERT_EQ(outputs[0].size(), 3);
+    ASSERT_EQ(scheduler.runningRequests(), 1);
+    ASSERT_EQ(scheduler.waitingRequests(), 1);
+    ASSERT_TRUE(scheduler.step());
+    ASSERT_EQ(scheduler.runningRequests(), 2);
+    ASSERT_EQ(scheduler.waitingRequests(), 0);
+    ASSERT_EQ(outputs[2].size(), 1);
+    scheduler.run();
+    ASSERT_FALSE(scheduler.step());
+    ASSERT_EQ(scheduler.runningRequests(), 0);
+    // each sequence decodes as if it ran alone.
+    for (int i = 0; i < prompts.size(); ++i) {
+        ASSERT_EQ(outputs[i], expected[i]) << "request " << i;
+    }
+    model.free();
+}
+
+TEST_F(CPUTest, CPUBatchSchedulerStop) {
+    SineLoader loader;
+    auto model = tinyLLaMA(10000);
+    model.load(loader);
+    LlmBatchScheduler scheduler(model, 1);
+    vector<int> first, second;
+    // a call back returning false retires its request and frees the slot for the next one.
+    scheduler.addRequest({1, 5, 9, 33}, greedyOpts(10), [&](unsigned int token) {
+        first.push_back((int)token);
+        return first.size() < 2;
+    });
+    scheduler.addRequest({7, 2, 64}, greedyOpts(4), [&](unsigned int token) {
+        second.push_back((int)token);
+        return true;
+    });
+    scheduler.run();
+    ASSERT_EQ(first.size(), 2);
+    auto reference = tinyLLaMA(10000);
+    reference.load(loader);
+    ASSERT_EQ(second, greedy(reference, {7, 2, 64}, 4));
+    model.free();
+    reference.free();
+}
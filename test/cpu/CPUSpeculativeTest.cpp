@@ -0,0 +1,101 @@
+#include "CPUTinyLLaMA.hpp"
+
+namespace {
+vector<int> speculative(LLaMAModel &model, LLaMAModel &draft, const vector<int> &prompt, const LlmTextGeneratorOpts &opt, int draft_tokens) {
+    Tensor input = tokenInput(prompt);
+    vector<int> tokens;
+    model.generate(input, opt, draft, draft_tokens, [&](unsigned int token) {
+        tokens.push_back((int)token);
+        return true;
+    });
+    return tokens;
+}
+} // namespace
+
+TEST_F(CPUTest, CPUSpeculativeGreedy) {
+    SineLoader loader;
+    const vector<int> prompt = {1, 5, 9, 33};
+    const int steps = 16;
+    auto reference = tinyLLaMA(10000);
+    reference.load(loader);
+    const auto expected = greedy(reference, prompt, steps);
+    // the weights of the draft are those of the target shifted a little.
+    SineLoader draft_loader(0.3F);
+    auto other = tinyLLaMA(10000);
+    other.load(draft_loader);
+    // the draft below proposes other tokens than the target, some of them are rejected.
+    ASSERT_NE(greedy(other, prompt, steps), expected);
+    reference.free();
+    other.free();
+
+    LlmTextGeneratorOpts opt;
+    opt.do_sample = false;
+    opt.max_new_tokens = steps;
+    // a draft of the same weights, all its proposals are accepted.
+    {
+        auto model = tinyLLaMA(10000);
+        model.load(loader);
+        auto draft = tinyLLaMA(10000);
+        draft.load(loader);
+        ASSERT_EQ(speculative(model, draft, prompt, opt, 3), expected);
+        model.free();
+        draft.free();
+    }
+    // a draft of other weights, the rejected proposals are rewound and the target's token is taken instead.
+    for (int draft_tokens : {1, 4}) {
+        auto model = tinyLLaMA(10000);
+        model.load(loader);
+        auto draft = tinyLLaMA(10000);
+        draft.load(draft_loader);
+        ASSERT_EQ(speculative(model, draft, prompt, opt, draft_tokens), expected) << draft_tokens << " draft tokens";
+        model.free();
+        draft.free();
+    }
+}
+
+TEST_F(CPUTest, CPUSpeculativeSampling) {
+    SineLoader loader;
+    auto model = tinyLLaMA(10000);
+    model.load(loader);
+    SineLoader draft_loader(0.3F);
+    auto draft = tinyLLaMA(10000);
+    draft.load(draft_loader);
+    LlmTextGeneratorOpts opt;
+    opt.do_sample = true;
+    opt.top_k = 5;
+    opt.max_new_tokens = 16;
+    const auto tokens = speculative(model, draft, {1, 5, 9, 33}, opt, 3);
+    ASSERT_EQ(tokens.size(), opt.max_new_tokens);
+    for (int token : tokens) {
+        ASSERT_GE(token, 0);
+        ASSERT_LT(token, 100);
+    }
+
+    model.free();
+    draft.free();
+}
+
+TEST_F(CPUTest, CPUSpeculativeRewind) {
+    SineLoader loader;
+    // after a rewind the model continues as if the rewound tokens had never been fed.
+    auto model = tinyLLaMA(10000);
+    model.load(loader);
+    Tensor input = tokenInput({1, 5, 9, 33, 7, 8});
+    model({input});
+    model.rewind(2);
+    input = tokenInput({40});
+    auto logits = model({input})[0];
+    vector<float> rewound(logits.dimension());
+    for (int v = 0; v < logits.dimension(); ++v) {
+        rewound[v] = logits.dataAt<float>(0, 0, 0, v);
+    }
+    auto fresh = tinyLLaMA(10000);
+    fresh.load(loader);
+    input = tokenInput({1, 5, 9, 33, 40});
+    auto expected = fresh({input})[0];
+    for (int v = 0; v < expected.dimension(); ++v) {
+        ASSERT_NEAR(rewound[v], expected.dataAt<float>(0, 0, expected.sequence() - 1, v), 1e-4);
+    }
+    model.free();
+    fresh.free();
+}
@@ -0,0 +1,74 @@
+#include "CPUTest.hpp"
+#include "backends/cpu/ThreadPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+TEST_F(CPUTest, CPUThreadPool) {
+    mllm::ThreadPool pool(false, 4);
+    vector<std::atomic<int>> calls(7);
+    for (int round = 0; round < 3; ++round) {
+        pool.run(7, [&](int ith, int nth) {
+            EXPECT_EQ(nth, 7);
+            calls[ith]++;
+        });
+    }
+    for (auto &count : calls) {
+        EXPECT_EQ(count.load(), 3);
+    }
+    EXPECT_LE(pool.threads(), 4);
+    // a job submitted from inside a job runs on the calling thread.
+    std::atomic<int> nested{0};
+    pool.run(4, [&](int, int) {
+        pool.run(3, [&](int, int) { nested++; });
+    });
+    EXPECT_EQ(nested.load(), 12);
+}
+
+TEST_F(CPUTest, CPUThreadPoolParallelFor) {
+    const int n0 = 3, n1 = 5, n2 = 7;
+    vector<std::atomic<int>> hits(n0 * n1 * n2);
+    mllm::parallel_for_3d(n0, n1, n2, 4, [&](int i0, int i1, int i2) {
+        hits[(i0 * n1 + i1) * n2 + i2]++;
+    });
+    for (auto &count : hits) {
+        EXPECT_EQ(count.load(), 1);
+    }
+    std::atomic<int64_t> sum{0};
+    mllm::parallel_for(10, 110, 3, [&](int64_t i) { sum += i; });
+    EXPECT_EQ(sum.load(), 5950);
+}
+
+TEST_F(CPUTest, CPUThreadPoolSessions) {
+    // two sessions submitting jobs at the same time share the workers: neither of them runs its jobs alone
+    // while the other one holds every worker.
+    mllm::ThreadPool pool(false, 4);
+    const int jobs = 30, nth = 4;
+    const auto sleep = std::chrono::milliseconds(2);
+    auto session = [&](double &ms, int &shared) {
+        const auto caller = std::this_thread::get_id();
+        const auto start = std::chrono::steady_clock::now();
+        for (int job = 0; job < jobs; ++job) {
+            std::atomic<int> elsewhere{0};
+            pool.run(nth, [&](int, int) {
+                std::this_thread::sleep_for(sleep);
+                elsewhere += std::this_thread::get_id() != caller;
+            });
+            shared += elsewhere.load() > 0;
+        }
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    pool.run(nth, [](int, int) {});
+    double ms[2] = {0, 0};
+    int shared[2] = {0, 0};
+    std::thread other(session, std::ref(ms[1]), std::ref(shared[1]));
+    session(ms[0], shared[0]);
+    other.join();
+    // run alone, a session would take jobs * nth sleeps, 2 threads each halve it.
+    const double serial = jobs * nth * 2.0;
+    for (int i = 0; i < 2; ++i) {
+        EXPECT_GT(shared[i], jobs / 2) << "session " << i;
+        EXPECT_LT(ms[i], 0.75 * serial) << "session " << i;
+    }
+    EXPECT_LT(std::max(ms[0], ms[1]), 1.5 * std::min(ms[0], ms[1]));
+}
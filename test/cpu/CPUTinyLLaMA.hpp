@@ -0,0 +1,91 @@
+#ifndef MLLM_CPUTINYLLAMA_HPP
+#define MLLM_CPUTINYLLAMA_HPP
+#include "CPUTest.hpp"
+#include "models/llama/modeling_llama.hpp"
+#include <cmath>
+
+// a LLaMA small enough to run whole in the tests, of F32 weights which depend on their names and `phase` only.
+class SineLoader : public AbstructLoader {
+public:
+    explicit SineLoader(float phase = 0) :
+        phase_(phase) {
+    }
+    bool load(Tensor *tensor) override {
+        const size_t seed = std::hash<std::string>()(tensor->name()) % 1000;
+        const bool norm = tensor->name().find("norm") != string::npos;
+        for (int i = 0; i < tensor->count(); ++i) {
+            tensor->hostPtr<float>()[i] = norm ? 1.0F : 0.2F * std::sin(seed + i * 0.37F + phase_);
+        }
+        return true;
+    }
+    bool load(std::shared_ptr<Tensor> tensor) override {
+        return load(tensor.get());
+    }
+    DataType getDataType(string name) override {
+        return MLLM_TYPE_F32;
+    }
+
+private:
+    float phase_;
+};
+
+inline LLaMAModel tinyLLaMA(float rope_theta, int cache_limit = 64) {
+    LLaMANameConfig names;
+    names.init(LLAMAROPE);
+    return LLaMAModel(100, 32, 2, 2, 64, 1, LLAMAROPE, rope_theta, 64, cache_limit, names, names.blk_name);
+}
+
+inline Tensor tokenInput(const vector<int> &tokens) {
+    Tensor input(1, 1, (int)tokens.size(), 1, Module::backends[MLLM_CPU], true);
+    input.setTtype(INPUT_TENSOR);
+    for (int i = 0; i < tokens.size(); ++i) {
+        input.setDataAt<float>(0, 0, i, 0, (float)tokens[i]);
+    }
+    return input;
+}
+
+inline int argmax(Tensor &logits, int row) {
+    int best = 0;
+    for (int v = 1; v < logits.dimension(); ++v) {
+        if (logits.dataAt<float>(0, 0, row, v) > logits.dataAt<float>(0, 0, row, best)) {
+            best = v;
+        }
+    }
+    return best;
+}
+
+// the greedy tokens after the token ids `input`.
+inline vector<int> greedy(LLaMAModel &model, Tensor input, int steps) {
+    vector<int> tokens;
+    for (int step = 0; step < steps; ++step) {
+        auto logits = model({input})[0];
+        const int best = argmax(logits, logits.sequence() - 1);
+        tokens.push_back(best);
+        input.reshape(1, 1, 1, 1);
+        input.alloc();
+        input.setDataAt<float>(0, 0, 0, 0, (float)best);
+    }
+    return tokens;
+}
+
+inline vector<int> greedy(LLaMAModel &model, const vector<int> &prompt, int steps) {
+    return greedy(model, tokenInput(prompt), steps);
+}
+
+// the logits of the prompt and of each of the `tokens` decoded after it.
+inline vector<vector<float>> decodeLogits(LLaMAModel &model, const vector<int> &prompt, const vector<int> &tokens) {
+    vector<vector<float>> logits;
+    Tensor input = tokenInput(prompt);
+    for (int step = 0; step <= tokens.size(); ++step) {
+        auto output = model({input})[0];
+        logits.emplace_back(output.hostPtr<float>(), output.hostPtr<float>() + output.count());
+        if (step < tokens.size()) {
+            input.reshape(1, 1, 1, 1);
+            input.alloc();
+            input.setDataAt<float>(0, 0, 0, 0, (float)tokens[step]);
+        }
+    }
+    return logits;
+}
+
+#endif // MLLM_CPUTINYLLAMA_HPP
@@ -4,6 +4,8 @@
 #include "gtest/gtest.h"
 #include "TokenizorTest.hpp"
 #include "tokenizers/BPE/Bpe.hpp"
+#include <cstdint>
+#include <cstdio>
 TEST_F(TokenizerTest, OPTTokenizerTest) {
     GTEST_SKIP();
     auto bpe = new mllm::BPETokenizer("./vocab_opt.mllm");
@@ -35,3 +37,106 @@ TEST_F(TokenizerTest, OPTTokenizerTest) {
 
 
 }
+
+TEST_F(TokenizerTest, BPEPretokenizeTest) {
+    auto words = mllm::BPETokenizer::pretokenize("<|startoftext|>a photo of it's 2 cats,dogs  <|endoftext|>\n");
+    vector<string> expected = {"<|startoftext|>", "a", "photo", "of", "it", "'s", "2", "cats", ",dogs", "<|endoftext|>"};
+    ASSERT_EQ(words, expected);
+    ASSERT_EQ(mllm::BPETokenizer::pretokenize("'x<|foo|> \xe6\x97\xa5\xe6\x9c\xac"), (vector<string>{"'x<|foo|>", "\xe6\x97\xa5\xe6\x9c\xac"}));
+    ASSERT_TRUE(mllm::BPETokenizer::pretokenize(" \t\r\n").empty());
+}
+
+namespace {
+// the merges of a word as BPETokenizer did before the heap: apply every occurrence of the pair of the lowest
+// rank in turn, finding that pair again over the whole word each time.
+vector<string> naiveBpe(const string &word, const std::unordered_map<string, unsigned> &merge_rank) {
+    vector<string> splits;
+    for (char c : word) {
+        splits.emplace_back(1, c);
+    }
+    while (splits.size() > 1) {
+        unsigned best_rank = UINT32_MAX;
+        int best = -1;
+        for (int i = 1; i < splits.size(); ++i) {
+            auto rank = merge_rank.find(splits[i - 1] + " " + splits[i]);
+            if (rank != merge_rank.end() && rank->second < best_rank) {
+                best_rank = rank->second;
+                best = i - 1;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        const string first = splits[best], second = splits[best + 1];
+        vector<string> merged;
+        for (int i = 0; i < splits.size(); ++i) {
+            if (i + 1 < splits.size() && splits[i] == first && splits[i + 1] == second) {
+                merged.push_back(first + second);
+                ++i;
+            } else {
+                merged.push_back(splits[i]);
+            }
+        }
+        splits = merged;
+    }
+    return splits;
+}
+
+void writeVocab(const string &path, const vector<string> &vocab) {
+    FILE *fp = fopen(path.c_str(), "wb");
+    ASSERT_NE(fp, nullptr);
+    auto write_int = [fp](int32_t value) { fwrite(&value, sizeof(value), 1, fp); };
+    write_int(23333);
+    write_int((int32_t)vocab.size());
+    for (int id = 0; id < vocab.size(); ++id) {
+        write_int(id);
+        write_int((int32_t)vocab[id].size());
+        fwrite(vocab[id].data(), 1, vocab[id].size(), fp);
+        // the encoder emits the score of a piece as its id.
+        const float score = (float)id;
+        fwrite(&score, sizeof(score), 1, fp);
+    }
+    fclose(fp);
+}
+} // namespace
+
+TEST_F(TokenizerTest, BPEMergeTest) {
+    // overlapping merges ("a a" and "aa a" against "a b"), and ones which need another merged first.
+    const vector<string> merges = {"a a", "b c", "aa a", "a b", "ab c", "c d", "bc d", "aa b", "e e", "ee e", "aab cd"};
+    vector<string> vocab = {"<unk>", "<s>", "</s>", "a", "b", "c", "d", "e"};
+    std::unordered_map<string, unsigned> merge_rank;
+    for (unsigned rank = 0; rank < merges.size(); ++rank) {
+        merge_rank[merges[rank]] = rank;
+        auto space = merges[rank].find(' ');
+        vocab.push_back(merges[rank].substr(0, space) + merges[rank].substr(space + 1));
+    }
+    const string vocab_path = ::testing::TempDir() + "bpe_merge_vocab.mllm";
+    writeVocab(vocab_path, vocab);
+    mllm::BPETokenizer bpe(vocab_path);
+    bpe.setMergeRank(merge_rank);
+    bpe.setSpecialToken("<s>", "</s>", "<unk>");
+    std::unordered_map<string, mllm::token_id_t> vocab_ids;
+    for (int id = 0; id < vocab.size(); ++id) {
+        vocab_ids[vocab[id]] = id;
+    }
+
+    const string text = "aaaa aaab abcd aaaaa bcbcd eeeee aabcd aaaa z aazb abcd aaaaaaab eeee aaaa abcabc aaab";
+    vector<mllm::token_id_t> expected;
+    for (const auto &word : mllm::BPETokenizer::pretokenize(text)) {
+        for (const auto &piece : naiveBpe(word, merge_rank)) {
+            auto id = vocab_ids.find(piece);
+            expected.push_back(id == vocab_ids.end() ? vocab_ids["<unk>"] : id->second);
+        }
+    }
+    expected.push_back(vocab_ids["</s>"]);
+    // no cache, a cache which evicts most of the repeated words before they come again, and the default one.
+    for (size_t cache_size : {0, 2, 4096}) {
+        bpe.setWordCacheSize(cache_size);
+        for (int pass = 0; pass < 2; ++pass) {
+            vector<mllm::token_id_t> tokens;
+            bpe.tokenize(text, tokens, false, false, "");
+            ASSERT_EQ(tokens, expected) << "cache of " << cache_size << " words, pass " << pass;
+        }
+    }
+    std::remove(vocab_path.c_str());
+}
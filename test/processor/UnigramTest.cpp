@@ -31,4 +31,19 @@ TEST_F(TokenizerTest, UnigramTest) {
     std::cout << result << std::endl;
 
 
-}
\ No newline at end of file
+}
+TEST_F(TokenizerTest, DoubleArrayTrieTest) {
+    mllm::DoubleArrayTrie trie;
+    trie.build({{"ab", 1, -1.0F}, {"a", 0, -0.5F}, {"abc", 2, -2.0F}, {"b", 3, -3.0F}, {"\xe2\x96\x81", 4, -4.0F}, {"a", 5, 0.0F}});
+    std::vector<std::pair<size_t, int32_t>> matches;
+    auto collect = [&](size_t length, int32_t id, float score) { matches.emplace_back(length, id); };
+    trie.commonPrefixSearch("abcd", collect);
+    ASSERT_EQ(matches, (std::vector<std::pair<size_t, int32_t>>{{1, 0}, {2, 1}, {3, 2}}));
+    matches.clear();
+    trie.commonPrefixSearch("\xe2\x96\x81" "a", collect);
+    ASSERT_EQ(matches, (std::vector<std::pair<size_t, int32_t>>{{3, 4}}));
+    matches.clear();
+    trie.commonPrefixSearch("c", collect);
+    trie.commonPrefixSearch("", collect);
+    ASSERT_TRUE(matches.empty());
+}
@@ -2,12 +2,19 @@
 // Created by Xiang Li on 23-11-2.
 //
 #include "gtest/gtest.h"
+#include <cstring>
+#include <fstream>
+#include <random>
 #include <unordered_map>
+#include "Imatrix.hpp"
 #include "ParamLoader.hpp"
 #include "ParamWriter.hpp"
 #include "QuantWriter.hpp"
 #include "QuantTest.hpp"
 #include "Types.hpp"
+#include "backends/cpu/CPUBackend.hpp"
+#include "backends/cpu/quantize/QuantizeQ6.hpp"
+#include "memory/SystemMemoryManager.hpp"
 namespace mllm {
 TEST_F(QuantTest, ReadTest) {
     auto loader = ParamLoader("../bin/quant_test.mllm");
@@ -57,4 +64,133 @@ TEST_F(QuantTest, QuantTest) {
     auto *ori_data = quant->data_["weight_f1"];
     ASSERT_TRUE(compare_eq(reinterpret_cast<block_q4_0 *>(ori_data), reinterpret_cast<block_q4_0 *>(data)));
 }
+TEST_F(QuantTest, MmapLoadTest) {
+    vector<string> names = {"weight_a", "weight_b"};
+    vector<float> a = {1.f, 2.f, 3.f};
+    vector<float> b(64);
+    for (int i = 0; i < b.size(); i++) {
+        b[i] = i * 0.5f;
+    }
+    auto *writer = new ParamWriter("../bin/mmap_test.mllm");
+    writer->paddingIndex(names);
+    writer->writeParam("weight_a", DataType::MLLM_TYPE_F32, a.data(), a.size() * sizeof(float));
+    writer->writeParam("weight_b", DataType::MLLM_TYPE_F32, b.data(), b.size() * sizeof(float));
+    writer->writeIndex();
+    delete writer;
+
+    shared_ptr<MemoryManager> mm = std::make_shared<SystemMemoryManager>();
+    CPUBackend bn(mm);
+    auto loader = ParamLoader("../bin/mmap_test.mllm", true);
+    ASSERT_TRUE(loader.isMmaped());
+    Tensor weight(&bn);
+    weight.setName("weight_b");
+    weight.reshape(1, 1, 1, b.size());
+    weight.setDtype(loader.getDataType("weight_b"));
+    weight.alloc();
+    ASSERT_TRUE(loader.load(&weight));
+    ASSERT_TRUE(weight.externalHostPtr());
+    ASSERT_EQ((uintptr_t)weight.rawHostPtr() % _PARAM_ALIGNMENT, 0);
+    for (int i = 0; i < b.size(); i++) {
+        ASSERT_EQ(weight.dataAt<float>(0, 0, 0, i), b[i]);
+    }
+    weight.free();
+    ASSERT_EQ(weight.rawHostPtr(), nullptr);
+    // the mapping is read-only, loadCopy gives a weight that can be written.
+    Tensor copy(&bn);
+    copy.setName("weight_b");
+    copy.reshape(1, 1, 1, b.size());
+    copy.setDtype(loader.getDataType("weight_b"));
+    copy.alloc();
+    ASSERT_TRUE(loader.loadCopy(&copy));
+    ASSERT_FALSE(copy.externalHostPtr());
+    copy.setDataAt<float>(0, 0, 0, 1, -1.F);
+    ASSERT_EQ(copy.dataAt<float>(0, 0, 0, 2), b[2]);
+    ASSERT_EQ(copy.dataAt<float>(0, 0, 0, 1), -1.F);
+}
+TEST_F(QuantTest, PolicyTest) {
+    vector<string> names = {"model.layers.0.mlp.up_proj.weight", "lm_head.weight"};
+    vector<float> w(256);
+    for (int i = 0; i < w.size(); i++) {
+        w[i] = (i % 17) * 0.25f - 2.f;
+    }
+    auto *writer = new ParamWriter("../bin/policy_test.mllm");
+    writer->paddingIndex(names);
+    for (const auto &name : names) {
+        writer->writeParam(name, DataType::MLLM_TYPE_F32, w.data(), w.size() * sizeof(float));
+    }
+    writer->writeIndex();
+    delete writer;
+    std::ofstream("../bin/policy_test.txt") << "# keep the head in 8 bits\nlm_head Q8_0\n";
+
+    auto *quant = new QuantWriter("../bin/policy_result.mllm", "../bin/policy_test.mllm");
+    ASSERT_TRUE(quant->loadPolicy("../bin/policy_test.txt"));
+    quant->setThreads(2);
+    ASSERT_EQ(quant->readParams(), 2);
+    quant->quantParams(DataType::MLLM_TYPE_Q4_0);
+    auto loader = ParamLoader("../bin/policy_result.mllm");
+    ASSERT_EQ(loader.getDataType(names[0]), DataType::MLLM_TYPE_Q4_0);
+    ASSERT_EQ(loader.getDataType(names[1]), DataType::MLLM_TYPE_Q8_0);
+    for (const auto &name : names) {
+        auto [data, size] = loader.load(name);
+        ASSERT_EQ(size, DataTypeSize(loader.getDataType(name), w.size()));
+        ASSERT_EQ(memcmp(data, quant->data_[name], size), 0);
+        delete[] data;
+    }
+    delete quant;
+
+    std::ofstream("../bin/policy_test.txt") << "lm_head Q9_0\n";
+    QuantWriter bad("../bin/policy_result.mllm", "../bin/policy_test.mllm");
+    ASSERT_FALSE(bad.loadPolicy("../bin/policy_test.txt"));
+}
+TEST_F(QuantTest, ImatrixTest) {
+    const int rows = 8, cols = 512;
+    std::mt19937 gen(0);
+    std::normal_distribution<float> normal;
+    vector<float> x(2 * cols), w(rows * cols);
+    // a few channels of the activations are much larger, as in LLMs.
+    for (int i = 0; i < x.size(); i++) {
+        x[i] = normal(gen) * (i % 16 == 0 ? 10.f : 1.f);
+    }
+    for (auto &v : w) {
+        v = normal(gen);
+    }
+    Imatrix collected;
+    collected.add("w", x.data(), 1, cols, cols);
+    collected.add("w", x.data() + cols, 1, cols, cols);
+    ASSERT_TRUE(collected.save("../bin/imatrix_test.imatrix"));
+    Imatrix imatrix;
+    ASSERT_TRUE(imatrix.load("../bin/imatrix_test.imatrix"));
+    auto weights = imatrix.weights("w");
+    ASSERT_EQ(weights.size(), cols);
+    ASSERT_FLOAT_EQ(weights[3], (x[3] * x[3] + x[cols + 3] * x[cols + 3]) / 2);
+    ASSERT_TRUE(imatrix.weights("v").empty());
+
+    // the error of the outputs, the squared error of the weights weighed by the imatrix, is smaller with it.
+    auto error = [&](DataType type, const float *quant_weights) {
+        vector<char> q(DataTypeSize(type, w.size()));
+        vector<float> dq(w.size());
+        switch (type) {
+        case MLLM_TYPE_Q4_0:
+            quantize_q4_0(w.data(), q.data(), rows, cols, quant_weights);
+            dequantize_row_q4_0(q.data(), dq.data(), dq.size());
+            break;
+        case MLLM_TYPE_Q4_K:
+            quantize_q4_K(w.data(), q.data(), rows, cols, quant_weights);
+            dequantize_row_q4_K((block_q4_K *)q.data(), dq.data(), dq.size());
+            break;
+        default:
+            quantize_q6_K(w.data(), q.data(), rows, cols, quant_weights);
+            dequantize_row_q6_K((block_q6_K *)q.data(), dq.data(), dq.size());
+            break;
+        }
+        double sum = 0;
+        for (int i = 0; i < w.size(); i++) {
+            sum += weights[i % cols] * (w[i] - dq[i]) * (w[i] - dq[i]);
+        }
+        return sum;
+    };
+    for (auto type : {MLLM_TYPE_Q4_0, MLLM_TYPE_Q4_K, MLLM_TYPE_Q6_K}) {
+        ASSERT_LT(error(type, weights.data()), error(type, nullptr)) << DataTypeName(type);
+    }
+}
 } // namespace mllm
@@ -7,6 +7,7 @@ import os
 import torch
 
 MAGIC_NUMBER = 20012
+PARAM_ALIGNMENT = 32
 file_map = {}
 
 
@@ -68,6 +69,9 @@ class Writer:
     def write_tensor(self, tensor: torch.Tensor, name: str) -> [int, int]:
         tensor_idx = Tensor(name=name, dtype=self.__torch_dtype_to_int(tensor.dtype))
         self.tensors_map[name] = tensor_idx
+        # pad to PARAM_ALIGNMENT so that mllm can use the weights in-place from a mmaped file
+        padding = (PARAM_ALIGNMENT - self.writer.tell() % PARAM_ALIGNMENT) % PARAM_ALIGNMENT
+        self.writer.write(b"\x00" * padding)
         offset = self.writer.tell()
         if tensor.dtype == torch.bfloat16:  # to float 16
             tensor_numpy = tensor.detach().to(torch.float32).numpy()